@@ -0,0 +1,67 @@
+#include <y_format.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+double Now () {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// A typical log line: a timestamp, a level, a module name, and a couple of numbers.
+template <typename F>
+void Bench (char const * name, F && format_one) {
+    constexpr int Reps = 2'000'000;
+    char buffer [256];
+    unsigned total = 0;
+    auto t0 = Now();
+    for (int i = 0; i < Reps; ++i)
+        total += format_one(buffer, unsigned(sizeof(buffer)), i);
+    auto t1 = Now();
+    ::printf("%-28s %7.1f ns/line  (%u bytes; last: %s)\n", name, (t1 - t0) * 1e9 / Reps, total, buffer);
+}
+
+template <typename F>
+void BenchStr (char const * name, F && format_one) {
+    constexpr int Reps = 2'000'000;
+    std::string s;
+    size_t total = 0;
+    auto t0 = Now();
+    for (int i = 0; i < Reps; ++i) {
+        s = format_one(i);
+        total += s.size();
+    }
+    auto t1 = Now();
+    ::printf("%-28s %7.1f ns/line  (%zu bytes; last: %s)\n", name, (t1 - t0) * 1e9 / Reps, total, s.c_str());
+}
+
+int main () {
+    char const * const module = "net.session";
+    double const ratio = 0.8125;
+
+    Bench("snprintf", [&](char * buf, unsigned size, int i) {
+        return unsigned(::snprintf(buf, size, "[%10lld] %-5s %s: processed %d packets, %d dropped, ratio %g",
+            1'650'000'000'000LL + i, "INFO", module, i, i % 7, ratio));
+    });
+    Bench("y::fmt::ToCStr", [&](char * buf, unsigned size, int i) {
+        return y::fmt::ToCStr(buf, size, "[{w10r}] {w5} {}: processed {} packets, {} dropped, ratio {}",
+            1'650'000'000'000LL + i, "INFO", module, i, i % 7, ratio);
+    });
+    Bench("y::fmt::ToCStr + Y_FMT", [&](char * buf, unsigned size, int i) {
+        return y::fmt::ToCStr(buf, size, Y_FMT("[{w10r}] {w5} {}: processed {} packets, {} dropped, ratio {}"),
+            1'650'000'000'000LL + i, "INFO", module, i, i % 7, ratio);
+    });
+
+    // Into a std::string, formatted in a single pass (no size pre-count)
+    BenchStr("y::fmt::ToStr", [&](int i) {
+        return y::fmt::ToStr("[{w10r}] {w5} {}: processed {} packets, {} dropped, ratio {}",
+            1'650'000'000'000LL + i, "INFO", module, i, i % 7, ratio);
+    });
+    BenchStr("y::fmt::ToStr + Y_FMT", [&](int i) {
+        return y::fmt::ToStr(Y_FMT("[{w10r}] {w5} {}: processed {} packets, {} dropped, ratio {}"),
+            1'650'000'000'000LL + i, "INFO", module, i, i % 7, ratio);
+    });
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "../experimental/y_bignum.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+static double Now () {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(high_resolution_clock::now().time_since_epoch()).count();
+}
+
+static unsigned volatile g_sink;
+
+// Best of a few runs, in microseconds per multiplication of two n-digit
+//  numbers, with the given thresholds
+static double Bench (int n, int karatsuba_threshold, int toom3_threshold) {
+    y_bignum_karatsuba_threshold = karatsuba_threshold;
+    y_bignum_toom3_threshold = toom3_threshold;
+
+    std::mt19937 rng (n);
+    y_bignum_num_t a = {}, b = {}, r = {}, scratch = {};
+    y_bignum_realloc(&a, n, false);
+    y_bignum_realloc(&b, n, false);
+    y_bignum_realloc(&r, 2 * n, false);
+    for (int i = 0; i < n; ++i) {
+        a.digs[i] = rng() | 1;
+        b.digs[i] = rng() | 1;
+    }
+    int const scratch_size = y_bignum_mul_scratch_size(n, n);
+    if (scratch_size > 0)
+        y_bignum_realloc(&scratch, scratch_size, false);
+
+    int const reps = 1 + 2'000'000 / (n * n);
+    double best = 1e30;
+    for (int run = 0; run < 5; ++run) {
+        auto t0 = Now();
+        for (int i = 0; i < reps; ++i)
+            y_bignum_mul_with_scratch(&r, &a, &b, &scratch);
+        auto t1 = Now();
+        g_sink = r.digs[n];
+        if (t1 - t0 < best)
+            best = t1 - t0;
+    }
+
+    y_bignum_free(&a);
+    y_bignum_free(&b);
+    y_bignum_free(&r);
+    y_bignum_free(&scratch);
+    return best * 1e6 / reps;
+}
+
+// Microseconds per modular exponentiation with a random n-digit odd (or even)
+//  modulus, and per division of a 2n-digit number by it
+static void BenchModular (char const * name, int n, int exp_digits, bool odd) {
+    std::mt19937 rng (n + exp_digits);
+    y_bignum_num_t g = {}, e = {}, m = {}, r = {}, a = {}, q = {}, scratch = {};
+    y_bignum_realloc(&g, n, false);
+    y_bignum_realloc(&e, exp_digits, false);
+    y_bignum_realloc(&m, n, false);
+    y_bignum_realloc(&r, n, false);
+    y_bignum_realloc(&a, 2 * n, false);
+    y_bignum_realloc(&q, n + 1, false);
+    for (int i = 0; i < n; ++i) {
+        g.digs[i] = rng();
+        m.digs[i] = rng();
+    }
+    m.digs[n - 1] |= 0x8000'0000;
+    m.digs[0] = odd ? (m.digs[0] | 1) : (m.digs[0] & ~1U);
+    for (int i = 0; i < exp_digits; ++i)
+        e.digs[i] = rng();
+    if (1 == exp_digits)
+        e.digs[0] = 65537;
+    for (int i = 0; i < 2 * n; ++i)
+        a.digs[i] = rng();
+    int const scratch_size = std::max(y_bignum_powmod_scratch_size(n, exp_digits, n), y_bignum_divmod_scratch_size(2 * n, n));
+    y_bignum_realloc(&scratch, scratch_size, false);
+
+    auto best_of = [&] (int reps, auto && f) {
+        double best = 1e30;
+        for (int run = 0; run < 5; ++run) {
+            auto t0 = Now();
+            for (int i = 0; i < reps; ++i)
+                f();
+            auto t1 = Now();
+            if (t1 - t0 < best)
+                best = t1 - t0;
+        }
+        return best * 1e6 / reps;
+    };
+    double const powmod = best_of((1 == exp_digits) ? 200 : 3, [&] {
+        y_bignum_powmod_with_scratch(&r, &g, &e, &m, &scratch);
+        g_sink = r.digs[0];
+    });
+    double const div = best_of(1000, [&] {
+        y_bignum_divmod_with_scratch(&q, &r, &a, &m, &scratch);
+        g_sink = q.digs[0];
+    });
+    ::printf("%-28s powmod %10.1f us | %d-by-%d digit divmod %7.2f us\n", name, powmod, 2 * n, n, div);
+
+    y_bignum_free(&g);
+    y_bignum_free(&e);
+    y_bignum_free(&m);
+    y_bignum_free(&r);
+    y_bignum_free(&a);
+    y_bignum_free(&q);
+    y_bignum_free(&scratch);
+}
+
+int main () {
+    int const karatsuba = y_bignum_karatsuba_threshold;
+    int const toom3 = y_bignum_toom3_threshold;
+    int const never = 1 << 30;
+
+    // Where one level of Karatsuba (or Toom-3) on top of what's below it
+    //  starts to pay off is where the threshold should be.
+    ::printf("%8s %14s %14s\n", "digits", "schoolbook", "Karatsuba");
+    for (int n = 16; n <= 64; n += 8)
+        ::printf("%8d %11.2f us %11.2f us\n", n, Bench(n, never, never), Bench(n, n, never));
+    ::printf("%8s %14s %14s\n", "digits", "Karatsuba", "Toom-3");
+    for (int n = 60; n <= 300; n += 30)
+        ::printf("%8d %11.2f us %11.2f us\n", n, Bench(n, karatsuba, never), Bench(n, karatsuba, n));
+
+    ::printf("\nthresholds: Karatsuba from %d digits, Toom-3 from %d\n", karatsuba, toom3);
+    ::printf("%8s %14s %14s %14s\n", "digits", "schoolbook", "Karatsuba", "Toom-3");
+    for (int n : {32, 64, 128, 256, 512, 1024, 2048, 4096, 8192}) {
+        double const school = Bench(n, never, never);
+        double const kara = Bench(n, karatsuba, never);
+        double const toom = Bench(n, karatsuba, toom3);
+        ::printf("%8d %11.2f us %11.2f us %11.2f us\n", n, school, kara, toom);
+    }
+
+    ::printf("\n");
+    BenchModular("1024-bit, e = 65537", 32, 1, true);
+    BenchModular("2048-bit, e = 65537", 64, 1, true);
+    BenchModular("4096-bit, e = 65537", 128, 1, true);
+    BenchModular("1024-bit, full exponent", 32, 32, true);
+    BenchModular("2048-bit, full exponent", 64, 64, true);
+    BenchModular("2048-bit even, full exponent", 64, 64, false);
+    return 0;
+}
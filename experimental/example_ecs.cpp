@@ -220,6 +220,147 @@ int main () {
             ::printf("\n");
         }
     }
+
+    {
+        using MoveParams = ex::QueryParams<
+            ex::ComponentTypePack<PositionComponent>,
+            ex::ComponentTypePack<DirectionComponent>,
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<>,
+            ex::TagTypePack<>,
+            ex::TagTypePack<InactiveTag>
+        >;
+        using FlagsParams = ex::QueryParams<
+            ex::ComponentTypePack<FlagsComponent>,
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<>,
+            ex::TagTypePack<>,
+            ex::TagTypePack<>
+        >;
+        using NamesParams = ex::QueryParams<
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<NameComponent, PositionComponent>,
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<>,
+            ex::ComponentTypePack<>,
+            ex::TagTypePack<>,
+            ex::TagTypePack<>
+        >;
+
+        ex::World world_;
+        auto world = &world_;
+        ex::World_Create(world, tm, 16384);
+
+        ex::JobPool * pool = nullptr;
+        ex::JobPool_Create(&pool);
+
+        ex::Query<MoveParams> move_query;
+        ex::Query<FlagsParams> flags_query;
+        ex::Query<NamesParams> names_query;
+        ex::Query_Create(&move_query, world);
+        ex::Query_Create(&flags_query, world);
+        ex::Query_Create(&names_query, world);
+
+        auto noop = [](ex::World *, ex::JobPool *, void *) {};
+        auto move = [](ex::World *, ex::JobPool * pool, void * user_data) {
+            auto query = static_cast<ex::Query<MoveParams> const *>(user_data);
+            ex::Query_ForEachParallel(query, pool, [](ex::QueryChunk<MoveParams> const & chunk, unsigned /*worker_index*/) {
+                PositionComponent * pos = std::get<0>(chunk.arrays.fullaccess);
+                DirectionComponent const * dir = std::get<0>(chunk.arrays.readonly);
+                for (ex::SizeType i = 0; i < chunk.count; ++i) {
+                    pos[i].x += dir[i].x;
+                    pos[i].y += dir[i].y;
+                    pos[i].z += dir[i].z;
+                }
+            });
+        };
+        ex::Scheduler scheduler;
+        ex::Scheduler_Create(&scheduler, world, pool);
+        ex::Scheduler_AddSystem(&scheduler, "Move", &move_query, move, &move_query);
+        ex::Scheduler_AddSystem(&scheduler, "Flags", &flags_query, noop, nullptr);
+        ex::Scheduler_AddSystem(&scheduler, "Names", &names_query, noop, nullptr);
+        ex::Scheduler_AddSystem(&scheduler, "Move again", &move_query, move, &move_query);
+        ex::Scheduler_Build(&scheduler);
+
+        ::printf("\n%u worker threads; %u systems in %u waves:\n", ex::JobPool_ThreadCount(pool), scheduler.system_count, scheduler.wave_count);
+        for (unsigned i = 0; i < scheduler.system_count; ++i)
+            ::printf("    wave %u: %s\n", scheduler.systems[i].wave, scheduler.systems[i].name);
+
+        auto t0 = 1'000 * Now();
+        for (int i = 0; i < 1'000; ++i)
+            ex::Scheduler_Run(&scheduler);
+        auto t1 = 1'000 * Now();
+        ::printf("1000 runs of an empty schedule: %.3f ms\n", t1 - t0);
+
+        t0 = 1'000 * Now();
+        for (int i = 0; i < 100'000; ++i)
+            ex::Query_Create(&move_query, world);
+        t1 = 1'000 * Now();
+        ::printf("100000 (cached) query creations: %.3f ms; %u entity types matched\n", t1 - t0, move_query.entity_type_count);
+
+        ex::ComponentBitSet d_comps;
+        ex::TagBitSet d_tags;
+        ex::SizeType d_index = 0;
+        ex::ComponentBitSet_Make(&d_comps, tm, {"Position", "Direction", "Flags"});
+        ex::TagBitSet_MakeEmpty(&d_tags);
+        ex::World_AddEntityType(world, &d_index, "F", d_comps, d_tags, 1'000);
+        ex::Query_Create(&move_query, world);
+        ::printf("Added entity type #%u; now %u entity types matched\n", d_index, move_query.entity_type_count);
+
+        {
+            ex::ComponentBitSet b_comps;
+            ex::TagBitSet b_tags, b_inactive_tags;
+            ex::SizeType b_index = 0, b_inactive_index = 0;
+            ex::ComponentBitSet_Make(&b_comps, tm, {"Name", "Position", "Direction"});
+            ex::TagBitSet_MakeEmpty(&b_tags);
+            ex::TagBitSet_Make(&b_inactive_tags, tm, {"Inactive"});
+            ex::World_FindEntityType(world, b_comps, b_tags, &b_index);
+            ex::World_FindEntityType(world, b_comps, b_inactive_tags, &b_inactive_index);
+
+            ex::SizeType const n = 200'000;
+            auto ids = new ex::EntityID [n];
+            auto t2 = 1'000 * Now();
+            ex::World_SpawnEntities(world, b_index, n, ids);
+            auto t3 = 1'000 * Now();
+            for (int i = 0; i < 100; ++i)
+                ex::Scheduler_Run(&scheduler);
+            auto t4 = 1'000 * Now();
+            ex::World_MoveEntities(world, ids, n / 2, b_inactive_index);  // i.e. add the "Inactive" tag
+            auto t5 = 1'000 * Now();
+            ex::World_DespawnEntities(world, ids + n / 4, n / 2);
+            auto t6 = 1'000 * Now();
+            ::printf("%u entities: spawn %.3f ms, 100 runs %.3f ms, move half %.3f ms, despawn half %.3f ms; %u left\n",
+                n, t3 - t2, t4 - t3, t5 - t4, t6 - t5, world->total_entity_count);
+            delete[] ids;
+
+            // Structural changes from inside a parallel query go through per-worker command buffers.
+            ex::CommandQueue commands;
+            ex::CommandQueue_Create(&commands, pool);
+            auto t7 = 1'000 * Now();
+            ex::Query_ForEachParallel(&move_query, pool, [&](ex::QueryChunk<MoveParams> const & chunk, unsigned worker_index) {
+                ex::CommandBuffer * cb = ex::CommandQueue_GetBuffer(&commands, worker_index);
+                ex::EntityID const * chunk_ids = world->entity_types[chunk.entity_type_index].entity_ids + chunk.first_entity;
+                for (ex::SizeType i = 0; i < chunk.count; ++i)
+                    if (0 == (chunk.first_entity + i) % 3)
+                        ex::CommandBuffer_Despawn(cb, chunk_ids[i]);
+                    else if (1 == (chunk.first_entity + i) % 3)
+                        ex::CommandBuffer_Move(cb, chunk_ids[i], b_inactive_index);
+            });
+            auto t8 = 1'000 * Now();
+            ex::World_Apply(world, &commands);
+            auto t9 = 1'000 * Now();
+            ::printf("Deferred despawn/move of 2/3 of the active ones: record %.3f ms, apply %.3f ms; %u left\n", t8 - t7, t9 - t8, world->total_entity_count);
+            ex::CommandQueue_Destroy(&commands);
+        }
+
+        ex::Scheduler_Destroy(&scheduler);
+        ex::JobPool_Destroy(pool);
+        ex::World_Destroy(world);
+    }
+
     ex::TypeManager_Destroy(tm);
     ZZZ z = {};
     return int(z.x);
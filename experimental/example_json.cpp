@@ -1,7 +1,12 @@
 #include "../experimental/y_json.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <random>
+#include <string>
 
 static double Now () {
     using namespace std::chrono;
@@ -40,11 +45,220 @@ void ErrorPrinter (
 ) {
 }
 
+static std::string MakeRepeatedSimple (int count) {
+    std::string ret = "[";
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) ret += ",";
+        ret += simple_json;
+    }
+    ret += "]";
+    return ret;
+}
+
+static std::string MakeNumbers (int count) {
+    std::mt19937_64 rng (1);
+    std::uniform_real_distribution<double> dist (-1e6, 1e6);
+    std::string ret = "[";
+    char buf [64];
+    for (int i = 0; i < count; ++i) {
+        if (i % 2)
+            ::snprintf(buf, sizeof(buf), "%s%.17g", (i > 0 ? "," : ""), dist(rng));
+        else
+            ::snprintf(buf, sizeof(buf), "%s%lld", (i > 0 ? "," : ""), (long long)(rng() >> 12));
+        ret += buf;
+    }
+    ret += "]";
+    return ret;
+}
+
+static std::string MakeStrings (int count) {
+    std::mt19937_64 rng (2);
+    std::string ret = "[";
+    for (int i = 0; i < count; ++i) {
+        ret += (i > 0 ? ",{\"text\":\"" : "{\"text\":\"");
+        int len = int(rng() % 400) + 10;
+        for (int j = 0; j < len; ++j)
+            ret += (j % 97 == 96) ? "\\n" : std::string(1, char('a' + rng() % 26));
+        ret += "\", \"id\": " + std::to_string(i) + "}";
+    }
+    ret += "]";
+    return ret;
+}
+
+static void Bench (char const * name, std::string const & json) {
+    char const * engine_names [] = {"default", "recursive", "structural"};
+    json_engine_e const engines [] = {JSON_ENGINE_Default, JSON_ENGINE_RecursiveDescent, JSON_ENGINE_StructuralIndex};
+    int const reps = int(200'000'000 / (json.size() + 1)) + 1;
+    for (int e = 0; e < 3; ++e) {
+        json_options_t options {engines[e]};
+        auto t0 = Now();
+        for (int i = 0; i < reps; ++i)
+            JSON_ParseEx({json.data(), json_size_t(json.size())}, &options, ElemPrinter, ErrorPrinter, nullptr);
+        auto t1 = Now();
+        ::printf("%-16s %-10s %10zu bytes x %5d: %8.1f MB/s\n", name, engine_names[e], json.size(), reps, (double(json.size()) * reps) / (t1 - t0) / (1024 * 1024));
+    }
+
+    size_t const chunk_size = 64 * 1024;
+    auto t0 = Now();
+    for (int i = 0; i < reps; ++i) {
+        auto parser = JSON_PushCreate(ElemPrinter, ErrorPrinter, nullptr);
+        for (size_t from = 0; from < json.size(); from += chunk_size)
+            JSON_PushFeed(parser, {json.data() + from, json_size_t(std::min(chunk_size, json.size() - from))});
+        JSON_PushFinish(parser);
+        JSON_PushDestroy(parser);
+    }
+    auto t1 = Now();
+    ::printf("%-16s %-10s %10zu bytes x %5d: %8.1f MB/s\n", name, "push 64K", json.size(), reps, (double(json.size()) * reps) / (t1 - t0) / (1024 * 1024));
+
+    t0 = Now();
+    for (int i = 0; i < reps; ++i)
+        JSON_DocDestroy(JSON_DocParse({json.data(), json_size_t(json.size())}, nullptr, ErrorPrinter, nullptr));
+    t1 = Now();
+    ::printf("%-16s %-10s %10zu bytes x %5d: %8.1f MB/s\n", name, "doc", json.size(), reps, (double(json.size()) * reps) / (t1 - t0) / (1024 * 1024));
+}
+
+static void BenchNDJSON (int record_count) {
+    std::string in;
+    for (int i = 0; i < record_count; ++i) {
+        in += simple_json;
+        for (size_t j = in.size() - (sizeof(simple_json) - 1); j < in.size(); ++j)
+            if ('\n' == in[j]) in[j] = ' ';
+        in += '\n';
+    }
+    for (int threads : {1, 0}) {
+        json_ndjson_result_t result;
+        auto t0 = Now();
+        JSON_NDJSONParseMemory(in.data(), in.size(), nullptr, threads, ElemPrinter, nullptr, &result);
+        auto t1 = Now();
+        ::printf("%-16s %-10s %10zu bytes, %llu records (%llu bad): %8.1f MB/s\n", "ndjson", (threads ? "1 thread" : "all"), in.size(),
+            result.record_count, result.error_count, double(in.size()) / (t1 - t0) / (1024 * 1024));
+        JSON_NDJSONFreeResult(&result);
+    }
+}
+
+// The same shape of field table as the ECS example's reflection info
+struct Monster {
+    char name [16];
+    int32_t hp;
+    float pos [3];
+    bool hostile;
+};
+
+static json_field_t const MonsterFields [] = {
+    {JSON_FTYPE_Str, offsetof(Monster, name), sizeof(Monster::name), "name", nullptr},
+    {JSON_FTYPE_I32, offsetof(Monster, hp), sizeof(Monster::hp), "hp", nullptr},
+    {JSON_FTYPE_F32, offsetof(Monster, pos), sizeof(Monster::pos), "pos", nullptr},
+    {JSON_FTYPE_Bool, offsetof(Monster, hostile), sizeof(Monster::hostile), "hostile", nullptr},
+};
+
+static bool AppendToString (char const * data, json_size_t size, void * user_data) {
+    static_cast<std::string *>(user_data)->append(data, size);
+    return true;
+}
+
+static void BenchCBOR (char const * name, std::string const & json) {
+    int const reps = int(200'000'000 / (json.size() + 1)) + 1;
+    std::string out;
+    for (json_write_style_e style : {JSON_WSTYLE_Compact, JSON_WSTYLE_CBOR}) {
+        auto t0 = Now();
+        for (int i = 0; i < reps; ++i) {
+            out.clear();
+            json_writer_t * w = JSON_WriterCreate(AppendToString, &out, style, 0);
+            JSON_WriteParsed(w, {json.data(), json_size_t(json.size())}, ErrorPrinter, nullptr);
+            JSON_WriterFinish(w);
+            JSON_WriterDestroy(w);
+        }
+        auto t1 = Now();
+        ::printf("%-16s %-10s %10zu bytes x %5d: %8.1f MB/s of input\n", name, (JSON_WSTYLE_CBOR == style ? "to cbor" : "to compact"),
+            out.size(), reps, (double(json.size()) * reps) / (t1 - t0) / (1024 * 1024));
+    }
+
+    std::string const & cbor = out;
+    auto t0 = Now();
+    for (int i = 0; i < reps; ++i)
+        JSON_CBORParse({cbor.data(), json_size_t(cbor.size())}, ElemPrinter, ErrorPrinter, nullptr);
+    auto t1 = Now();
+    ::printf("%-16s %-10s %10zu bytes x %5d: %8.1f MB/s, %8.1f MB/s of the text equivalent\n", name, "cbor parse", cbor.size(), reps,
+        (double(cbor.size()) * reps) / (t1 - t0) / (1024 * 1024), (double(json.size()) * reps) / (t1 - t0) / (1024 * 1024));
+}
+
+static void BenchBind () {
+    std::string const json = R"({"name": "Grue", "pos": [1.5, -2, 40], "lore": {"eats": ["adventurers"]}, "hp": 120, "hostile": true})";
+    json_schema_t * schema = JSON_SchemaCreate(MonsterFields, sizeof(MonsterFields) / sizeof(MonsterFields[0]), sizeof(Monster));
+    Monster m = {};
+    int const reps = 1'000'000;
+    auto t0 = Now();
+    for (int i = 0; i < reps; ++i)
+        JSON_Bind({json.data(), json_size_t(json.size())}, schema, &m, ErrorPrinter, nullptr);
+    auto t1 = Now();
+    ::printf("%-16s %-10s %10zu bytes x %5d: %8.1f MB/s (%s, %d hp, at %g,%g,%g)\n", "monster", "bind", json.size(), reps,
+        (double(json.size()) * reps) / (t1 - t0) / (1024 * 1024), m.name, int(m.hp), m.pos[0], m.pos[1], m.pos[2]);
+    JSON_SchemaDestroy(schema);
+}
+
+static void BenchWrite (int record_count) {
+    std::string out;
+    out.reserve(size_t(record_count) * 120);
+    auto append = [&](char c) {out += c; return true;};
+    for (json_write_style_e style : {JSON_WSTYLE_Compact, JSON_WSTYLE_Pretty}) {
+        out.clear();
+        auto t0 = Now();
+        json_writer_t * w = JSON_WriterCreate(JSON_SinkToFunctor<decltype(append)>, &append, style, 4);
+        JSON_WriteArrayBegin(w);
+        for (int i = 0; i < record_count; ++i) {
+            JSON_WriteObjectBegin(w);
+            JSON_WriteName(w, "id", 2);
+            JSON_WriteInt(w, i);
+            JSON_WriteName(w, "score", 5);
+            JSON_WriteReal(w, i * 0.37);
+            JSON_WriteName(w, "tag", 3);
+            JSON_WriteString(w, "some \"quoted\" text that is mostly plain", 39);
+            JSON_WriteName(w, "ok", 2);
+            JSON_WriteBool(w, 0 == i % 3);
+            JSON_WriteObjectEnd(w);
+        }
+        JSON_WriteArrayEnd(w);
+        JSON_WriterFinish(w);
+        JSON_WriterDestroy(w);
+        auto t1 = Now();
+        ::printf("%-16s %-10s %10zu bytes: %8.1f MB/s\n", "write", (JSON_WSTYLE_Compact == style ? "compact" : "pretty"), out.size(),
+            double(out.size()) / (t1 - t0) / (1024 * 1024));
+    }
+}
+
+static void BenchQuery (std::string const & json) {
+    char const * pointers [] = {"/0/age", "/5000/nope/4", "/9999/nope/1"};
+    json_query_t * query = JSON_QueryCompile(pointers, 3);
+    int const reps = int(200'000'000 / (json.size() + 1)) + 1;
+    int matches = 0;
+    auto t0 = Now();
+    for (int i = 0; i < reps; ++i)
+        JSON_QueryRun(query, {json.data(), json_size_t(json.size())},
+            [](json_size_t, json_value_t, json_substr_t, json_buffer_t const *, json_location_t const *, void * ud) {++*static_cast<int *>(ud);},
+            ErrorPrinter, &matches);
+    auto t1 = Now();
+    ::printf("%-16s %-10s %10zu bytes x %5d: %8.1f MB/s (%d matches)\n", "simple_json x1e4", "query 3", json.size(), reps,
+        (double(json.size()) * reps) / (t1 - t0) / (1024 * 1024), matches / reps);
+    JSON_QueryDestroy(query);
+}
+
 int main () {
     auto t0 = Now();
     JSON_Parse({simple_json, sizeof(simple_json) - 1}, ElemPrinter, ErrorPrinter, nullptr);
     auto t1 = Now();
     ::printf("%d nanosecs\n", int(0.5 + (t1 - t0) * 1'000'000'000));
 
+    Bench("simple_json", simple_json);
+    Bench("simple_json x1e4", MakeRepeatedSimple(10'000));
+    Bench("numbers", MakeNumbers(1'000'000));
+    Bench("strings", MakeStrings(100'000));
+    BenchNDJSON(1'000'000);
+    BenchCBOR("simple_json x1e4", MakeRepeatedSimple(10'000));
+    BenchCBOR("numbers", MakeNumbers(1'000'000));
+    BenchCBOR("strings", MakeStrings(100'000));
+    BenchBind();
+    BenchQuery(MakeRepeatedSimple(10'000));
+    BenchWrite(1'000'000);
+
     return 0;
 }
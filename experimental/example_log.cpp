@@ -0,0 +1,79 @@
+#include "../experimental/y_log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static double Now () {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// Time spent in the logging thread per call, in bursts that fit in the ring
+//  (so this is the hot-path cost, not the background thread's.)
+static void BenchProducer (char const * name, y::Log::FullPolicy when_full) {
+    y::Log::Config config;
+    config.path = "example_log.log";
+    config.ring_size = 16 << 20;
+    config.when_full = when_full;
+    config.idle_wait_ms = 20;       // On a single core, keeps the background thread from preempting a burst
+    y::Log::Start(config);
+
+    constexpr int Bursts = 20, PerBurst = 50'000;
+    std::vector<double> ns_per_call;
+    std::thread producer ([&] {
+        char const * const module = "net.session";
+        for (int b = 0; b < Bursts; ++b) {
+            auto t0 = Now();
+            for (int i = 0; i < PerBurst; ++i)
+                y::Log::Info("[{w10r}] {}: processed {} packets, {} dropped, ratio {}", b * PerBurst + i, module, i, i % 7, 0.8125);
+            auto t1 = Now();
+            ns_per_call.push_back((t1 - t0) * 1e9 / PerBurst);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));  // Let the background thread catch up
+        }
+    });
+    producer.join();
+
+    auto t0 = Now();
+    y::Log::Stop();
+    auto t1 = Now();
+
+    std::sort(ns_per_call.begin(), ns_per_call.end());
+    ::printf("%-22s producer: %6.1f ns/call median, %6.1f best; %llu dropped; final drain %.1f ms\n",
+        name, ns_per_call[ns_per_call.size() / 2], ns_per_call.front(),
+        (unsigned long long)y::Log::DroppedCount(), (t1 - t0) * 1e3);
+}
+
+// How fast the background thread formats and writes.
+static void BenchConsumer () {
+    y::Log::Config config;
+    config.path = "example_log.log";
+    config.ring_size = 64 << 20;
+    config.when_full = y::Log::FullPolicy::Block;
+    config.idle_wait_ms = 1000;     // So it only wakes up to drain, below
+    y::Log::Start(config);
+
+    constexpr int Count = 500'000;
+    std::thread producer ([&] {
+        for (int i = 0; i < Count; ++i)
+            y::Log::Info("[{w10r}] {}: processed {} packets, {} dropped, ratio {}", i, "net.session", i, i % 7, 0.8125);
+    });
+    producer.join();
+
+    auto t0 = Now();
+    y::Log::Stop();
+    auto t1 = Now();
+    ::printf("%-22s consumer: %6.1f ns/message formatted and written\n", "", (t1 - t0) * 1e9 / Count);
+}
+
+int main () {
+    BenchProducer("FullPolicy::Drop", y::Log::FullPolicy::Drop);
+    BenchProducer("FullPolicy::Block", y::Log::FullPolicy::Block);
+    BenchConsumer();
+    ::remove("example_log.log");
+    for (int i = 1; i <= 4; ++i)
+        ::remove(("example_log.log." + std::to_string(i)).c_str());
+    return 0;
+}
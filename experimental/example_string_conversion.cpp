@@ -0,0 +1,146 @@
+#include "../experimental/y_string_conversion.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+static double Now () {
+    using namespace std::chrono;
+    return duration_cast<duration<double>>(high_resolution_clock::now().time_since_epoch()).count();
+}
+
+static unsigned volatile g_sink;
+
+// Best of a few runs, in ns per conversion
+template <typename T, typename F>
+static double Bench (std::vector<T> const & values, F && f) {
+    double best = 1e30;
+    for (int run = 0; run < 7; ++run) {
+        unsigned total = 0;
+        auto t0 = Now();
+        for (auto v : values)
+            total += f(v);
+        auto t1 = Now();
+        g_sink = total;
+        if (t1 - t0 < best)
+            best = t1 - t0;
+    }
+    return best * 1e9 / values.size();
+}
+
+static void Compare (char const * name, std::vector<unsigned long long> const & values) {
+    char buffer [64];
+    auto ours_10 = Bench(values, [&](unsigned long long v) {
+        return y::cvt::i2s(buffer, sizeof(buffer), v).size;
+    });
+    auto std_10 = Bench(values, [&](unsigned long long v) {
+        return unsigned(std::to_chars(buffer, buffer + sizeof(buffer), v).ptr - buffer);
+    });
+    auto ours_16 = Bench(values, [&](unsigned long long v) {
+        return y::cvt::i2s(buffer, sizeof(buffer), v, 16).size;
+    });
+    auto std_16 = Bench(values, [&](unsigned long long v) {
+        return unsigned(std::to_chars(buffer, buffer + sizeof(buffer), v, 16).ptr - buffer);
+    });
+    auto grouped = Bench(values, [&](unsigned long long v) {
+        return y::cvt::i2s(buffer, sizeof(buffer), v, 10, false, 3, ',').size;
+    });
+    ::printf("%-14s base 10: i2s %5.1f ns, to_chars %5.1f ns | base 16: i2s %5.1f ns, to_chars %5.1f ns | grouped: %5.1f ns\n",
+        name, ours_10, std_10, ours_16, std_16, grouped);
+}
+
+static void CompareFloats (char const * name, std::vector<double> const & values) {
+    char buffer [64];
+    auto ours = Bench(values, [&](double v) {
+        return y::cvt::f2s(buffer, sizeof(buffer), v).size;
+    });
+    auto theirs = Bench(values, [&](double v) {
+        return unsigned(std::to_chars(buffer, buffer + sizeof(buffer), v).ptr - buffer);
+    });
+    auto ours_fixed = Bench(values, [&](double v) {
+        return y::cvt::f2s(buffer, sizeof(buffer), v, y::cvt::FloatFormat::Fixed, 3).size;
+    });
+    auto theirs_fixed = Bench(values, [&](double v) {
+        return unsigned(std::to_chars(buffer, buffer + sizeof(buffer), v, std::chars_format::fixed, 3).ptr - buffer);
+    });
+    auto printf_fixed = Bench(values, [&](double v) {
+        return unsigned(::snprintf(buffer, sizeof(buffer), "%.3f", v));
+    });
+    ::printf("%-14s shortest: f2s %5.1f ns, to_chars %5.1f ns | %%.3f: f2s %5.1f ns, to_chars %5.1f ns, snprintf %5.1f ns\n",
+        name, ours, theirs, ours_fixed, theirs_fixed, printf_fixed);
+}
+
+static void CompareParsing (char const * name, std::vector<std::string> const & texts) {
+    auto ours_int = Bench(texts, [&](std::string const & s) {
+        unsigned long long v = 0;
+        y::cvt::s2i(s.data(), unsigned(s.size()), v);
+        return unsigned(v);
+    });
+    auto theirs_int = Bench(texts, [&](std::string const & s) {
+        unsigned long long v = 0;
+        std::from_chars(s.data(), s.data() + s.size(), v);
+        return unsigned(v);
+    });
+    auto ours_float = Bench(texts, [&](std::string const & s) {
+        double v = 0;
+        y::cvt::s2f(s.data(), unsigned(s.size()), v);
+        return unsigned(v);
+    });
+    auto theirs_float = Bench(texts, [&](std::string const & s) {
+        double v = 0;
+        std::from_chars(s.data(), s.data() + s.size(), v);
+        return unsigned(v);
+    });
+    auto strtod_float = Bench(texts, [&](std::string const & s) {
+        return unsigned(::strtod(s.c_str(), nullptr));
+    });
+    ::printf("%-14s s2i %5.1f ns, from_chars %5.1f ns | s2f %5.1f ns, from_chars %5.1f ns, strtod %5.1f ns\n",
+        name, ours_int, theirs_int, ours_float, theirs_float, strtod_float);
+}
+
+int main () {
+    constexpr int Count = 1'000'000;
+    std::mt19937_64 rng (12345);
+    std::vector<unsigned long long> small, u32, full, mixed;
+    for (int i = 0; i < Count; ++i) {
+        small.push_back(rng() % 1000);
+        u32.push_back(rng() & 0xFFFF'FFFFU);
+        full.push_back(rng());
+        mixed.push_back(rng() >> (rng() % 64));     // Uniform in length, so the digit count isn't predictable
+    }
+    Compare("0..999", small);
+    Compare("32-bit", u32);
+    Compare("64-bit", full);
+    Compare("mixed length", mixed);
+
+    std::vector<double> metrics, any;
+    for (int i = 0; i < Count; ++i) {
+        metrics.push_back(double(rng() % 10'000'000) / 1000);  // Like latencies in ms
+        uint64_t bits;
+        double d;
+        do {
+            bits = rng();
+            ::memcpy(&d, &bits, sizeof(d));
+        } while (!std::isfinite(d) || std::abs(d) > 1e30 || std::abs(d) < 1e-30);  // Keep %.3f short
+        any.push_back(d);
+    }
+    CompareFloats("metrics", metrics);
+    CompareFloats("any double", any);
+
+    std::vector<std::string> short_ints, long_ints, prices;
+    for (int i = 0; i < Count; ++i) {
+        short_ints.push_back(std::to_string(rng() % 100'000));
+        long_ints.push_back(std::to_string(rng() >> 1));
+        prices.push_back(std::to_string(rng() % 100'000) + "." + std::to_string(10 + rng() % 90));
+    }
+    CompareParsing("5 digits", short_ints);
+    CompareParsing("19 digits", long_ints);
+    CompareParsing("prices", prices);
+    return 0;
+}
@@ -68,8 +68,9 @@ static inline ResultAndCarry
 add_with_carry (y_bignum_dig_t a, y_bignum_dig_t b, y_bignum_dig_t c) {
     assert(c < WordMax);    // input carry is small!
     ResultAndCarry ret;
-    ret.result = a + b + c;
-    ret.carry = ((ret.result < a || ret.result < b /*|| ret.result < c*/) ? 1 : 0);
+    y_bignum_dig_t const sum = a + b;
+    ret.result = sum + c;
+    ret.carry = ((sum < a || ret.result < sum) ? 1 : 0);
     return ret;
 }
 
@@ -229,10 +230,909 @@ bool y_bignum_sub (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_
     }
 }
 
-bool y_bignum_mul (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
-bool y_bignum_div (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
-bool y_bignum_mod (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
-bool y_bignum_pow (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);   // res = a ** b (or a ^ b)
+//----------------------------------------------------------------------
+// Multiplication. The kernels below work on bare digit arrays (least
+//  significant first,) never write to their inputs, and take all the
+//  temporary space they need from "t", which must hold at least
+//  mul_scratch_size() digits.
+
+int y_bignum_karatsuba_threshold = 32;
+int y_bignum_toom3_threshold = 128;
+
+typedef unsigned long long WideWord;
+static_assert(sizeof(WideWord) == 2 * sizeof(y_bignum_dig_t), "");
+
+static const int DigBits = 8 * sizeof(y_bignum_dig_t);
+
+enum class MulAlgorithm {
+    Schoolbook,
+    Unbalanced,     // Slices of the longer operand, each as long as the shorter one
+    Karatsuba,
+    Toom3,
+};
+
+static inline int
+significant_dig_count (y_bignum_num_t const * num) {
+    int ret = dig_count(num);
+    while (ret > 0 && 0 == num->digs[ret - 1])
+        ret -= 1;
+    return ret;
+}
+
+// r[0..rn) += x[0..xn), for xn <= rn; returns the carry out of r
+static y_bignum_dig_t
+add_into (y_bignum_dig_t * r, int rn, y_bignum_dig_t const * x, int xn) {
+    WideWord carry = 0;
+    int i = 0;
+    for (; i < xn; ++i) {
+        carry += (WideWord)r[i] + x[i];
+        r[i] = (y_bignum_dig_t)carry;
+        carry >>= DigBits;
+    }
+    for (; carry > 0 && i < rn; ++i) {
+        carry += r[i];
+        r[i] = (y_bignum_dig_t)carry;
+        carry >>= DigBits;
+    }
+    return (y_bignum_dig_t)carry;
+}
+
+// r[0..rn) -= x[0..xn), for xn <= rn; returns the borrow out of r
+static y_bignum_dig_t
+sub_from (y_bignum_dig_t * r, int rn, y_bignum_dig_t const * x, int xn) {
+    y_bignum_dig_t borrow = 0;
+    int i = 0;
+    for (; i < xn; ++i) {
+        WideWord const d = (WideWord)r[i] - x[i] - borrow;
+        r[i] = (y_bignum_dig_t)d;
+        borrow = (y_bignum_dig_t)(d >> (2 * DigBits - 1));
+    }
+    for (; borrow > 0 && i < rn; ++i) {
+        borrow = (0 == r[i]) ? 1 : 0;
+        r[i] -= 1;
+    }
+    return borrow;
+}
+
+// The n-digit values below are two's complement, i.e. modulo 2^(n*DigBits)
+static void
+negate_in_place (y_bignum_dig_t * r, int n) {
+    y_bignum_dig_t carry = 1;
+    for (int i = 0; i < n; ++i) {
+        r[i] = ~r[i] + carry;
+        carry = (carry > 0 && 0 == r[i]) ? 1 : 0;
+    }
+}
+
+static inline bool
+is_negative_digs (y_bignum_dig_t const * r, int n) {
+    return 0 != (r[n - 1] >> (DigBits - 1));
+}
+
+static void
+shift_left_1 (y_bignum_dig_t * r, int n) {
+    for (int i = n - 1; i > 0; --i)
+        r[i] = (r[i] << 1) | (r[i - 1] >> (DigBits - 1));
+    r[0] <<= 1;
+}
+
+// Arithmetic shift, so it's an exact division by 2 of an even value
+static void
+shift_right_1 (y_bignum_dig_t * r, int n) {
+    for (int i = 0; i < n - 1; ++i)
+        r[i] = (r[i] >> 1) | (r[i + 1] << (DigBits - 1));
+    r[n - 1] = (r[n - 1] >> 1) | (r[n - 1] & ((y_bignum_dig_t)1 << (DigBits - 1)));
+}
+
+// Exact division by 3 of a multiple of 3, by multiplying with the inverse of
+//  3 modulo the digit base (Hensel division); works for negative values too.
+static void
+divexact_by_3 (y_bignum_dig_t * r, int n) {
+    const y_bignum_dig_t InverseOf3 = 0xAAAA'AAAB;
+    static_assert(sizeof(y_bignum_dig_t) == 4, "InverseOf3 is for 32-bit digits");
+    y_bignum_dig_t borrow = 0;
+    for (int i = 0; i < n; ++i) {
+        y_bignum_dig_t const s = r[i] - borrow;
+        y_bignum_dig_t const q = s * InverseOf3;
+        // q * 3 == s + B * (q * 3 >> DigBits); what's above s is owed by the next digit
+        borrow = (y_bignum_dig_t)(((WideWord)q * 3) >> DigBits) + (r[i] < borrow ? 1 : 0);
+        r[i] = q;
+    }
+}
+
+// out[0..n) = |x - y|, for n-digit x and yn-digit y (yn <= n); returns whether x < y
+static bool
+abs_diff (y_bignum_dig_t * out, y_bignum_dig_t const * x, int n, y_bignum_dig_t const * y, int yn) {
+    int i = n - 1;
+    for (; i >= yn && 0 == x[i]; --i) {}
+    if (i < yn)
+        for (; i >= 0 && x[i] == y[i]; --i) {}
+    bool const ret = (i >= 0 && i < yn && x[i] < y[i]);
+    if (ret) {
+        ::memcpy(out, y, yn * sizeof(y_bignum_dig_t));
+        ::memset(out + yn, 0, (n - yn) * sizeof(y_bignum_dig_t));
+        sub_from(out, n, x, n);
+    } else {
+        ::memcpy(out, x, n * sizeof(y_bignum_dig_t));
+        sub_from(out, n, y, yn);
+    }
+    return ret;
+}
+
+static MulAlgorithm
+pick_mul_algorithm (int an, int bn) {   // an >= bn
+    MulAlgorithm ret = MulAlgorithm::Schoolbook;
+    if (bn < max(4, y_bignum_karatsuba_threshold))
+        ret = MulAlgorithm::Schoolbook;
+    else if (2 * bn <= an + 1)
+        ret = MulAlgorithm::Unbalanced;
+    else if (bn >= max(4, y_bignum_toom3_threshold) && bn > 2 * ((an + 2) / 3))
+        ret = MulAlgorithm::Toom3;
+    else
+        ret = MulAlgorithm::Karatsuba;
+    return ret;
+}
+
+static int
+mul_scratch_size (int an, int bn) {
+    if (an < bn) {
+        int const t = an; an = bn; bn = t;
+    }
+    int ret = 0;
+    switch (pick_mul_algorithm(an, bn)) {
+    case MulAlgorithm::Schoolbook:
+        break;
+    case MulAlgorithm::Unbalanced: {
+        int const rest = an % bn;
+        ret = 2 * bn + max(mul_scratch_size(bn, bn), rest > 0 ? mul_scratch_size(bn, rest) : 0);
+    } break;
+    case MulAlgorithm::Karatsuba: {
+        int const m = (an + 1) / 2;
+        ret = max(4 * m + 1 + mul_scratch_size(m, m), mul_scratch_size(an - m, bn - m));
+    } break;
+    case MulAlgorithm::Toom3: {
+        int const k = (an + 2) / 3, e = k + 1, w = 2 * k + 2;
+        ret = max(4 * e + 3 * w + mul_scratch_size(e, e), max(mul_scratch_size(k, k), mul_scratch_size(an - 2 * k, bn - 2 * k)));
+    } break;
+    }
+    return ret;
+}
+
+static void mul_digs (y_bignum_dig_t * r, y_bignum_dig_t const * a, int an, y_bignum_dig_t const * b, int bn, y_bignum_dig_t * t);
+
+// r[0..an+bn) = a * b, a row at a time; a digit product plus two digits
+//  always fits in a WideWord, so there's no carry to track beyond that.
+static void
+mul_schoolbook (y_bignum_dig_t * r, y_bignum_dig_t const * a, int an, y_bignum_dig_t const * b, int bn) {
+    WideWord carry = 0;
+    WideWord const a0 = a[0];
+    for (int j = 0; j < bn; ++j) {
+        carry += a0 * b[j];
+        r[j] = (y_bignum_dig_t)carry;
+        carry >>= DigBits;
+    }
+    r[bn] = (y_bignum_dig_t)carry;
+    for (int i = 1; i < an; ++i) {
+        WideWord const ai = a[i];
+        y_bignum_dig_t * ri = r + i;
+        carry = 0;
+        for (int j = 0; j < bn; ++j) {
+            carry += ai * b[j] + ri[j];
+            ri[j] = (y_bignum_dig_t)carry;
+            carry >>= DigBits;
+        }
+        ri[bn] = (y_bignum_dig_t)carry;
+    }
+}
+
+static void
+mul_unbalanced (y_bignum_dig_t * r, y_bignum_dig_t const * a, int an, y_bignum_dig_t const * b, int bn, y_bignum_dig_t * t) {
+    ::memset(r, 0, (an + bn) * sizeof(y_bignum_dig_t));
+    for (int off = 0; off < an; off += bn) {
+        int const n = min(bn, an - off);
+        mul_digs(t, a + off, n, b, bn, t + 2 * bn);
+        add_into(r + off, an + bn - off, t, n + bn);
+    }
+}
+
+// With a = a1 B^m + a0 and b = b1 B^m + b0, the middle term is
+//  a0 b0 + a1 b1 - (a0 - a1)(b0 - b1); the subtractive form keeps the
+//  half-size operands at m digits instead of m + 1.
+static void
+mul_karatsuba (y_bignum_dig_t * r, y_bignum_dig_t const * a, int an, y_bignum_dig_t const * b, int bn, y_bignum_dig_t * t) {
+    int const m = (an + 1) / 2;
+    int const n = an + bn;
+    mul_digs(r, a, m, b, m, t);
+    mul_digs(r + 2 * m, a + m, an - m, b + m, bn - m, t);
+
+    y_bignum_dig_t * da = t;
+    y_bignum_dig_t * db = t + m;
+    y_bignum_dig_t * mid = t + 2 * m;
+    bool const negative = abs_diff(da, a, m, a + m, an - m) != abs_diff(db, b, m, b + m, bn - m);
+    mul_digs(mid, da, m, db, m, t + 4 * m + 1);
+    mid[2 * m] = 0;
+    if (!negative)
+        negate_in_place(mid, 2 * m + 1);
+    // The middle term is known to fit, so working modulo B^(2m+1) is fine
+    add_into(mid, 2 * m + 1, r, 2 * m);
+    add_into(mid, 2 * m + 1, r + 2 * m, n - 2 * m);
+    add_into(r + m, n - m, mid, min(2 * m + 1, n - m));
+}
+
+// x and y are e-digit two's complement values; ma and mb are e digits of room
+static void
+mul_signed (y_bignum_dig_t * r, y_bignum_dig_t const * x, y_bignum_dig_t const * y, int e, y_bignum_dig_t * ma, y_bignum_dig_t * mb, y_bignum_dig_t * t) {
+    ::memcpy(ma, x, e * sizeof(y_bignum_dig_t));
+    ::memcpy(mb, y, e * sizeof(y_bignum_dig_t));
+    bool const xneg = is_negative_digs(ma, e);
+    bool const yneg = is_negative_digs(mb, e);
+    if (xneg)
+        negate_in_place(ma, e);
+    if (yneg)
+        negate_in_place(mb, e);
+    mul_digs(r, ma, e, mb, e, t);
+    if (xneg != yneg)
+        negate_in_place(r, 2 * e);
+}
+
+// Evaluates at 0, 1, -1, -2 and infinity and interpolates with Bodrato's
+//  sequence. The intermediate values are signed, and are kept as two's
+//  complement numbers just wide enough for them (e and w digits.)
+static void
+mul_toom3 (y_bignum_dig_t * r, y_bignum_dig_t const * a, int an, y_bignum_dig_t const * b, int bn, y_bignum_dig_t * t) {
+    int const k = (an + 2) / 3, e = k + 1, w = 2 * k + 2;
+    int const n = an + bn;
+    int const a2n = an - 2 * k, b2n = bn - 2 * k;
+    y_bignum_dig_t const * a0 = a, * a1 = a + k, * a2 = a + 2 * k;
+    y_bignum_dig_t const * b0 = b, * b1 = b + k, * b2 = b + 2 * k;
+    y_bignum_dig_t * pa = t;
+    y_bignum_dig_t * pb = pa + e;
+    y_bignum_dig_t * ma = pb + e;
+    y_bignum_dig_t * mb = ma + e;
+    y_bignum_dig_t * r1 = mb + e;
+    y_bignum_dig_t * rm1 = r1 + w;
+    y_bignum_dig_t * rm2 = rm1 + w;
+    y_bignum_dig_t * rest = rm2 + w;
+    y_bignum_dig_t const * rinf = r + 4 * k;
+    int const rinfn = n - 4 * k;
+
+    // r(0) and r(inf) go straight in their places in r
+    mul_digs(r, a0, k, b0, k, t);
+    mul_digs(r + 4 * k, a2, a2n, b2, b2n, t);
+
+    ::memcpy(pa, a0, k * sizeof(y_bignum_dig_t));
+    ::memcpy(pb, b0, k * sizeof(y_bignum_dig_t));
+    pa[k] = pb[k] = 0;
+    add_into(pa, e, a2, a2n);
+    add_into(pb, e, b2, b2n);
+    ::memcpy(ma, pa, e * sizeof(y_bignum_dig_t));
+    ::memcpy(mb, pb, e * sizeof(y_bignum_dig_t));
+    add_into(ma, e, a1, k);
+    add_into(mb, e, b1, k);
+    mul_digs(r1, ma, e, mb, e, rest);                   // r(1)
+    sub_from(pa, e, a1, k);
+    sub_from(pb, e, b1, k);
+    mul_signed(rm1, pa, pb, e, ma, mb, rest);           // r(-1)
+    add_into(pa, e, a2, a2n);
+    add_into(pb, e, b2, b2n);
+    shift_left_1(pa, e);
+    shift_left_1(pb, e);
+    sub_from(pa, e, a0, k);
+    sub_from(pb, e, b0, k);
+    mul_signed(rm2, pa, pb, e, ma, mb, rest);           // r(-2)
+
+    sub_from(rm2, w, r1, w);
+    divexact_by_3(rm2, w);                              // c3 = (r(-2) - r(1)) / 3
+    sub_from(r1, w, rm1, w);
+    shift_right_1(r1, w);                               // c1 = (r(1) - r(-1)) / 2
+    sub_from(rm1, w, r, 2 * k);                         // c2 = r(-1) - r(0)
+    negate_in_place(rm2, w);
+    add_into(rm2, w, rm1, w);
+    shift_right_1(rm2, w);
+    add_into(rm2, w, rinf, rinfn);
+    add_into(rm2, w, rinf, rinfn);                      // c3 = (c2 - c3) / 2 + 2 r(inf)
+    add_into(rm1, w, r1, w);
+    sub_from(rm1, w, rinf, rinfn);                      // c2 = c2 + c1 - r(inf)
+    sub_from(r1, w, rm2, w);                            // c1 = c1 - c3
+
+    // The coefficients are non-negative and fit in the product, so only
+    //  the digits that land inside r matter.
+    ::memset(r + 2 * k, 0, 2 * k * sizeof(y_bignum_dig_t));
+    add_into(r + k, n - k, r1, min(w, n - k));
+    add_into(r + 2 * k, n - 2 * k, rm1, min(w, n - 2 * k));
+    add_into(r + 3 * k, n - 3 * k, rm2, min(w, n - 3 * k));
+}
+
+// r[0..an+bn) = a * b; r must not overlap a or b
+static void
+mul_digs (y_bignum_dig_t * r, y_bignum_dig_t const * a, int an, y_bignum_dig_t const * b, int bn, y_bignum_dig_t * t) {
+    if (an < bn) {
+        y_bignum_dig_t const * const p = a; a = b; b = p;
+        int const n = an; an = bn; bn = n;
+    }
+    switch (pick_mul_algorithm(an, bn)) {
+    case MulAlgorithm::Schoolbook: mul_schoolbook(r, a, an, b, bn); break;
+    case MulAlgorithm::Unbalanced: mul_unbalanced(r, a, an, b, bn, t); break;
+    case MulAlgorithm::Karatsuba: mul_karatsuba(r, a, an, b, bn, t); break;
+    case MulAlgorithm::Toom3: mul_toom3(r, a, an, b, bn, t); break;
+    }
+}
+
+// Exact, for the given number of significant digits
+static int
+mul_scratch_size_for (int acnt, int bcnt) {
+    int ret = 0;
+    if (acnt > 0 && bcnt > 0)
+        ret = mul_scratch_size(acnt, bcnt);
+    return ret;
+}
+
+// The exact size goes up and down a little around the thresholds, and the
+//  caller may not know how many digits are significant, so this is a bound
+//  that holds for any smaller operands too (the exact one stays under 5.1 n.)
+int y_bignum_mul_scratch_size (int a_size, int b_size) {
+    int ret = 0;
+    if (mul_scratch_size_for(a_size, b_size) > 0)
+        ret = 6 * max(a_size, b_size) + 64;
+    return ret;
+}
+
+bool y_bignum_mul_with_scratch (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b, y_bignum_num_t * scratch) {
+    bool ret = false;
+    int const acnt = significant_dig_count(a);
+    int const bcnt = significant_dig_count(b);
+    int const rcnt = dig_count(res);
+    if (res && a && b && rcnt >= acnt + bcnt && res->digs != a->digs && res->digs != b->digs &&
+            dig_count(scratch) >= mul_scratch_size_for(acnt, bcnt)) {
+        int i = 0;
+        if (acnt > 0 && bcnt > 0) {
+            mul_digs(res->digs, a->digs, acnt, b->digs, bcnt, scratch ? scratch->digs : nullptr);
+            i = acnt + bcnt;
+        }
+        ::memset(res->digs + i, 0, (rcnt - i) * sizeof(y_bignum_dig_t));
+        y_bignum_set_sign(res, i > 0 && is_negative(a) != is_negative(b));
+        ret = true;
+    }
+    return ret;
+}
+
+bool y_bignum_mul (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b) {
+    bool ret = false;
+    if (res && a && b) {
+        int const scratch_size = mul_scratch_size_for(significant_dig_count(a), significant_dig_count(b));
+        if (scratch_size > 0) {
+            y_bignum_num_t scratch = {};
+            if (y_bignum_realloc(&scratch, scratch_size, false) && scratch.digs) {
+                ret = y_bignum_mul_with_scratch(res, a, b, &scratch);
+                y_bignum_free(&scratch);
+            }
+        } else {
+            ret = y_bignum_mul_with_scratch(res, a, b, nullptr);
+        }
+    }
+    return ret;
+}
+
+//----------------------------------------------------------------------
+// Division, by Knuth's algorithm D (TAOCP vol. 2, 4.3.1.)
+
+static inline int
+leading_zero_bits (y_bignum_dig_t v) {  // v != 0
+    int ret = 0;
+    for (; 0 == (v >> (DigBits - 1)); v <<= 1)
+        ret += 1;
+    return ret;
+}
+
+static inline bool
+is_zero_digs (y_bignum_dig_t const * x, int n) {
+    int i = 0;
+    for (; i < n && 0 == x[i]; ++i) {}
+    return i == n;
+}
+
+// out[0..n) = x[0..n) << s, for 0 <= s < DigBits; returns the bits shifted
+//  out of the top. out may be x.
+static y_bignum_dig_t
+shift_left_bits (y_bignum_dig_t * out, y_bignum_dig_t const * x, int n, int s) {
+    y_bignum_dig_t ret = 0;
+    if (0 == s) {
+        ::memmove(out, x, n * sizeof(y_bignum_dig_t));
+    } else {
+        ret = x[n - 1] >> (DigBits - s);
+        for (int i = n - 1; i > 0; --i)
+            out[i] = (x[i] << s) | (x[i - 1] >> (DigBits - s));
+        out[0] = x[0] << s;
+    }
+    return ret;
+}
+
+// out[0..n) = x[0..n) >> s, for 0 <= s < DigBits
+static void
+shift_right_bits (y_bignum_dig_t * out, y_bignum_dig_t const * x, int n, int s) {
+    if (0 == s) {
+        ::memmove(out, x, n * sizeof(y_bignum_dig_t));
+    } else {
+        for (int i = 0; i < n - 1; ++i)
+            out[i] = (x[i] >> s) | (x[i + 1] << (DigBits - s));
+        out[n - 1] = x[n - 1] >> s;
+    }
+}
+
+static inline void
+clear_digs_from (y_bignum_num_t * num, int idx) {
+    int const n = dig_count(num);
+    if (idx < n)
+        ::memset(num->digs + idx, 0, (n - idx) * sizeof(y_bignum_dig_t));
+}
+
+static int
+divmod_scratch_size (int an, int bn) {
+    return an + bn + 1;
+}
+
+// q[0..an-bn+1) = a / b and r[0..bn) = a % b, for an >= bn and b[bn-1] != 0.
+//  Either of q and r can be null, and neither may overlap a or b.
+static void
+divmod_digs (y_bignum_dig_t * q, y_bignum_dig_t * r, y_bignum_dig_t const * a, int an, y_bignum_dig_t const * b, int bn, y_bignum_dig_t * t) {
+    if (1 == bn) {
+        WideWord const d = b[0];
+        WideWord rem = 0;
+        for (int i = an - 1; i >= 0; --i) {
+            WideWord const num = (rem << DigBits) | a[i];
+            if (q)
+                q[i] = (y_bignum_dig_t)(num / d);
+            rem = num % d;
+        }
+        if (r)
+            r[0] = (y_bignum_dig_t)rem;
+    } else {
+        // With the divisor's top bit set, the estimate of each quotient digit
+        //  from the top two digits is never more than 2 too big, and the test
+        //  against the third digit below catches almost all of those.
+        int const s = leading_zero_bits(b[bn - 1]);
+        y_bignum_dig_t * u = t;
+        y_bignum_dig_t * v = t + an + 1;
+        shift_left_bits(v, b, bn, s);
+        u[an] = shift_left_bits(u, a, an, s);
+        WideWord const vtop = v[bn - 1];
+        WideWord const vnext = v[bn - 2];
+        for (int j = an - bn; j >= 0; --j) {
+            WideWord const num = ((WideWord)u[j + bn] << DigBits) | u[j + bn - 1];
+            WideWord qhat = num / vtop;
+            WideWord rhat = num % vtop;
+            while (qhat > WordMax || qhat * vnext > ((rhat << DigBits) | u[j + bn - 2])) {
+                qhat -= 1;
+                rhat += vtop;
+                if (rhat > WordMax)
+                    break;
+            }
+
+            // u[j..j+bn] -= qhat * v
+            WideWord carry = 0;
+            y_bignum_dig_t borrow = 0;
+            for (int i = 0; i < bn; ++i) {
+                carry += qhat * v[i];
+                WideWord const d = (WideWord)u[i + j] - (y_bignum_dig_t)carry - borrow;
+                carry >>= DigBits;
+                u[i + j] = (y_bignum_dig_t)d;
+                borrow = (y_bignum_dig_t)(d >> (2 * DigBits - 1));
+            }
+            WideWord const d = (WideWord)u[j + bn] - carry - borrow;
+            u[j + bn] = (y_bignum_dig_t)d;
+            if (0 != (d >> (2 * DigBits - 1))) {   // Still one too big (rare); the carry out cancels the borrow
+                qhat -= 1;
+                add_into(u + j, bn + 1, v, bn);
+            }
+            if (q)
+                q[j] = (y_bignum_dig_t)qhat;
+        }
+        if (r)
+            shift_right_bits(r, u, bn, s);
+    }
+}
+
+int y_bignum_divmod_scratch_size (int a_size, int b_size) {
+    int ret = 0;
+    if (a_size > 0 && b_size > 0)
+        ret = divmod_scratch_size(a_size, b_size);
+    return ret;
+}
+
+bool y_bignum_divmod_with_scratch (y_bignum_num_t * quot, y_bignum_num_t * rem, y_bignum_num_t const * a, y_bignum_num_t const * b, y_bignum_num_t * scratch) {
+    bool ret = false;
+    int const acnt = significant_dig_count(a);
+    int const bcnt = significant_dig_count(b);
+    int const qcnt = (acnt >= bcnt) ? acnt - bcnt + 1 : 0;
+    int const rcnt = min(acnt, bcnt);
+    if (a && b && bcnt > 0 && (quot || rem) && quot != rem &&
+            (!quot || (dig_count(quot) >= qcnt && quot->digs != a->digs && quot->digs != b->digs)) &&
+            (!rem || (dig_count(rem) >= rcnt && rem->digs != a->digs && rem->digs != b->digs)) &&
+            dig_count(scratch) >= y_bignum_divmod_scratch_size(acnt, bcnt)) {
+        int qlen = 0, rlen = 0;
+        if (acnt >= bcnt) {
+            divmod_digs(quot ? quot->digs : nullptr, rem ? rem->digs : nullptr, a->digs, acnt, b->digs, bcnt, scratch->digs);
+            qlen = qcnt;
+            rlen = bcnt;
+        } else if (rem) {
+            ::memcpy(rem->digs, a->digs, acnt * sizeof(y_bignum_dig_t));
+            rlen = acnt;
+        }
+        // Like C, the quotient is truncated and the remainder has a's sign
+        if (quot) {
+            clear_digs_from(quot, qlen);
+            y_bignum_set_sign(quot, !is_zero_digs(quot->digs, qlen) && is_negative(a) != is_negative(b));
+        }
+        if (rem) {
+            clear_digs_from(rem, rlen);
+            y_bignum_set_sign(rem, !is_zero_digs(rem->digs, rlen) && is_negative(a));
+        }
+        ret = true;
+    }
+    return ret;
+}
+
+static bool
+divmod_allocating (y_bignum_num_t * quot, y_bignum_num_t * rem, y_bignum_num_t const * a, y_bignum_num_t const * b) {
+    bool ret = false;
+    if (a && b) {
+        y_bignum_num_t scratch = {};
+        int const scratch_size = y_bignum_divmod_scratch_size(significant_dig_count(a), significant_dig_count(b));
+        if (0 == scratch_size || (y_bignum_realloc(&scratch, scratch_size, false) && scratch.digs))
+            ret = y_bignum_divmod_with_scratch(quot, rem, a, b, &scratch);
+        y_bignum_free(&scratch);
+    }
+    return ret;
+}
+
+bool y_bignum_div (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b) {
+    return res && divmod_allocating(res, nullptr, a, b);
+}
+
+bool y_bignum_mod (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b) {
+    return res && divmod_allocating(nullptr, res, a, b);
+}
+
+//----------------------------------------------------------------------
+// Exponentiation. Modulo an odd m, the products are done on Montgomery
+//  forms (x R mod m, with R = B^n) which need no division to reduce;
+//  with an even m, each product is reduced with divmod_digs().
+
+// -1/m0 modulo B, by Newton's iteration; each step doubles the good bits
+static y_bignum_dig_t
+montgomery_inverse (y_bignum_dig_t m0) {
+    y_bignum_dig_t x = m0;      // Good to 3 bits, for any odd m0
+    for (int i = 0; i < 4; ++i)
+        x *= 2 - m0 * x;
+    return 0 - x;
+}
+
+// r[0..n) = a b / R mod m, for a, b < m (CIOS: the reduction is
+//  interleaved with the multiplication, a digit of a at a time.) t holds
+//  n + 2 digits, and r may be a or b.
+static void
+montgomery_mul (y_bignum_dig_t * r, y_bignum_dig_t const * a, y_bignum_dig_t const * b, y_bignum_dig_t const * m, int n, y_bignum_dig_t m_inv, y_bignum_dig_t * t) {
+    ::memset(t, 0, (n + 2) * sizeof(y_bignum_dig_t));
+    for (int i = 0; i < n; ++i) {
+        WideWord const ai = a[i];
+        WideWord carry = 0;
+        for (int j = 0; j < n; ++j) {
+            carry += ai * b[j] + t[j];
+            t[j] = (y_bignum_dig_t)carry;
+            carry >>= DigBits;
+        }
+        carry += t[n];
+        t[n] = (y_bignum_dig_t)carry;
+        t[n + 1] = (y_bignum_dig_t)(carry >> DigBits);
+
+        // Add the multiple of m that clears the low digit, and drop it
+        WideWord const mq = (y_bignum_dig_t)(t[0] * m_inv);
+        carry = (t[0] + mq * m[0]) >> DigBits;
+        for (int j = 1; j < n; ++j) {
+            carry += mq * m[j] + t[j];
+            t[j - 1] = (y_bignum_dig_t)carry;
+            carry >>= DigBits;
+        }
+        carry += t[n];
+        t[n - 1] = (y_bignum_dig_t)carry;
+        t[n] = t[n + 1] + (y_bignum_dig_t)(carry >> DigBits);
+    }
+    // t < 2m here
+    int i = n - 1;
+    if (0 == t[n])
+        for (; i >= 0 && t[i] == m[i]; --i) {}
+    if (0 != t[n] || i < 0 || t[i] > m[i])
+        sub_from(t, n + 1, m, n);
+    ::memcpy(r, t, n * sizeof(y_bignum_dig_t));
+}
+
+// r[0..n) = a a / R mod m, for a < m; the cross products are done once and
+//  doubled, and the reduction is done separately afterwards. t holds 2n
+//  digits, and r may be a.
+static void
+montgomery_sqr (y_bignum_dig_t * r, y_bignum_dig_t const * a, y_bignum_dig_t const * m, int n, y_bignum_dig_t m_inv, y_bignum_dig_t * t) {
+    ::memset(t, 0, 2 * n * sizeof(y_bignum_dig_t));
+    for (int i = 0; i < n - 1; ++i) {
+        WideWord const ai = a[i];
+        WideWord carry = 0;
+        for (int j = i + 1; j < n; ++j) {
+            carry += ai * a[j] + t[i + j];
+            t[i + j] = (y_bignum_dig_t)carry;
+            carry >>= DigBits;
+        }
+        t[i + n] = (y_bignum_dig_t)carry;
+    }
+    shift_left_1(t, 2 * n);
+    WideWord carry = 0;
+    for (int i = 0; i < n; ++i) {
+        WideWord const p = (WideWord)a[i] * a[i];
+        carry += (y_bignum_dig_t)p + (WideWord)t[2 * i];
+        t[2 * i] = (y_bignum_dig_t)carry;
+        carry = (carry >> DigBits) + (p >> DigBits) + t[2 * i + 1];
+        t[2 * i + 1] = (y_bignum_dig_t)carry;
+        carry >>= DigBits;
+    }
+
+    // Clear the low digits one at a time, as in montgomery_mul()
+    y_bignum_dig_t top = 0;
+    for (int i = 0; i < n; ++i) {
+        WideWord const mq = (y_bignum_dig_t)(t[i] * m_inv);
+        carry = 0;
+        for (int j = 0; j < n; ++j) {
+            carry += mq * m[j] + t[i + j];
+            t[i + j] = (y_bignum_dig_t)carry;
+            carry >>= DigBits;
+        }
+        carry += (WideWord)t[i + n] + top;
+        t[i + n] = (y_bignum_dig_t)carry;
+        top = (y_bignum_dig_t)(carry >> DigBits);
+    }
+    y_bignum_dig_t * u = t + n;
+    int i = n - 1;
+    if (0 == top)
+        for (; i >= 0 && u[i] == m[i]; --i) {}
+    if (0 != top || i < 0 || u[i] > m[i])
+        sub_from(u, n, m, n);
+    ::memcpy(r, u, n * sizeof(y_bignum_dig_t));
+}
+
+struct ModContext {
+    y_bignum_dig_t const * m;
+    int n;
+    bool montgomery;
+    y_bignum_dig_t m_inv;
+    y_bignum_dig_t * t;         // mod_mul_scratch_size() digits
+};
+
+static int
+mod_mul_scratch_size (int n) {  // Enough for both kinds
+    return 2 * n + max(y_bignum_mul_scratch_size(n, n), divmod_scratch_size(2 * n, n));
+}
+
+// r = a b mod m (or a b / R mod m, for Montgomery forms); r may be a or b
+static void
+mod_mul (ModContext const & ctx, y_bignum_dig_t * r, y_bignum_dig_t const * a, y_bignum_dig_t const * b) {
+    if (ctx.montgomery) {
+        montgomery_mul(r, a, b, ctx.m, ctx.n, ctx.m_inv, ctx.t);
+    } else {
+        y_bignum_dig_t * p = ctx.t;
+        mul_digs(p, a, ctx.n, b, ctx.n, p + 2 * ctx.n);
+        divmod_digs(nullptr, r, p, 2 * ctx.n, ctx.m, ctx.n, p + 2 * ctx.n);
+    }
+}
+
+static void
+mod_sqr (ModContext const & ctx, y_bignum_dig_t * r, y_bignum_dig_t const * a) {
+    if (ctx.montgomery)
+        montgomery_sqr(r, a, ctx.m, ctx.n, ctx.m_inv, ctx.t);
+    else
+        mod_mul(ctx, r, a, a);
+}
+
+// The same cut-offs as OpenSSL: fewer products overall against a bigger table
+static int
+window_bits (int exp_bits) {
+    int ret = 1;
+    if (exp_bits > 671)
+        ret = 6;
+    else if (exp_bits > 239)
+        ret = 5;
+    else if (exp_bits > 79)
+        ret = 4;
+    else if (exp_bits > 23)
+        ret = 3;
+    return ret;
+}
+
+static int
+powmod_scratch_size (int base_n, int exp_n, int n) {
+    int const table = (1 << (window_bits(exp_n * DigBits) - 1)) * n;
+    int const work = max(divmod_scratch_size(max(base_n, n), n),
+        max(2 * n + 1 + divmod_scratch_size(2 * n + 1, n), mod_mul_scratch_size(n)));
+    return table + 2 * n + work;
+}
+
+static inline unsigned
+exp_bit (y_bignum_dig_t const * e, int i) {
+    return (e[i / DigBits] >> (i % DigBits)) & 1;
+}
+
+// r[0..n) = base^e mod m, for m > 1 (n significant digits); uses
+//  powmod_scratch_size() digits of t.
+static void
+powmod_digs (y_bignum_dig_t * r, y_bignum_dig_t const * base, int base_n, y_bignum_dig_t const * e, int en, y_bignum_dig_t const * m, int n, y_bignum_dig_t * t) {
+    int const exp_bits = (en > 0) ? en * DigBits - leading_zero_bits(e[en - 1]) : 0;
+    int const w = window_bits(exp_bits);
+    ModContext ctx;
+    ctx.m = m;
+    ctx.n = n;
+    ctx.montgomery = (1 == (m[0] & 1));
+    ctx.m_inv = ctx.montgomery ? montgomery_inverse(m[0]) : 0;
+
+    // The table holds g, g^3, g^5, ... g^(2^w - 1)
+    y_bignum_dig_t * table = t;
+    y_bignum_dig_t * acc = table + (1 << (w - 1)) * n;
+    y_bignum_dig_t * tmp = acc + n;
+    y_bignum_dig_t * work = tmp + n;
+    ctx.t = work;
+
+    if (base_n >= n) {
+        divmod_digs(nullptr, table, base, base_n, m, n, work);
+    } else {
+        ::memcpy(table, base, base_n * sizeof(y_bignum_dig_t));
+        ::memset(table + base_n, 0, (n - base_n) * sizeof(y_bignum_dig_t));
+    }
+    ::memset(tmp, 0, n * sizeof(y_bignum_dig_t));
+    tmp[0] = 1;
+    if (ctx.montgomery) {
+        // R^2 mod m takes g into Montgomery form, and 1 to R mod m
+        ::memset(work, 0, 2 * n * sizeof(y_bignum_dig_t));
+        work[2 * n] = 1;
+        divmod_digs(nullptr, acc, work, 2 * n + 1, m, n, work + 2 * n + 1);
+        montgomery_mul(table, table, acc, m, n, ctx.m_inv, work);
+        montgomery_mul(acc, acc, tmp, m, n, ctx.m_inv, work);
+    } else {
+        ::memcpy(acc, tmp, n * sizeof(y_bignum_dig_t));
+    }
+    if (w > 1) {
+        mod_sqr(ctx, tmp, table);
+        for (int i = 1; i < (1 << (w - 1)); ++i)
+            mod_mul(ctx, table + i * n, table + (i - 1) * n, tmp);
+    }
+
+    // Left to right; each run of up to w bits that starts and ends with a 1
+    //  costs one multiplication by a table entry.
+    bool acc_is_one = true;
+    for (int i = exp_bits - 1; i >= 0; ) {
+        if (0 == exp_bit(e, i)) {
+            if (!acc_is_one)
+                mod_sqr(ctx, acc, acc);
+            i -= 1;
+        } else {
+            int low = max(i - w + 1, 0);
+            while (0 == exp_bit(e, low))
+                low += 1;
+            unsigned window = 0;
+            for (int k = i; k >= low; --k) {
+                window = (window << 1) | exp_bit(e, k);
+                if (!acc_is_one)
+                    mod_sqr(ctx, acc, acc);
+            }
+            if (acc_is_one)
+                ::memcpy(acc, table + (window >> 1) * n, n * sizeof(y_bignum_dig_t));
+            else
+                mod_mul(ctx, acc, acc, table + (window >> 1) * n);
+            acc_is_one = false;
+            i = low - 1;
+        }
+    }
+
+    if (ctx.montgomery) {
+        ::memset(tmp, 0, n * sizeof(y_bignum_dig_t));
+        tmp[0] = 1;
+        montgomery_mul(r, acc, tmp, m, n, ctx.m_inv, work);
+    } else {
+        ::memcpy(r, acc, n * sizeof(y_bignum_dig_t));
+    }
+}
+
+int y_bignum_powmod_scratch_size (int base_size, int exp_size, int mod_size) {
+    int ret = 0;
+    if (mod_size > 0)
+        ret = powmod_scratch_size(max(base_size, 0), max(exp_size, 0), mod_size);
+    return ret;
+}
+
+bool y_bignum_powmod_with_scratch (y_bignum_num_t * res, y_bignum_num_t const * base, y_bignum_num_t const * exp, y_bignum_num_t const * mod, y_bignum_num_t * scratch) {
+    bool ret = false;
+    int const base_cnt = significant_dig_count(base);
+    int const exp_cnt = significant_dig_count(exp);
+    int const n = significant_dig_count(mod);
+    if (res && base && exp && mod && n > 0 && !is_negative(exp) && dig_count(res) >= n &&
+            res->digs != exp->digs && res->digs != mod->digs &&
+            dig_count(scratch) >= powmod_scratch_size(base_cnt, exp_cnt, n)) {
+        if (1 == n && 1 == mod->digs[0]) {
+            ::memset(res->digs, 0, n * sizeof(y_bignum_dig_t));
+        } else {
+            powmod_digs(res->digs, base->digs, base_cnt, exp->digs, exp_cnt, mod->digs, n, scratch->digs);
+            // A negative base gives m - (|base|^e mod m) for odd e
+            if (is_negative(base) && exp_cnt > 0 && 1 == (exp->digs[0] & 1) && !is_zero_digs(res->digs, n)) {
+                negate_in_place(res->digs, n);
+                add_into(res->digs, n, mod->digs, n);
+            }
+        }
+        ::memset(res->digs + n, 0, (dig_count(res) - n) * sizeof(y_bignum_dig_t));
+        y_bignum_set_sign(res, false);
+        ret = true;
+    }
+    return ret;
+}
+
+bool y_bignum_powmod (y_bignum_num_t * res, y_bignum_num_t const * base, y_bignum_num_t const * exp, y_bignum_num_t const * mod) {
+    bool ret = false;
+    int const n = significant_dig_count(mod);
+    if (n > 0) {
+        y_bignum_num_t scratch = {};
+        int const scratch_size = powmod_scratch_size(significant_dig_count(base), significant_dig_count(exp), n);
+        if (y_bignum_realloc(&scratch, scratch_size, false) && scratch.digs)
+            ret = y_bignum_powmod_with_scratch(res, base, exp, mod, &scratch);
+        y_bignum_free(&scratch);
+    }
+    return ret;
+}
+
+// Without a modulus, the exponent has to fit in a digit for the result to
+//  be of any sensible size.
+bool y_bignum_pow (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b) {
+    bool ret = false;
+    int const acnt = significant_dig_count(a);
+    int const bcnt = significant_dig_count(b);
+    int const rcnt = dig_count(res);
+    if (res && a && b && bcnt <= 1 && !is_negative(b) && rcnt > 0 && res->digs != a->digs && res->digs != b->digs) {
+        y_bignum_dig_t const e = (bcnt > 0) ? b->digs[0] : 0;
+        long long const bits = (acnt > 0) ? (long long)acnt * DigBits - leading_zero_bits(a->digs[acnt - 1]) : 0;
+        long long const need = (bits * e + DigBits - 1) / DigBits;
+        if (0 == e || 0 == acnt) {
+            ::memset(res->digs, 0, rcnt * sizeof(y_bignum_dig_t));
+            res->digs[0] = (0 == e) ? 1 : 0;
+            y_bignum_set_sign(res, false);
+            ret = true;
+        } else if (need <= rcnt) {
+            // Two buffers for the running power (products are written out to
+            //  the sum of the operand lengths, which can be more than they
+            //  turn out to need,) and room for multiplying
+            y_bignum_num_t scratch = {};
+            int const n = (int)need;
+            if (y_bignum_realloc(&scratch, 4 * n + y_bignum_mul_scratch_size(n, n), false) && scratch.digs) {
+                y_bignum_dig_t * x = scratch.digs;
+                y_bignum_dig_t * y = x + 2 * n;
+                y_bignum_dig_t * t = y + 2 * n;
+                int len = acnt;
+                ::memcpy(x, a->digs, acnt * sizeof(y_bignum_dig_t));
+                for (int i = DigBits - 2 - leading_zero_bits(e); i >= 0; --i) {
+                    mul_digs(y, x, len, x, len, t);
+                    len = 2 * len;
+                    while (0 == y[len - 1])
+                        len -= 1;
+                    y_bignum_dig_t * s = x; x = y; y = s;
+                    if (0 != ((e >> i) & 1)) {
+                        mul_digs(y, x, len, a->digs, acnt, t);
+                        len += acnt;
+                        while (0 == y[len - 1])
+                            len -= 1;
+                        s = x; x = y; y = s;
+                    }
+                }
+                ::memcpy(res->digs, x, len * sizeof(y_bignum_dig_t));
+                ::memset(res->digs + len, 0, (rcnt - len) * sizeof(y_bignum_dig_t));
+                y_bignum_set_sign(res, is_negative(a) && 1 == (e & 1));
+                ret = true;
+            }
+            y_bignum_free(&scratch);
+        }
+    }
+    return ret;
+}
 
 //bool y_bignum_add (y_bignum_num_t * res, y_bignum_num_t const * a, unsigned long long b);
 //bool y_bignum_sub (y_bignum_num_t * res, y_bignum_num_t const * a, unsigned long long b);
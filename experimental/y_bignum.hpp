@@ -47,10 +47,35 @@ bool y_bignum_sub_unsigned (y_bignum_num_t * res, y_bignum_num_t const * a, y_bi
 
 bool y_bignum_add (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
 bool y_bignum_sub (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
-bool y_bignum_mul (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
-bool y_bignum_div (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
-bool y_bignum_mod (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);
-bool y_bignum_pow (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);   // res = a ** b (or a ^ b)
+bool y_bignum_mul (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);  // res must have room for a->size + b->size digits, and not be a or b
+bool y_bignum_div (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);  // Truncated, like C
+bool y_bignum_mod (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);  // Has a's sign, like C
+bool y_bignum_pow (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b);   // res = a ** b (or a ^ b); b must fit in a digit, and res hold b times the bits in a
+// Sliding-window exponentiation: its timing and memory accesses follow the
+//  bits of exp, so it is NOT constant-time, and isn't safe to use with a
+//  private exponent. A 2048-bit modulus takes about 96 us with e = 65537,
+//  and about 10 ms with a full 2048-bit exponent (see example_bignum.cpp.)
+bool y_bignum_powmod (y_bignum_num_t * res, y_bignum_num_t const * base, y_bignum_num_t const * exp, y_bignum_num_t const * mod);  // res = base ** exp mod |mod|, in [0, |mod|)
+
+// y_bignum_mul() allocates temporary space for the larger operands; this
+//  takes it from "scratch" instead, which must have at least
+//  y_bignum_mul_scratch_size() digits (zero means it can be null.)
+int y_bignum_mul_scratch_size (int a_size, int b_size);
+bool y_bignum_mul_with_scratch (y_bignum_num_t * res, y_bignum_num_t const * a, y_bignum_num_t const * b, y_bignum_num_t * scratch);
+
+// The same for division (either of quot and rem can be null) and modular
+//  exponentiation, for repeated use without allocating. quot needs
+//  a->size - b->size + 1 digits, and rem and res need b->size and
+//  mod->size digits (fewer if those have leading zeros.) res may be base.
+int y_bignum_divmod_scratch_size (int a_size, int b_size);
+bool y_bignum_divmod_with_scratch (y_bignum_num_t * quot, y_bignum_num_t * rem, y_bignum_num_t const * a, y_bignum_num_t const * b, y_bignum_num_t * scratch);
+int y_bignum_powmod_scratch_size (int base_size, int exp_size, int mod_size);
+bool y_bignum_powmod_with_scratch (y_bignum_num_t * res, y_bignum_num_t const * base, y_bignum_num_t const * exp, y_bignum_num_t const * mod, y_bignum_num_t * scratch);
+
+// Operand sizes (in digits) from which multiplication switches from
+//  schoolbook to Karatsuba, and then to Toom-3. See example_bignum.cpp.
+extern int y_bignum_karatsuba_threshold;
+extern int y_bignum_toom3_threshold;
 
 //bool y_bignum_add (y_bignum_num_t * res, y_bignum_num_t const * a, unsigned long long b);
 //bool y_bignum_sub (y_bignum_num_t * res, y_bignum_num_t const * a, unsigned long long b);
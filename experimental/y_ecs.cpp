@@ -1,7 +1,13 @@
 #include "y_ecs.hpp"
+#include <atomic>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdlib>  // for malloc() and friends
+#include <algorithm>    // std::sort()
 #include <cstring>  // strcmp()
+#include <mutex>
+#include <new>      // placement new
+#include <thread>
 
 //#include <Windows.h>  // for VirtualAlloc
 
@@ -120,6 +126,175 @@ static bool PagedArray_IsClear (World::PerEntityComponent const * array) {  // N
     }
     return ret;
 }
+//----------------------------------------------------------------------
+// Note: Never frees pages; shrinking just marks them unused.
+static bool PagedArray_Resize (World::PerEntityComponent * array, SizeType page_size, SizeType count_per_page, SizeType new_count) {
+    SizeType const pages_needed = (new_count + count_per_page - 1) / count_per_page;
+    if (pages_needed > array->page_array_size) {
+        SizeType new_array_size = 2 * array->page_array_size;
+        if (new_array_size < pages_needed)
+            new_array_size = pages_needed;
+        auto ptrs = static_cast<Byte **>(g_realloc(array->page_ptrs, new_array_size * sizeof(Byte *)));
+        if (!ptrs)
+            return false;
+        for (SizeType i = array->page_array_size; i < new_array_size; ++i)
+            ptrs[i] = nullptr;
+        array->page_ptrs = ptrs;
+        array->page_array_size = new_array_size;
+    }
+    while (array->pages_allocated < pages_needed) {
+        auto page = static_cast<Byte *>(g_page_alloc(page_size));
+        if (!page)
+            return false;
+        array->page_ptrs[array->pages_allocated] = page;
+        array->pages_allocated += 1;
+    }
+    array->pages_in_use = pages_needed;
+    array->elements_in_last_page = (0 == new_count) ? 0 : new_count - (pages_needed - 1) * count_per_page;
+    return true;
+}
+//----------------------------------------------------------------------
+static inline Byte * PagedArray_ElementPtr (World::PerEntityComponent const * array, SizeType count_per_page, SizeType element_size, SizeType index) {
+    return array->page_ptrs[index / count_per_page] + (index % count_per_page) * element_size;
+}
+//----------------------------------------------------------------------
+static void PagedArray_ZeroRange (World::PerEntityComponent * array, SizeType count_per_page, SizeType element_size, SizeType first, SizeType count) {
+    while (count > 0) {
+        SizeType n = count_per_page - first % count_per_page;
+        if (n > count)
+            n = count;
+        ::memset(PagedArray_ElementPtr(array, count_per_page, element_size, first), 0, size_t(n) * element_size);
+        first += n;
+        count -= n;
+    }
+}
+//----------------------------------------------------------------------
+// Note: Both arrays must be of the same component type (and not overlap.)
+static void PagedArray_CopyRange (World::PerEntityComponent * dst, SizeType dst_first, World::PerEntityComponent const * src, SizeType src_first, SizeType count, SizeType count_per_page, SizeType element_size) {
+    while (count > 0) {
+        SizeType n = count_per_page - dst_first % count_per_page;
+        SizeType const src_left_in_page = count_per_page - src_first % count_per_page;
+        if (n > src_left_in_page)
+            n = src_left_in_page;
+        if (n > count)
+            n = count;
+        ::memcpy(
+            PagedArray_ElementPtr(dst, count_per_page, element_size, dst_first),
+            PagedArray_ElementPtr(src, count_per_page, element_size, src_first),
+            size_t(n) * element_size
+        );
+        dst_first += n;
+        src_first += n;
+        count -= n;
+    }
+}
+//======================================================================
+struct QueryCacheEntry {
+    bool used;
+    uint64_t hash;
+    QuerySignature signature;
+    SizeType scanned_entity_type_count;     // Entity types [0..this) are already checked against the signature.
+    SizeType match_count;
+    EntityTypeBitSet matches;
+};
+//----------------------------------------------------------------------
+struct QueryCache {
+    std::mutex mutex;
+    SizeType capacity;          // Always zero or a power of two.
+    SizeType count;
+    QueryCacheEntry * entries;
+};
+//----------------------------------------------------------------------
+static inline uint64_t HashMix (uint64_t h, uint64_t word) {
+    h ^= word;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+}
+//----------------------------------------------------------------------
+static uint64_t QuerySignature_Hash (QuerySignature const & sig) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (auto w : sig.essential.bits) h = HashMix(h, w);
+    for (auto w : sig.excluded.bits) h = HashMix(h, w);
+    for (auto w : sig.tags_essential.bits) h = HashMix(h, w);
+    for (auto w : sig.tags_excluded.bits) h = HashMix(h, w);
+    return h;
+}
+//----------------------------------------------------------------------
+static bool QuerySignature_Equals (QuerySignature const & a, QuerySignature const & b) {
+    return
+        BitSet_Equals(a.essential.bits, b.essential.bits) &&
+        BitSet_Equals(a.excluded.bits, b.excluded.bits) &&
+        BitSet_Equals(a.tags_essential.bits, b.tags_essential.bits) &&
+        BitSet_Equals(a.tags_excluded.bits, b.tags_excluded.bits);
+}
+//----------------------------------------------------------------------
+static bool QuerySignature_Matches (QuerySignature const & sig, World::PerEntityType const * et) {
+    return
+        BitSet_ContainsAll(et->components.bits, sig.essential.bits) &&
+        !BitSet_ContainsAny(et->components.bits, sig.excluded.bits) &&
+        BitSet_ContainsAll(et->tags.bits, sig.tags_essential.bits) &&
+        !BitSet_ContainsAny(et->tags.bits, sig.tags_excluded.bits);
+}
+//----------------------------------------------------------------------
+static QueryCache * QueryCache_Create () {
+    auto ret = static_cast<QueryCache *>(g_alloc(sizeof(QueryCache)));
+    if (ret) {
+        new (ret) QueryCache;
+        ret->capacity = 0;
+        ret->count = 0;
+        ret->entries = nullptr;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+static void QueryCache_Destroy (QueryCache * cache) {
+    if (cache) {
+        g_dealloc(cache->entries, cache->capacity * sizeof(QueryCacheEntry));
+        cache->~QueryCache();
+        g_dealloc(cache, sizeof(QueryCache));
+    }
+}
+//----------------------------------------------------------------------
+// Note: Open addressing with linear probing; entries are never removed.
+//      Must be called with the mutex held.
+static QueryCacheEntry * QueryCache_FindOrInsert (QueryCache * cache, QuerySignature const & sig) {
+    if (2 * (cache->count + 1) > cache->capacity) {
+        SizeType new_capacity = cache->capacity > 0 ? 2 * cache->capacity : 64;
+        auto new_entries = static_cast<QueryCacheEntry *>(g_alloc_zero(new_capacity * sizeof(QueryCacheEntry)));
+        if (!new_entries)
+            return nullptr;
+        for (SizeType i = 0; i < cache->capacity; ++i) {
+            QueryCacheEntry const * old = cache->entries + i;
+            if (old->used) {
+                SizeType j = SizeType(old->hash) & (new_capacity - 1);
+                while (new_entries[j].used)
+                    j = (j + 1) & (new_capacity - 1);
+                new_entries[j] = *old;
+            }
+        }
+        g_dealloc(cache->entries, cache->capacity * sizeof(QueryCacheEntry));
+        cache->entries = new_entries;
+        cache->capacity = new_capacity;
+    }
+
+    uint64_t const hash = QuerySignature_Hash(sig);
+    SizeType const mask = cache->capacity - 1;
+    SizeType i = SizeType(hash) & mask;
+    for (;;) {
+        QueryCacheEntry * entry = cache->entries + i;
+        if (!entry->used) {
+            *entry = {};
+            entry->used = true;
+            entry->hash = hash;
+            entry->signature = sig;
+            cache->count += 1;
+            return entry;
+        }
+        if (entry->hash == hash && QuerySignature_Equals(entry->signature, sig))
+            return entry;
+        i = (i + 1) & mask;
+    }
+}
 //======================================================================
 bool TypeManager_Create (TypeManager * out_type_manager) {
     bool ret = false;
@@ -508,6 +683,8 @@ EntityType * EntityType_Register (TypeManager * type_manager, char const * name,
         entity_type->initial_capacity = initial_capacity;
         entity_type->component_count = static_cast<ComponentCount>(BitSet_CountOnes(components.bits));
         entity_type->components = components;
+        entity_type->tag_count = static_cast<ComponentCount>(BitSet_CountOnes(tags.bits));
+        entity_type->tags = tags;
         entity_type->owner = type_manager;
 
         unsigned i = 0;
@@ -709,7 +886,8 @@ bool World_Create (World * out_world, TypeManager const * type_manager, SizeType
         auto entity_names_mem = static_cast<World::Name *>(g_alloc_zero(entity_count * sizeof(World::Name)));
         auto entity_types_mem = static_cast<World::PerEntityType *>(g_alloc_zero(entity_count * sizeof(World::PerEntityType)));
         auto entity_comps_mem = static_cast<World::PerEntityComponent *>(g_alloc_zero(entity_comp_count * sizeof(World::PerEntityComponent)));
-        assert(comp_names_mem && comp_types_mem && entity_names_mem && entity_types_mem && entity_comps_mem);
+        auto query_cache = QueryCache_Create();
+        assert(comp_names_mem && comp_types_mem && entity_names_mem && entity_types_mem && entity_comps_mem && query_cache);
 
         *out_world = {};
         out_world->type_manager = type_manager;
@@ -717,6 +895,8 @@ bool World_Create (World * out_world, TypeManager const * type_manager, SizeType
         //out_world->data_page_shift = page_size_shift;
         //out_world->data_page_index_mask = data_page_size - 1;
         out_world->entity_component_data = entity_comps_mem;
+        out_world->query_cache = query_cache;
+        out_world->entity_record_free_head = InvalidIndex;
 
         unsigned i = 0;
 
@@ -782,11 +962,15 @@ bool World_Destroy (World * world) {
         for (SizeType i = 0, n = world->component_type_count * world->entity_type_count; i < n; ++i)
             PagedArray_Clear(world->entity_component_data + i, world->data_page_size);
         g_dealloc(world->entity_component_data, sizeof(World::PerEntityComponent) * world->component_type_count * world->entity_type_count);
+        for (SizeType i = 0; i < world->entity_type_count; ++i)
+            g_dealloc(world->entity_types[i].entity_ids, world->entity_types[i].entity_id_capacity * sizeof(EntityID));
+        g_dealloc(world->entity_records, world->entity_record_capacity * sizeof(World::EntityRecord));
         g_dealloc(world->entity_types, world->entity_type_count * sizeof(World::PerEntityType));
         g_dealloc(world->entity_type_names, world->entity_type_count * sizeof(World::Name));
         g_dealloc(world->component_types, world->component_type_count * sizeof(World::PerComponentType));
         g_dealloc(world->component_type_names, world->component_type_count * sizeof(World::Name));
         g_dealloc(world->tag_type_names, world->tag_type_count * sizeof(World::Name));
+        QueryCache_Destroy(world->query_cache);
         *world = {};
         ret = true;
     }
@@ -811,6 +995,9 @@ WorldMemoryStats World_GatherMemoryStats (World const * world) {
         add_to_overhead_and_total(sizeof(World::PerEntityType) * world->entity_type_count);
         add_to_overhead_and_total(sizeof(World::Name) * world->entity_type_count);
         add_to_overhead_and_total(sizeof(World::PerEntityComponent) * world->component_type_count * world->entity_type_count);
+        add_to_overhead_and_total(sizeof(World::EntityRecord) * world->entity_record_capacity);
+        for (unsigned entity_type_idx = 0; entity_type_idx < world->entity_type_count; ++entity_type_idx)
+            add_to_overhead_and_total(sizeof(EntityID) * world->entity_types[entity_type_idx].entity_id_capacity);
 
         for (unsigned entity_type_idx = 0, i = 0; entity_type_idx < world->entity_type_count; ++entity_type_idx) {
             auto et = world->entity_types + entity_type_idx;
@@ -837,6 +1024,856 @@ WorldMemoryStats World_GatherMemoryStats (World const * world) {
     return ret;
 }
 //----------------------------------------------------------------------
+bool World_AddEntityType (World * world, SizeType * out_entity_type_index, char const * name, ComponentBitSet const & components, TagBitSet const & tags, SizeType initial_capacity) {
+    bool ret = false;
+    if (
+        world &&
+        world->initialized &&
+        world->entity_type_count < MaxEntityTypes &&
+        !BitSet_Empty(components.bits) &&
+        BitSet_FindOne(components.bits, world->component_type_count) >= sizeof(components.bits) * 8 &&    // No unknown component types
+        BitSet_FindOne(tags.bits, world->tag_type_count) >= sizeof(tags.bits) * 8 &&
+        name &&
+        ::strlen(name) > 0 &&
+        ::strlen(name) <= MaxNameLen
+    ) {
+        SizeType const old_count = world->entity_type_count;
+        SizeType const new_count = old_count + 1;
+        SizeType const comp_count = world->component_type_count;
+
+        bool exists = false;
+        for (SizeType i = 0; i < old_count && !exists; ++i) {
+            auto et = world->entity_types + i;
+            exists =
+                0 == ::strcmp(name, world->entity_type_names[i]) ||
+                (BitSet_Equals(components.bits, et->components.bits) && BitSet_Equals(tags.bits, et->tags.bits));
+        }
+        auto names_mem = exists ? nullptr : static_cast<World::Name *>(g_realloc(world->entity_type_names, new_count * sizeof(World::Name)));
+        if (names_mem)
+            world->entity_type_names = names_mem;
+        auto types_mem = !names_mem ? nullptr : static_cast<World::PerEntityType *>(g_realloc(world->entity_types, new_count * sizeof(World::PerEntityType)));
+        if (types_mem)
+            world->entity_types = types_mem;
+        auto comps_mem = !types_mem ? nullptr : static_cast<World::PerEntityComponent *>(g_realloc(world->entity_component_data, new_count * comp_count * sizeof(World::PerEntityComponent)));
+        if (comps_mem)
+            world->entity_component_data = comps_mem;
+        if (comps_mem) {
+            StrCpy(world->entity_type_names[old_count], name, sizeof(World::Name));
+
+            World::PerEntityType * et = world->entity_types + old_count;
+            *et = {};
+            et->components = components;
+            et->tags = tags;
+            et->component_count = static_cast<ComponentCount>(BitSet_CountOnes(components.bits));
+            et->tag_count = static_cast<ComponentCount>(BitSet_CountOnes(tags.bits));
+            et->entity_count = 0;
+
+            World::PerEntityComponent * ecd = world->entity_component_data + old_count * comp_count;
+            for (SizeType comp_type_idx = 0; comp_type_idx < comp_count; ++comp_type_idx) {
+                PagedArray_InitEmpty(ecd + comp_type_idx);
+                if (BitSet_GetBit(components.bits, comp_type_idx)) {
+                    auto comps_per_page = world->component_types[comp_type_idx].count_per_page;
+                    PagedArray_InitReserve(ecd + comp_type_idx, world->data_page_size, (initial_capacity + comps_per_page - 1) / comps_per_page);
+                }
+            }
+
+            // Note: The query cache picks this up on the next lookup; see World_MatchEntityTypes().
+            world->entity_type_count = new_count;
+            if (out_entity_type_index)
+                *out_entity_type_index = old_count;
+            ret = true;
+        }
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool World_MatchEntityTypes (World * world, QuerySignature const & signature, EntityTypeBitSet * out_entity_types, SizeType * out_entity_type_count) {
+    bool ret = false;
+    if (world && world->query_cache && out_entity_types && out_entity_type_count) {
+        QueryCache * cache = world->query_cache;
+        std::lock_guard<std::mutex> lock (cache->mutex);
+        QueryCacheEntry * entry = QueryCache_FindOrInsert(cache, signature);
+        if (entry) {
+            for (SizeType i = entry->scanned_entity_type_count; i < world->entity_type_count; ++i) {
+                if (QuerySignature_Matches(signature, world->entity_types + i)) {
+                    BitSet_SetBit(entry->matches.bits, i);
+                    entry->match_count += 1;
+                }
+            }
+            entry->scanned_entity_type_count = world->entity_type_count;
+
+            *out_entity_types = entry->matches;
+            *out_entity_type_count = entry->match_count;
+            ret = true;
+        }
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool World_FindEntityType (World const * world, ComponentBitSet const & components, TagBitSet const & tags, SizeType * out_entity_type_index) {
+    bool ret = false;
+    if (world && world->initialized && out_entity_type_index) {
+        for (SizeType i = 0; i < world->entity_type_count && !ret; ++i) {
+            if (BitSet_Equals(components.bits, world->entity_types[i].components.bits) && BitSet_Equals(tags.bits, world->entity_types[i].tags.bits)) {
+                *out_entity_type_index = i;
+                ret = true;
+            }
+        }
+    }
+    return ret;
+}
+//======================================================================
+// Entity directory and lifecycle:
+//----------------------------------------------------------------------
+struct EntityLocation {
+    SizeType entity_type;
+    SizeType slot;
+    EntityID id;
+};
+//----------------------------------------------------------------------
+// Note: Sorts by entity type, then by *descending* slot; that's the order
+//      EntityType_SwapRemoveSlots() needs.
+static void EntityLocations_Sort (EntityLocation * locs, SizeType count) {
+    std::sort(locs, locs + count, [](EntityLocation const & a, EntityLocation const & b) {
+        return a.entity_type < b.entity_type || (a.entity_type == b.entity_type && a.slot > b.slot);
+    });
+}
+//----------------------------------------------------------------------
+static bool EntityType_ReserveIDs (World::PerEntityType * et, SizeType capacity) {
+    if (capacity > et->entity_id_capacity) {
+        SizeType new_capacity = 2 * et->entity_id_capacity;
+        if (new_capacity < capacity)
+            new_capacity = capacity;
+        auto ids = static_cast<EntityID *>(g_realloc(et->entity_ids, new_capacity * sizeof(EntityID)));
+        if (!ids)
+            return false;
+        et->entity_ids = ids;
+        et->entity_id_capacity = new_capacity;
+    }
+    return true;
+}
+//----------------------------------------------------------------------
+// Makes room for count more entities of the given type (i.e. entity_count + count,) but doesn't change entity_count.
+static bool EntityType_Grow (World * world, SizeType entity_type_index, SizeType count) {
+    World::PerEntityType * et = world->entity_types + entity_type_index;
+    World::PerEntityComponent * ecd = world->entity_component_data + entity_type_index * world->component_type_count;
+    SizeType const new_count = et->entity_count + count;
+
+    bool ok = EntityType_ReserveIDs(et, new_count);
+    SizeType ct = BitSet_FindOne(et->components.bits, 0);
+    for (; ok && ct < world->component_type_count; ct = BitSet_FindOne(et->components.bits, ct + 1))
+        ok = PagedArray_Resize(ecd + ct, world->data_page_size, world->component_types[ct].count_per_page, new_count);
+    if (!ok) {  // Roll back the ones we've grown; their extra pages stay allocated, which is harmless.
+        for (SizeType ct2 = BitSet_FindOne(et->components.bits, 0); ct2 < ct; ct2 = BitSet_FindOne(et->components.bits, ct2 + 1))
+            PagedArray_Resize(ecd + ct2, world->data_page_size, world->component_types[ct2].count_per_page, et->entity_count);
+    }
+    return ok;
+}
+//----------------------------------------------------------------------
+// Note: locs must all be from this entity type, sorted by descending slot
+//      and without repeats. Each one is filled by the entity that's currently
+//      last. The moves are replayed column by column, which keeps each memcpy
+//      inside one component array.
+static void EntityType_SwapRemoveSlots (World * world, SizeType entity_type_index, EntityLocation const * locs, SizeType count) {
+    World::PerEntityType * et = world->entity_types + entity_type_index;
+    World::PerEntityComponent * ecd = world->entity_component_data + entity_type_index * world->component_type_count;
+    SizeType const old_count = et->entity_count;
+    assert(count <= old_count);
+
+    for (SizeType ct = BitSet_FindOne(et->components.bits, 0); ct < world->component_type_count; ct = BitSet_FindOne(et->components.bits, ct + 1)) {
+        SizeType const cpp = world->component_types[ct].count_per_page;
+        SizeType const size = world->component_types[ct].size;
+        SizeType n = old_count;
+        for (SizeType i = 0; i < count; ++i, --n) {
+            SizeType const last = n - 1;
+            if (locs[i].slot != last)
+                ::memcpy(PagedArray_ElementPtr(ecd + ct, cpp, size, locs[i].slot), PagedArray_ElementPtr(ecd + ct, cpp, size, last), size);
+        }
+        PagedArray_Resize(ecd + ct, world->data_page_size, cpp, old_count - count);
+    }
+
+    SizeType n = old_count;
+    for (SizeType i = 0; i < count; ++i, --n) {
+        SizeType const last = n - 1;
+        if (locs[i].slot != last) {
+            EntityID const moved = et->entity_ids[last];
+            et->entity_ids[locs[i].slot] = moved;
+            world->entity_records[moved.index].slot = locs[i].slot;
+        }
+    }
+    et->entity_count = old_count - count;
+}
+//----------------------------------------------------------------------
+static bool World_ReserveEntityRecords (World * world, SizeType extra) {
+    // Note: Worst case, i.e. as if there were no free records.
+    SizeType const needed = world->entity_record_count + extra;
+    if (needed > MaxEntities || needed < extra)
+        return false;
+    if (needed > world->entity_record_capacity) {
+        SizeType new_capacity = 2 * world->entity_record_capacity;
+        if (new_capacity < needed)
+            new_capacity = needed;
+        if (new_capacity > MaxEntities)
+            new_capacity = MaxEntities;
+        auto records = static_cast<World::EntityRecord *>(g_realloc(world->entity_records, new_capacity * sizeof(World::EntityRecord)));
+        if (!records)
+            return false;
+        world->entity_records = records;
+        world->entity_record_capacity = new_capacity;
+    }
+    return true;
+}
+//----------------------------------------------------------------------
+static EntityID World_AllocEntityRecord (World * world, SizeType entity_type_index, SizeType slot) {
+    SizeType index = world->entity_record_free_head;
+    if (InvalidIndex != index) {
+        world->entity_record_free_head = world->entity_records[index].slot;
+    } else {
+        assert(world->entity_record_count < world->entity_record_capacity);
+        index = world->entity_record_count;
+        world->entity_record_count += 1;
+        world->entity_records[index].generation = 0;
+    }
+    World::EntityRecord * rec = world->entity_records + index;
+    rec->entity_type = entity_type_index;
+    rec->slot = slot;
+
+    EntityID ret;
+    ret.generation = rec->generation;
+    ret.index = index;
+    return ret;
+}
+//----------------------------------------------------------------------
+static void World_FreeEntityRecord (World * world, EntityID id) {
+    World::EntityRecord * rec = world->entity_records + id.index;
+    rec->generation += 1;   // Note: Wraps around after 256 reuses; that's what 8 bits buy us.
+    rec->entity_type = InvalidIndex;
+    rec->slot = world->entity_record_free_head;
+    world->entity_record_free_head = id.index;
+}
+//----------------------------------------------------------------------
+bool World_IsAlive (World const * world, EntityID id) {
+    bool ret = false;
+    if (world && id.index < world->entity_record_count) {
+        World::EntityRecord const * rec = world->entity_records + id.index;
+        ret = InvalidIndex != rec->entity_type && rec->generation == id.generation;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool World_GetEntityLocation (World const * world, EntityID id, SizeType * out_entity_type_index, SizeType * out_slot) {
+    bool ret = false;
+    if (World_IsAlive(world, id)) {
+        if (out_entity_type_index)
+            *out_entity_type_index = world->entity_records[id.index].entity_type;
+        if (out_slot)
+            *out_slot = world->entity_records[id.index].slot;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool World_SpawnEntities (World * world, SizeType entity_type_index, SizeType count, EntityID * out_ids) {
+    bool ret = false;
+    if (
+        world &&
+        world->initialized &&
+        entity_type_index < world->entity_type_count &&
+        World_ReserveEntityRecords(world, count) &&
+        EntityType_Grow(world, entity_type_index, count)
+    ) {
+        World::PerEntityType * et = world->entity_types + entity_type_index;
+        World::PerEntityComponent * ecd = world->entity_component_data + entity_type_index * world->component_type_count;
+        SizeType const first = et->entity_count;
+
+        for (SizeType ct = BitSet_FindOne(et->components.bits, 0); ct < world->component_type_count; ct = BitSet_FindOne(et->components.bits, ct + 1))
+            PagedArray_ZeroRange(ecd + ct, world->component_types[ct].count_per_page, world->component_types[ct].size, first, count);
+
+        for (SizeType i = 0; i < count; ++i) {
+            EntityID id = World_AllocEntityRecord(world, entity_type_index, first + i);
+            et->entity_ids[first + i] = id;
+            if (out_ids)
+                out_ids[i] = id;
+        }
+        et->entity_count = first + count;
+        world->total_entity_count += count;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool World_DespawnEntities (World * world, EntityID const * ids, SizeType count) {
+    bool ret = false;
+    if (world && world->initialized && (ids || 0 == count)) {
+        auto locs = static_cast<EntityLocation *>(g_alloc(count * sizeof(EntityLocation) + 1));
+        if (locs) {
+            SizeType n = 0;
+            for (SizeType i = 0; i < count; ++i) {
+                if (World_IsAlive(world, ids[i])) {
+                    World::EntityRecord const * rec = world->entity_records + ids[i].index;
+                    locs[n++] = {rec->entity_type, rec->slot, ids[i]};
+                    World_FreeEntityRecord(world, ids[i]);  // Also makes a repeated ID dead.
+                }
+            }
+            EntityLocations_Sort(locs, n);
+
+            for (SizeType begin = 0, end = 0; begin < n; begin = end) {
+                for (end = begin + 1; end < n && locs[end].entity_type == locs[begin].entity_type; ++end)
+                    ;
+                EntityType_SwapRemoveSlots(world, locs[begin].entity_type, locs + begin, end - begin);
+            }
+            world->total_entity_count -= n;
+
+            g_dealloc(locs, count * sizeof(EntityLocation) + 1);
+            ret = (n == count);
+        }
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+// Note: Entities are appended to the target in ascending source slot
+//      order, so runs of neighbouring source entities are copied with a
+//      single memcpy per component (per page.)
+bool World_MoveEntities (World * world, EntityID const * ids, SizeType count, SizeType target_entity_type_index) {
+    bool ret = false;
+    if (world && world->initialized && (ids || 0 == count) && target_entity_type_index < world->entity_type_count) {
+        auto locs = static_cast<EntityLocation *>(g_alloc(count * sizeof(EntityLocation) + 1));
+        if (locs) {
+            SizeType n = 0;
+            SizeType valid = 0;
+            for (SizeType i = 0; i < count; ++i) {
+                if (World_IsAlive(world, ids[i])) {
+                    World::EntityRecord const * rec = world->entity_records + ids[i].index;
+                    valid += 1;
+                    if (rec->entity_type != target_entity_type_index)
+                        locs[n++] = {rec->entity_type, rec->slot, ids[i]};
+                }
+            }
+            EntityLocations_Sort(locs, n);
+
+            // A repeated ID would be moved twice; drop the repeats.
+            SizeType unique = 0;
+            for (SizeType i = 0; i < n; ++i)
+                if (0 == unique || locs[i].entity_type != locs[unique - 1].entity_type || locs[i].slot != locs[unique - 1].slot)
+                    locs[unique++] = locs[i];
+            valid -= n - unique;
+            n = unique;
+
+            World::PerEntityType * dst_et = world->entity_types + target_entity_type_index;
+            World::PerEntityComponent * dst_ecd = world->entity_component_data + target_entity_type_index * world->component_type_count;
+            bool ok = true;
+            for (SizeType begin = 0, end = 0; begin < n && ok; begin = end) {
+                for (end = begin + 1; end < n && locs[end].entity_type == locs[begin].entity_type; ++end)
+                    ;
+                SizeType const src_type = locs[begin].entity_type;
+                SizeType const k = end - begin;
+                World::PerEntityType const * src_et = world->entity_types + src_type;
+                World::PerEntityComponent const * src_ecd = world->entity_component_data + src_type * world->component_type_count;
+
+                ok = EntityType_Grow(world, target_entity_type_index, k);
+                if (ok) {
+                    SizeType const first = dst_et->entity_count;
+
+                    // locs[begin..end) are in descending slot order; locs[end - 1 - j] goes to first + j.
+                    for (SizeType ct = BitSet_FindOne(dst_et->components.bits, 0); ct < world->component_type_count; ct = BitSet_FindOne(dst_et->components.bits, ct + 1)) {
+                        SizeType const cpp = world->component_types[ct].count_per_page;
+                        SizeType const size = world->component_types[ct].size;
+                        if (BitSet_GetBit(src_et->components.bits, ct)) {
+                            for (SizeType j = 0; j < k; ) {
+                                SizeType const src_first = locs[end - 1 - j].slot;
+                                SizeType run = 1;
+                                while (j + run < k && locs[end - 1 - j - run].slot == src_first + run)
+                                    run += 1;
+                                PagedArray_CopyRange(dst_ecd + ct, first + j, src_ecd + ct, src_first, run, cpp, size);
+                                j += run;
+                            }
+                        } else {
+                            PagedArray_ZeroRange(dst_ecd + ct, cpp, size, first, k);
+                        }
+                    }
+
+                    for (SizeType j = 0; j < k; ++j) {
+                        EntityID const id = locs[end - 1 - j].id;
+                        dst_et->entity_ids[first + j] = id;
+                        world->entity_records[id.index].entity_type = target_entity_type_index;
+                        world->entity_records[id.index].slot = first + j;
+                    }
+                    dst_et->entity_count = first + k;
+
+                    EntityType_SwapRemoveSlots(world, src_type, locs + begin, k);
+                }
+            }
+
+            g_dealloc(locs, count * sizeof(EntityLocation) + 1);
+            ret = ok && (valid == count);
+        }
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+//======================================================================
+struct JobBatch {
+    JobFunc func;
+    void * user_data;
+    SizeType job_count;
+    std::atomic<SizeType> next_job;
+    std::atomic<unsigned> attached_workers;  // Pool threads currently working on this batch.
+    JobBatch * next;
+};
+//----------------------------------------------------------------------
+struct JobPool {
+    std::mutex mutex;
+    std::condition_variable work_available;
+    bool quit;
+    JobBatch * batches;     // Guarded by the mutex.
+    unsigned thread_count;
+    std::thread * threads;
+};
+//----------------------------------------------------------------------
+static thread_local JobPool const * t_job_pool = nullptr;
+static thread_local unsigned t_job_pool_worker_index = 0;
+//----------------------------------------------------------------------
+static JobBatch * JobPool_FindWork (JobPool * pool) {  // Note: The pool's mutex must be held.
+    for (auto batch = pool->batches; batch; batch = batch->next)
+        if (batch->next_job.load() < batch->job_count)
+            return batch;
+    return nullptr;
+}
+//----------------------------------------------------------------------
+static void JobBatch_Drain (JobBatch * batch, unsigned worker_index) {
+    for (;;) {
+        SizeType job_index = batch->next_job.fetch_add(1);
+        if (job_index >= batch->job_count)
+            break;
+        batch->func(batch->user_data, job_index, worker_index);
+    }
+}
+//----------------------------------------------------------------------
+static void JobPool_WorkerMain (JobPool * pool, unsigned worker_index) {
+    t_job_pool = pool;
+    t_job_pool_worker_index = worker_index;
+
+    std::unique_lock<std::mutex> lock (pool->mutex);
+    for (;;) {
+        JobBatch * batch = nullptr;
+        pool->work_available.wait(lock, [&]{return pool->quit || nullptr != (batch = JobPool_FindWork(pool));});
+        if (!batch)
+            break;
+        batch->attached_workers.fetch_add(1);   // Under the lock, so the batch can't be unlinked before this.
+        lock.unlock();
+        JobBatch_Drain(batch, worker_index);
+        batch->attached_workers.fetch_sub(1);   // The batch might be gone after this.
+        lock.lock();
+    }
+}
+//----------------------------------------------------------------------
+bool JobPool_Create (JobPool ** out_pool, unsigned thread_count) {
+    bool ret = false;
+    if (out_pool) {
+        if (0 == thread_count) {
+            unsigned hw = std::thread::hardware_concurrency();
+            thread_count = (hw > 1 ? hw - 1 : 0);
+        }
+        void * pool_mem = g_alloc(sizeof(JobPool));
+        std::thread * threads = nullptr;
+        if (pool_mem && thread_count > 0) {
+            threads = static_cast<std::thread *>(g_alloc(thread_count * sizeof(std::thread)));
+            if (!threads) {
+                g_dealloc(pool_mem, sizeof(JobPool));
+                pool_mem = nullptr;
+            }
+        }
+        if (pool_mem) {
+            auto pool = new (pool_mem) JobPool;
+            pool->quit = false;
+            pool->batches = nullptr;
+            pool->thread_count = thread_count;
+            pool->threads = threads;
+            for (unsigned i = 0; i < thread_count; ++i)
+                new (pool->threads + i) std::thread (JobPool_WorkerMain, pool, i + 1);
+            *out_pool = pool;
+            ret = true;
+        }
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+void JobPool_Destroy (JobPool * pool) {
+    if (pool) {
+        {
+            std::lock_guard<std::mutex> lock (pool->mutex);
+            assert(!pool->batches);
+            pool->quit = true;
+        }
+        pool->work_available.notify_all();
+        for (unsigned i = 0; i < pool->thread_count; ++i) {
+            pool->threads[i].join();
+            pool->threads[i].~thread();
+        }
+        if (pool->threads)
+            g_dealloc(pool->threads, pool->thread_count * sizeof(std::thread));
+        pool->~JobPool();
+        g_dealloc(pool, sizeof(JobPool));
+    }
+}
+//----------------------------------------------------------------------
+unsigned JobPool_ThreadCount (JobPool const * pool) {
+    return pool ? pool->thread_count : 0;
+}
+//----------------------------------------------------------------------
+unsigned JobPool_WorkerIndex (JobPool const * pool) {
+    return (pool && t_job_pool == pool) ? t_job_pool_worker_index : 0;
+}
+//----------------------------------------------------------------------
+void JobPool_Run (JobPool * pool, SizeType job_count, JobFunc func, void * user_data) {
+    if (0 == job_count || !func)
+        return;
+
+    unsigned const worker_index = JobPool_WorkerIndex(pool);
+    if (!pool || 0 == pool->thread_count || 1 == job_count) {
+        for (SizeType i = 0; i < job_count; ++i)
+            func(user_data, i, worker_index);
+        return;
+    }
+
+    JobBatch batch;
+    batch.func = func;
+    batch.user_data = user_data;
+    batch.job_count = job_count;
+    batch.next_job = 0;
+    batch.attached_workers = 0;
+    {
+        std::lock_guard<std::mutex> lock (pool->mutex);
+        batch.next = pool->batches;
+        pool->batches = &batch;
+    }
+    pool->work_available.notify_all();
+
+    JobBatch_Drain(&batch, worker_index);
+
+    // All the jobs are claimed now; unlink the batch so no new worker attaches, then wait for the stragglers.
+    {
+        std::lock_guard<std::mutex> lock (pool->mutex);
+        JobBatch ** p = &pool->batches;
+        while (*p != &batch)
+            p = &(*p)->next;
+        *p = batch.next;
+    }
+    while (0 != batch.attached_workers.load())
+        std::this_thread::yield();
+}
+//----------------------------------------------------------------------
+bool System_ConflictsWith (System const * a, System const * b) {
+    bool ret = false;
+    if (a && b && BitSet_ContainsAny(a->entity_types.bits, b->entity_types.bits)) {
+        ret =
+            BitSet_ContainsAny(a->writes.bits, b->writes.bits) ||
+            BitSet_ContainsAny(a->writes.bits, b->reads.bits) ||
+            BitSet_ContainsAny(a->reads.bits, b->writes.bits);
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+static void Scheduler_ClearWaves (Scheduler * scheduler) {
+    if (scheduler->wave_offsets)
+        g_dealloc(scheduler->wave_offsets, (scheduler->wave_count + 1) * sizeof(SizeType));
+    if (scheduler->wave_systems)
+        g_dealloc(scheduler->wave_systems, scheduler->system_count * sizeof(SizeType));
+    scheduler->wave_count = 0;
+    scheduler->wave_offsets = nullptr;
+    scheduler->wave_systems = nullptr;
+    scheduler->built = false;
+}
+//----------------------------------------------------------------------
+bool Scheduler_Create (Scheduler * out_scheduler, World * world, JobPool * pool) {
+    bool ret = false;
+    if (out_scheduler && world && world->initialized) {
+        *out_scheduler = {};
+        out_scheduler->world = world;
+        out_scheduler->pool = pool;
+        out_scheduler->initialized = true;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool Scheduler_Destroy (Scheduler * scheduler) {
+    bool ret = false;
+    if (scheduler && scheduler->initialized) {
+        Scheduler_ClearWaves(scheduler);
+        if (scheduler->systems)
+            g_dealloc(scheduler->systems, scheduler->system_capacity * sizeof(System));
+        *scheduler = {};
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool Scheduler_AddSystem (Scheduler * scheduler, char const * name, ComponentBitSet const & reads, ComponentBitSet const & writes, EntityTypeBitSet const & entity_types, SystemFunc func, void * user_data) {
+    bool ret = false;
+    if (scheduler && scheduler->initialized && func && name && ::strlen(name) <= MaxNameLen) {
+        if (scheduler->system_count == scheduler->system_capacity) {
+            SizeType new_capacity = (scheduler->system_capacity > 0 ? 2 * scheduler->system_capacity : 16);
+            auto new_systems = static_cast<System *>(g_realloc(scheduler->systems, new_capacity * sizeof(System)));
+            if (!new_systems)
+                return false;
+            scheduler->systems = new_systems;
+            scheduler->system_capacity = new_capacity;
+        }
+        Scheduler_ClearWaves(scheduler);
+
+        System * sys = scheduler->systems + scheduler->system_count;
+        *sys = {};
+        sys->func = func;
+        sys->user_data = user_data;
+        sys->reads = reads;
+        sys->writes = writes;
+        sys->entity_types = entity_types;
+        StrCpy(sys->name, name, sizeof(sys->name));
+        scheduler->system_count += 1;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool Scheduler_AddSystem (Scheduler * scheduler, char const * name, ComponentBitSet const & reads, ComponentBitSet const & writes, QuerySignature const & signature, SystemFunc func, void * user_data) {
+    bool ret = false;
+    if (Scheduler_AddSystem(scheduler, name, reads, writes, EntityTypeBitSet{}, func, user_data)) {
+        System * sys = scheduler->systems + scheduler->system_count - 1;
+        sys->has_signature = true;
+        sys->signature = signature;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool Scheduler_Build (Scheduler * scheduler) {
+    bool ret = false;
+    if (scheduler && scheduler->initialized) {
+        Scheduler_ClearWaves(scheduler);
+        SizeType const n = scheduler->system_count;
+
+        // The world may have gained entity types since the system was added.
+        for (SizeType j = 0; j < n; ++j) {
+            System * sys = scheduler->systems + j;
+            SizeType match_count = 0;
+            if (sys->has_signature && !World_MatchEntityTypes(scheduler->world, sys->signature, &sys->entity_types, &match_count))
+                return false;
+        }
+        scheduler->built_entity_type_count = scheduler->world->entity_type_count;
+
+        // A system goes into the wave right after the last earlier system that it conflicts with.
+        SizeType wave_count = 0;
+        for (SizeType j = 0; j < n; ++j) {
+            System * sys = scheduler->systems + j;
+            sys->wave = 0;
+            for (SizeType i = 0; i < j; ++i)
+                if (scheduler->systems[i].wave + 1 > sys->wave && System_ConflictsWith(scheduler->systems + i, sys))
+                    sys->wave = scheduler->systems[i].wave + 1;
+            if (sys->wave + 1 > wave_count)
+                wave_count = sys->wave + 1;
+        }
+
+        scheduler->wave_offsets = static_cast<SizeType *>(g_alloc_zero((wave_count + 1) * sizeof(SizeType)));
+        scheduler->wave_systems = (n > 0 ? static_cast<SizeType *>(g_alloc(n * sizeof(SizeType))) : nullptr);
+        if (!scheduler->wave_offsets || (n > 0 && !scheduler->wave_systems))
+            return false;
+        scheduler->wave_count = wave_count;
+
+        // Counting sort of the systems by wave, keeping the order they were added in.
+        for (SizeType j = 0; j < n; ++j)
+            scheduler->wave_offsets[scheduler->systems[j].wave + 1] += 1;
+        for (SizeType w = 0; w < wave_count; ++w)
+            scheduler->wave_offsets[w + 1] += scheduler->wave_offsets[w];
+        for (SizeType w = 0; w < wave_count; ++w)
+            for (SizeType j = 0, k = scheduler->wave_offsets[w]; j < n; ++j)
+                if (scheduler->systems[j].wave == w)
+                    scheduler->wave_systems[k++] = j;
+
+        scheduler->built = true;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool Scheduler_Run (Scheduler * scheduler) {
+    bool ret = false;
+    if (
+        scheduler && scheduler->initialized &&
+        ((scheduler->built && scheduler->built_entity_type_count == scheduler->world->entity_type_count) || Scheduler_Build(scheduler))
+    ) {
+        for (SizeType w = 0; w < scheduler->wave_count; ++w) {
+            SizeType const * wave = scheduler->wave_systems + scheduler->wave_offsets[w];
+            JobPool_ParallelFor(
+                scheduler->pool, scheduler->wave_offsets[w + 1] - scheduler->wave_offsets[w],
+                [scheduler, wave](SizeType job_index, unsigned /*worker_index*/) {
+                    System const * sys = scheduler->systems + wave[job_index];
+                    sys->func(scheduler->world, scheduler->pool, sys->user_data);
+                }
+            );
+        }
+        ret = true;
+    }
+    return ret;
+}
+//======================================================================
+bool CommandQueue_Create (CommandQueue * out_queue, JobPool const * pool) {
+    bool ret = false;
+    if (out_queue) {
+        *out_queue = {};
+        unsigned const buffer_count = JobPool_ThreadCount(pool) + 1;
+        out_queue->buffers = static_cast<CommandBuffer *>(g_alloc_zero(buffer_count * sizeof(CommandBuffer)));
+        if (out_queue->buffers) {
+            out_queue->buffer_count = buffer_count;
+            out_queue->initialized = true;
+            ret = true;
+        }
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool CommandQueue_Destroy (CommandQueue * queue) {
+    bool ret = false;
+    if (queue && queue->initialized) {
+        for (unsigned i = 0; i < queue->buffer_count; ++i)
+            g_dealloc(queue->buffers[i].commands, queue->buffers[i].capacity * sizeof(Command));
+        g_dealloc(queue->buffers, queue->buffer_count * sizeof(CommandBuffer));
+        *queue = {};
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+CommandBuffer * CommandQueue_GetBuffer (CommandQueue * queue, unsigned worker_index) {
+    CommandBuffer * ret = nullptr;
+    if (queue && queue->initialized && worker_index < queue->buffer_count)
+        ret = queue->buffers + worker_index;
+    return ret;
+}
+//----------------------------------------------------------------------
+static Command * CommandBuffer_Append (CommandBuffer * buffer) {
+    if (buffer->count == buffer->capacity) {
+        SizeType new_capacity = buffer->capacity > 0 ? 2 * buffer->capacity : 256;
+        auto commands = static_cast<Command *>(g_realloc(buffer->commands, new_capacity * sizeof(Command)));
+        if (!commands)
+            return nullptr;
+        buffer->commands = commands;
+        buffer->capacity = new_capacity;
+    }
+    Command * ret = buffer->commands + buffer->count;
+    buffer->count += 1;
+    *ret = {};
+    return ret;
+}
+//----------------------------------------------------------------------
+bool CommandBuffer_Spawn (CommandBuffer * buffer, SizeType entity_type_index, SizeType count, EntityID * out_ids) {
+    bool ret = false;
+    Command * cmd = buffer ? CommandBuffer_Append(buffer) : nullptr;
+    if (cmd) {
+        cmd->kind = Command::Spawn;
+        cmd->entity_type = entity_type_index;
+        cmd->count = count;
+        cmd->out_ids = out_ids;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool CommandBuffer_Despawn (CommandBuffer * buffer, EntityID id) {
+    bool ret = false;
+    Command * cmd = buffer ? CommandBuffer_Append(buffer) : nullptr;
+    if (cmd) {
+        cmd->kind = Command::Despawn;
+        cmd->id = id;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool CommandBuffer_Move (CommandBuffer * buffer, EntityID id, SizeType target_entity_type_index) {
+    bool ret = false;
+    Command * cmd = buffer ? CommandBuffer_Append(buffer) : nullptr;
+    if (cmd) {
+        cmd->kind = Command::Move;
+        cmd->entity_type = target_entity_type_index;
+        cmd->id = id;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+bool CommandBuffer_Clear (CommandBuffer * buffer) {
+    bool ret = false;
+    if (buffer) {
+        buffer->count = 0;
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+// Note: Gathers everything into one array, sorts it by (kind, entity type)
+//      and hands each run of same-kind-same-type commands to the batched
+//      World_* function. Returns false if any of the commands failed (e.g.
+//      a dead ID,) but still applies the rest.
+bool World_Apply (World * world, CommandQueue * queue) {
+    bool ret = false;
+    if (world && world->initialized && queue && queue->initialized) {
+        SizeType total = 0;
+        for (unsigned i = 0; i < queue->buffer_count; ++i)
+            total += queue->buffers[i].count;
+
+        auto cmds = static_cast<Command *>(g_alloc(total * sizeof(Command) + 1));
+        auto ids = static_cast<EntityID *>(g_alloc(total * sizeof(EntityID) + 1));
+        if (cmds && ids) {
+            SizeType n = 0;
+            for (unsigned i = 0; i < queue->buffer_count; ++i) {
+                if (queue->buffers[i].count)    // An empty buffer may not have an array at all
+                    ::memcpy(cmds + n, queue->buffers[i].commands, queue->buffers[i].count * sizeof(Command));
+                n += queue->buffers[i].count;
+            }
+            std::stable_sort(cmds, cmds + n, [](Command const & a, Command const & b) {
+                return a.kind < b.kind || (a.kind == b.kind && a.entity_type < b.entity_type);
+            });
+
+            ret = true;
+            for (SizeType begin = 0, end = 0; begin < n; begin = end) {
+                Command::Kind const kind = cmds[begin].kind;
+                SizeType const entity_type = (Command::Despawn == kind ? 0 : cmds[begin].entity_type);
+                for (end = begin + 1; end < n && cmds[end].kind == kind && (Command::Despawn == kind || cmds[end].entity_type == entity_type); ++end)
+                    ;
+
+                if (Command::Spawn == kind) {
+                    SizeType spawn_count = 0;
+                    for (SizeType i = begin; i < end; ++i)
+                        spawn_count += cmds[i].count;
+                    auto spawned = static_cast<EntityID *>(g_alloc(spawn_count * sizeof(EntityID) + 1));
+                    if (spawned && World_SpawnEntities(world, entity_type, spawn_count, spawned)) {
+                        for (SizeType i = begin, k = 0; i < end; k += cmds[i].count, ++i)
+                            if (cmds[i].out_ids)
+                                ::memcpy(cmds[i].out_ids, spawned + k, cmds[i].count * sizeof(EntityID));
+                    } else {
+                        ret = false;
+                    }
+                    g_dealloc(spawned, spawn_count * sizeof(EntityID) + 1);
+                } else {
+                    for (SizeType i = begin; i < end; ++i)
+                        ids[i - begin] = cmds[i].id;
+                    bool ok = (Command::Move == kind)
+                        ? World_MoveEntities(world, ids, end - begin, entity_type)
+                        : World_DespawnEntities(world, ids, end - begin);
+                    ret = ret && ok;
+                }
+            }
+
+            for (unsigned i = 0; i < queue->buffer_count; ++i)
+                CommandBuffer_Clear(queue->buffers + i);
+        }
+        g_dealloc(ids, total * sizeof(EntityID) + 1);
+        g_dealloc(cmds, total * sizeof(Command) + 1);
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
 //======================================================================
 }   // namespace Ex
 }   // namespace y
@@ -31,7 +31,7 @@ static inline bool BitSet_Empty (T (&bits) [N]) {
 }
 //----------------------------------------------------------------------
 template <typename T, size_t N>
-static inline unsigned BitSet_CountOnes (T (&bits) [N]) {
+static inline unsigned BitSet_CountOnes (T const (&bits) [N]) {
     static_assert(std::is_integral_v<T> && std::is_unsigned_v<T> && N > 0);
     unsigned ret = 0;
     for (size_t i = 0; i < N; ++i) {
@@ -71,7 +71,7 @@ static inline void BitSet_ClearAll (T (&bits) [N]) {
 }
 //----------------------------------------------------------------------
 template <typename T, size_t N>
-static inline bool BitSet_Equals (T (&a) [N], T (&b) [N]) {
+static inline bool BitSet_Equals (T const (&a) [N], T const (&b) [N]) {
     static_assert(std::is_integral_v<T> && std::is_unsigned_v<T> && N > 0);
     for (size_t i = 0; i < N; ++i)
         if (a[i] != b[i])
@@ -116,13 +116,19 @@ static inline bool BitSet_ContainsAny (T const (&super) [N], T const (&sub) [N])
     return false;
 }
 //----------------------------------------------------------------------
+template <typename T, size_t N>
+static inline void BitSet_Union (T (&dst) [N], T const (&src) [N]) {
+    static_assert(std::is_integral_v<T> && std::is_unsigned_v<T> && N > 0);
+    for (size_t i = 0; i < N; ++i)
+        dst[i] |= src[i];
+}
+//----------------------------------------------------------------------
 #pragma endregion
 
 }   // namespace y
 
 
 // TODO(yzt): Add the concept of "tags".
-// TODO(yzt): Add a "roster" or "directory" that contains all entities to the "World" (a.k.a. EntityManager functionality)
 // TODO(yzt): Add a series of default component types and tag types, and probably auto register them when creating the TypeManager (e.g. a MyEntityID component, or "Active", "Dynamic", "Prefab", "ReadOnly" tags.) That MyEntityID component probably should be added to all entity types anyways.
 
 namespace y {
@@ -142,6 +148,8 @@ constexpr SizeType MaxNameLen = 63;
 constexpr ComponentCount MaxComponentTypes = 128;
 constexpr ComponentCount MaxTagTypes = 64;
 constexpr SizeType MaxEntityTypes = 1'000;
+constexpr SizeType MaxEntities = SizeType(1) << 24;     // Because of EntityID::index
+constexpr SizeType InvalidIndex = ~SizeType(0);
 
 struct TypeManager;
 
@@ -201,6 +209,17 @@ struct TypeManager {
     EntityType * entity_type_last;
 };
 
+// Note: What decides which entity types a query matches. Full-access and
+//      read-only don't matter here, and neither do optional components.
+struct QuerySignature {
+    ComponentBitSet essential;
+    ComponentBitSet excluded;
+    TagBitSet tags_essential;
+    TagBitSet tags_excluded;
+};
+
+struct QueryCache;  // Opaque; see y_ecs.cpp
+
 struct World {
     using Name = char [MaxNameLen + 1];
 
@@ -230,6 +249,8 @@ struct World {
         ComponentCount component_count;
         ComponentCount tag_count;
         SizeType entity_count;
+        SizeType entity_id_capacity;
+        EntityID * entity_ids;      // The ID of the entity in each slot; parallel to the component arrays.
     } * entity_types;
 
     struct PerEntityComponent {
@@ -241,6 +262,20 @@ struct World {
         SizeType pages_in_use;      // FIXME(yzt): Should I change this to something like "full_pages"?
         SizeType elements_in_last_page;
     } * entity_component_data;      // NOTE(yzt): The ComponentTypes of each EntityType are laid together, i.e. element 0 is the 1st component type of the 1st entity type, element 1 is the 2nd component type of the 1st entity type, etc.
+
+    QueryCache * query_cache;       // Matched entity types, per QuerySignature. Only scans the entity types added since the last lookup.
+
+    // Note: The entity directory; indexed by EntityID::index. An ID is
+    //      alive if its record is in use and the generations match. Freed
+    //      records are chained through their "slot" field.
+    SizeType entity_record_count;
+    SizeType entity_record_capacity;
+    SizeType entity_record_free_head;   // InvalidIndex if there are no free records
+    struct EntityRecord {
+        SizeType entity_type;   // InvalidIndex if free
+        SizeType slot;          // Where the entity's components are, in its entity type's arrays
+        uint8_t generation;
+    } * entity_records;
 };
 
 //---------------------------------------------------------------------
@@ -293,6 +328,85 @@ struct WorldMemoryStats {
 
 //----------------------------------------------------------------------
 
+// Note: A bunch of worker threads that execute "batches" of jobs. The
+//      thread that submits a batch also works on it (and so does any pool
+//      thread that submits a nested batch from inside a job,) so nesting
+//      JobPool_Run calls can't deadlock.
+struct JobPool;     // Opaque; see y_ecs.cpp
+
+// Note: worker_index is in [0..JobPool_ThreadCount(pool)]; 0 is the
+//      (non-pool) thread that called JobPool_Run, the rest are pool threads.
+//      Use it to index per-thread data that needs no locking.
+using JobFunc = void (*) (void * user_data, SizeType job_index, unsigned worker_index);
+
+using SystemFunc = void (*) (World * world, JobPool * pool, void * user_data);
+
+struct System {
+    SystemFunc func;
+    void * user_data;
+    ComponentBitSet reads;
+    ComponentBitSet writes;
+    EntityTypeBitSet entity_types;  // Two systems can only conflict if they touch a common entity type.
+    bool has_signature;             // If set, Scheduler_Build() re-matches entity_types against the world's current entity types.
+    QuerySignature signature;
+    SizeType wave;                  // Filled by Scheduler_Build()
+    char name [MaxNameLen + 1];
+};
+
+// Note: Systems run in the order they were added, except that systems
+//      that don't conflict (i.e. none of them writes a component type that
+//      the other reads or writes, on a common entity type) are grouped into
+//      "waves" and each wave is run in parallel.
+struct Scheduler {
+    bool initialized;
+    bool built;
+    World * world;
+    JobPool * pool;             // Can be nullptr, then everything runs on the calling thread.
+
+    SizeType system_count;
+    SizeType system_capacity;
+    System * systems;
+
+    SizeType built_entity_type_count;   // world->entity_type_count at the last build; Scheduler_Run() rebuilds if it's changed.
+    SizeType wave_count;
+    SizeType * wave_offsets;    // wave_count + 1 elements; the systems of wave w are wave_systems[wave_offsets[w]..wave_offsets[w + 1])
+    SizeType * wave_systems;
+};
+
+// Note: Structural changes (spawn, despawn, moving entities to another
+//      entity type, i.e. adding/removing components or tags) can't be done
+//      while systems are running in parallel. Record them into the command
+//      buffer of the current worker instead, and World_Apply() them later.
+struct Command {
+    enum Kind : uint8_t {   // Also the order that World_Apply() applies them in.
+        Spawn,
+        Move,
+        Despawn,
+    };
+
+    Kind kind;
+    SizeType entity_type;   // Spawn: the type to spawn; Move: the target type
+    SizeType count;         // Spawn only
+    EntityID id;            // Move and Despawn only
+    EntityID * out_ids;     // Spawn only; filled in by World_Apply(), can be nullptr.
+};
+
+struct CommandBuffer {
+    SizeType count;
+    SizeType capacity;
+    Command * commands;
+};
+
+// One CommandBuffer per worker of a JobPool (including worker 0, the calling
+// thread,) so recording a command never needs a lock.
+struct CommandQueue {
+    bool initialized;
+    unsigned buffer_count;
+    CommandBuffer * buffers;
+};
+
+//----------------------------------------------------------------------
+
 
 //----------------------------------------------------------------------
 // Functions:
@@ -363,6 +477,54 @@ EntityType const * EntityType_FindByComponentAndTagSets (TypeManager const * typ
 bool World_Create (World * out_world, TypeManager const * type_manager, SizeType data_page_size, SizeType max_entity_types = MaxEntityTypes, ComponentCount max_component_types = MaxComponentTypes, ComponentCount max_tags = MaxTagTypes);
 bool World_Destroy (World * world);
 WorldMemoryStats World_GatherMemoryStats (World const * world);
+// Note: Adds an entity type that wasn't registered with the type manager. Don't call while anything else is using the world!
+bool World_AddEntityType (World * world, SizeType * out_entity_type_index, char const * name, ComponentBitSet const & components, TagBitSet const & tags, SizeType initial_capacity = 0);
+bool World_MatchEntityTypes (World * world, QuerySignature const & signature, EntityTypeBitSet * out_entity_types, SizeType * out_entity_type_count);  // Thread-safe; uses the world's query cache.
+bool World_FindEntityType (World const * world, ComponentBitSet const & components, TagBitSet const & tags, SizeType * out_entity_type_index);
+
+// Note: New entities' components are zero-filled. out_ids can be nullptr.
+bool World_SpawnEntities (World * world, SizeType entity_type_index, SizeType count, EntityID * out_ids);
+// Note: Dead or repeated IDs are skipped (and make these return false,)
+//      the rest are still processed. Entities are swap-removed, so the slots
+//      of other entities of the same types change.
+bool World_DespawnEntities (World * world, EntityID const * ids, SizeType count);
+// Note: This is how you add/remove components or tags. Shared components
+//      are copied, new ones are zero-filled. IDs don't change.
+bool World_MoveEntities (World * world, EntityID const * ids, SizeType count, SizeType target_entity_type_index);
+bool World_IsAlive (World const * world, EntityID id);
+bool World_GetEntityLocation (World const * world, EntityID id, SizeType * out_entity_type_index, SizeType * out_slot);
+template <typename T>
+T * World_GetComponentPtr (World const * world, SizeType entity_type_index, SizeType entity_index);  // nullptr if the entity type doesn't have T. Only valid up to the end of its page!
+
+bool JobPool_Create (JobPool ** out_pool, unsigned thread_count = 0);   // thread_count == 0 means one less than the number of hardware threads.
+void JobPool_Destroy (JobPool * pool);
+unsigned JobPool_ThreadCount (JobPool const * pool);
+unsigned JobPool_WorkerIndex (JobPool const * pool);    // Of the calling thread; 0 if it's not one of the pool's threads.
+void JobPool_Run (JobPool * pool, SizeType job_count, JobFunc func, void * user_data);   // Returns when all the jobs are done.
+template <typename F>
+void JobPool_ParallelFor (JobPool * pool, SizeType job_count, F && func);   // func(SizeType job_index, unsigned worker_index)
+
+bool Scheduler_Create (Scheduler * out_scheduler, World * world, JobPool * pool);
+bool Scheduler_Destroy (Scheduler * scheduler);
+bool Scheduler_AddSystem (Scheduler * scheduler, char const * name, ComponentBitSet const & reads, ComponentBitSet const & writes, EntityTypeBitSet const & entity_types, SystemFunc func, void * user_data);
+// Note: The system's entity types are whatever matches signature at build time, so entity types added later are accounted for.
+bool Scheduler_AddSystem (Scheduler * scheduler, char const * name, ComponentBitSet const & reads, ComponentBitSet const & writes, QuerySignature const & signature, SystemFunc func, void * user_data);
+bool Scheduler_Build (Scheduler * scheduler);
+bool Scheduler_Run (Scheduler * scheduler); // Builds the dependency graph if it's not built yet, or if entity types were added to the world since.
+bool System_ConflictsWith (System const * a, System const * b);
+
+bool CommandQueue_Create (CommandQueue * out_queue, JobPool const * pool);
+bool CommandQueue_Destroy (CommandQueue * queue);
+CommandBuffer * CommandQueue_GetBuffer (CommandQueue * queue, unsigned worker_index);  // e.g. the worker_index passed to your job, or JobPool_WorkerIndex()
+bool CommandBuffer_Spawn (CommandBuffer * buffer, SizeType entity_type_index, SizeType count, EntityID * out_ids = nullptr);
+bool CommandBuffer_Despawn (CommandBuffer * buffer, EntityID id);
+bool CommandBuffer_Move (CommandBuffer * buffer, EntityID id, SizeType target_entity_type_index);
+bool CommandBuffer_Clear (CommandBuffer * buffer);
+// Note: Single-threaded! Applies (and clears) all the commands in all the
+//      queue's buffers; all spawns first, then moves, then despawns, each kind
+//      batched by entity type. If an entity is moved more than once, it ends
+//      up in one of the targets, but which one is unspecified.
+bool World_Apply (World * world, CommandQueue * queue);
 
 //======================================================================
 
@@ -423,6 +585,20 @@ struct ComponentTypePack<> {
     template <unsigned I>
     static void Iterators_Init (IteratorTupleType * /*out_iterators*/, World const * /*world*/, SizeType /*entity_type_index*/) {
     }
+
+    template <unsigned I>
+    static SizeType Chunk_MinCountPerPage (World const * /*world*/, SizeType /*entity_type_index*/, SizeType current_min) {
+        return current_min;
+    }
+
+    template <unsigned I>
+    static SizeType Chunk_ContiguousCount (World const * /*world*/, SizeType /*entity_type_index*/, SizeType /*entity_index*/, SizeType max_count) {
+        return max_count;
+    }
+
+    template <unsigned I, typename PtrTupleType>
+    static void Chunk_GetPointers (PtrTupleType * /*out_ptrs*/, World const * /*world*/, SizeType /*entity_type_index*/, SizeType /*entity_index*/) {
+    }
 };
 
 template <typename T0, typename ... Ts>
@@ -440,42 +616,91 @@ struct ComponentTypePack<T0, Ts...> {
     static ComponentBitSet GetBitSet () {
         auto ret = TailType::GetBitSet();
         auto seqnum = HeadType::GetTypeInfo().seqnum;
-        auto constexpr word_bits = sizeof(decltype(ret)::Word) * 8;
-        ret.bits[seqnum / word_bits] |= (decltype(ret)::Word)(1) << (seqnum % word_bits);
+        auto constexpr word_bits = sizeof(typename decltype(ret)::Word) * 8;
+        ret.bits[seqnum / word_bits] |= (typename decltype(ret)::Word)(1) << (seqnum % word_bits);
         return ret;
     }
 
+    // Note: Optional components that the entity type doesn't have get an empty iterator.
     template <unsigned I>
     static void Iterators_Init (IteratorTupleType * out_iterators, World const * world, SizeType entity_type_index) {
-        static_assert(I < std::tuple_size_v<IteratorTupleType>, "");
-        assert(out_iterators);
-        assert(world);
-        assert(entity_type_index < world->entity_type_count);
-        assert(0 != BitSet_GetBit(world->entity_types[entity_type_index].components.bits, HeadType::GetTypeInfo().seqnum));
-
-        unsigned const comp_type_index = HeadType::GetTypeInfo().seqnum;
-        unsigned const ecd_index = entity_type_index * world->component_type_count + comp_type_index;
-
-        PagedIterator<HeadType> * mine = &(std::get<I>(*out_iterators));
-        World::PerEntityComponent * ecd = world->entity_component_data[ecd_index];
-
-        HeadType * ptr = nullptr;
-        SizeType cnt = 0;
-        if (ecd->pages_in_use > 1) {
-            ptr = ecd->page_ptrs[0];
-            cnt = world->component_types[comp_type_index].count_per_page;
-        } else if (ecd->pages_in_use == 1) {
-            ptr = ecd->page_ptrs[0];
-            cnt = ecd->elements_in_last_page;
+        if constexpr (I < Count) {
+            using T = std::tuple_element_t<I, ValueTupleType>;
+            assert(out_iterators);
+            assert(world);
+            assert(entity_type_index < world->entity_type_count);
+
+            unsigned const comp_type_index = T::GetTypeInfo().seqnum;
+            unsigned const ecd_index = entity_type_index * world->component_type_count + comp_type_index;
+
+            PagedIterator<T> * mine = &(std::get<I>(*out_iterators));
+            *mine = {};
+            if (BitSet_GetBit(world->entity_types[entity_type_index].components.bits, comp_type_index)) {
+                World::PerEntityComponent const * ecd = &world->entity_component_data[ecd_index];
+
+                T * ptr = nullptr;
+                SizeType cnt = 0;
+                if (ecd->pages_in_use > 1) {
+                    ptr = reinterpret_cast<T *>(ecd->page_ptrs[0]);
+                    cnt = world->component_types[comp_type_index].count_per_page;
+                } else if (ecd->pages_in_use == 1) {
+                    ptr = reinterpret_cast<T *>(ecd->page_ptrs[0]);
+                    cnt = ecd->elements_in_last_page;
+                }
+
+                mine->element_cur = ptr;
+                mine->element_end = ptr + cnt;
+                mine->page_cur = reinterpret_cast<T **>(ecd->page_ptrs);
+                mine->page_end = reinterpret_cast<T **>(ecd->page_ptrs) + ecd->pages_in_use;
+                mine->elements_in_last_page = ecd->elements_in_last_page;
+            }
+
+            Iterators_Init<I + 1>(out_iterators, world, entity_type_index);
         }
+    }
 
-        mine->element_cur = ptr;
-        mine->element_end = ptr + sizeof(HeadType) * cnt;
-        mine->page_cur = ecd->page_ptrs;
-        mine->page_end = ecd->page_ptrs + ecd->pages_in_use;
-        mine->elements_in_last_page = ecd->elements_in_last_page;
+    // Smallest per-page element count among the components of this pack that the entity type actually has.
+    template <unsigned I>
+    static SizeType Chunk_MinCountPerPage (World const * world, SizeType entity_type_index, SizeType current_min) {
+        if constexpr (I < Count) {
+            using T = std::tuple_element_t<I, ValueTupleType>;
+            unsigned const comp_type_index = T::GetTypeInfo().seqnum;
+            if (BitSet_GetBit(world->entity_types[entity_type_index].components.bits, comp_type_index)) {
+                SizeType const cpp = world->component_types[comp_type_index].count_per_page;
+                if (cpp < current_min)
+                    current_min = cpp;
+            }
+            return Chunk_MinCountPerPage<I + 1>(world, entity_type_index, current_min);
+        } else {
+            return current_min;
+        }
+    }
 
-        Iterators_Init<I + 1>(out_iterators, world, entity_type_index);
+    // How many entities, starting at entity_index and at most max_count, don't cross a page boundary in any of the components of this pack.
+    template <unsigned I>
+    static SizeType Chunk_ContiguousCount (World const * world, SizeType entity_type_index, SizeType entity_index, SizeType max_count) {
+        if constexpr (I < Count) {
+            using T = std::tuple_element_t<I, ValueTupleType>;
+            unsigned const comp_type_index = T::GetTypeInfo().seqnum;
+            if (BitSet_GetBit(world->entity_types[entity_type_index].components.bits, comp_type_index)) {
+                SizeType const cpp = world->component_types[comp_type_index].count_per_page;
+                SizeType const left_in_page = cpp - entity_index % cpp;
+                if (left_in_page < max_count)
+                    max_count = left_in_page;
+            }
+            return Chunk_ContiguousCount<I + 1>(world, entity_type_index, entity_index, max_count);
+        } else {
+            return max_count;
+        }
+    }
+
+    template <unsigned I, typename PtrTupleType>
+    static void Chunk_GetPointers (PtrTupleType * out_ptrs, World const * world, SizeType entity_type_index, SizeType entity_index) {
+        if constexpr (I < Count) {
+            using T = std::tuple_element_t<I, ValueTupleType>;
+            std::get<I>(*out_ptrs) = World_GetComponentPtr<T>(world, entity_type_index, entity_index);
+            Chunk_GetPointers<I + 1>(out_ptrs, world, entity_type_index, entity_index);
+        }
     }
 
     template <unsigned I>
@@ -513,8 +738,8 @@ struct TagTypePack<T0, Ts...> {
     static TagBitSet GetBitSet () {
         auto ret = TailType::GetBitSet();
         auto seqnum = HeadType::GetTypeInfo().seqnum;
-        auto constexpr word_bits = sizeof(decltype(ret)::Word) * 8;
-        ret.bits[seqnum / word_bits] |= (decltype(ret)::Word)(1) << (seqnum % word_bits);
+        auto constexpr word_bits = sizeof(typename decltype(ret)::Word) * 8;
+        ret.bits[seqnum / word_bits] |= (typename decltype(ret)::Word)(1) << (seqnum % word_bits);
         return ret;
     }
 
@@ -600,9 +825,40 @@ struct QueryResultIterator {
     static_assert(QueryParamsType::IsQueryParams);
 };
 
+// Note: A run of entities of one entity type that doesn't cross a page
+//      boundary in any of the query's components, so each of the pointers is
+//      a plain array of "count" elements. Optional components that the entity
+//      type doesn't have are nullptr.
+template <typename QueryParamsType>
+struct QueryChunk {
+    SizeType entity_type_index;
+    SizeType first_entity;      // Index of arrays' first element, among the entities of this entity type
+    SizeType count;
+    typename QueryParamsType::Pointers arrays;
+
+    static_assert(QueryParamsType::IsQueryParams);
+};
+
 template <typename QueryParamsType>
 bool Query_Create (Query<QueryParamsType> * out_query, World * world);
 
+template <typename QueryParamsType>
+bool Query_GetSignature (Query<QueryParamsType> const * query, QuerySignature * out_signature);
+
+// Calls func(QueryChunk<QueryParamsType> const & chunk, unsigned worker_index)
+// for every chunk of the query results, in parallel. Returns when all chunks
+// are processed. pool can be nullptr, then it all runs on this thread.
+// Note: Don't add or remove entities of the matched types from inside func.
+template <typename QueryParamsType, typename F>
+bool Query_ForEachParallel (Query<QueryParamsType> const * query, JobPool * pool, F && func);
+
+// Essential and optional full-access components are "writes", read-only ones are "reads."
+template <typename QueryParamsType>
+bool Query_GetAccessSets (Query<QueryParamsType> const * query, ComponentBitSet * out_reads, ComponentBitSet * out_writes);
+
+template <typename QueryParamsType>
+bool Scheduler_AddSystem (Scheduler * scheduler, char const * name, Query<QueryParamsType> const * query, SystemFunc func, void * user_data);
+
 //template <typename QueryParamsType>
 //bool World_DestroyQuery (Query<QueryParamsType> * query);
 
@@ -768,30 +1024,158 @@ bool Query_Create (Query<QueryParamsType> * out_query, World * world) {
 
     bool ret = false;
     if (out_query && world) {
-        auto cef = QueryParamsType::ComponentsEssentialFullaccess::GetBitSet();
-        auto cer = QueryParamsType::ComponentsEssentialReadonly::GetBitSet();
-        auto cx = QueryParamsType::ComponentsExcluded::GetBitSet();
-        auto cof = QueryParamsType::ComponentsOptionalFullaccess::GetBitSet();
-        auto cor = QueryParamsType::ComponentsOptionalReadonly::GetBitSet();
-        auto te = QueryParamsType::TagsEssential::GetBitSet();
-        auto tx = QueryParamsType::TagsExcluded::GetBitSet();
-        
         *out_query = {};
         out_query->world = world;
-        out_query->entity_type_count = 0;
-        for (unsigned entity_type_idx = 0; entity_type_idx < world->entity_type_count; ++entity_type_idx) {
-            auto const * et = &world->entity_types[entity_type_idx];
-
-            if (BitSet_ContainsAll(et->components.bits, cef.bits) &&
-                BitSet_ContainsAll(et->components.bits, cer.bits) &&
-                !BitSet_ContainsAny(et->components.bits, cx.bits) &&
-                BitSet_ContainsAll(et->tags.bits, te.bits) &&
-                !BitSet_ContainsAny(et->tags.bits, tx.bits)
-            ) {
-                BitSet_SetBit(out_query->entity_types_set.bits, entity_type_idx);
-                out_query->entity_type_count += 1;
-            }
+        QuerySignature sig;
+        ret =
+            Query_GetSignature(out_query, &sig) &&
+            World_MatchEntityTypes(world, sig, &out_query->entity_types_set, &out_query->entity_type_count);
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+template <typename QueryParamsType>
+bool Query_GetSignature (Query<QueryParamsType> const * query, QuerySignature * out_signature) {
+    static_assert(QueryParamsType::IsQueryParams, "");
+
+    bool ret = false;
+    if (query && out_signature) {
+        out_signature->essential = QueryParamsType::ComponentsEssentialFullaccess::GetBitSet();
+        BitSet_Union(out_signature->essential.bits, QueryParamsType::ComponentsEssentialReadonly::GetBitSet().bits);
+        out_signature->excluded = QueryParamsType::ComponentsExcluded::GetBitSet();
+        out_signature->tags_essential = QueryParamsType::TagsEssential::GetBitSet();
+        out_signature->tags_excluded = QueryParamsType::TagsExcluded::GetBitSet();
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+template <typename QueryParamsType>
+bool Query_GetAccessSets (Query<QueryParamsType> const * query, ComponentBitSet * out_reads, ComponentBitSet * out_writes) {
+    static_assert(QueryParamsType::IsQueryParams, "");
+
+    bool ret = false;
+    if (query && out_reads && out_writes) {
+        *out_writes = QueryParamsType::ComponentsEssentialFullaccess::GetBitSet();
+        BitSet_Union(out_writes->bits, QueryParamsType::ComponentsOptionalFullaccess::GetBitSet().bits);
+        *out_reads = QueryParamsType::ComponentsEssentialReadonly::GetBitSet();
+        BitSet_Union(out_reads->bits, QueryParamsType::ComponentsOptionalReadonly::GetBitSet().bits);
+        ret = true;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+template <typename QueryParamsType>
+bool Scheduler_AddSystem (Scheduler * scheduler, char const * name, Query<QueryParamsType> const * query, SystemFunc func, void * user_data) {
+    bool ret = false;
+    ComponentBitSet reads, writes;
+    QuerySignature sig;
+    if (Query_GetAccessSets(query, &reads, &writes) && Query_GetSignature(query, &sig))
+        ret = Scheduler_AddSystem(scheduler, name, reads, writes, sig, func, user_data);
+    return ret;
+}
+//----------------------------------------------------------------------
+template <typename F>
+void JobPool_ParallelFor (JobPool * pool, SizeType job_count, F && func) {
+    using FuncType = std::remove_reference_t<F>;
+    JobFunc thunk = [](void * user_data, SizeType job_index, unsigned worker_index) {
+        (*static_cast<FuncType *>(user_data))(job_index, worker_index);
+    };
+    JobPool_Run(pool, job_count, thunk, const_cast<std::remove_const_t<FuncType> *>(&func));
+}
+//----------------------------------------------------------------------
+template <typename T>
+T * World_GetComponentPtr (World const * world, SizeType entity_type_index, SizeType entity_index) {
+    static_assert(IsComponentV<T>, "");
+    assert(world);
+    assert(entity_type_index < world->entity_type_count);
+
+    T * ret = nullptr;
+    unsigned const comp_type_index = T::GetTypeInfo().seqnum;
+    if (BitSet_GetBit(world->entity_types[entity_type_index].components.bits, comp_type_index)) {
+        SizeType const cpp = world->component_types[comp_type_index].count_per_page;
+        World::PerEntityComponent const * ecd = &world->entity_component_data[entity_type_index * world->component_type_count + comp_type_index];
+        SizeType const page = entity_index / cpp;
+        if (page < ecd->pages_in_use)
+            ret = reinterpret_cast<T *>(ecd->page_ptrs[page]) + entity_index % cpp;
+    }
+    return ret;
+}
+//----------------------------------------------------------------------
+// Note: Each job is one page-worth of entities of the component with the
+//      smallest pages (i.e. most entities per job that still touch only one
+//      page of that component.) The other components may still have a page
+//      boundary inside a job, which then gets split into multiple chunks.
+template <typename QueryParamsType, typename F>
+bool Query_ForEachParallel (Query<QueryParamsType> const * query, JobPool * pool, F && func) {
+    using QPT = QueryParamsType;
+    static_assert(QPT::IsQueryParams, "");
+
+    bool ret = false;
+    if (query && query->world) {
+        World const * world = query->world;
+
+        // Note: ~12KB of stack; cheaper than allocating every time.
+        SizeType type_indices [MaxEntityTypes];
+        SizeType jobs_size [MaxEntityTypes];        // Entities per job, for each entity type
+        SizeType jobs_offset [MaxEntityTypes + 1];  // Index of the first job of each entity type
+        SizeType type_count = 0;
+        jobs_offset[0] = 0;
+        for (
+            unsigned et = BitSet_FindOne(query->entity_types_set.bits, 0);
+            et < world->entity_type_count;
+            et = BitSet_FindOne(query->entity_types_set.bits, et + 1)
+        ) {
+            SizeType const entity_count = world->entity_types[et].entity_count;
+            if (0 == entity_count)
+                continue;
+            SizeType per_job = entity_count;
+            per_job = QPT::CEF::template Chunk_MinCountPerPage<0>(world, et, per_job);
+            per_job = QPT::CER::template Chunk_MinCountPerPage<0>(world, et, per_job);
+            per_job = QPT::COF::template Chunk_MinCountPerPage<0>(world, et, per_job);
+            per_job = QPT::COR::template Chunk_MinCountPerPage<0>(world, et, per_job);
+
+            type_indices[type_count] = et;
+            jobs_size[type_count] = per_job;
+            jobs_offset[type_count + 1] = jobs_offset[type_count] + (entity_count + per_job - 1) / per_job;
+            type_count += 1;
         }
+
+        JobPool_ParallelFor(pool, jobs_offset[type_count], [&](SizeType job_index, unsigned worker_index) {
+            // Find the last entity type whose first job is <= job_index
+            SizeType lo = 0, hi = type_count;
+            while (hi - lo > 1) {
+                SizeType mid = (lo + hi) / 2;
+                if (jobs_offset[mid] <= job_index)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+
+            QueryChunk<QPT> chunk;
+            chunk.entity_type_index = type_indices[lo];
+            SizeType const entity_count = world->entity_types[chunk.entity_type_index].entity_count;
+            SizeType begin = (job_index - jobs_offset[lo]) * jobs_size[lo];
+            SizeType const end = (entity_count - begin < jobs_size[lo]) ? entity_count : begin + jobs_size[lo];
+
+            while (begin < end) {
+                SizeType count = end - begin;
+                count = QPT::CEF::template Chunk_ContiguousCount<0>(world, chunk.entity_type_index, begin, count);
+                count = QPT::CER::template Chunk_ContiguousCount<0>(world, chunk.entity_type_index, begin, count);
+                count = QPT::COF::template Chunk_ContiguousCount<0>(world, chunk.entity_type_index, begin, count);
+                count = QPT::COR::template Chunk_ContiguousCount<0>(world, chunk.entity_type_index, begin, count);
+
+                chunk.first_entity = begin;
+                chunk.count = count;
+                QPT::CEF::template Chunk_GetPointers<0>(&chunk.arrays.fullaccess, world, chunk.entity_type_index, begin);
+                QPT::CER::template Chunk_GetPointers<0>(&chunk.arrays.readonly, world, chunk.entity_type_index, begin);
+                QPT::COF::template Chunk_GetPointers<0>(&chunk.arrays.opt_fullaccess, world, chunk.entity_type_index, begin);
+                QPT::COR::template Chunk_GetPointers<0>(&chunk.arrays.opt_readonly, world, chunk.entity_type_index, begin);
+
+                func(static_cast<QueryChunk<QPT> const &>(chunk), worker_index);
+                begin += count;
+            }
+        });
         ret = true;
     }
     return ret;
@@ -821,11 +1205,11 @@ bool Query_GetFirstResult (QueryResultIterator<QueryParamsType> * out_result, Qu
         out_result->type_index = BitSet_FindOne(query->entity_types_set.bits, 0);
         out_result->entity_index = 0;
 
-        if (out_result->type_index < MaxComponentTypes) {
-            QPT::CEF::Iterators_Init<0>(&out_result->iterator.fullaccess, out_result->world, out_result->type_index);
-            QPT::CER::Iterators_Init<0>(&out_result->iterator.readonly, out_result->world, out_result->type_index);
-            QPT::COF::Iterators_Init<0>(&out_result->iterator.opt_fullaccess, out_result->world, out_result->type_index);
-            QPT::COR::Iterators_Init<0>(&out_result->iterator.opt_readonly, out_result->world, out_result->type_index);
+        if (out_result->type_index < out_result->world->entity_type_count) {
+            QPT::CEF::template Iterators_Init<0>(&out_result->iterator.fullaccess, out_result->world, out_result->type_index);
+            QPT::CER::template Iterators_Init<0>(&out_result->iterator.readonly, out_result->world, out_result->type_index);
+            QPT::COF::template Iterators_Init<0>(&out_result->iterator.opt_fullaccess, out_result->world, out_result->type_index);
+            QPT::COR::template Iterators_Init<0>(&out_result->iterator.opt_readonly, out_result->world, out_result->type_index);
             ret = true;
         }
     }
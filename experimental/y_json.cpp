@@ -1,9 +1,50 @@
 #include "y_json.h"
+#include "y_string_conversion.hpp"     // y::cvt::s2f()
 
 #include <cassert>
-
-#define Y_OPT_JSON_TRACK_LINE_AND_COLUMN        1
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>  // memchr(), memcpy()
+
+// Note: Errors always get a correct line and column (they are computed when
+//  the error is reported.) Define this to also keep them up-to-date for the
+//  element callbacks, at the cost of counting newlines as we go.
+//#define Y_OPT_JSON_TRACK_LINE_AND_COLUMN        1
 #define Y_OPT_JSON_CALC_SUBSTR_UNESCAPED_SIZE   1
+#define Y_OPT_JSON_WRITER_BUFFER_SIZE           4096    // The writer calls its sink with (at most) this much at a time
+#define Y_OPT_JSON_WRITER_MAX_DEPTH             256
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define Y_JSON_SIMD_AVX2    1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define Y_JSON_SIMD_SSE2    1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define Y_JSON_SIMD_NEON    1
+#endif
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+#include <charconv> // std::to_chars(), for the writer; std::from_chars()
+#include <cmath>
+
+#include <atomic>   // For the NDJSON driver
+#include <new>
+#include <thread>
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 #define Y_ASSERT(cond, ...)         assert(cond)
 #define Y_ASSERT_STRONG(cond, ...)  assert(cond)
@@ -21,7 +62,9 @@ struct State {
     json_buffer_t in;
     int cur;    // char, or -1 if EOI; Note: this must be initialized at the beginning.
 
-    json_location_t loc;
+    json_location_t loc;    // Note: line and column are only valid after a call to SyncLineAndColumn()
+    json_size_t line_scan_byte; // Newlines before this byte are already counted into loc.line...
+    json_size_t line_start_byte; // ...and this is where the last line started.
 
     json_user_handle_t parent;
     json_substr_t cur_name;
@@ -49,6 +92,12 @@ struct State {
 //    };
 //}
 
+// Note: this is too simplistic. There are UNICODE whitespace characters not considered here.
+static inline bool
+is_whitespace (int c) {
+    return ' ' == c || '\t' == c || '\n' == c || '\r' == c /*|| '\f' == c || '\v' == c || '\b' == c*/;
+}
+
 static inline bool
 eoi (State const * state) {
     return state->loc.byte >= state->in.size;
@@ -64,23 +113,217 @@ UpdateCurChar (State * state) {
 
 static inline void
 Advance (State * state) {
+    state->loc.byte += 1;
+    UpdateCurChar(state);    
+}
+
+static inline void
+JumpTo (State * state, json_size_t byte) {
+    state->loc.byte = byte;
+    UpdateCurChar(state);
+}
+
+// Counts the newlines in [from, to) and updates line/column; memchr() is plenty fast for this.
+static inline void
+CountLines (json_buffer_t const & in, json_size_t from, json_size_t to, int * inout_line, json_size_t * inout_line_start) {
+    char const * p = in.ptr + from;
+    char const * const end = in.ptr + to;
+    while (p < end) {
+        auto nl = static_cast<char const *>(::memchr(p, '\n', end - p));
+        if (!nl)
+            break;
+        *inout_line += 1;
+        *inout_line_start = json_size_t(nl - in.ptr) + 1;
+        p = nl + 1;
+    }
+}
+
+static inline void
+CalcLineAndColumn (json_buffer_t const & in, json_location_t * loc) {
+    json_size_t line_start = 0;
+    int line = 1;
+    CountLines(in, 0, (loc->byte < in.size ? loc->byte : in.size), &line, &line_start);
+    loc->line = line;
+    loc->column = int(loc->byte - line_start) + 1;
+}
+
+static inline void
+SyncLineAndColumn (State * state) {
 #if defined(Y_OPT_JSON_TRACK_LINE_AND_COLUMN)
-    if ('\n' == state->in.ptr[state->loc.byte]) {
-        state->loc.line += 1;
-        state->loc.column = 1;
-    } else
-        state->loc.column += 1;
+    json_size_t const to = (state->loc.byte < state->in.size ? state->loc.byte : state->in.size);
+    if (to > state->line_scan_byte) {
+        CountLines(state->in, state->line_scan_byte, to, &state->loc.line, &state->line_start_byte);
+        state->line_scan_byte = to;
+    }
+    state->loc.column = int(state->loc.byte - state->line_start_byte) + 1;
+#else
+    (void)state;
 #endif
-    state->loc.byte += 1;
+}
 
-    UpdateCurChar(state);    
+//----------------------------------------------------------------------
+// Scanning kernels; each has an AVX2 (32 bytes at a time,) an SSE2 or NEON
+//  (16 bytes,) and a scalar version for the tail.
+
+static inline unsigned
+CountTrailingZeros (unsigned x) {   // x must not be zero
+#if defined(_MSC_VER)
+    unsigned long ret;
+    _BitScanForward(&ret, x);
+    return unsigned(ret);
+#else
+    return unsigned(__builtin_ctz(x));
+#endif
 }
 
-// Note: this is too simplistic. There are UNICODE whitespace characters not considered here.
+static inline unsigned
+CountTrailingZeros64 (unsigned long long x) {   // x must not be zero
+#if defined(_MSC_VER)
+    unsigned long ret;
+    _BitScanForward64(&ret, x);
+    return unsigned(ret);
+#else
+    return unsigned(__builtin_ctzll(x));
+#endif
+}
+
+#if defined(Y_JSON_SIMD_NEON)
+static inline unsigned long long
+NeonMask (uint8x16_t cmp) {     // 4 bits per byte; the index is (CountTrailingZeros64(mask) / 4)
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+}
+#endif
+
 static inline bool
-is_whitespace (int c) {
-    return ' ' == c || '\t' == c || '\n' == c || '\r' == c /*|| '\f' == c || '\v' == c || '\b' == c*/;
+is_string_special (unsigned char c) {
+    return '"' == c || '\\' == c || c < 0x20;
+}
+
+// Returns the first '"', '\\' or control character (< 0x20) in [p, end), or end.
+static inline char const *
+scan_string_special (char const * p, char const * end) {
+#if defined(Y_JSON_SIMD_AVX2)
+    {
+        __m256i const quote = _mm256_set1_epi8('"');
+        __m256i const backslash = _mm256_set1_epi8('\\');
+        __m256i const max_ctrl = _mm256_set1_epi8(0x1F);
+        while (end - p >= 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+            __m256i m = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                _mm256_cmpeq_epi8(_mm256_min_epu8(v, max_ctrl), v)  // i.e. v <= 0x1F, unsigned
+            );
+            unsigned mask = unsigned(_mm256_movemask_epi8(m));
+            if (mask)
+                return p + CountTrailingZeros(mask);
+            p += 32;
+        }
+    }
+#endif
+#if defined(Y_JSON_SIMD_SSE2)
+    {
+        __m128i const quote = _mm_set1_epi8('"');
+        __m128i const backslash = _mm_set1_epi8('\\');
+        __m128i const max_ctrl = _mm_set1_epi8(0x1F);
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+            __m128i m = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                _mm_cmpeq_epi8(_mm_min_epu8(v, max_ctrl), v)
+            );
+            unsigned mask = unsigned(_mm_movemask_epi8(m));
+            if (mask)
+                return p + CountTrailingZeros(mask);
+            p += 16;
+        }
+    }
+#elif defined(Y_JSON_SIMD_NEON)
+    {
+        uint8x16_t const quote = vdupq_n_u8('"');
+        uint8x16_t const backslash = vdupq_n_u8('\\');
+        uint8x16_t const min_normal = vdupq_n_u8(0x20);
+        while (end - p >= 16) {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<uint8_t const *>(p));
+            uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vcltq_u8(v, min_normal));
+            unsigned long long mask = NeonMask(m);
+            if (mask)
+                return p + CountTrailingZeros64(mask) / 4;
+            p += 16;
+        }
+    }
+#endif
+    while (p < end && !is_string_special((unsigned char)*p))
+        ++p;
+    return p;
+}
+
+// Returns the first non-whitespace byte in [p, end), or end.
+// Note: Most whitespace runs between tokens are zero or one byte long, so
+//  we check two bytes before going wide.
+static inline char const *
+scan_non_whitespace (char const * p, char const * end) {
+    if (p < end && !is_whitespace(*p))
+        return p;
+    if (p + 1 < end && !is_whitespace(p[1]))
+        return p + 1;
+#if defined(Y_JSON_SIMD_AVX2)
+    {
+        __m256i const sp = _mm256_set1_epi8(' ');
+        __m256i const tab = _mm256_set1_epi8('\t');
+        __m256i const lf = _mm256_set1_epi8('\n');
+        __m256i const cr = _mm256_set1_epi8('\r');
+        while (end - p >= 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+            __m256i ws = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr))
+            );
+            unsigned mask = ~unsigned(_mm256_movemask_epi8(ws));
+            if (mask)
+                return p + CountTrailingZeros(mask);
+            p += 32;
+        }
+    }
+#endif
+#if defined(Y_JSON_SIMD_SSE2)
+    {
+        __m128i const sp = _mm_set1_epi8(' ');
+        __m128i const tab = _mm_set1_epi8('\t');
+        __m128i const lf = _mm_set1_epi8('\n');
+        __m128i const cr = _mm_set1_epi8('\r');
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+            __m128i ws = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))
+            );
+            unsigned mask = ~unsigned(_mm_movemask_epi8(ws)) & 0xFFFFu;
+            if (mask)
+                return p + CountTrailingZeros(mask);
+            p += 16;
+        }
+    }
+#elif defined(Y_JSON_SIMD_NEON)
+    {
+        uint8x16_t const sp = vdupq_n_u8(' ');
+        uint8x16_t const tab = vdupq_n_u8('\t');
+        uint8x16_t const lf = vdupq_n_u8('\n');
+        uint8x16_t const cr = vdupq_n_u8('\r');
+        while (end - p >= 16) {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<uint8_t const *>(p));
+            uint8x16_t ws = vorrq_u8(vorrq_u8(vceqq_u8(v, sp), vceqq_u8(v, tab)), vorrq_u8(vceqq_u8(v, lf), vceqq_u8(v, cr)));
+            unsigned long long mask = NeonMask(vmvnq_u8(ws));
+            if (mask)
+                return p + CountTrailingZeros64(mask) / 4;
+            p += 16;
+        }
+    }
+#endif
+    while (p < end && is_whitespace(*p))
+        ++p;
+    return p;
 }
+//----------------------------------------------------------------------
 
 static inline void
 consume (State * state) {
@@ -108,8 +351,10 @@ expect (State * state, char expected) {    // also consumes the character
 
 static inline void
 skip_ws (State * state) {
-    while (!eoi(state) && is_whitespace(state->cur))
-        Advance(state);
+    if (!eoi(state) && is_whitespace(state->cur)) {
+        char const * p = scan_non_whitespace(state->in.ptr + state->loc.byte, state->in.ptr + state->in.size);
+        JumpTo(state, json_size_t(p - state->in.ptr));
+    }
 }
 
 //static inline char
@@ -135,35 +380,147 @@ skip_ws (State * state) {
 //    skip_ws(state);
 //}
 
+// Note: Jumps from one '"', '\\' or control character to the next, so the
+//  plain runs in between (i.e. almost all of a typical string) are skipped
+//  16 or 32 bytes at a time.
 static inline json_substr_t
 read_str (State * state) {
     expect(state, '"');
     auto begin = state->loc.byte;
-    int unescaped = 0;
-    bool prev_was_backslash = false;
-    while (!eoi(state)) {
-        if (!prev_was_backslash) {
-            if ('"' == state->cur)
+    int escape_savings = 0;     // How many bytes shorter the string gets after unescaping
+    char const * const in_end = state->in.ptr + state->in.size;
+    char const * p = state->in.ptr + begin;
+    for (;;) {
+        p = scan_string_special(p, in_end);
+        if (p >= in_end) {
+            JumpTo(state, state->in.size);
+            throw Exception{JSON_SEV_Error, JSON_ERR_IncompleteInput, state->loc, "Input ended inside a string", 0, 0};
+        }
+        if ('"' == *p)
+            break;
+        if ('\\' == *p) {
+            if (p + 1 >= in_end) {
+                JumpTo(state, state->in.size);
+                throw Exception{JSON_SEV_Error, JSON_ERR_IncompleteInput, state->loc, "Input ended inside a string", 0, 0};
+            }
+            switch (p[1]) {
+            case 'u': escape_savings += 5; break;
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': escape_savings += 1; break;
+            default:
+                JumpTo(state, json_size_t(p + 1 - state->in.ptr));
+                throw Exception{JSON_SEV_Pedantic, JSON_ERR_BadEscaping, state->loc, "Unknown string escape sequence", state->cur, 0};
                 break;
-            if ('\\' == state->cur)
-                prev_was_backslash = true;
-        } else {    // previous character was actually a backslash
-            switch (state->cur) {
-            case 'u': unescaped -= 5; break;
-            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': unescaped -= 1; break;
-            default: throw Exception{JSON_SEV_Pedantic, JSON_ERR_BadEscaping, state->loc, "Unknown string escape sequence", state->cur, 0}; break;
             }
-            prev_was_backslash = false;
+            p += 2;
+        } else {
+            JumpTo(state, json_size_t(p - state->in.ptr));
+            throw Exception{JSON_SEV_Error, JSON_ERR_ControlCharInString, state->loc, "Control characters must be escaped inside strings", state->cur, 0};
         }
-        Advance(state);
-        unescaped += 1;
     }
-    auto end = state->loc.byte;
+    auto end = json_size_t(p - state->in.ptr);
+    JumpTo(state, end);
     expect(state, '"');
 
-    return {begin, end, json_size_t(unescaped)};
+#if defined(Y_OPT_JSON_CALC_SUBSTR_UNESCAPED_SIZE)
+    return {begin, end, json_size_t(end - begin - escape_savings)};
+#else
+    return {begin, end, json_size_t(end - begin)};
+#endif
+}
+
+//----------------------------------------------------------------------
+// Number conversion:
+//  - Integers are accumulated 8 digits at a time (SWAR) when there are 8
+//    digits available.
+//  - Reals are checked against the grammar here, then converted (correctly
+//    rounded, and regardless of the locale) by y::cvt::s2f().
+
+static inline bool
+is_digit (int c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool
+is_eight_digits (uint64_t val) {
+    return 0 == (((val + 0x4646464646464646ULL) | (val - 0x3030303030303030ULL)) & 0x8080808080808080ULL);
+}
+
+static inline uint64_t
+load_eight_bytes (char const * p) {     // As a little-endian word
+    uint64_t ret;
+    ::memcpy(&ret, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    ret = __builtin_bswap64(ret);
+#endif
+    return ret;
+}
+
+static inline uint32_t
+parse_eight_digits (uint64_t val) {
+    uint64_t const mask = 0x000000FF000000FFULL;
+    uint64_t const mul1 = 0x000F424000000064ULL;    // 100 + (1000000 << 32)
+    uint64_t const mul2 = 0x0000271000000001ULL;    // 1 + (10000 << 32)
+    val -= 0x3030303030303030ULL;
+    val = (val * 10) + (val >> 8);
+    val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+    return uint32_t(val);
+}
+
+static inline int
+decimal_length (uint32_t x) {
+    int ret = 0;
+    for (; x; x /= 10)
+        ret += 1;
+    return ret;
+}
+
+// Accumulates the digits at p into *inout_value while it has fewer than 19
+// significant digits (so it can't overflow,) and only counts the rest as
+// "dropped". Returns the end of the digits.
+static inline char const *
+accumulate_digits (char const * p, char const * end, uint64_t * inout_value, int * inout_significant, int * out_kept, int * out_dropped) {
+    uint64_t v = *inout_value;
+    int sig = *inout_significant;
+    int kept = 0, dropped = 0;
+    while (end - p >= 8 && sig <= 19 - 8) {
+        uint64_t const chunk = load_eight_bytes(p);
+        if (!is_eight_digits(chunk))
+            break;
+        uint32_t const eight = parse_eight_digits(chunk);
+        if (0 == v) {
+            v = eight;
+            sig = decimal_length(eight);
+        } else {
+            v = v * 100000000 + eight;
+            sig += 8;
+        }
+        kept += 8;
+        p += 8;
+    }
+    for (; p < end && is_digit(*p); ++p) {
+        if (sig < 19) {
+            v = v * 10 + unsigned(*p - '0');
+            if (0 != v)
+                sig += 1;
+            kept += 1;
+        } else {
+            dropped += 1;
+        }
+    }
+    *inout_value = v;
+    *inout_significant = sig;
+    *out_kept = kept;
+    *out_dropped = dropped;
+    return p;
 }
 
+//----------------------------------------------------------------------
+
+static inline void
+emit_value (State * state, json_value_t const & value) {
+    SyncLineAndColumn(state);
+    state->elem_cb(JSON_ETYPE_Value, nullptr, value, state->parent, &state->in, &state->loc, state->user_data);
+}
 
 static void
 parse_value (State * state);
@@ -174,6 +531,7 @@ parse_object (State * state) {
     expect(state, '{');
 
     auto old_parent = state->parent;
+    SyncLineAndColumn(state);
     auto self = state->elem_cb(JSON_ETYPE_ObjectBegin, nullptr, {}, state->parent, &state->in, &state->loc, state->user_data);
     state->parent = self;
     state->loc.depth += 1;
@@ -181,6 +539,11 @@ parse_object (State * state) {
     skip_ws(state);
     while ('}' != state->cur) {
         state->cur_name = read_str(state);
+        json_value_t name;
+        name.type = JSON_VTYPE_String;
+        name.data.s = state->cur_name;
+        SyncLineAndColumn(state);
+        state->elem_cb(JSON_ETYPE_Name, nullptr, name, self, &state->in, &state->loc, state->user_data);
         skip_ws(state);
         expect(state, ':');
         skip_ws(state);
@@ -197,6 +560,7 @@ parse_object (State * state) {
 
     state->loc.depth -= 1;
     state->parent = old_parent;
+    SyncLineAndColumn(state);
     state->elem_cb(JSON_ETYPE_ObjectEnd, self, {}, old_parent, &state->in, &state->loc, state->user_data);
 }
 
@@ -205,6 +569,7 @@ parse_array (State * state) {
     expect(state, '[');
 
     auto old_parent = state->parent;
+    SyncLineAndColumn(state);
     auto self = state->elem_cb(JSON_ETYPE_ArrayBegin, nullptr, {}, state->parent, &state->in, &state->loc, state->user_data);
     state->parent = self;
     state->loc.depth += 1;
@@ -223,23 +588,110 @@ parse_array (State * state) {
 
     state->loc.depth -= 1;
     state->parent = old_parent;
+    SyncLineAndColumn(state);
     state->elem_cb(JSON_ETYPE_ArrayEnd, self, {}, old_parent, &state->in, &state->loc, state->user_data);
 }
 
 static void
 parse_string (State * state) {
+    json_value_t value;
+    value.type = JSON_VTYPE_String;
+    value.data.s = read_str(state);
+    emit_value(state, value);
+}
+
+static inline void
+expect_literal (State * state, char const * literal, json_size_t len) {
+    if (state->in.size - state->loc.byte < len || 0 != ::memcmp(state->in.ptr + state->loc.byte, literal, len))
+        throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, state->loc, "Expected one of \"true\", \"false\" or \"null\"", state->cur, 0};
+    JumpTo(state, state->loc.byte + len);
 }
 
 static void
 parse_bool (State * state) {
+    json_value_t value;
+    value.type = JSON_VTYPE_Bool;
+    value.data.b = ('t' == state->cur);
+    if (value.data.b)
+        expect_literal(state, "true", 4);
+    else
+        expect_literal(state, "false", 5);
+    emit_value(state, value);
 }
 
 static void
 parse_null (State * state) {
+    json_value_t value;
+    value.type = JSON_VTYPE_Null;
+    value.data = {};
+    expect_literal(state, "null", 4);
+    emit_value(state, value);
 }
 
+// Note: A bit more lenient than the spec; accepts a leading '+', leading
+//  zeros, and a missing integer part (e.g. ".5".)
 static void
 parse_number (State * state) {
+    char const * const begin = state->in.ptr + state->loc.byte;
+    char const * const end = state->in.ptr + state->in.size;
+    char const * p = begin;
+
+    bool negative = false;
+    if ('-' == *p || '+' == *p) {
+        negative = ('-' == *p);
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int significant = 0, kept = 0, dropped = 0;
+    char const * const int_begin = p;
+    p = accumulate_digits(p, end, &mantissa, &significant, &kept, &dropped);
+    bool const has_int_part = (p != int_begin);
+    bool const truncated = (dropped > 0);
+
+    bool is_real = false;
+    if (p < end && '.' == *p) {
+        is_real = true;
+        ++p;
+        char const * const frac_begin = p;
+        p = accumulate_digits(p, end, &mantissa, &significant, &kept, &dropped);
+        if (p == frac_begin && !has_int_part) {
+            JumpTo(state, json_size_t(p - state->in.ptr));
+            throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, state->loc, "Expected digits in a number", state->cur, 0};
+        }
+    } else if (!has_int_part) {
+        JumpTo(state, json_size_t(p - state->in.ptr));
+        throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, state->loc, "Expected digits in a number", state->cur, 0};
+    }
+
+    if (p < end && ('e' == *p || 'E' == *p)) {
+        is_real = true;
+        ++p;
+        if (p < end && ('-' == *p || '+' == *p))
+            ++p;
+        if (p >= end || !is_digit(*p)) {
+            JumpTo(state, json_size_t(p - state->in.ptr));
+            throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, state->loc, "Expected digits in the exponent of a number", state->cur, 0};
+        }
+        while (p < end && is_digit(*p))
+            ++p;
+    }
+
+    json_value_t value;
+    if (!is_real && !truncated && mantissa <= (negative ? uint64_t(1) << 63 : uint64_t(INT64_MAX))) {
+        value.type = JSON_VTYPE_Int;
+        value.data.i = negative ? (long long)(0 - mantissa) : (long long)mantissa;
+    } else {
+        double d = 0;
+        auto const res = y::cvt::s2f(begin, unsigned(p - begin), d);   // Out of range is infinity, which is fine
+        if (res.size != unsigned(p - begin))
+            throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, state->loc, "Couldn't convert a number", state->cur, 0};
+        value.type = JSON_VTYPE_Real;
+        value.data.r = d;
+    }
+
+    JumpTo(state, json_size_t(p - state->in.ptr));
+    emit_value(state, value);
 }
 
 static void
@@ -370,6 +822,402 @@ ParseObject (
 }
 #endif
 
+//----------------------------------------------------------------------
+// The structural-index engine:
+//  Stage 1 classifies the input 64 bytes at a time into bitmasks (quotes,
+//  backslashes, whitespace and operators,) figures out which quotes are
+//  escaped and which bytes are inside strings (with carries across blocks,)
+//  and writes the offsets of all "structural" bytes into an index: the
+//  operators outside strings, the quotes, and the first byte of each
+//  literal/number. Strings with no escapes or control characters in them
+//  are marked clean, so stage 2 doesn't need to look inside them at all.
+//  Stage 2 walks the index with an explicit stack instead of recursion, and
+//  uses the same value parsers and emits the same elements (and errors) as
+//  the recursive-descent engine.
+// Note: With SSE2 on one core, stage 1 alone is a bit slower than the
+//  recursive-descent engine as a whole (which also scans with SIMD,) so this
+//  isn't the default. Wider vectors, or running stage 1 on another thread,
+//  might change that.
+
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t whitespace;
+    uint64_t op;    // { } [ ] : ,
+    uint64_t control;   // Below 0x20
+};
+
+static inline void
+classify_block (char const * p, BlockMasks * out) {
+#if defined(Y_JSON_SIMD_AVX2)
+    __m256i const quote = _mm256_set1_epi8('"');
+    __m256i const backslash = _mm256_set1_epi8('\\');
+    __m256i const sp = _mm256_set1_epi8(' ');
+    __m256i const tab = _mm256_set1_epi8('\t');
+    __m256i const lf = _mm256_set1_epi8('\n');
+    __m256i const cr = _mm256_set1_epi8('\r');
+    __m256i const lower = _mm256_set1_epi8(0x20);   // '[' | 0x20 == '{', and ']' | 0x20 == '}'
+    __m256i const open = _mm256_set1_epi8('{');
+    __m256i const close = _mm256_set1_epi8('}');
+    __m256i const colon = _mm256_set1_epi8(':');
+    __m256i const comma = _mm256_set1_epi8(',');
+    __m256i const last_control = _mm256_set1_epi8(0x1F);
+    uint64_t q = 0, b = 0, w = 0, o = 0, k = 0;
+    for (int half = 0; half < 2; ++half) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + 32 * half));
+        __m256i vl = _mm256_or_si256(v, lower);
+        uint64_t const shift = 32 * half;
+        q |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << shift;
+        b |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << shift;
+        w |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr))
+        )))) << shift;
+        o |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(vl, open), _mm256_cmpeq_epi8(vl, close)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma))
+        )))) << shift;
+        k |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, last_control), last_control)))) << shift;
+    }
+    *out = {q, b, w, o, k};
+#elif defined(Y_JSON_SIMD_SSE2)
+    __m128i const quote = _mm_set1_epi8('"');
+    __m128i const backslash = _mm_set1_epi8('\\');
+    __m128i const sp = _mm_set1_epi8(' ');
+    __m128i const tab = _mm_set1_epi8('\t');
+    __m128i const lf = _mm_set1_epi8('\n');
+    __m128i const cr = _mm_set1_epi8('\r');
+    __m128i const lower = _mm_set1_epi8(0x20);
+    __m128i const open = _mm_set1_epi8('{');
+    __m128i const close = _mm_set1_epi8('}');
+    __m128i const colon = _mm_set1_epi8(':');
+    __m128i const comma = _mm_set1_epi8(',');
+    __m128i const last_control = _mm_set1_epi8(0x1F);
+    uint64_t q = 0, b = 0, w = 0, o = 0, k = 0;
+    for (int quarter = 0; quarter < 4; ++quarter) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + 16 * quarter));
+        __m128i vl = _mm_or_si128(v, lower);
+        uint64_t const shift = 16 * quarter;
+        q |= uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+        b |= uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+        w |= uint64_t(unsigned(_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))
+        )))) << shift;
+        o |= uint64_t(unsigned(_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(vl, open), _mm_cmpeq_epi8(vl, close)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma))
+        )))) << shift;
+        k |= uint64_t(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, last_control), last_control)))) << shift;
+    }
+    *out = {q, b, w, o, k};
+#else
+    uint64_t q = 0, b = 0, w = 0, o = 0, k = 0;
+    for (int i = 0; i < 64; ++i) {
+        char const c = p[i];
+        uint64_t const bit = uint64_t(1) << i;
+        if (static_cast<unsigned char>(c) < 0x20) k |= bit;
+        if ('"' == c) q |= bit;
+        else if ('\\' == c) b |= bit;
+        else if (is_whitespace(c)) w |= bit;
+        else if ('{' == c || '}' == c || '[' == c || ']' == c || ':' == c || ',' == c) o |= bit;
+    }
+    *out = {q, b, w, o, k};
+#endif
+}
+
+// For each bit set in x, flips every bit from there to the top; i.e. bit i of the result is the XOR of bits 0..i of x.
+static inline uint64_t
+prefix_xor (uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// The bytes right after an odd-length run of backslashes, i.e. the escaped ones.
+static inline uint64_t
+find_escaped (uint64_t backslash, uint64_t * inout_prev_ends_odd_backslash) {
+    uint64_t const even_bits = 0x5555555555555555ULL;
+    uint64_t const odd_bits = ~even_bits;
+    uint64_t const start_edges = backslash & ~(backslash << 1);
+    uint64_t const even_start_mask = even_bits ^ *inout_prev_ends_odd_backslash;
+    uint64_t const even_starts = start_edges & even_start_mask;
+    uint64_t const odd_starts = start_edges & ~even_start_mask;
+    uint64_t const even_carries = backslash + even_starts;
+    uint64_t odd_carries = backslash + odd_starts;
+    bool const ends_odd_backslash = odd_carries < backslash;    // Overflowed
+    odd_carries |= *inout_prev_ends_odd_backslash;
+    *inout_prev_ends_odd_backslash = ends_odd_backslash ? 1 : 0;
+    uint64_t const even_carry_ends = even_carries & ~backslash;
+    uint64_t const odd_carry_ends = odd_carries & ~backslash;
+    return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+}
+
+// Stage 1 runs a small window ahead of stage 2, instead of indexing the whole input up front; this keeps the
+//  index in L1 and avoids allocating (and page-faulting) 4 bytes of index per byte of input.
+struct StructuralIndexer {
+    static constexpr int WindowBlocks = 64;     // How many 64-byte blocks to index per refill
+    static constexpr int Capacity = WindowBlocks * 64 + 64;
+
+    json_buffer_t in;
+    json_size_t next_block = 0;
+    uint64_t prev_ends_odd_backslash = 0;
+    uint64_t prev_in_string = 0;    // All ones or all zeros
+    uint64_t prev_separator = 1;    // The start of input counts as a separator
+    bool prev_string_dirty = false; // The string that continues into the next block has escapes or control chars so far
+    int begin = 0;
+    int end = 0;
+    json_size_t positions [Capacity];
+    bool dirty [Capacity];          // Only meaningful for closing quotes: whether the string needs the full read_str() treatment
+};
+
+static void
+index_block (StructuralIndexer * ix, char const * p, json_size_t base) {
+    BlockMasks m;
+    classify_block(p, &m);
+
+    uint64_t const escaped = find_escaped(m.backslash, &ix->prev_ends_odd_backslash);
+    uint64_t const quotes = m.quote & ~escaped;
+    uint64_t const in_string = prefix_xor(quotes) ^ ix->prev_in_string;    // Includes the opening quote, but not the closing one
+    ix->prev_in_string = uint64_t(int64_t(in_string) >> 63);
+
+    uint64_t const separator = m.whitespace | m.op | quotes;
+    uint64_t const scalar = ~(separator | in_string);
+    uint64_t const scalar_start = scalar & ((separator << 1) | ix->prev_separator);
+    ix->prev_separator = separator >> 63;
+
+    // Closing quotes are indexed too, so clean strings can be taken straight from the index.
+    uint64_t const closing_quotes = quotes & ~in_string;
+    uint64_t structural = (m.op & ~in_string) | quotes | scalar_start;
+    uint64_t const dirty = (m.backslash | m.control) & in_string;
+    json_size_t * out = ix->positions + ix->end;
+    bool * out_dirty = ix->dirty + ix->end;
+    if (0 == dirty && !ix->prev_string_dirty) {
+        while (structural) {
+            *out++ = base + json_size_t(CountTrailingZeros64(structural));
+            *out_dirty++ = false;
+            structural &= structural - 1;
+        }
+    } else {
+        // Between an opening quote (or the block start) and its closing quote there are no other structurals, so
+        //  the dirty bits below a closing quote and above the previous structural are all in that one string.
+        bool string_dirty = ix->prev_string_dirty;
+        uint64_t above_prev = ~uint64_t(0);
+        while (structural) {
+            unsigned const k = CountTrailingZeros64(structural);
+            uint64_t const bit = uint64_t(1) << k;
+            bool d = false;
+            if (closing_quotes & bit) {
+                d = string_dirty || 0 != (dirty & above_prev & (bit - 1));
+                string_dirty = false;
+            }
+            *out++ = base + json_size_t(k);
+            *out_dirty++ = d;
+            above_prev = ~((bit << 1) - 1);     // Zero when k == 63, which is fine; nothing is above it
+            structural &= structural - 1;
+        }
+        ix->prev_string_dirty = ix->prev_in_string && (string_dirty || 0 != (dirty & above_prev));
+    }
+    ix->end = int(out - ix->positions);
+}
+
+// Returns false if there is nothing more to index.
+static bool
+StructuralIndexer_Refill (StructuralIndexer * ix) {
+    if (ix->next_block >= ix->in.size)
+        return false;
+    int const remaining = ix->end - ix->begin;
+    if (ix->begin > 0 && remaining > 0) {
+        ::memmove(ix->positions, ix->positions + ix->begin, remaining * sizeof(json_size_t));
+        ::memmove(ix->dirty, ix->dirty + ix->begin, remaining * sizeof(bool));
+    }
+    ix->begin = 0;
+    ix->end = remaining;
+    for (int b = 0; b < StructuralIndexer::WindowBlocks && ix->next_block < ix->in.size && ix->end + 64 <= StructuralIndexer::Capacity; ++b) {
+        json_size_t const base = ix->next_block;
+        if (ix->in.size - base >= 64) {
+            index_block(ix, ix->in.ptr + base, base);
+        } else {                    // Pad the last block with whitespace
+            char tail [64];
+            ::memset(tail, ' ', sizeof(tail));
+            ::memcpy(tail, ix->in.ptr + base, ix->in.size - base);
+            index_block(ix, tail, base);
+        }
+        ix->next_block += 64;
+    }
+    return true;
+}
+
+// The position of the k-th structural from the current one, or the input size if there are no more.
+static inline json_size_t
+StructuralIndexer_Peek (StructuralIndexer * ix, int k) {
+    while (ix->end - ix->begin <= k)
+        if (!StructuralIndexer_Refill(ix))
+            return ix->in.size;
+    return ix->positions[ix->begin + k];
+}
+
+// Call only after peeking at k.
+static inline bool
+StructuralIndexer_IsDirty (StructuralIndexer const * ix, int k) {
+    return ix->dirty[ix->begin + k];
+}
+
+static inline void
+StructuralIndexer_Next (StructuralIndexer * ix) {
+    if (ix->begin < ix->end)
+        ix->begin += 1;
+}
+
+struct ContainerFrame {
+    json_user_handle_t self;
+    json_user_handle_t parent;
+    bool is_object;
+};
+
+static void
+parse_with_structural_index (State * state) {
+    StructuralIndexer ix;
+    ix.in = state->in;
+
+    int stack_capacity = 64;
+    int stack_size = 0;
+    auto stack = static_cast<ContainerFrame *>(::malloc(stack_capacity * sizeof(ContainerFrame)));
+    struct StackFree {ContainerFrame ** p; ~StackFree () {::free(*p);}} stack_free {&stack};
+    if (!stack)
+        throw Exception{JSON_SEV_Fatal, JSON_ERR_BadParams, state->loc, "Out of memory (for the container stack)", 0, 0};
+
+    auto push = [&](json_user_handle_t self, bool is_object) {
+        if (stack_size == stack_capacity) {
+            auto bigger = static_cast<ContainerFrame *>(::realloc(stack, 2 * stack_capacity * sizeof(ContainerFrame)));
+            if (!bigger)
+                throw Exception{JSON_SEV_Fatal, JSON_ERR_BadParams, state->loc, "Out of memory (for the container stack)", 0, 0};
+            stack = bigger;
+            stack_capacity *= 2;
+        }
+        stack[stack_size++] = {self, state->parent, is_object};
+        state->parent = self;
+        state->loc.depth += 1;
+    };
+    auto pop = [&](json_size_t p) {
+        ContainerFrame const f = stack[--stack_size];
+        state->loc.depth -= 1;
+        state->parent = f.parent;
+        JumpTo(state, p + 1);
+        SyncLineAndColumn(state);
+        state->elem_cb(f.is_object ? JSON_ETYPE_ObjectEnd : JSON_ETYPE_ArrayEnd, f.self, {}, f.parent, &state->in, &state->loc, state->user_data);
+    };
+    // Reads the string whose opening quote is the current structural, and leaves the state right after it.
+    auto take_string = [&](json_size_t open) -> json_substr_t {
+        json_size_t const close = StructuralIndexer_Peek(&ix, 1);
+        if (close < state->in.size && !StructuralIndexer_IsDirty(&ix, 1)) {
+            StructuralIndexer_Next(&ix);
+            StructuralIndexer_Next(&ix);
+            JumpTo(state, close + 1);
+            return {open + 1, close, close - open - 1};
+        }
+        JumpTo(state, open);
+        json_substr_t ret = read_str(state);    // Validates, and reports the errors
+        StructuralIndexer_Next(&ix);
+        StructuralIndexer_Next(&ix);
+        return ret;
+    };
+
+    enum class Expect {Value, ValueOrEnd, KeyOrEnd, CommaOrEnd};
+    Expect expect = Expect::Value;
+    for (;;) {
+        // Running off the end of the index is handled like any other unexpected character, so the errors are
+        //  the same as the other engine's.
+        json_size_t const p = StructuralIndexer_Peek(&ix, 0);
+        int const c = (p < state->in.size) ? state->in.ptr[p] : -1;
+
+        switch (expect) {
+        case Expect::ValueOrEnd:
+            if (']' == c) {
+                pop(p);
+                StructuralIndexer_Next(&ix);
+                expect = Expect::CommaOrEnd;
+                break;
+            }
+            // fallthrough
+        case Expect::Value:
+            if ('{' == c || '[' == c) {
+                JumpTo(state, p + 1);
+                SyncLineAndColumn(state);
+                auto self = state->elem_cb('{' == c ? JSON_ETYPE_ObjectBegin : JSON_ETYPE_ArrayBegin, nullptr, {}, state->parent, &state->in, &state->loc, state->user_data);
+                push(self, '{' == c);
+                StructuralIndexer_Next(&ix);
+                expect = ('{' == c) ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+            } else if ('"' == c) {
+                json_value_t value;
+                value.type = JSON_VTYPE_String;
+                value.data.s = take_string(p);
+                emit_value(state, value);
+                expect = Expect::CommaOrEnd;
+            } else {
+                JumpTo(state, p);
+                parse_value(state);     // Only numbers and literals get here (or garbage)
+                StructuralIndexer_Next(&ix);
+                // Whatever follows the value up to the next structural is whitespace, unless the value stopped short.
+                if (stack_size > 0 && state->loc.byte != StructuralIndexer_Peek(&ix, 0) && !is_whitespace(state->cur))
+                    throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedToken, state->loc, stack[stack_size - 1].is_object ? "Expected ',' or '}' in object" : "Expected ',' or ']' in array", 0, 0};
+                expect = Expect::CommaOrEnd;
+            }
+            break;
+        case Expect::KeyOrEnd: {
+            if ('}' == c) {
+                pop(p);
+                StructuralIndexer_Next(&ix);
+                expect = Expect::CommaOrEnd;
+                break;
+            }
+            if ('"' == c) {
+                state->cur_name = take_string(p);
+            } else {
+                JumpTo(state, p);
+                state->cur_name = read_str(state);  // Throws
+            }
+            json_value_t name;
+            name.type = JSON_VTYPE_String;
+            name.data.s = state->cur_name;
+            SyncLineAndColumn(state);
+            state->elem_cb(JSON_ETYPE_Name, nullptr, name, state->parent, &state->in, &state->loc, state->user_data);
+            JumpTo(state, StructuralIndexer_Peek(&ix, 0));
+            if (':' != state->cur)
+                throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedToken, state->loc, "Expected A, but found X", ':', state->cur};
+            StructuralIndexer_Next(&ix);
+            expect = Expect::Value;
+        } break;
+        case Expect::CommaOrEnd: {
+            bool const is_object = stack[stack_size - 1].is_object;
+            if (',' == c) {
+                StructuralIndexer_Next(&ix);
+                // Like the other engine, a trailing comma is tolerated in objects, but in arrays only right before the ']'
+                if (is_object)
+                    expect = Expect::KeyOrEnd;
+                else
+                    expect = (StructuralIndexer_Peek(&ix, 0) == p + 1) ? Expect::ValueOrEnd : Expect::Value;
+            } else if ((is_object && '}' == c) || (!is_object && ']' == c)) {
+                pop(p);
+                StructuralIndexer_Next(&ix);
+            } else {
+                JumpTo(state, p);
+                throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedToken, state->loc, is_object ? "Expected ',' or '}' in object" : "Expected ',' or ']' in array", 0, 0};
+            }
+        } break;
+        }
+
+        if (Expect::CommaOrEnd == expect && 0 == stack_size)
+            break;  // The top-level value is done; like the other engine, we ignore what comes after it.
+    }
+}
+
+//----------------------------------------------------------------------
+
 json_size_t
 JSON_Parse (
     json_buffer_t in,
@@ -377,7 +1225,18 @@ JSON_Parse (
     json_error_f error_cb,
     void * user_data
 ) {
-    json_location_t loc {0, 0, 1, 0};
+    return JSON_ParseEx(in, nullptr, elem_cb, error_cb, user_data);
+}
+
+json_size_t
+JSON_ParseEx (
+    json_buffer_t in,
+    json_options_t const * options,
+    json_element_f elem_cb,
+    json_error_f error_cb,
+    void * user_data
+) {
+    json_location_t loc {0, 0, 1, 1};
     if (!error_cb) {
         return 0;
     }
@@ -390,10 +1249,14 @@ JSON_Parse (
         return 0;
     }
 
+    json_engine_e const engine = options ? options->engine : JSON_ENGINE_Default;
+
     State state;
     state.in = in;
-    state.cur = in.ptr[0];
+    state.cur = (in.size > 0 ? in.ptr[0] : -1);
     state.loc = loc;
+    state.line_scan_byte = 0;
+    state.line_start_byte = 0;
     state.parent = nullptr;
     state.cur_name = {};
     state.elem_cb = elem_cb;
@@ -401,15 +1264,2480 @@ JSON_Parse (
     state.user_data = user_data;
 
     try {
+        if (JSON_ENGINE_StructuralIndex == engine) {
+            parse_with_structural_index(&state);
+        } else {
+            skip_ws(&state);
+            parse_value(&state);
+        }
         skip_ws(&state);
-        parse_object(&state);
     } catch (Exception & e) {
+        CalcLineAndColumn(state.in, &e.location);
         state.error_cb(e.severity, e.error, &state.in, &e.location, state.user_data, e.msg, e.param1, e.param2);
     }
 
     return state.loc.byte;
 }
 
+//======================================================================
+// The push parser: the same grammar as parse_value() and friends, but as
+//  an explicit state machine that can stop at the end of any chunk and pick
+//  up where it left off when the next chunk arrives. Complete tokens are
+//  parsed in place, inside the caller's chunk; only a token that straddles
+//  two chunks is copied (into "pending",) so the memory used is bounded by
+//  the longest token, not by the document.
+//  The element callbacks get the chunk (or the pending buffer) as their
+//  json_buffer_t, so the substrings are only valid during the callback, and
+//  the locations are offsets in the whole stream.
+
+// Locations are json_size_t offsets into the whole stream, so it can't be longer than this.
+static constexpr unsigned long long MaxPushStreamSize = json_size_t(~json_size_t(0));
+
+enum class PushExpect : uint8_t {
+    Value,
+    ValueOrEnd,         // Right after '['
+    ArrayAfterComma,    // Like the other parser, a ']' right after a ',' (no whitespace) is tolerated
+    KeyOrEnd,           // Right after '{' or ','
+    Colon,
+    CommaOrEnd,
+};
+
+struct json_push_parser_t {
+    json_element_f elem_cb;
+    json_error_f error_cb;
+    void * user_data;
+
+    PushExpect expect;
+    json_user_handle_t parent;
+    int depth;
+    int stack_size;
+    int stack_capacity;
+    ContainerFrame * stack;
+    unsigned long long value_count;     // Completed top-level values
+    unsigned long long fed_size;        // Total bytes fed so far; at most MaxPushStreamSize
+    bool failed;
+
+    char * pending;                     // Start of the token that straddles chunks, if any
+    json_size_t pending_size;
+    json_size_t pending_capacity;
+    bool pending_escape;                // The pending bytes (of a string) end with an unpaired backslash
+
+    unsigned long long window_base;     // Stream offset of byte 0 of the buffer being parsed
+    json_buffer_t window;
+    json_size_t line_scan_byte;         // In the window
+    unsigned long long line_start;      // Stream offset
+    int line;
+};
+
+// Updates the line count up to (window-relative) byte; the window's bytes must be visited in order.
+static void
+PushParser_CountLines (json_push_parser_t * parser, json_size_t byte) {
+    if (byte > parser->window.size)
+        byte = parser->window.size;
+    if (byte > parser->line_scan_byte) {
+        json_size_t line_start = 0;     // Never a valid result, since it's just past a '\n'
+        CountLines(parser->window, parser->line_scan_byte, byte, &parser->line, &line_start);
+        if (line_start > 0)
+            parser->line_start = parser->window_base + line_start;
+        parser->line_scan_byte = byte;
+    }
+}
+
+static json_location_t
+PushParser_StreamLocation (json_push_parser_t * parser, json_location_t loc) {
+    unsigned long long const byte = parser->window_base + loc.byte;
+    PushParser_CountLines(parser, loc.byte);
+    loc.byte = json_size_t(byte);       // Can't overflow; see MaxPushStreamSize.
+    loc.line = parser->line;
+    loc.column = int(byte - parser->line_start) + 1;
+    return loc;
+}
+
+static json_user_handle_t
+PushParser_ElementTrampoline (
+    json_elem_type_e elem_type,
+    json_user_handle_t self,
+    json_value_t value,
+    json_user_handle_t parent,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data
+) {
+    auto parser = static_cast<json_push_parser_t *>(user_data);
+#if defined(Y_OPT_JSON_TRACK_LINE_AND_COLUMN)
+    json_location_t const loc = PushParser_StreamLocation(parser, *location);
+#else
+    json_location_t loc = *location;
+    loc.byte = json_size_t(parser->window_base + loc.byte);
+#endif
+    return parser->elem_cb(elem_type, self, value, parent, input, &loc, parser->user_data);
+}
+
+// Moves the window past its first "consumed" bytes.
+static void
+PushParser_Retire (json_push_parser_t * parser, json_size_t consumed) {
+    PushParser_CountLines(parser, consumed);
+    parser->window_base += consumed;
+    parser->window.ptr += consumed;
+    parser->window.size -= consumed;
+    parser->line_scan_byte = 0;
+}
+
+static void
+PushParser_Push (json_push_parser_t * parser, State * state, json_user_handle_t self, bool is_object) {
+    if (parser->stack_size == parser->stack_capacity) {
+        int const new_capacity = (parser->stack_capacity > 0) ? 2 * parser->stack_capacity : 32;
+        auto bigger = static_cast<ContainerFrame *>(::realloc(parser->stack, new_capacity * sizeof(ContainerFrame)));
+        if (!bigger)
+            throw Exception{JSON_SEV_Fatal, JSON_ERR_BadParams, state->loc, "Out of memory (for the container stack)", 0, 0};
+        parser->stack = bigger;
+        parser->stack_capacity = new_capacity;
+    }
+    parser->stack[parser->stack_size++] = {self, state->parent, is_object};
+    state->parent = self;
+    state->loc.depth += 1;
+}
+
+static void
+PushParser_Pop (json_push_parser_t * parser, State * state) {
+    ContainerFrame const f = parser->stack[--parser->stack_size];
+    Advance(state);
+    state->loc.depth -= 1;
+    state->parent = f.parent;
+    SyncLineAndColumn(state);
+    state->elem_cb(f.is_object ? JSON_ETYPE_ObjectEnd : JSON_ETYPE_ArrayEnd, f.self, {}, f.parent, &state->in, &state->loc, state->user_data);
+}
+
+static inline bool
+is_scalar_delimiter (int c) {
+    return is_whitespace(c) || '{' == c || '}' == c || '[' == c || ']' == c || ',' == c || ':' == c || '"' == c;
+}
+
+// Parses the window until it runs out, and returns how much of it was consumed; what's left is the start of a
+//  token that continues in the next chunk. If at_end, the stream ends with this window, and anything unfinished
+//  is an error.
+static json_size_t
+PushParser_Run (json_push_parser_t * parser, bool at_end) {
+    State state;
+    state.in = parser->window;
+    state.loc = {0, parser->depth, 1, 1};
+    state.line_scan_byte = 0;
+    state.line_start_byte = 0;
+    state.parent = parser->parent;
+    state.cur_name = {};
+    state.elem_cb = PushParser_ElementTrampoline;
+    state.error_cb = parser->error_cb;
+    state.user_data = parser;
+    UpdateCurChar(&state);
+
+    // Reads a string (a value, or a name) unless it continues past the window.
+    auto string_is_complete = [&](json_substr_t * out_str) -> bool {
+        try {
+            *out_str = read_str(&state);
+        } catch (Exception & e) {
+            if (JSON_ERR_IncompleteInput == e.error && !at_end)
+                return false;
+            throw;
+        }
+        return true;
+    };
+    auto value_done = [&]() {
+        if (parser->stack_size > 0) {
+            parser->expect = PushExpect::CommaOrEnd;
+        } else {
+            parser->expect = PushExpect::Value;
+            parser->value_count += 1;
+        }
+    };
+    auto save = [&]() {
+        parser->parent = state.parent;
+        parser->depth = state.loc.depth;
+    };
+
+    for (;;) {
+        if (PushExpect::ArrayAfterComma == parser->expect) {
+            if (eoi(&state) && !at_end) {
+                save();
+                return state.loc.byte;
+            }
+            parser->expect = (']' == state.cur) ? PushExpect::ValueOrEnd : PushExpect::Value;
+        }
+        skip_ws(&state);
+        json_size_t const p = state.loc.byte;
+        if (eoi(&state) && (!at_end || (PushExpect::Value == parser->expect && 0 == parser->stack_size))) {
+            save();
+            return p;
+        }
+        int const c = state.cur;
+
+        switch (parser->expect) {
+        case PushExpect::ArrayAfterComma:   // Already resolved above
+        case PushExpect::ValueOrEnd:
+            if (']' == c) {
+                PushParser_Pop(parser, &state);
+                value_done();
+                break;
+            }
+            // fallthrough
+        case PushExpect::Value:
+            if ('{' == c || '[' == c) {
+                Advance(&state);
+                SyncLineAndColumn(&state);
+                auto self = state.elem_cb('{' == c ? JSON_ETYPE_ObjectBegin : JSON_ETYPE_ArrayBegin, nullptr, {}, state.parent, &state.in, &state.loc, state.user_data);
+                PushParser_Push(parser, &state, self, '{' == c);
+                parser->expect = ('{' == c) ? PushExpect::KeyOrEnd : PushExpect::ValueOrEnd;
+            } else if ('"' == c) {
+                json_value_t value;
+                value.type = JSON_VTYPE_String;
+                if (!string_is_complete(&value.data.s)) {
+                    save();
+                    return p;
+                }
+                emit_value(&state, value);
+                value_done();
+            } else {
+                if (!at_end) {    // A number or literal is only complete once we see what's after it
+                    json_size_t q = p;
+                    while (q < state.in.size && !is_scalar_delimiter(state.in.ptr[q]))
+                        ++q;
+                    if (q >= state.in.size) {
+                        save();
+                        return p;
+                    }
+                }
+                parse_value(&state);
+                value_done();
+            }
+            break;
+        case PushExpect::KeyOrEnd:
+            if ('}' == c) {
+                PushParser_Pop(parser, &state);
+                value_done();
+            } else {
+                json_substr_t name_str;
+                if (!string_is_complete(&name_str)) {
+                    save();
+                    return p;
+                }
+                state.cur_name = name_str;
+                json_value_t name;
+                name.type = JSON_VTYPE_String;
+                name.data.s = name_str;
+                SyncLineAndColumn(&state);
+                state.elem_cb(JSON_ETYPE_Name, nullptr, name, state.parent, &state.in, &state.loc, state.user_data);
+                parser->expect = PushExpect::Colon;
+            }
+            break;
+        case PushExpect::Colon:
+            expect(&state, ':');
+            parser->expect = PushExpect::Value;
+            break;
+        case PushExpect::CommaOrEnd: {
+            bool const is_object = parser->stack[parser->stack_size - 1].is_object;
+            if (',' == c) {
+                Advance(&state);
+                parser->expect = is_object ? PushExpect::KeyOrEnd : PushExpect::ArrayAfterComma;
+            } else if ((is_object && '}' == c) || (!is_object && ']' == c)) {
+                PushParser_Pop(parser, &state);
+                value_done();
+            } else {
+                throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedToken, state.loc, is_object ? "Expected ',' or '}' in object" : "Expected ',' or ']' in array", 0, 0};
+            }
+        } break;
+        }
+    }
+}
+
+// Looks for the end of a string that began before p; the escape flag carries an unpaired backslash across calls.
+//  Returns the end (just past the closing quote, or past a control char which read_str() will complain about,) or
+//  nullptr if the string goes on past the end.
+static char const *
+find_string_end (char const * p, char const * end, bool * inout_escape) {
+    if (*inout_escape) {
+        if (p >= end)
+            return nullptr;
+        p += 1;
+        *inout_escape = false;
+    }
+    for (;;) {
+        p = scan_string_special(p, end);
+        if (p >= end)
+            return nullptr;
+        if ('\\' != *p)
+            return p + 1;
+        if (p + 1 >= end) {
+            *inout_escape = true;
+            return nullptr;
+        }
+        p += 2;
+    }
+}
+
+// Finds where the pending token ends in the chunk (exclusive,) or returns false if it doesn't. For numbers and
+//  literals, the byte after the token is included too, so they are parsed exactly like they would be in one piece.
+static bool
+PushParser_FindTokenEnd (json_push_parser_t * parser, json_buffer_t chunk, json_size_t * out_end) {
+    bool ret = false;
+    if ('"' == parser->pending[0]) {
+        char const * p = find_string_end(chunk.ptr, chunk.ptr + chunk.size, &parser->pending_escape);
+        if (p) {
+            *out_end = json_size_t(p - chunk.ptr);
+            ret = true;
+        }
+    } else {
+        for (json_size_t i = 0; i < chunk.size && !ret; ++i)
+            if (is_scalar_delimiter(chunk.ptr[i])) {
+                *out_end = i + 1;
+                ret = true;
+            }
+    }
+    return ret;
+}
+
+static void
+PushParser_AppendPending (json_push_parser_t * parser, char const * data, json_size_t size) {
+    if (0 == size)
+        return;
+    if (parser->pending_size + size > parser->pending_capacity) {
+        json_size_t new_capacity = (parser->pending_capacity > 0) ? parser->pending_capacity : 256;
+        while (new_capacity < parser->pending_size + size)
+            new_capacity *= 2;
+        auto bigger = static_cast<char *>(::realloc(parser->pending, new_capacity));
+        if (!bigger)
+            throw Exception{JSON_SEV_Fatal, JSON_ERR_BadParams, {}, "Out of memory (for a token that straddles chunks)", 0, 0};
+        parser->pending = bigger;
+        parser->pending_capacity = new_capacity;
+    }
+    ::memcpy(parser->pending + parser->pending_size, data, size);
+    parser->pending_size += size;
+}
+
+// Finishes the pending token, which now must be complete. Returns how many bytes at the end of the pending
+//  buffer were not consumed (at most the one byte after a number or literal; e.g. an opening quote.)
+static json_size_t
+PushParser_RunPending (json_push_parser_t * parser, bool at_end) {
+    parser->window = {parser->pending, parser->pending_size};
+    parser->line_scan_byte = 0;
+    json_size_t const consumed = PushParser_Run(parser, at_end);
+    PushParser_Retire(parser, consumed);
+    parser->pending_size = 0;
+    parser->pending_escape = false;
+    return parser->window.size;
+}
+
+static void
+PushParser_ReportError (json_push_parser_t * parser, Exception const & e) {
+    json_location_t const loc = PushParser_StreamLocation(parser, e.location);
+    parser->failed = true;
+    parser->error_cb(e.severity, e.error, &parser->window, &loc, parser->user_data, e.msg, e.param1, e.param2);
+}
+
+json_push_parser_t *
+JSON_PushCreate (
+    json_element_f elem_cb,
+    json_error_f error_cb,
+    void * user_data
+) {
+    json_push_parser_t * ret = nullptr;
+    if (elem_cb && error_cb) {
+        ret = static_cast<json_push_parser_t *>(::calloc(1, sizeof(json_push_parser_t)));
+        if (ret) {
+            ret->elem_cb = elem_cb;
+            ret->error_cb = error_cb;
+            ret->user_data = user_data;
+            ret->expect = PushExpect::Value;
+            ret->line = 1;
+        }
+    }
+    return ret;
+}
+
+void
+JSON_PushDestroy (json_push_parser_t * parser) {
+    if (parser) {
+        ::free(parser->stack);
+        ::free(parser->pending);
+        ::free(parser);
+    }
+}
+
+bool
+JSON_PushFeed (json_push_parser_t * parser, json_buffer_t chunk) {
+    bool ret = false;
+    if (parser && !parser->failed && (chunk.ptr || 0 == chunk.size)) {
+        try {
+            if (chunk.size > MaxPushStreamSize - parser->fed_size)
+                throw Exception{JSON_SEV_Fatal, JSON_ERR_StreamTooLong, {0, parser->depth, 0, 0}, "a push-parsed stream can't be longer than 4GiB - 1 bytes", 0, 0};
+            parser->fed_size += chunk.size;
+            if (parser->pending_size > 0) {
+                json_size_t token_end = 0;
+                if (!PushParser_FindTokenEnd(parser, chunk, &token_end)) {
+                    PushParser_AppendPending(parser, chunk.ptr, chunk.size);
+                    chunk.size = 0;
+                } else {
+                    PushParser_AppendPending(parser, chunk.ptr, token_end);
+                    json_size_t const unconsumed = PushParser_RunPending(parser, false);
+                    chunk.ptr += token_end - unconsumed;
+                    chunk.size -= token_end - unconsumed;
+                }
+            }
+            if (chunk.size > 0) {
+                parser->window = chunk;
+                parser->line_scan_byte = 0;
+                json_size_t const consumed = PushParser_Run(parser, false);
+                PushParser_AppendPending(parser, chunk.ptr + consumed, chunk.size - consumed);
+                if (parser->pending_size > 0 && '"' == parser->pending[0])     // Only to learn whether it ends in the middle of an escape
+                    find_string_end(parser->pending + 1, parser->pending + parser->pending_size, &parser->pending_escape);
+                PushParser_Retire(parser, consumed);
+                parser->window = {};
+            }
+            ret = true;
+        } catch (Exception & e) {
+            PushParser_ReportError(parser, e);
+        }
+    }
+    return ret;
+}
+
+bool
+JSON_PushFinish (json_push_parser_t * parser) {
+    bool ret = false;
+    if (parser && !parser->failed) {
+        try {
+            if (parser->pending_size > 0) {
+                PushParser_RunPending(parser, true);
+            } else {
+                parser->window = {"", 0};
+                parser->line_scan_byte = 0;
+                PushParser_Run(parser, true);
+            }
+            if (0 == parser->value_count)
+                throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, {0, parser->depth, 0, 0}, "a JSON value should start with one of these characters: 0123456789+-.{[\"ntf", -1, 0};
+            ret = true;
+        } catch (Exception & e) {
+            PushParser_ReportError(parser, e);
+        }
+    }
+    return ret;
+}
+
+//======================================================================
+// The document (DOM): a tape of 16-byte nodes in one allocation, in document
+//  order. A container's children follow it directly, and it knows where its
+//  subtree ends, so skipping over a value is one lookup. An object's children
+//  alternate between names and values. Strings stay in the input (as
+//  substrings) until someone asks for them unescaped. Objects with many
+//  members get a hash table of their keys, in a pool next to the tape.
+
+#define Y_OPT_JSON_DOC_HASH_MIN_MEMBERS     16
+
+struct DocNode {
+    uint32_t type;          // json_value_type_e
+    uint32_t aux;           // String: estimated unescaped size; Array/Object: number of elements/members
+    union {
+        long long i;
+        double r;
+        bool b;
+        struct {json_size_t begin, end;} s;
+        struct {json_size_t end, table;} c;     // end: one past the last node of the subtree; table: offset in the pool, or NoTable
+    };
+};
+static_assert(sizeof(DocNode) == 16, "");
+
+static constexpr json_size_t NoTable = ~json_size_t(0);
+
+struct json_doc_t {
+    json_buffer_t in;
+    DocNode * nodes;
+    json_size_t node_count;
+    json_size_t node_capacity;
+    uint32_t * tables;      // Each: the capacity (a power of two,) then that many slots of name node indices (0 for empty)
+    json_size_t table_size;
+    json_size_t table_capacity;
+    json_error_f error_cb;
+    void * user_data;
+    bool failed;
+};
+
+static inline int
+hex_digit_value (char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static inline int
+read_hex4 (char const * p, char const * end) {     // -1 if there aren't 4 hex digits
+    int ret = -1;
+    if (end - p >= 4) {
+        int const a = hex_digit_value(p[0]), b = hex_digit_value(p[1]), c = hex_digit_value(p[2]), d = hex_digit_value(p[3]);
+        if (a >= 0 && b >= 0 && c >= 0 && d >= 0)
+            ret = (a << 12) | (b << 8) | (c << 4) | d;
+    }
+    return ret;
+}
+
+// Unescapes [p, end) (a string's contents, as validated by read_str()) into out, writing at most out_size bytes,
+//  and returns the full unescaped size. \u escapes become UTF-8; broken ones (and lone surrogates) become U+FFFD.
+static json_size_t
+unescape_string (char const * p, char const * end, char * out, json_size_t out_size) {
+    json_size_t n = 0;
+    auto put = [&](char c) {
+        if (n < out_size)
+            out[n] = c;
+        n += 1;
+    };
+    while (p < end) {
+        char const * bs = static_cast<char const *>(::memchr(p, '\\', end - p));
+        char const * const run_end = bs ? bs : end;
+        json_size_t const run = json_size_t(run_end - p);
+        if (n < out_size)
+            ::memcpy(out + n, p, (out_size - n < run) ? (out_size - n) : run);
+        n += run;
+        p = run_end;
+        if (!bs || p + 1 >= end)
+            break;
+        char const e = p[1];
+        p += 2;
+        switch (e) {
+        case 'b': put('\b'); break;
+        case 'f': put('\f'); break;
+        case 'n': put('\n'); break;
+        case 'r': put('\r'); break;
+        case 't': put('\t'); break;
+        case 'u': {
+            long cp = read_hex4(p, end);
+            if (cp >= 0) {
+                p += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {     // High surrogate; needs a low one right after
+                    int const lo = (end - p >= 6 && '\\' == p[0] && 'u' == p[1]) ? read_hex4(p + 2, end) : -1;
+                    if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        p += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+            } else {
+                cp = 0xFFFD;
+            }
+            if (cp < 0x80) {
+                put(char(cp));
+            } else if (cp < 0x800) {
+                put(char(0xC0 | (cp >> 6)));
+                put(char(0x80 | (cp & 0x3F)));
+            } else if (cp < 0x10000) {
+                put(char(0xE0 | (cp >> 12)));
+                put(char(0x80 | ((cp >> 6) & 0x3F)));
+                put(char(0x80 | (cp & 0x3F)));
+            } else {
+                put(char(0xF0 | (cp >> 18)));
+                put(char(0x80 | ((cp >> 12) & 0x3F)));
+                put(char(0x80 | ((cp >> 6) & 0x3F)));
+                put(char(0x80 | (cp & 0x3F)));
+            }
+        } break;
+        default: put(e); break;     // '"', '\\' and '/'
+        }
+    }
+    return n;
+}
+
+static inline uint32_t
+hash_bytes (char const * p, json_size_t size) {    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (json_size_t i = 0; i < size; ++i)
+        h = (h ^ uint8_t(p[i])) * 16777619u;
+    return h;
+}
+
+// Calls func(ptr, size) with the unescaped contents of a string; only copies if there are escapes.
+template <typename F>
+static inline auto
+WithUnescaped (char const * raw, json_size_t raw_size, F && func) -> decltype(func("", 0)) {
+    if (!::memchr(raw, '\\', raw_size))
+        return func(raw, raw_size);
+
+    char local [256];
+    json_size_t const size = unescape_string(raw, raw + raw_size, local, sizeof(local));
+    if (size <= sizeof(local))
+        return func(local, size);
+    auto heap = static_cast<char *>(::malloc(size));
+    if (!heap)
+        throw Exception{JSON_SEV_Fatal, JSON_ERR_BadParams, {}, "Out of memory (for unescaping a string)", 0, 0};
+    struct Free {char * p; ~Free () {::free(p);}} free_heap {heap};
+    unescape_string(raw, raw + raw_size, heap, size);
+    return func(heap, size);
+}
+
+template <typename F>
+static inline auto
+Doc_WithUnescaped (json_doc_t const * doc, DocNode const & node, F && func) -> decltype(func("", 0)) {
+    return WithUnescaped(doc->in.ptr + node.s.begin, node.s.end - node.s.begin, func);
+}
+
+static inline json_node_t
+Doc_Skip (json_doc_t const * doc, json_node_t node) {
+    DocNode const & n = doc->nodes[node];
+    return (JSON_VTYPE_Array == n.type || JSON_VTYPE_Object == n.type) ? n.c.end : node + 1;
+}
+
+static json_size_t
+Doc_AddNode (json_doc_t * doc, json_value_type_e type) {
+    if (doc->node_count == doc->node_capacity) {
+        json_size_t const new_capacity = (doc->node_capacity > 0) ? 2 * doc->node_capacity : 64;
+        auto bigger = static_cast<DocNode *>(::realloc(doc->nodes, size_t(new_capacity) * sizeof(DocNode)));
+        if (!bigger)
+            throw Exception{JSON_SEV_Fatal, JSON_ERR_BadParams, {}, "Out of memory (for the document)", 0, 0};
+        doc->nodes = bigger;
+        doc->node_capacity = new_capacity;
+    }
+    DocNode & n = doc->nodes[doc->node_count];
+    n.type = type;
+    n.aux = 0;
+    n.i = 0;
+    return doc->node_count++;
+}
+
+static void
+Doc_BuildKeyTable (json_doc_t * doc, json_node_t object) {
+    json_size_t capacity = 16;
+    while (capacity < 2 * doc->nodes[object].aux)
+        capacity *= 2;
+    if (doc->table_size + 1 + capacity > doc->table_capacity) {
+        json_size_t new_capacity = (doc->table_capacity > 0) ? 2 * doc->table_capacity : 1024;
+        while (new_capacity < doc->table_size + 1 + capacity)
+            new_capacity *= 2;
+        auto bigger = static_cast<uint32_t *>(::realloc(doc->tables, size_t(new_capacity) * sizeof(uint32_t)));
+        if (!bigger)
+            throw Exception{JSON_SEV_Fatal, JSON_ERR_BadParams, {}, "Out of memory (for the key tables)", 0, 0};
+        doc->tables = bigger;
+        doc->table_capacity = new_capacity;
+    }
+    json_size_t const offset = doc->table_size;
+    uint32_t * table = doc->tables + offset;
+    table[0] = capacity;
+    ::memset(table + 1, 0, capacity * sizeof(uint32_t));
+    doc->table_size += 1 + capacity;
+
+    uint32_t const mask = capacity - 1;
+    for (json_node_t name = object + 1; name < doc->nodes[object].c.end; name = Doc_Skip(doc, name + 1)) {
+        uint32_t slot = Doc_WithUnescaped(doc, doc->nodes[name], hash_bytes) & mask;
+        while (table[1 + slot])
+            slot = (slot + 1) & mask;
+        table[1 + slot] = name;
+    }
+    doc->nodes[object].c.table = offset;
+}
+
+static json_user_handle_t
+Doc_ElementCallback (
+    json_elem_type_e elem_type,
+    json_user_handle_t self,
+    json_value_t value,
+    json_user_handle_t parent,
+    json_buffer_t const * /*input*/,
+    json_location_t const * /*location*/,
+    void * user_data
+) {
+    // Handles are node indices plus one, so the root's parent can be null.
+    auto doc = static_cast<json_doc_t *>(user_data);
+    json_size_t const parent_node = json_size_t(reinterpret_cast<uintptr_t>(parent)) - 1;
+    json_user_handle_t ret = nullptr;
+    switch (elem_type) {
+    case JSON_ETYPE_ObjectBegin:
+    case JSON_ETYPE_ArrayBegin: {
+        if (parent && JSON_VTYPE_Array == doc->nodes[parent_node].type)
+            doc->nodes[parent_node].aux += 1;
+        json_size_t const n = Doc_AddNode(doc, JSON_ETYPE_ObjectBegin == elem_type ? JSON_VTYPE_Object : JSON_VTYPE_Array);
+        doc->nodes[n].c.table = NoTable;
+        ret = reinterpret_cast<json_user_handle_t>(uintptr_t(n) + 1);
+    } break;
+    case JSON_ETYPE_ObjectEnd:
+    case JSON_ETYPE_ArrayEnd: {
+        json_size_t const n = json_size_t(reinterpret_cast<uintptr_t>(self)) - 1;
+        doc->nodes[n].c.end = doc->node_count;
+        if (JSON_ETYPE_ObjectEnd == elem_type && doc->nodes[n].aux >= Y_OPT_JSON_DOC_HASH_MIN_MEMBERS)
+            Doc_BuildKeyTable(doc, n);
+    } break;
+    case JSON_ETYPE_Name: {
+        doc->nodes[parent_node].aux += 1;
+        json_size_t const n = Doc_AddNode(doc, JSON_VTYPE_String);
+        doc->nodes[n].aux = value.data.s.estimated_unescaped_size_bytes;
+        doc->nodes[n].s.begin = value.data.s.begin;
+        doc->nodes[n].s.end = value.data.s.end;
+    } break;
+    case JSON_ETYPE_Value: {
+        if (parent && JSON_VTYPE_Array == doc->nodes[parent_node].type)
+            doc->nodes[parent_node].aux += 1;
+        json_size_t const n = Doc_AddNode(doc, value.type);
+        DocNode & node = doc->nodes[n];
+        switch (value.type) {
+        case JSON_VTYPE_Bool: node.b = value.data.b; break;
+        case JSON_VTYPE_Int: node.i = value.data.i; break;
+        case JSON_VTYPE_Real: node.r = value.data.r; break;
+        case JSON_VTYPE_String:
+            node.aux = value.data.s.estimated_unescaped_size_bytes;
+            node.s.begin = value.data.s.begin;
+            node.s.end = value.data.s.end;
+            break;
+        default: break;
+        }
+    } break;
+    default: break;
+    }
+    return ret;
+}
+
+static void
+Doc_ErrorCallback (
+    json_error_severity_e severity,
+    json_error_e error,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data,
+    char const * msg,
+    int param1,
+    int param2
+) {
+    auto doc = static_cast<json_doc_t *>(user_data);
+    doc->failed = true;
+    if (doc->error_cb)
+        doc->error_cb(severity, error, input, location, doc->user_data, msg, param1, param2);
+}
+
+json_doc_t *
+JSON_DocParse (
+    json_buffer_t input,
+    json_options_t const * options,
+    json_error_f error_cb,
+    void * user_data
+) {
+    json_doc_t * ret = static_cast<json_doc_t *>(::calloc(1, sizeof(json_doc_t)));
+    if (ret) {
+        ret->in = input;
+        ret->error_cb = error_cb;
+        ret->user_data = user_data;
+        // A guess that's right for typical documents; it's only the first allocation.
+        json_size_t const guess = input.size / 8 + 16;
+        ret->nodes = static_cast<DocNode *>(::malloc(size_t(guess) * sizeof(DocNode)));
+        ret->node_capacity = ret->nodes ? guess : 0;
+        JSON_ParseEx(input, options, Doc_ElementCallback, Doc_ErrorCallback, ret);
+        if (ret->failed || 0 == ret->node_count) {
+            JSON_DocDestroy(ret);
+            ret = nullptr;
+        }
+    }
+    return ret;
+}
+
+void
+JSON_DocDestroy (json_doc_t * doc) {
+    if (doc) {
+        ::free(doc->nodes);
+        ::free(doc->tables);
+        ::free(doc);
+    }
+}
+
+json_size_t
+JSON_DocNodeCount (json_doc_t const * doc) {
+    return doc ? doc->node_count : 0;
+}
+
+json_value_type_e
+JSON_DocType (json_doc_t const * doc, json_node_t node) {
+    json_value_type_e ret = JSON_VTYPE_INVALID;
+    if (doc && node < doc->node_count)
+        ret = json_value_type_e(doc->nodes[node].type);
+    return ret;
+}
+
+json_size_t
+JSON_DocCount (json_doc_t const * doc, json_node_t node) {
+    json_size_t ret = 0;
+    if (doc && node < doc->node_count && (JSON_VTYPE_Array == doc->nodes[node].type || JSON_VTYPE_Object == doc->nodes[node].type))
+        ret = doc->nodes[node].aux;
+    return ret;
+}
+
+json_node_t
+JSON_DocFirstChild (json_doc_t const * doc, json_node_t node) {
+    json_node_t ret = JSON_NODE_INVALID;
+    if (JSON_DocCount(doc, node) > 0)
+        ret = node + 1;
+    return ret;
+}
+
+json_node_t
+JSON_DocNext (json_doc_t const * doc, json_node_t node, json_node_t container) {
+    json_node_t ret = JSON_NODE_INVALID;
+    if (doc && node < doc->node_count && container < node && node < doc->nodes[container].c.end) {
+        json_node_t const next = Doc_Skip(doc, node);
+        if (next < doc->nodes[container].c.end)
+            ret = next;
+    }
+    return ret;
+}
+
+json_node_t
+JSON_DocAt (json_doc_t const * doc, json_node_t array, json_size_t index) {
+    json_node_t ret = JSON_NODE_INVALID;
+    if (JSON_VTYPE_Array == JSON_DocType(doc, array) && index < doc->nodes[array].aux) {
+        ret = array + 1;
+        for (json_size_t i = 0; i < index; ++i)
+            ret = Doc_Skip(doc, ret);
+    }
+    return ret;
+}
+
+json_node_t
+JSON_DocFind (json_doc_t const * doc, json_node_t object, char const * key, json_size_t key_size) {
+    json_node_t ret = JSON_NODE_INVALID;
+    if (JSON_VTYPE_Object == JSON_DocType(doc, object) && (key || 0 == key_size)) {
+        auto matches = [&](json_node_t name) -> bool {
+            return Doc_WithUnescaped(doc, doc->nodes[name], [&](char const * p, json_size_t size) {
+                return size == key_size && 0 == ::memcmp(p, key, size);
+            });
+        };
+        try {
+            DocNode const & obj = doc->nodes[object];
+            if (NoTable != obj.c.table) {
+                uint32_t const * table = doc->tables + obj.c.table;
+                uint32_t const mask = table[0] - 1;
+                for (uint32_t slot = hash_bytes(key, key_size) & mask; table[1 + slot]; slot = (slot + 1) & mask)
+                    if (matches(table[1 + slot])) {
+                        ret = table[1 + slot] + 1;
+                        break;
+                    }
+            } else {
+                for (json_node_t name = object + 1; name < obj.c.end; name = Doc_Skip(doc, name + 1))
+                    if (matches(name)) {
+                        ret = name + 1;
+                        break;
+                    }
+            }
+        } catch (Exception &) {
+            ret = JSON_NODE_INVALID;    // Out of memory
+        }
+    }
+    return ret;
+}
+
+bool
+JSON_DocGetBool (json_doc_t const * doc, json_node_t node, bool * out_value) {
+    bool ret = false;
+    if (JSON_VTYPE_Bool == JSON_DocType(doc, node)) {
+        *out_value = doc->nodes[node].b;
+        ret = true;
+    }
+    return ret;
+}
+
+bool
+JSON_DocGetInt (json_doc_t const * doc, json_node_t node, long long * out_value) {
+    bool ret = false;
+    if (JSON_VTYPE_Int == JSON_DocType(doc, node)) {
+        *out_value = doc->nodes[node].i;
+        ret = true;
+    }
+    return ret;
+}
+
+bool
+JSON_DocGetReal (json_doc_t const * doc, json_node_t node, double * out_value) {
+    bool ret = false;
+    json_value_type_e const type = JSON_DocType(doc, node);
+    if (JSON_VTYPE_Real == type) {
+        *out_value = doc->nodes[node].r;
+        ret = true;
+    } else if (JSON_VTYPE_Int == type) {
+        *out_value = double(doc->nodes[node].i);
+        ret = true;
+    }
+    return ret;
+}
+
+bool
+JSON_DocGetRawString (json_doc_t const * doc, json_node_t node, json_substr_t * out_str) {
+    bool ret = false;
+    if (JSON_VTYPE_String == JSON_DocType(doc, node)) {
+        DocNode const & n = doc->nodes[node];
+        *out_str = {n.s.begin, n.s.end, n.aux};
+        ret = true;
+    }
+    return ret;
+}
+
+json_size_t
+JSON_DocGetString (json_doc_t const * doc, json_node_t node, char * out, json_size_t out_size) {
+    json_size_t ret = 0;
+    if (JSON_VTYPE_String == JSON_DocType(doc, node) && (out || 0 == out_size)) {
+        DocNode const & n = doc->nodes[node];
+        ret = unescape_string(doc->in.ptr + n.s.begin, doc->in.ptr + n.s.end, out, out_size);
+    }
+    return ret;
+}
+
+//======================================================================
+// NDJSON: one JSON value per line. The input is cut into chunks at line
+//  boundaries, and the worker threads take chunks off a shared counter
+//  (so a slow chunk doesn't hold the others up,) parse each line on its
+//  own with JSON_ParseEx, and collect the records per chunk; at the end the
+//  chunks are concatenated, which keeps the records in input order.
+
+struct NDJSONChunk {
+    unsigned long long begin;
+    unsigned long long end;
+    json_ndjson_record_t * records;
+    unsigned long long record_count;
+    unsigned long long record_capacity;
+    bool out_of_memory;
+};
+
+struct NDJSONWorker {
+    json_element_f elem_cb;
+    void * user_data;
+    json_ndjson_record_t * record;  // The one being parsed
+};
+
+static json_user_handle_t
+NDJSON_ElementTrampoline (
+    json_elem_type_e elem_type,
+    json_user_handle_t self,
+    json_value_t value,
+    json_user_handle_t parent,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data
+) {
+    auto worker = static_cast<NDJSONWorker *>(user_data);
+    json_user_handle_t ret = nullptr;
+    if (worker->elem_cb)
+        ret = worker->elem_cb(elem_type, self, value, parent, input, location, worker->user_data);
+    if (0 == location->depth && (JSON_ETYPE_ObjectBegin == elem_type || JSON_ETYPE_ArrayBegin == elem_type || JSON_ETYPE_Value == elem_type))
+        worker->record->root = ret;
+    return ret;
+}
+
+static void
+NDJSON_ErrorTrampoline (
+    json_error_severity_e /*severity*/,
+    json_error_e error,
+    json_buffer_t const * /*input*/,
+    json_location_t const * location,
+    void * user_data,
+    char const * /*msg*/,
+    int /*param1*/,
+    int /*param2*/
+) {
+    auto worker = static_cast<NDJSONWorker *>(user_data);
+    if (JSON_ERR_INVALID == worker->record->error) {
+        worker->record->error = error;
+        worker->record->error_location = *location;
+    }
+}
+
+static void
+NDJSON_ParseChunk (char const * data, NDJSONChunk * chunk, json_options_t const * options, NDJSONWorker * worker) {
+    char const * p = data + chunk->begin;
+    char const * const end = data + chunk->end;
+    while (p < end) {
+        auto nl = static_cast<char const *>(::memchr(p, '\n', end - p));
+        char const * const line_end = nl ? nl : end;
+        if (scan_non_whitespace(p, line_end) < line_end) {     // Blank lines aren't records
+            if (chunk->record_count == chunk->record_capacity) {
+                unsigned long long const new_capacity = (chunk->record_capacity > 0) ? 2 * chunk->record_capacity : 1024;
+                auto bigger = static_cast<json_ndjson_record_t *>(::realloc(chunk->records, size_t(new_capacity) * sizeof(json_ndjson_record_t)));
+                if (!bigger) {
+                    chunk->out_of_memory = true;
+                    return;
+                }
+                chunk->records = bigger;
+                chunk->record_capacity = new_capacity;
+            }
+            json_ndjson_record_t * record = chunk->records + chunk->record_count++;
+            *record = {};
+            record->offset = (unsigned long long)(p - data);
+            record->size = json_size_t(line_end - p);
+            worker->record = record;
+            json_buffer_t const line {p, record->size};
+            json_size_t const consumed = JSON_ParseEx(line, options, NDJSON_ElementTrampoline, NDJSON_ErrorTrampoline, worker);
+            if (JSON_ERR_INVALID == record->error && consumed < line.size) {
+                record->error = JSON_ERR_TrailingContent;
+                record->error_location = {consumed, 0, 1, int(consumed) + 1};
+            }
+        }
+        p = line_end + 1;
+    }
+}
+
+int
+JSON_NDJSONThreadCount (int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = int(std::thread::hardware_concurrency());
+        if (thread_count <= 0)
+            thread_count = 1;
+    }
+    return thread_count;
+}
+
+bool
+JSON_NDJSONParseMemory (
+    char const * data,
+    unsigned long long size,
+    json_options_t const * options,
+    int thread_count,
+    json_element_f elem_cb,
+    void * const * worker_user_data,
+    json_ndjson_result_t * out_result
+) {
+    bool ret = false;
+    if (out_result && (data || 0 == size)) {
+        *out_result = {};
+        thread_count = JSON_NDJSONThreadCount(thread_count);
+
+        // Many more chunks than threads, for balance; but not so small that the bookkeeping shows.
+        unsigned long long chunk_size = size / (unsigned long long)(thread_count * 16) + 1;
+        if (chunk_size < (1ULL << 20))
+            chunk_size = 1ULL << 20;
+        unsigned long long const max_chunks = size / chunk_size + 1;
+        auto chunks = static_cast<NDJSONChunk *>(::calloc(size_t(max_chunks), sizeof(NDJSONChunk)));
+        if (chunks) {
+            unsigned long long chunk_count = 0;
+            for (unsigned long long begin = 0; begin < size; ) {
+                unsigned long long end = begin + chunk_size;
+                if (end >= size) {
+                    end = size;
+                } else {                // Move the end to just past a newline; a line is never split
+                    auto nl = static_cast<char const *>(::memchr(data + end, '\n', size_t(size - end)));
+                    end = nl ? (unsigned long long)(nl - data) + 1 : size;
+                }
+                chunks[chunk_count].begin = begin;
+                chunks[chunk_count].end = end;
+                chunk_count += 1;
+                begin = end;
+            }
+
+            std::atomic<unsigned long long> next_chunk {0};
+            auto work = [&](int worker_index) {
+                NDJSONWorker worker {elem_cb, worker_user_data ? worker_user_data[worker_index] : nullptr, nullptr};
+                for (unsigned long long c = next_chunk++; c < chunk_count; c = next_chunk++)
+                    NDJSON_ParseChunk(data, chunks + c, options, &worker);
+            };
+            int const helper_count = int((unsigned long long)(thread_count - 1) < chunk_count ? thread_count - 1 : (chunk_count > 0 ? chunk_count - 1 : 0));
+            std::thread * helpers = (helper_count > 0) ? static_cast<std::thread *>(::malloc(helper_count * sizeof(std::thread))) : nullptr;
+            int started = 0;
+            if (helpers) {
+                try {       // If we can't start a thread, we make do with the ones we've got
+                    for (; started < helper_count; ++started)
+                        new (helpers + started) std::thread (work, started + 1);
+                } catch (...) {}
+            }
+            work(0);
+            for (int i = 0; i < started; ++i) {
+                helpers[i].join();
+                helpers[i].~thread();
+            }
+            ::free(helpers);
+
+            bool out_of_memory = false;
+            unsigned long long total = 0;
+            for (unsigned long long c = 0; c < chunk_count; ++c) {
+                total += chunks[c].record_count;
+                out_of_memory = out_of_memory || chunks[c].out_of_memory;
+            }
+            if (!out_of_memory && total > 0)
+                out_result->records = static_cast<json_ndjson_record_t *>(::malloc(size_t(total) * sizeof(json_ndjson_record_t)));
+            if (!out_of_memory && (out_result->records || 0 == total)) {
+                for (unsigned long long c = 0; c < chunk_count; ++c) {
+                    if (chunks[c].record_count > 0)
+                        ::memcpy(out_result->records + out_result->record_count, chunks[c].records, size_t(chunks[c].record_count) * sizeof(json_ndjson_record_t));
+                    out_result->record_count += chunks[c].record_count;
+                }
+                for (unsigned long long r = 0; r < out_result->record_count; ++r)
+                    if (JSON_ERR_INVALID != out_result->records[r].error)
+                        out_result->error_count += 1;
+                ret = true;
+            }
+            for (unsigned long long c = 0; c < chunk_count; ++c)
+                ::free(chunks[c].records);
+            ::free(chunks);
+        }
+    }
+    return ret;
+}
+
+bool
+JSON_NDJSONParseFile (
+    char const * path,
+    json_options_t const * options,
+    int thread_count,
+    json_element_f elem_cb,
+    void * const * worker_user_data,
+    json_ndjson_result_t * out_result
+) {
+    bool ret = false;
+    if (path && out_result) {
+#if defined(_WIN32)
+        HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (INVALID_HANDLE_VALUE != file) {
+            LARGE_INTEGER size;
+            if (::GetFileSizeEx(file, &size)) {
+                if (0 == size.QuadPart) {
+                    ret = JSON_NDJSONParseMemory("", 0, options, thread_count, elem_cb, worker_user_data, out_result);
+                } else {
+                    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                    if (mapping) {
+                        void * view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                        if (view) {
+                            ret = JSON_NDJSONParseMemory(static_cast<char const *>(view), (unsigned long long)size.QuadPart, options, thread_count, elem_cb, worker_user_data, out_result);
+                            ::UnmapViewOfFile(view);
+                        }
+                        ::CloseHandle(mapping);
+                    }
+                }
+            }
+            ::CloseHandle(file);
+        }
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd >= 0) {
+            struct stat st;
+            if (0 == ::fstat(fd, &st)) {
+                if (0 == st.st_size) {
+                    ret = JSON_NDJSONParseMemory("", 0, options, thread_count, elem_cb, worker_user_data, out_result);
+                } else {
+                    void * view = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (MAP_FAILED != view) {
+                        ::madvise(view, size_t(st.st_size), MADV_SEQUENTIAL);
+                        ret = JSON_NDJSONParseMemory(static_cast<char const *>(view), (unsigned long long)st.st_size, options, thread_count, elem_cb, worker_user_data, out_result);
+                        ::munmap(view, size_t(st.st_size));
+                    }
+                }
+            }
+            ::close(fd);
+        }
+#endif
+    }
+    return ret;
+}
+
+void
+JSON_NDJSONFreeResult (json_ndjson_result_t * result) {
+    if (result) {
+        ::free(result->records);
+        *result = {};
+    }
+}
+
+//======================================================================
+// The binder: parses straight into a struct, driven by a table of fields
+//  (type, offset, size, name; the same shape as the reflection tables in
+//  the ECS example.) Names are matched with a hash table built once per
+//  schema, and nothing is allocated per document.
+
+struct json_schema_t {
+    json_size_t struct_size;
+    json_size_t field_count;
+    json_field_t const * fields;
+    uint32_t table_mask;
+    uint32_t table [1];             // Actually (table_mask + 1) slots of field index + 1; 0 is empty
+};
+
+static json_size_t
+Binder_ElementSize (json_field_t const & f) {
+    switch (f.type) {
+    case JSON_FTYPE_Bool: return sizeof(bool);
+    case JSON_FTYPE_I32: return sizeof(int32_t);
+    case JSON_FTYPE_I64: return sizeof(int64_t);
+    case JSON_FTYPE_F32: return sizeof(float);
+    case JSON_FTYPE_F64: return sizeof(double);
+    case JSON_FTYPE_Str: return f.size;     // A char array (NUL-terminated;) no arrays of strings
+    case JSON_FTYPE_Struct: return f.schema ? f.schema->struct_size : 0;
+    default: return 0;
+    }
+}
+
+json_schema_t *
+JSON_SchemaCreate (json_field_t const * fields, json_size_t field_count, json_size_t struct_size) {
+    json_schema_t * ret = nullptr;
+    bool valid = (fields || 0 == field_count);
+    for (json_size_t i = 0; valid && i < field_count; ++i) {
+        json_size_t const elem = Binder_ElementSize(fields[i]);
+        valid = fields[i].name && elem > 0 && fields[i].size >= elem && fields[i].size % elem == 0
+            && fields[i].offset + fields[i].size <= struct_size;
+    }
+    if (valid) {
+        uint32_t capacity = 8;
+        while (capacity < 2 * field_count)
+            capacity *= 2;
+        ret = static_cast<json_schema_t *>(::calloc(1, sizeof(json_schema_t) + (capacity - 1) * sizeof(uint32_t)));
+        if (ret) {
+            ret->struct_size = struct_size;
+            ret->field_count = field_count;
+            ret->fields = fields;
+            ret->table_mask = capacity - 1;
+            for (json_size_t i = 0; i < field_count; ++i) {
+                uint32_t slot = hash_bytes(fields[i].name, json_size_t(::strlen(fields[i].name))) & ret->table_mask;
+                while (ret->table[slot])
+                    slot = (slot + 1) & ret->table_mask;
+                ret->table[slot] = i + 1;
+            }
+        }
+    }
+    return ret;
+}
+
+void
+JSON_SchemaDestroy (json_schema_t * schema) {
+    ::free(schema);
+}
+
+static json_field_t const *
+Schema_FindField (json_schema_t const * schema, char const * name, json_size_t name_size) {
+    json_field_t const * ret = nullptr;
+    for (uint32_t slot = hash_bytes(name, name_size) & schema->table_mask; schema->table[slot]; slot = (slot + 1) & schema->table_mask) {
+        json_field_t const & f = schema->fields[schema->table[slot] - 1];
+        if (0 == ::strncmp(f.name, name, name_size) && 0 == f.name[name_size]) {
+            ret = &f;
+            break;
+        }
+    }
+    return ret;
+}
+
+struct BinderFrame {
+    json_schema_t const * schema;   // For objects; null for arrays, and for things we're skipping
+    char * base;                    // Of the struct (objects) or of the field (arrays); null when skipping
+    json_field_t const * field;     // Objects: the field the next value goes into (null to skip it); arrays: the array field
+    json_size_t index;              // Arrays: where the next element goes
+};
+
+// Only containers that go into the struct get a frame; the ones being skipped
+//  (and everything inside them) share "skipping", and are only counted.
+struct Binder {
+    static constexpr int MaxDepth = 64;
+
+    json_schema_t const * schema;
+    void * out;
+    json_error_f error_cb;
+    void * user_data;
+    bool mismatch;
+    int depth;
+    int skip_depth;
+    BinderFrame skipping;           // All null, so nothing inside is bound
+    BinderFrame frames [MaxDepth];
+};
+
+static void
+Binder_Mismatch (Binder * b, json_buffer_t const * input, json_location_t const * location, char const * msg) {
+    b->mismatch = true;
+    if (b->error_cb)
+        b->error_cb(JSON_SEV_Error, JSON_ERR_SchemaMismatch, input, location, b->user_data, msg, 0, 0);
+}
+
+// Where a value (or an element of an array value) goes, or null if it's not wanted.
+static char *
+Binder_Target (Binder * b, BinderFrame * parent, json_field_t const ** out_field, json_buffer_t const * input, json_location_t const * location) {
+    char * ret = nullptr;
+    *out_field = nullptr;
+    if (parent && parent->base) {
+        if (parent->schema) {               // A member
+            if (parent->field) {
+                *out_field = parent->field;
+                ret = parent->base + parent->field->offset;
+                parent->field = nullptr;
+            }
+        } else {                            // An element
+            json_field_t const * f = parent->field;
+            json_size_t const elem = Binder_ElementSize(*f);
+            if (parent->index < f->size / elem) {
+                *out_field = f;
+                ret = parent->base + parent->index * elem;
+            } else {
+                Binder_Mismatch(b, input, location, "Too many elements for the array field");
+            }
+            parent->index += 1;
+        }
+    }
+    return ret;
+}
+
+static json_user_handle_t
+Binder_ElementCallback (
+    json_elem_type_e elem_type,
+    json_user_handle_t,
+    json_value_t value,
+    json_user_handle_t parent_handle,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data
+) {
+    auto b = static_cast<Binder *>(user_data);
+    auto parent = static_cast<BinderFrame *>(parent_handle);
+    json_user_handle_t ret = nullptr;
+    switch (elem_type) {
+    case JSON_ETYPE_ObjectBegin:
+    case JSON_ETYPE_ArrayBegin: {
+        BinderFrame frame = {};
+        json_field_t const * f = nullptr;
+        char * target = nullptr;
+        if (b->skip_depth > 0) {
+            // Inside something we're skipping
+        } else if (!parent) {
+            if (JSON_ETYPE_ObjectBegin == elem_type) {
+                frame.schema = b->schema;
+                frame.base = static_cast<char *>(b->out);
+            } else {
+                Binder_Mismatch(b, input, location, "The top-level value must be an object");
+            }
+        } else {
+            bool const is_element = parent->base && !parent->schema;
+            target = Binder_Target(b, parent, &f, input, location);
+            if (target) {
+                bool const is_array_field = f->size > Binder_ElementSize(*f) && JSON_FTYPE_Str != f->type;
+                if (JSON_ETYPE_ArrayBegin == elem_type && is_array_field && !is_element) {
+                    frame.base = target;
+                    frame.field = f;
+                } else if (JSON_ETYPE_ObjectBegin == elem_type && JSON_FTYPE_Struct == f->type && (is_element || !is_array_field)) {
+                    frame.schema = f->schema;
+                    frame.base = target;
+                } else {
+                    Binder_Mismatch(b, input, location, "The field's type doesn't match the value");
+                }
+            }
+        }
+        if (frame.base) {
+            if (b->depth >= Binder::MaxDepth)
+                throw Exception{JSON_SEV_Fatal, JSON_ERR_SchemaMismatch, *location, "Too deeply nested for the binder", 0, 0};
+            b->frames[b->depth] = frame;
+            ret = b->frames + b->depth++;
+        } else {
+            b->skip_depth += 1;
+            ret = &b->skipping;
+        }
+    } break;
+    case JSON_ETYPE_ObjectEnd:
+    case JSON_ETYPE_ArrayEnd:
+        if (b->skip_depth > 0)      // Skipped containers are always the innermost ones
+            b->skip_depth -= 1;
+        else
+            b->depth -= 1;
+        break;
+    case JSON_ETYPE_Name:
+        if (parent && parent->schema) {
+            parent->field = WithUnescaped(input->ptr + value.data.s.begin, value.data.s.end - value.data.s.begin, [&](char const * p, json_size_t size) {
+                return Schema_FindField(parent->schema, p, size);
+            });
+        }
+        break;
+    case JSON_ETYPE_Value: {
+        json_field_t const * f = nullptr;
+        char * target = Binder_Target(b, parent, &f, input, location);
+        if (!parent)
+            Binder_Mismatch(b, input, location, "The top-level value must be an object");
+        if (!target)
+            break;
+        if (!parent->schema || f->size == Binder_ElementSize(*f) || JSON_FTYPE_Str == f->type) {
+            bool ok = true;
+            switch (f->type) {
+            case JSON_FTYPE_Bool:
+                ok = (JSON_VTYPE_Bool == value.type);
+                if (ok) *reinterpret_cast<bool *>(target) = value.data.b;
+                break;
+            case JSON_FTYPE_I32:
+                ok = (JSON_VTYPE_Int == value.type && value.data.i >= INT32_MIN && value.data.i <= INT32_MAX);
+                if (ok) {int32_t v = int32_t(value.data.i); ::memcpy(target, &v, sizeof(v));}
+                break;
+            case JSON_FTYPE_I64:
+                ok = (JSON_VTYPE_Int == value.type);
+                if (ok) {int64_t v = value.data.i; ::memcpy(target, &v, sizeof(v));}
+                break;
+            case JSON_FTYPE_F32:
+            case JSON_FTYPE_F64: {
+                ok = (JSON_VTYPE_Real == value.type || JSON_VTYPE_Int == value.type);
+                double const d = (JSON_VTYPE_Real == value.type) ? value.data.r : double(value.data.i);
+                if (ok && JSON_FTYPE_F32 == f->type) {float v = float(d); ::memcpy(target, &v, sizeof(v));}
+                if (ok && JSON_FTYPE_F64 == f->type) ::memcpy(target, &d, sizeof(d));
+            } break;
+            case JSON_FTYPE_Str:
+                ok = (JSON_VTYPE_String == value.type);
+                if (ok) {
+                    char const * raw = input->ptr + value.data.s.begin;
+                    json_size_t const size = unescape_string(raw, raw + (value.data.s.end - value.data.s.begin), target, f->size - 1);
+                    target[size < f->size ? size : f->size - 1] = '\0';
+                    if (size >= f->size)
+                        Binder_Mismatch(b, input, location, "The string was truncated to fit the field");
+                }
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            if (!ok)
+                Binder_Mismatch(b, input, location, "The field's type doesn't match the value");
+        } else {
+            Binder_Mismatch(b, input, location, "The field is an array, but the value isn't");
+        }
+    } break;
+    default: break;
+    }
+    return ret;
+}
+
+static void
+Binder_ErrorCallback (
+    json_error_severity_e severity,
+    json_error_e error,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data,
+    char const * msg,
+    int param1,
+    int param2
+) {
+    auto b = static_cast<Binder *>(user_data);
+    b->mismatch = true;
+    if (b->error_cb)
+        b->error_cb(severity, error, input, location, b->user_data, msg, param1, param2);
+}
+
+bool
+JSON_Bind (
+    json_buffer_t input,
+    json_schema_t const * schema,
+    void * out,
+    json_error_f error_cb,
+    void * user_data
+) {
+    bool ret = false;
+    if (schema && out) {
+        Binder b;
+        b.schema = schema;
+        b.out = out;
+        b.error_cb = error_cb;
+        b.user_data = user_data;
+        b.mismatch = false;
+        b.depth = 0;
+        b.skip_depth = 0;
+        b.skipping = {};
+        JSON_Parse(input, Binder_ElementCallback, Binder_ErrorCallback, &b);
+        ret = !b.mismatch;
+    }
+    return ret;
+}
+
+//======================================================================
+// The writer: output is gathered in a fixed buffer and handed to the sink
+//  in big pieces. Strings are escaped a 64-byte block at a time (with the
+//  same classifier the structural indexer uses,) and the runs that need no
+//  escaping are copied as they are.
+
+struct json_writer_t {
+    json_write_f sink;
+    void * user_data;
+    json_write_style_e style;
+    int indent;
+    bool failed;
+    bool after_name;
+    int depth;
+    unsigned long long top_level_count;
+    uint64_t is_object [Y_OPT_JSON_WRITER_MAX_DEPTH / 64];
+    uint64_t has_items [Y_OPT_JSON_WRITER_MAX_DEPTH / 64];
+    json_size_t used;
+    char buffer [Y_OPT_JSON_WRITER_BUFFER_SIZE];
+};
+
+static inline bool
+Writer_GetBit (uint64_t const * bits, int index) {
+    return 0 != ((bits[index / 64] >> (index % 64)) & 1);
+}
+
+static inline void
+Writer_SetBit (uint64_t * bits, int index, bool value) {
+    uint64_t const bit = uint64_t(1) << (index % 64);
+    bits[index / 64] = value ? (bits[index / 64] | bit) : (bits[index / 64] & ~bit);
+}
+
+static bool
+Writer_Flush (json_writer_t * w) {
+    if (w->used > 0 && !w->failed)
+        w->failed = !w->sink(w->buffer, w->used, w->user_data);
+    w->used = 0;
+    return !w->failed;
+}
+
+static inline void
+Writer_Put (json_writer_t * w, char const * data, json_size_t size) {
+    if (w->used + size > sizeof(w->buffer))
+        Writer_Flush(w);
+    if (size >= sizeof(w->buffer)) {
+        if (!w->failed)
+            w->failed = !w->sink(data, size, w->user_data);
+    } else {
+        ::memcpy(w->buffer + w->used, data, size);
+        w->used += size;
+    }
+}
+
+static inline void
+Writer_Put (json_writer_t * w, char c) {
+    if (w->used == sizeof(w->buffer))
+        Writer_Flush(w);
+    w->buffer[w->used++] = c;
+}
+
+static void
+Writer_NewLine (json_writer_t * w, int depth) {
+    static char const spaces [] = "                                                                ";
+    Writer_Put(w, '\n');
+    for (long long n = (long long)(w->indent) * depth; n > 0; n -= sizeof(spaces) - 1)
+        Writer_Put(w, spaces, json_size_t(n < (long long)(sizeof(spaces) - 1) ? n : sizeof(spaces) - 1));
+}
+
+// Writes whatever goes between the previous thing and this member/element; false if it can't go here.
+static bool
+Writer_Separate (json_writer_t * w, bool is_name) {
+    bool ret = false;
+    if (!w->failed) {
+        if (0 == w->depth) {
+            if (!is_name) {
+                if (w->top_level_count > 0 && JSON_WSTYLE_CBOR != w->style)
+                    Writer_Put(w, '\n');
+                ret = true;
+            }
+        } else if (w->after_name) {
+            if (!is_name) {
+                w->after_name = false;
+                ret = true;
+            }
+        } else if (is_name == Writer_GetBit(w->is_object, w->depth - 1)) {
+            if (Writer_GetBit(w->has_items, w->depth - 1) && JSON_WSTYLE_CBOR != w->style)
+                Writer_Put(w, ',');
+            Writer_SetBit(w->has_items, w->depth - 1, true);
+            if (JSON_WSTYLE_Pretty == w->style)
+                Writer_NewLine(w, w->depth);
+            ret = true;
+        }
+        w->failed = !ret;
+    }
+    return ret;
+}
+
+static inline void
+Writer_ValueDone (json_writer_t * w) {
+    if (0 == w->depth)
+        w->top_level_count += 1;
+}
+
+// A CBOR item head: the major type and the argument, in as few bytes as it fits.
+static void
+Writer_CBORHead (json_writer_t * w, unsigned major, uint64_t arg) {
+    char head [9];
+    json_size_t size = 1;
+    unsigned const mt = major << 5;
+    if (arg < 24) {
+        head[0] = char(mt | unsigned(arg));
+    } else {
+        int const bytes = (arg <= 0xFF) ? 1 : (arg <= 0xFFFF) ? 2 : (arg <= 0xFFFFFFFFULL) ? 4 : 8;
+        head[0] = char(mt | (1 == bytes ? 24 : 2 == bytes ? 25 : 4 == bytes ? 26 : 27));
+        for (int i = bytes - 1; i >= 0; --i, arg >>= 8)
+            head[1 + i] = char(arg & 0xFF);
+        size += bytes;
+    }
+    Writer_Put(w, head, size);
+}
+
+static void
+Writer_Escaped (json_writer_t * w, char c) {
+    char esc [6] = {'\\', c, 0, 0, 0, 0};
+    json_size_t size = 2;
+    switch (c) {
+    case '"': case '\\': break;
+    case '\b': esc[1] = 'b'; break;
+    case '\f': esc[1] = 'f'; break;
+    case '\n': esc[1] = 'n'; break;
+    case '\r': esc[1] = 'r'; break;
+    case '\t': esc[1] = 't'; break;
+    default:
+        esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+        esc[4] = "0123456789abcdef"[(c >> 4) & 0x0F];
+        esc[5] = "0123456789abcdef"[c & 0x0F];
+        size = 6;
+        break;
+    }
+    Writer_Put(w, esc, size);
+}
+
+static void
+Writer_String (json_writer_t * w, char const * str, json_size_t size) {
+    if (JSON_WSTYLE_CBOR == w->style) {
+        Writer_CBORHead(w, 3, size);
+        Writer_Put(w, str, size);
+        return;
+    }
+    Writer_Put(w, '"');
+    char const * p = str;
+    char const * const end = str + size;
+    while (p < end) {
+        char padded [64];
+        char const * block = p;
+        json_size_t const n = json_size_t(end - p < 64 ? end - p : 64);
+        if (n < 64) {
+            ::memset(padded, ' ', sizeof(padded));
+            ::memcpy(padded, p, n);
+            block = padded;
+        }
+        BlockMasks m;
+        classify_block(block, &m);
+        uint64_t special = (m.quote | m.backslash | m.control) & (n < 64 ? (uint64_t(1) << n) - 1 : ~uint64_t(0));
+        json_size_t run_begin = 0;
+        while (special) {
+            json_size_t const k = json_size_t(CountTrailingZeros64(special));
+            Writer_Put(w, p + run_begin, k - run_begin);
+            Writer_Escaped(w, p[k]);
+            run_begin = k + 1;
+            special &= special - 1;
+        }
+        Writer_Put(w, p + run_begin, n - run_begin);
+        p += n;
+    }
+    Writer_Put(w, '"');
+}
+
+//----------------------------------------------------------------------
+
+json_writer_t *
+JSON_WriterCreate (json_write_f sink, void * user_data, json_write_style_e style, int indent) {
+    json_writer_t * ret = nullptr;
+    if (sink && indent >= 0) {
+        ret = static_cast<json_writer_t *>(::calloc(1, sizeof(json_writer_t)));
+        if (ret) {
+            ret->sink = sink;
+            ret->user_data = user_data;
+            ret->style = style;
+            ret->indent = indent;
+        }
+    }
+    return ret;
+}
+
+bool
+JSON_WriterFinish (json_writer_t * writer) {
+    bool ret = false;
+    if (writer) {
+        if (writer->depth > 0)
+            writer->failed = true;
+        ret = Writer_Flush(writer);
+    }
+    return ret;
+}
+
+void
+JSON_WriterDestroy (json_writer_t * writer) {
+    ::free(writer);
+}
+
+bool
+JSON_WriteNull (json_writer_t * writer) {
+    bool ret = false;
+    if (writer && Writer_Separate(writer, false)) {
+        if (JSON_WSTYLE_CBOR == writer->style)
+            Writer_Put(writer, char(0xF6));
+        else
+            Writer_Put(writer, "null", 4);
+        Writer_ValueDone(writer);
+        ret = !writer->failed;
+    }
+    return ret;
+}
+
+bool
+JSON_WriteBool (json_writer_t * writer, bool value) {
+    bool ret = false;
+    if (writer && Writer_Separate(writer, false)) {
+        if (JSON_WSTYLE_CBOR == writer->style)
+            Writer_Put(writer, char(value ? 0xF5 : 0xF4));
+        else if (value)
+            Writer_Put(writer, "true", 4);
+        else
+            Writer_Put(writer, "false", 5);
+        Writer_ValueDone(writer);
+        ret = !writer->failed;
+    }
+    return ret;
+}
+
+bool
+JSON_WriteInt (json_writer_t * writer, long long value) {
+    bool ret = false;
+    if (writer && Writer_Separate(writer, false)) {
+        if (JSON_WSTYLE_CBOR == writer->style) {
+            if (value >= 0)
+                Writer_CBORHead(writer, 0, uint64_t(value));
+            else
+                Writer_CBORHead(writer, 1, ~uint64_t(value));  // -1 - value
+        } else {
+            char digits [24];
+            auto const res = std::to_chars(digits, digits + sizeof(digits), value);
+            Writer_Put(writer, digits, json_size_t(res.ptr - digits));
+        }
+        Writer_ValueDone(writer);
+        ret = !writer->failed;
+    }
+    return ret;
+}
+
+bool
+JSON_WriteReal (json_writer_t * writer, double value) {
+    bool ret = false;
+    if (writer && Writer_Separate(writer, false)) {
+        if (JSON_WSTYLE_CBOR == writer->style) {
+            char bytes [9];
+            json_size_t size = 0;
+            if (double(float(value)) == value || std::isnan(value)) {     // Fits in a single
+                float const f = float(value);
+                uint32_t bits;
+                ::memcpy(&bits, &f, sizeof(bits));
+                bytes[size++] = char(0xFA);
+                for (int i = 3; i >= 0; --i)
+                    bytes[size++] = char((bits >> (8 * i)) & 0xFF);
+            } else {
+                uint64_t bits;
+                ::memcpy(&bits, &value, sizeof(bits));
+                bytes[size++] = char(0xFB);
+                for (int i = 7; i >= 0; --i)
+                    bytes[size++] = char((bits >> (8 * i)) & 0xFF);
+            }
+            Writer_Put(writer, bytes, size);
+        } else if (std::isfinite(value)) {
+            char digits [40];
+            auto const res = std::to_chars(digits, digits + sizeof(digits) - 2, value);    // Shortest round-trip
+            char * end = res.ptr;
+            if (!::memchr(digits, '.', end - digits) && !::memchr(digits, 'e', end - digits)) {
+                *end++ = '.';   // So that it reads back as a real
+                *end++ = '0';
+            }
+            Writer_Put(writer, digits, json_size_t(end - digits));
+        } else {
+            Writer_Put(writer, "null", 4);
+        }
+        Writer_ValueDone(writer);
+        ret = !writer->failed;
+    }
+    return ret;
+}
+
+bool
+JSON_WriteString (json_writer_t * writer, char const * str, json_size_t size) {
+    bool ret = false;
+    if (writer && (str || 0 == size) && Writer_Separate(writer, false)) {
+        Writer_String(writer, str, size);
+        Writer_ValueDone(writer);
+        ret = !writer->failed;
+    }
+    return ret;
+}
+
+bool
+JSON_WriteName (json_writer_t * writer, char const * name, json_size_t size) {
+    bool ret = false;
+    if (writer && (name || 0 == size) && Writer_Separate(writer, true)) {
+        Writer_String(writer, name, size);
+        if (JSON_WSTYLE_Pretty == writer->style)
+            Writer_Put(writer, ": ", 2);
+        else if (JSON_WSTYLE_Compact == writer->style)
+            Writer_Put(writer, ':');
+        writer->after_name = true;
+        ret = !writer->failed;
+    }
+    return ret;
+}
+
+static bool
+Writer_Begin (json_writer_t * w, bool is_object) {
+    bool ret = false;
+    if (w && w->depth < Y_OPT_JSON_WRITER_MAX_DEPTH && Writer_Separate(w, false)) {
+        if (JSON_WSTYLE_CBOR == w->style)
+            Writer_Put(w, char(is_object ? 0xBF : 0x9F));  // Indefinite length, so we needn't know the count up front
+        else
+            Writer_Put(w, is_object ? '{' : '[');
+        Writer_SetBit(w->is_object, w->depth, is_object);
+        Writer_SetBit(w->has_items, w->depth, false);
+        w->depth += 1;
+        ret = !w->failed;
+    } else if (w) {
+        w->failed = true;
+    }
+    return ret;
+}
+
+static bool
+Writer_End (json_writer_t * w, bool is_object) {
+    bool ret = false;
+    if (w && !w->failed) {
+        if (w->depth > 0 && !w->after_name && is_object == Writer_GetBit(w->is_object, w->depth - 1)) {
+            w->depth -= 1;
+            if (JSON_WSTYLE_Pretty == w->style && Writer_GetBit(w->has_items, w->depth))
+                Writer_NewLine(w, w->depth);
+            if (JSON_WSTYLE_CBOR == w->style)
+                Writer_Put(w, char(0xFF));
+            else
+                Writer_Put(w, is_object ? '}' : ']');
+            Writer_ValueDone(w);
+            ret = !w->failed;
+        } else {
+            w->failed = true;
+        }
+    }
+    return ret;
+}
+
+bool JSON_WriteObjectBegin (json_writer_t * writer) {return Writer_Begin(writer, true);}
+bool JSON_WriteObjectEnd (json_writer_t * writer) {return Writer_End(writer, true);}
+bool JSON_WriteArrayBegin (json_writer_t * writer) {return Writer_Begin(writer, false);}
+bool JSON_WriteArrayEnd (json_writer_t * writer) {return Writer_End(writer, false);}
+
+//----------------------------------------------------------------------
+// Writing a parsed text document back out, through any writer (so, to
+//  re-indent it, or to turn it into CBOR.)
+
+struct Transcoder {
+    json_writer_t * writer;
+    json_error_f error_cb;
+    void * user_data;
+    bool failed;
+};
+
+static json_user_handle_t
+Transcoder_ElementCallback (
+    json_elem_type_e elem_type,
+    json_user_handle_t,
+    json_value_t value,
+    json_user_handle_t,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data
+) {
+    auto t = static_cast<Transcoder *>(user_data);
+    json_writer_t * w = t->writer;
+    bool ok = true;
+    switch (elem_type) {
+    case JSON_ETYPE_ObjectBegin: ok = JSON_WriteObjectBegin(w); break;
+    case JSON_ETYPE_ObjectEnd: ok = JSON_WriteObjectEnd(w); break;
+    case JSON_ETYPE_ArrayBegin: ok = JSON_WriteArrayBegin(w); break;
+    case JSON_ETYPE_ArrayEnd: ok = JSON_WriteArrayEnd(w); break;
+    case JSON_ETYPE_Name:
+    case JSON_ETYPE_Value:
+        switch (value.type) {
+        case JSON_VTYPE_Null: ok = JSON_WriteNull(w); break;
+        case JSON_VTYPE_Bool: ok = JSON_WriteBool(w, value.data.b); break;
+        case JSON_VTYPE_Int: ok = JSON_WriteInt(w, value.data.i); break;
+        case JSON_VTYPE_Real: ok = JSON_WriteReal(w, value.data.r); break;
+        case JSON_VTYPE_String:
+            ok = WithUnescaped(input->ptr + value.data.s.begin, value.data.s.end - value.data.s.begin, [&](char const * p, json_size_t size) {
+                return (JSON_ETYPE_Name == elem_type) ? JSON_WriteName(w, p, size) : JSON_WriteString(w, p, size);
+            });
+            break;
+        default: break;
+        }
+        break;
+    default: break;
+    }
+    if (!ok && !t->failed) {
+        t->failed = true;
+        t->error_cb(JSON_SEV_Fatal, JSON_ERR_BadParams, input, location, t->user_data, "The writer failed", 0, 0);
+    }
+    return nullptr;
+}
+
+static void
+Transcoder_ErrorCallback (
+    json_error_severity_e severity,
+    json_error_e error,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data,
+    char const * msg,
+    int param1,
+    int param2
+) {
+    auto t = static_cast<Transcoder *>(user_data);
+    t->failed = true;
+    t->error_cb(severity, error, input, location, t->user_data, msg, param1, param2);
+}
+
+bool
+JSON_WriteParsed (json_writer_t * writer, json_buffer_t input, json_error_f error_cb, void * user_data) {
+    bool ret = false;
+    if (writer && error_cb) {
+        Transcoder t {writer, error_cb, user_data, false};
+        JSON_Parse(input, Transcoder_ElementCallback, Transcoder_ErrorCallback, &t);
+        ret = !t.failed;
+    }
+    return ret;
+}
+
+//======================================================================
+// CBOR (RFC 8949) input: the same element events as text, from the binary
+//  encoding. The writer produces it (with JSON_WSTYLE_CBOR,) and this reads
+//  that and anything else that sticks to the JSON data model.
+
+static inline uint64_t
+cbor_read_be (char const * p, int bytes) {
+    uint64_t ret = 0;
+    for (int i = 0; i < bytes; ++i)
+        ret = (ret << 8) | static_cast<unsigned char>(p[i]);
+    return ret;
+}
+
+static inline void
+cbor_need (State * state, json_size_t bytes) {
+    if (state->in.size - state->loc.byte < bytes) {
+        state->loc.byte = state->in.size;
+        throw Exception{JSON_SEV_Error, JSON_ERR_IncompleteInput, state->loc, "Input ended inside a CBOR item", 0, 0};
+    }
+}
+
+// Reads an item head. An indefinite-length item has no argument (it's set to
+//  0,) so tell it apart by *out_indefinite (or its additional info, 31.)
+static inline unsigned
+cbor_read_head (State * state, uint64_t * out_arg, unsigned * out_info, bool * out_indefinite = nullptr) {
+    cbor_need(state, 1);
+    unsigned const initial = static_cast<unsigned char>(state->in.ptr[state->loc.byte]);
+    unsigned const info = initial & 0x1F;
+    state->loc.byte += 1;
+    if (out_indefinite)
+        *out_indefinite = false;
+    if (info < 24) {
+        *out_arg = info;
+    } else if (info < 28) {
+        int const bytes = 1 << (info - 24);
+        cbor_need(state, json_size_t(bytes));
+        *out_arg = cbor_read_be(state->in.ptr + state->loc.byte, bytes);
+        state->loc.byte += json_size_t(bytes);
+    } else if (31 == info && 0 != (initial >> 5) && 1 != (initial >> 5) && 6 != (initial >> 5)) {
+        *out_arg = 0;
+        if (out_indefinite)
+            *out_indefinite = true;
+    } else {
+        state->loc.byte -= 1;
+        throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, state->loc, "Malformed CBOR item head", int(initial), 0};
+    }
+    *out_info = info;
+    return initial >> 5;
+}
+
+static inline double
+cbor_half_to_double (unsigned half) {
+    int const exp = (half >> 10) & 0x1F;
+    double const mant = half & 0x3FF;
+    double const val = (0 == exp) ? std::ldexp(mant, -24) : (31 == exp) ? (0 == mant ? INFINITY : NAN) : std::ldexp(mant + 1024, exp - 25);
+    return (half & 0x8000) ? -val : val;
+}
+
+static inline bool
+cbor_at_break (State * state) {
+    cbor_need(state, 1);
+    bool const ret = (char(0xFF) == state->in.ptr[state->loc.byte]);
+    if (ret)
+        state->loc.byte += 1;
+    return ret;
+}
+
+static void
+parse_cbor_value (State * state);
+
+static void
+parse_cbor_container (State * state, bool is_object, uint64_t count, bool indefinite) {
+    // Every element takes at least a byte (and every member two,) so a count that can't fit is cut-off input.
+    if (!indefinite && count > (state->in.size - state->loc.byte) / (is_object ? 2 : 1)) {
+        state->loc.byte = state->in.size;
+        throw Exception{JSON_SEV_Error, JSON_ERR_IncompleteInput, state->loc, "Input ended inside a CBOR array or map", 0, 0};
+    }
+
+    auto old_parent = state->parent;
+    auto self = state->elem_cb(is_object ? JSON_ETYPE_ObjectBegin : JSON_ETYPE_ArrayBegin, nullptr, {}, state->parent, &state->in, &state->loc, state->user_data);
+    state->parent = self;
+    state->loc.depth += 1;
+
+    for (uint64_t i = 0; indefinite ? !cbor_at_break(state) : i < count; ++i) {
+        if (is_object) {
+            json_size_t const key_at = state->loc.byte;
+            uint64_t size;
+            unsigned info;
+            unsigned const major = cbor_read_head(state, &size, &info);
+            if (3 != major || 31 == info) {
+                state->loc.byte = key_at;
+                throw Exception{JSON_SEV_Error, JSON_ERR_Unsupported, state->loc, "Map keys must be (definite-length) text strings", int(major), 0};
+            }
+            if (size > state->in.size - state->loc.byte) {
+                state->loc.byte = state->in.size;
+                throw Exception{JSON_SEV_Error, JSON_ERR_IncompleteInput, state->loc, "Input ended inside a CBOR string", 0, 0};
+            }
+            json_value_t name;
+            name.type = JSON_VTYPE_String;
+            name.data.s = {state->loc.byte, json_size_t(state->loc.byte + size), json_size_t(size)};
+            state->loc.byte += json_size_t(size);
+            state->elem_cb(JSON_ETYPE_Name, nullptr, name, self, &state->in, &state->loc, state->user_data);
+        }
+        parse_cbor_value(state);
+    }
+
+    state->loc.depth -= 1;
+    state->parent = old_parent;
+    state->elem_cb(is_object ? JSON_ETYPE_ObjectEnd : JSON_ETYPE_ArrayEnd, self, {}, old_parent, &state->in, &state->loc, state->user_data);
+}
+
+static void
+parse_cbor_value (State * state) {
+    json_size_t const item_at = state->loc.byte;
+    uint64_t arg;
+    unsigned info;
+    bool indefinite;
+    unsigned major = cbor_read_head(state, &arg, &info, &indefinite);
+    while (6 == major)      // Tags are dropped; the tagged item is all that's left
+        major = cbor_read_head(state, &arg, &info, &indefinite);
+
+    json_value_t value = {};
+    switch (major) {
+    case 0:
+        if (arg <= uint64_t(INT64_MAX)) {
+            value.type = JSON_VTYPE_Int;
+            value.data.i = (long long)(arg);
+        } else {
+            value.type = JSON_VTYPE_Real;
+            value.data.r = double(arg);
+        }
+        break;
+    case 1:
+        if (arg <= uint64_t(INT64_MAX)) {
+            value.type = JSON_VTYPE_Int;
+            value.data.i = -1 - (long long)(arg);
+        } else {
+            value.type = JSON_VTYPE_Real;
+            value.data.r = -1.0 - double(arg);
+        }
+        break;
+    case 2:
+    case 3:
+        if (indefinite) {
+            state->loc.byte = item_at;
+            throw Exception{JSON_SEV_Error, JSON_ERR_Unsupported, state->loc, "Indefinite-length strings are not supported", 0, 0};
+        }
+        if (arg > state->in.size - state->loc.byte) {
+            state->loc.byte = state->in.size;
+            throw Exception{JSON_SEV_Error, JSON_ERR_IncompleteInput, state->loc, "Input ended inside a CBOR string", 0, 0};
+        }
+        value.type = JSON_VTYPE_String;
+        value.data.s = {state->loc.byte, json_size_t(state->loc.byte + arg), json_size_t(arg)};
+        state->loc.byte += json_size_t(arg);
+        break;
+    case 4:
+    case 5:
+        parse_cbor_container(state, 5 == major, arg, indefinite);
+        return;
+    default:    // 7
+        switch (info) {
+        case 20: case 21: value.type = JSON_VTYPE_Bool; value.data.b = (21 == info); break;
+        case 22: case 23: value.type = JSON_VTYPE_Null; break;  // null and undefined
+        case 25: value.type = JSON_VTYPE_Real; value.data.r = cbor_half_to_double(unsigned(arg)); break;
+        case 26: {
+            uint32_t const bits = uint32_t(arg);
+            float f;
+            ::memcpy(&f, &bits, sizeof(f));
+            value.type = JSON_VTYPE_Real;
+            value.data.r = f;
+        } break;
+        case 27:
+            value.type = JSON_VTYPE_Real;
+            ::memcpy(&value.data.r, &arg, sizeof(value.data.r));
+            break;
+        default:
+            state->loc.byte = item_at;
+            throw Exception{JSON_SEV_Error, JSON_ERR_Unsupported, state->loc, "CBOR simple value with no JSON equivalent (or a stray break)", int(info), 0};
+        }
+        break;
+    }
+    state->elem_cb(JSON_ETYPE_Value, nullptr, value, state->parent, &state->in, &state->loc, state->user_data);
+}
+
+json_size_t
+JSON_CBORParse (
+    json_buffer_t in,
+    json_element_f elem_cb,
+    json_error_f error_cb,
+    void * user_data
+) {
+    json_location_t loc {0, 0, 0, 0};
+    if (!error_cb) {
+        return 0;
+    }
+    if (!elem_cb || (!in.ptr && in.size > 0)) {
+        error_cb(JSON_SEV_Fatal, JSON_ERR_BadParams, &in, &loc, user_data, "The element callback and the input must be valid", 0, 0);
+        return 0;
+    }
+
+    State state;
+    state.in = in;
+    state.cur = -1;     // Unused
+    state.loc = loc;
+    state.line_scan_byte = 0;
+    state.line_start_byte = 0;
+    state.parent = nullptr;
+    state.cur_name = {};
+    state.elem_cb = elem_cb;
+    state.error_cb = error_cb;
+    state.user_data = user_data;
+
+    try {
+        parse_cbor_value(&state);
+    } catch (Exception & e) {
+        state.error_cb(e.severity, e.error, &state.in, &e.location, state.user_data, e.msg, e.param1, e.param2);
+    }
+
+    return state.loc.byte;
+}
+
+//======================================================================
+// Queries: the pointers are compiled into a trie (one node per distinct
+//  prefix,) and the input is walked with the trie in hand. Members and
+//  elements that no pointer goes through are skipped a 64-byte block at a
+//  time, only tracking strings and bracket depth, and without looking at
+//  the values.
+
+struct QueryNode {
+    json_size_t first_child;    // 0 if none (the root is never a child)
+    json_size_t next_sibling;
+    json_size_t token_begin;    // Unescaped, in json_query_t::chars
+    json_size_t token_size;
+    long long index;            // If the token is also an array index, or -1
+    json_size_t first_match;    // Pointer index + 1, or 0; duplicate pointers are chained through next_match
+};
+
+struct json_query_t {
+    json_size_t pointer_count;
+    json_size_t node_count;
+    QueryNode * nodes;
+    json_size_t * next_match;   // Per pointer; index + 1 of the next pointer that's the same as this one, or 0
+    char * chars;
+};
+
+static long long
+Query_TokenIndex (char const * token, json_size_t size) {
+    long long ret = -1;
+    if (size > 0 && size <= 18 && ('0' != token[0] || 1 == size)) {
+        ret = 0;
+        for (json_size_t i = 0; ret >= 0 && i < size; ++i)
+            ret = is_digit(token[i]) ? ret * 10 + (token[i] - '0') : -1;
+    }
+    return ret;
+}
+
+json_query_t *
+JSON_QueryCompile (char const * const * pointers, json_size_t pointer_count) {
+    json_query_t * ret = nullptr;
+    json_size_t max_nodes = 1, max_chars = 0;
+    bool valid = (pointers || 0 == pointer_count);
+    for (json_size_t i = 0; valid && i < pointer_count; ++i) {
+        valid = pointers[i] && ('\0' == pointers[i][0] || '/' == pointers[i][0]);
+        for (char const * p = valid ? pointers[i] : ""; *p; ++p) {
+            max_nodes += ('/' == *p);
+            max_chars += 1;
+        }
+    }
+    if (valid) {
+        size_t const bytes = sizeof(json_query_t) + max_nodes * sizeof(QueryNode) + pointer_count * sizeof(json_size_t) + max_chars;
+        ret = static_cast<json_query_t *>(::calloc(1, bytes));
+    }
+    if (ret) {
+        ret->pointer_count = pointer_count;
+        ret->nodes = reinterpret_cast<QueryNode *>(ret + 1);
+        ret->next_match = reinterpret_cast<json_size_t *>(ret->nodes + max_nodes);
+        ret->chars = reinterpret_cast<char *>(ret->next_match + pointer_count);
+        ret->nodes[0].index = -1;
+        ret->node_count = 1;
+        json_size_t chars_used = 0;
+        for (json_size_t i = 0; valid && i < pointer_count; ++i) {
+            json_size_t node = 0;
+            for (char const * p = pointers[i]; valid && *p; ) {
+                // Unescape the token ("~0" is '~' and "~1" is '/') into the spare room after the used chars
+                char * const token = ret->chars + chars_used;
+                json_size_t size = 0;
+                for (++p; valid && *p && '/' != *p; ++p) {
+                    if ('~' == *p) {
+                        valid = ('0' == p[1] || '1' == p[1]);
+                        token[size++] = ('1' == p[1]) ? '/' : '~';
+                        ++p;
+                    } else {
+                        token[size++] = *p;
+                    }
+                }
+                json_size_t child = ret->nodes[node].first_child;
+                while (child && !(ret->nodes[child].token_size == size && 0 == ::memcmp(ret->chars + ret->nodes[child].token_begin, token, size)))
+                    child = ret->nodes[child].next_sibling;
+                if (0 == child) {
+                    child = ret->node_count++;
+                    QueryNode & n = ret->nodes[child];
+                    n.token_begin = chars_used;
+                    n.token_size = size;
+                    n.index = Query_TokenIndex(token, size);
+                    n.next_sibling = ret->nodes[node].first_child;
+                    ret->nodes[node].first_child = child;
+                    chars_used += size;
+                }
+                node = child;
+            }
+            ret->next_match[i] = ret->nodes[node].first_match;
+            ret->nodes[node].first_match = i + 1;
+        }
+        if (!valid) {
+            ::free(ret);
+            ret = nullptr;
+        }
+    }
+    return ret;
+}
+
+void
+JSON_QueryDestroy (json_query_t * query) {
+    ::free(query);
+}
+
+struct QueryRun {
+    json_query_t const * query;
+    json_match_f match_cb;
+    void * user_data;
+    bool * matched;             // Per node, so only the first match of each pointer is reported
+    json_size_t remaining;      // Nodes with pointers that haven't matched yet
+    json_value_t captured;      // The scalar parse_value() just read
+};
+
+struct QueryDone {};            // Thrown when every pointer has matched; nothing else can
+
+static json_user_handle_t
+Query_CaptureValue (json_elem_type_e elem_type, json_user_handle_t, json_value_t value, json_user_handle_t, json_buffer_t const *, json_location_t const *, void * user_data) {
+    if (JSON_ETYPE_Value == elem_type)
+        static_cast<QueryRun *>(user_data)->captured = value;
+    return nullptr;
+}
+
+// Skips a whole array or object; strings inside are only checked for where they end.
+static void
+skip_container (State * state) {
+    char const * const in = state->in.ptr;
+    json_size_t pos = state->loc.byte;
+    uint64_t prev_ends_odd_backslash = 0;
+    uint64_t prev_in_string = 0;
+    int depth = 0;
+    while (pos < state->in.size) {
+        char tail [64];
+        char const * block = in + pos;
+        if (state->in.size - pos < 64) {
+            ::memset(tail, ' ', sizeof(tail));
+            ::memcpy(tail, in + pos, state->in.size - pos);
+            block = tail;
+        }
+        BlockMasks m;
+        classify_block(block, &m);
+        uint64_t const quotes = m.quote & ~find_escaped(m.backslash, &prev_ends_odd_backslash);
+        uint64_t const in_string = prefix_xor(quotes) ^ prev_in_string;
+        prev_in_string = uint64_t(int64_t(in_string) >> 63);
+        for (uint64_t brackets = m.op & ~in_string; brackets; brackets &= brackets - 1) {
+            unsigned const k = CountTrailingZeros64(brackets);
+            char const c = block[k] | 0x20;     // '[' -> '{', ']' -> '}'
+            if ('{' == c) {
+                depth += 1;
+            } else if ('}' == c && 0 == --depth) {
+                JumpTo(state, pos + k + 1);
+                return;
+            }
+        }
+        pos += 64;
+    }
+    JumpTo(state, state->in.size);
+    throw Exception{JSON_SEV_Error, JSON_ERR_IncompleteInput, state->loc, "Input ended inside an array or object", 0, 0};
+}
+
+static void
+skip_value (State * state) {
+    if ('{' == state->cur || '[' == state->cur) {
+        skip_container(state);
+    } else if ('"' == state->cur) {
+        read_str(state);
+    } else if (!eoi(state) && !is_scalar_delimiter(state->cur)) {
+        json_size_t pos = state->loc.byte;
+        while (pos < state->in.size && !is_scalar_delimiter(state->in.ptr[pos]))
+            ++pos;
+        JumpTo(state, pos);
+    } else {
+        throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedValue, state->loc, "a JSON value should start with one of these characters: 0123456789+-.{[\"ntf", state->cur, 0};
+    }
+}
+
+static json_size_t
+Query_FindMember (QueryRun const * run, json_size_t node, State const * state, json_substr_t const & name) {
+    char const * const raw = state->in.ptr + name.begin;
+    json_size_t const raw_size = name.end - name.begin;
+    auto find = [&](char const * p, json_size_t size) {
+        json_size_t child = run->query->nodes[node].first_child;
+        while (child && !(run->query->nodes[child].token_size == size && 0 == ::memcmp(run->query->chars + run->query->nodes[child].token_begin, p, size)))
+            child = run->query->nodes[child].next_sibling;
+        return child;
+    };
+    return ::memchr(raw, '\\', raw_size) ? WithUnescaped(raw, raw_size, find) : find(raw, raw_size);
+}
+
+static json_size_t
+Query_FindElement (QueryRun const * run, json_size_t node, long long index) {
+    json_size_t child = run->query->nodes[node].first_child;
+    while (child && run->query->nodes[child].index != index)
+        child = run->query->nodes[child].next_sibling;
+    return child;
+}
+
+static void
+query_value (QueryRun * run, State * state, json_size_t node);
+
+static void
+query_object (QueryRun * run, State * state, json_size_t node) {
+    expect(state, '{');
+    state->loc.depth += 1;
+    skip_ws(state);
+    while ('}' != state->cur) {
+        json_size_t const child = Query_FindMember(run, node, state, read_str(state));
+        skip_ws(state);
+        expect(state, ':');
+        skip_ws(state);
+        if (child)
+            query_value(run, state, child);
+        else
+            skip_value(state);
+        skip_ws(state);
+        if (',' != state->cur && '}' != state->cur)
+            throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedToken, state->loc, "Expected ',' or '}' in object", 0, 0};
+        if (',' == state->cur) {
+            consume(state);
+            skip_ws(state);
+        }
+    }
+    consume(state);
+    state->loc.depth -= 1;
+}
+
+static void
+query_array (QueryRun * run, State * state, json_size_t node) {
+    expect(state, '[');
+    state->loc.depth += 1;
+    skip_ws(state);
+    for (long long index = 0; ']' != state->cur; ++index) {
+        skip_ws(state);
+        json_size_t const child = Query_FindElement(run, node, index);
+        if (child)
+            query_value(run, state, child);
+        else
+            skip_value(state);
+        skip_ws(state);
+        if (',' != state->cur && ']' != state->cur)
+            throw Exception{JSON_SEV_Error, JSON_ERR_ExpectedToken, state->loc, "Expected ',' or ']' in array", 0, 0};
+        if (',' == state->cur)
+            consume(state);
+    }
+    consume(state);
+    state->loc.depth -= 1;
+}
+
+static void
+query_value (QueryRun * run, State * state, json_size_t node) {
+    QueryNode const & n = run->query->nodes[node];
+    bool const wanted = n.first_match && !run->matched[node];
+    json_size_t const begin = state->loc.byte;
+    json_value_t value = {};
+    if ('{' == state->cur) {
+        if (n.first_child)
+            query_object(run, state, node);
+        else
+            skip_container(state);
+        value.type = JSON_VTYPE_Object;
+    } else if ('[' == state->cur) {
+        if (n.first_child)
+            query_array(run, state, node);
+        else
+            skip_container(state);
+        value.type = JSON_VTYPE_Array;
+    } else if (wanted) {
+        parse_value(state);     // Calls Query_CaptureValue()
+        value = run->captured;
+    } else {
+        skip_value(state);
+    }
+    if (wanted) {
+        run->matched[node] = true;
+        SyncLineAndColumn(state);
+        json_substr_t const raw = {begin, state->loc.byte, state->loc.byte - begin};
+        for (json_size_t m = n.first_match; m; m = run->query->next_match[m - 1])
+            run->match_cb(m - 1, value, raw, &state->in, &state->loc, run->user_data);
+        if (0 == --run->remaining)
+            throw QueryDone{};
+    }
+}
+
+bool
+JSON_QueryRun (
+    json_query_t const * query,
+    json_buffer_t input,
+    json_match_f match_cb,
+    json_error_f error_cb,
+    void * user_data
+) {
+    bool ret = false;
+    if (query && match_cb && (input.ptr || 0 == input.size)) {
+        QueryRun run;
+        run.query = query;
+        run.match_cb = match_cb;
+        run.user_data = user_data;
+        run.matched = static_cast<bool *>(::calloc(query->node_count, sizeof(bool)));
+        run.remaining = 0;
+        for (json_size_t i = 0; i < query->node_count; ++i)
+            run.remaining += (query->nodes[i].first_match ? 1 : 0);
+        run.captured = {};
+
+        State state;
+        state.in = input;
+        state.cur = (input.size > 0 ? input.ptr[0] : -1);
+        state.loc = {0, 0, 1, 1};
+        state.line_scan_byte = 0;
+        state.line_start_byte = 0;
+        state.parent = nullptr;
+        state.cur_name = {};
+        state.elem_cb = Query_CaptureValue;
+        state.error_cb = error_cb;
+        state.user_data = &run;
+
+        if (run.matched && run.remaining > 0) {
+            try {
+                skip_ws(&state);
+                query_value(&run, &state, 0);
+                ret = true;
+            } catch (QueryDone &) {
+                ret = true;
+            } catch (Exception & e) {
+                if (error_cb) {
+                    CalcLineAndColumn(state.in, &e.location);
+                    error_cb(e.severity, e.error, &state.in, &e.location, user_data, e.msg, e.param1, e.param2);
+                }
+            }
+        } else {
+            ret = (nullptr != run.matched);
+        }
+        ::free(run.matched);
+    }
+    return ret;
+}
 
 #if 0
 #pragma once
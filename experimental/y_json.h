@@ -81,6 +81,11 @@ typedef enum {
     JSON_ERR_ExpectedToken,
     JSON_ERR_ExpectedValue,
     JSON_ERR_BadEscaping,   // invalid character after a backslash (inside a string)
+    JSON_ERR_ControlCharInString,   // unescaped character below 0x20 (inside a string)
+    JSON_ERR_TrailingContent,       // something other than whitespace after the value (NDJSON records only)
+    JSON_ERR_SchemaMismatch,        // the value doesn't fit the field it's bound to (binder only)
+    JSON_ERR_Unsupported,           // valid CBOR, but with no JSON equivalent (CBOR input only)
+    JSON_ERR_StreamTooLong,         // more than 4GiB - 1 bytes fed to a push parser
     //JSON_ERR_MissingEnclosingBrace, // pedantic
 } json_error_e;
 
@@ -105,6 +110,16 @@ typedef void (*json_error_f) (
     int param2
 );
 
+typedef enum {
+    JSON_ENGINE_Default = 0,            // Currently the recursive descent; it's as fast or faster on everything measured so far
+    JSON_ENGINE_RecursiveDescent,
+    JSON_ENGINE_StructuralIndex,        // Indexes the structural characters (with SIMD,) then walks the index without recursion
+} json_engine_e;
+
+typedef struct {
+    json_engine_e engine;
+} json_options_t;
+
 // This is a "SAX" style parser, for those old-enough to remember!
 // Takes the JSON it's supposed to parse, and returns the number of bytes
 //  that it consumed.
@@ -117,8 +132,306 @@ json_size_t JSON_Parse (
     void * user_data
 );
 
+// Same as above; options can be NULL (then it's exactly JSON_Parse.) All
+//  engines emit the same elements and report the same errors.
+json_size_t JSON_ParseEx (
+    json_buffer_t input,
+    json_options_t const * options,
+    json_element_f elem_cb,
+    json_error_f error_cb,
+    void * user_data
+);
+
+// The push parser, for input that arrives in chunks (e.g. from a socket.)
+//  It emits the same elements as JSON_Parse, as soon as each one is complete,
+//  and only keeps a copy of the token that straddles the last chunk boundary.
+//  The differences are that the json_buffer_t passed to the callbacks (and
+//  so the substrings) is only valid during the callback, that locations are
+//  offsets into the whole stream, and that a stream can have any number of
+//  top-level values, one after the other (with optional whitespace between.)
+// Since locations are json_size_t offsets, a stream can be at most 4GiB - 1
+//  bytes long; the chunk that would go past that is a JSON_ERR_StreamTooLong
+//  (fatal) error.
+// After an error (reported through the error callback,) JSON_PushFeed and
+//  JSON_PushFinish return false and the parser can only be destroyed.
+typedef struct json_push_parser_t json_push_parser_t;
+
+json_push_parser_t * JSON_PushCreate (
+    json_element_f elem_cb,
+    json_error_f error_cb,
+    void * user_data
+);
+void JSON_PushDestroy (json_push_parser_t * parser);
+// The chunk is not needed after this returns.
+bool JSON_PushFeed (json_push_parser_t * parser, json_buffer_t chunk);
+// Call at the end of the stream; reports unclosed arrays and objects, and empty streams.
+bool JSON_PushFinish (json_push_parser_t * parser);
+
+// A parsed document, kept as one array of compact nodes. Strings are NOT
+//  copied; they point into the input, which must outlive the document, and
+//  are unescaped when asked for. Nodes are numbered in document order, the
+//  root is node 0, and an object's children alternate between the name (a
+//  string node) and the value.
+typedef struct json_doc_t json_doc_t;
+typedef json_size_t json_node_t;
+#define JSON_NODE_INVALID   ((json_node_t)~0u)
+
+// Returns NULL on errors (which are reported to error_cb, if it's not NULL.)
+json_doc_t * JSON_DocParse (
+    json_buffer_t input,
+    json_options_t const * options,     // Can be NULL
+    json_error_f error_cb,
+    void * user_data
+);
+void JSON_DocDestroy (json_doc_t * doc);
+
+json_size_t JSON_DocNodeCount (json_doc_t const * doc);
+json_value_type_e JSON_DocType (json_doc_t const * doc, json_node_t node);
+// Number of elements in an array, or members in an object; zero for anything else.
+json_size_t JSON_DocCount (json_doc_t const * doc, json_node_t node);
+json_node_t JSON_DocFirstChild (json_doc_t const * doc, json_node_t node);
+// The child of container that comes after node, skipping over node's own children.
+json_node_t JSON_DocNext (json_doc_t const * doc, json_node_t node, json_node_t container);
+json_node_t JSON_DocAt (json_doc_t const * doc, json_node_t array, json_size_t index);  // Linear
+// Returns the value for the (unescaped) key. Objects with many members are hashed; smaller ones are searched.
+json_node_t JSON_DocFind (json_doc_t const * doc, json_node_t object, char const * key, json_size_t key_size);
+
+bool JSON_DocGetBool (json_doc_t const * doc, json_node_t node, bool * out_value);
+bool JSON_DocGetInt (json_doc_t const * doc, json_node_t node, long long * out_value);
+bool JSON_DocGetReal (json_doc_t const * doc, json_node_t node, double * out_value);   // Also takes ints
+// The string as it is in the input, still escaped. Its estimated_unescaped_size_bytes is a good buffer size for
+//  JSON_DocGetString (exact, unless there are \u escapes outside ASCII.)
+bool JSON_DocGetRawString (json_doc_t const * doc, json_node_t node, json_substr_t * out_str);
+// Unescapes into out (UTF-8, not NUL-terminated,) writing at most out_size bytes. Returns the full unescaped size.
+json_size_t JSON_DocGetString (json_doc_t const * doc, json_node_t node, char * out, json_size_t out_size);
+
+// NDJSON (one value per line) in parallel. Each non-blank line is parsed on
+//  its own and becomes a record; the records come back in input order. The
+//  element callback is called from several threads at once: each worker
+//  gets its own user data (worker_user_data[i], for i in [0, thread_count),
+//  or NULL if worker_user_data is NULL,) and substrings and locations are
+//  relative to the record. thread_count <= 0 means one per hardware thread;
+//  size worker_user_data with JSON_NDJSONThreadCount(thread_count) then.
+typedef struct {
+    unsigned long long offset;      // Of the record's first byte, in the whole input
+    json_size_t size;               // Not including the newline
+    json_user_handle_t root;        // What the element callback returned for the top-level element
+    json_error_e error;             // JSON_ERR_INVALID (zero) if the record is fine; only the first error is kept
+    json_location_t error_location; // In the record
+} json_ndjson_record_t;
+
+typedef struct {
+    json_ndjson_record_t * records;
+    unsigned long long record_count;
+    unsigned long long error_count;
+} json_ndjson_result_t;
+
+// How many workers the NDJSON parsers use for this thread_count (i.e. itself, if it's positive.)
+int JSON_NDJSONThreadCount (int thread_count);
+// These return false only if they couldn't do the job at all (unreadable file, out of memory.)
+bool JSON_NDJSONParseMemory (
+    char const * data,
+    unsigned long long size,
+    json_options_t const * options,     // Can be NULL
+    int thread_count,
+    json_element_f elem_cb,             // Can be NULL, to just validate
+    void * const * worker_user_data,
+    json_ndjson_result_t * out_result
+);
+// Memory-maps the file.
+bool JSON_NDJSONParseFile (
+    char const * path,
+    json_options_t const * options,
+    int thread_count,
+    json_element_f elem_cb,
+    void * const * worker_user_data,
+    json_ndjson_result_t * out_result
+);
+void JSON_NDJSONFreeResult (json_ndjson_result_t * result);
+
+// The binder: parses an object straight into a struct, described by a
+//  table of fields. A field whose size is a multiple of its element's size
+//  is a fixed-size array (strings are char arrays, and can't be arrayed.)
+//  Members that aren't in the table are skipped, as are fields that aren't
+//  in the JSON (so initialize the struct first.) Names are compared after
+//  unescaping, and case-sensitively.
+typedef enum {
+    JSON_FTYPE_INVALID = 0,
+    JSON_FTYPE_Bool,        // bool
+    JSON_FTYPE_I32,         // int32_t
+    JSON_FTYPE_I64,         // int64_t
+    JSON_FTYPE_F32,         // float; also takes integers
+    JSON_FTYPE_F64,         // double; also takes integers
+    JSON_FTYPE_Str,         // char [size]; always NUL-terminated, and truncated if needed (which is reported)
+    JSON_FTYPE_Struct,      // Another struct, described by "schema"
+} json_field_type_e;
+
+typedef struct json_schema_t json_schema_t;
+
+typedef struct {
+    json_field_type_e type;
+    json_size_t offset;
+    json_size_t size;
+    char const * name;
+    json_schema_t const * schema;   // Only for JSON_FTYPE_Struct
+} json_field_t;
+
+// Precomputes the name lookup. The field table (and the names) must outlive the schema. Returns NULL if a field
+//  doesn't make sense (e.g. it's outside the struct.)
+json_schema_t * JSON_SchemaCreate (json_field_t const * fields, json_size_t field_count, json_size_t struct_size);
+void JSON_SchemaDestroy (json_schema_t * schema);
+
+// Returns false if there were any errors; values that don't match their field (JSON_ERR_SchemaMismatch) are
+//  reported and skipped, and parsing goes on.
+bool JSON_Bind (
+    json_buffer_t input,
+    json_schema_t const * schema,
+    void * out,
+    json_error_f error_cb,      // Can be NULL
+    void * user_data
+);
+
+// The writer: a streaming serializer, with no tree and no intermediate
+//  strings. Output goes to the sink in pieces of up to a few KB. Calls must
+//  form valid JSON (e.g. a name before each member value, matched ends;)
+//  anything else (or a sink that returns false) fails the writer, and all
+//  later calls return false. Several top-level values are written one per
+//  line, which makes NDJSON. Reals are written in their shortest round-trip
+//  form (NaN and infinities become null,) and strings are escaped as needed
+//  but otherwise copied as is, so they should be UTF-8.
+typedef struct json_writer_t json_writer_t;
+
+typedef bool (*json_write_f) (char const * data, json_size_t size, void * user_data);
+
+typedef enum {
+    JSON_WSTYLE_Compact = 0,
+    JSON_WSTYLE_Pretty,     // A member/element per line, indented
+    JSON_WSTYLE_CBOR,       // Binary; see JSON_CBORParse(). Arrays and objects are indefinite-length.
+} json_write_style_e;
+
+json_writer_t * JSON_WriterCreate (json_write_f sink, void * user_data, json_write_style_e style, int indent);
+// Hands the rest of the output to the sink; false if anything went wrong, or arrays or objects are still open.
+bool JSON_WriterFinish (json_writer_t * writer);
+void JSON_WriterDestroy (json_writer_t * writer);
+
+bool JSON_WriteNull (json_writer_t * writer);
+bool JSON_WriteBool (json_writer_t * writer, bool value);
+bool JSON_WriteInt (json_writer_t * writer, long long value);
+bool JSON_WriteReal (json_writer_t * writer, double value);
+bool JSON_WriteString (json_writer_t * writer, char const * str, json_size_t size);
+bool JSON_WriteName (json_writer_t * writer, char const * name, json_size_t size);
+bool JSON_WriteObjectBegin (json_writer_t * writer);
+bool JSON_WriteObjectEnd (json_writer_t * writer);
+bool JSON_WriteArrayBegin (json_writer_t * writer);
+bool JSON_WriteArrayEnd (json_writer_t * writer);
+// Parses a text document and writes it out through the writer (which can be of any style;) false on errors.
+bool JSON_WriteParsed (json_writer_t * writer, json_buffer_t input, json_error_f error_cb, void * user_data);
+
+// Binary input: CBOR (RFC 8949,) reported through the same callbacks as
+//  JSON_Parse(), so the same consumer works for both. The differences:
+//  strings point at raw UTF-8 (there's no escaping, so nothing needs to be
+//  unescaped, and they might contain '"' or '\\' as is,) byte strings are
+//  reported as strings too, tags are ignored, and lines and columns are
+//  always zero. Map keys have to be text strings, and strings can't be
+//  indefinite-length (JSON_ERR_Unsupported.) Returns how much was consumed
+//  (i.e. one top-level item.)
+json_size_t JSON_CBORParse (
+    json_buffer_t input,
+    json_element_f elem_cb,
+    json_error_f error_cb,
+    void * user_data
+);
+
+// Queries: pulls the values at a set of JSON pointers (RFC 6901, e.g.
+//  "/a/b/0/c"; "" is the whole document) out of a document, without a DOM.
+//  Only the paths leading to the pointers are parsed; everything else is
+//  skipped by counting brackets and finding string ends, so it's only
+//  loosely validated. Each pointer is reported once, at its first match,
+//  and the run stops as soon as every pointer has matched. Matches come in
+//  document order of where the values end (so a pointer into an array or
+//  object is reported before the container itself.)
+typedef struct json_query_t json_query_t;
+
+// value has the parsed scalar (same as the element callback would get;) for arrays and objects only the type is set.
+//  raw is the whole value's text, in every case.
+typedef void (*json_match_f) (
+    json_size_t pointer_index,
+    json_value_t value,
+    json_substr_t raw,
+    json_buffer_t const * input,
+    json_location_t const * location,
+    void * user_data
+);
+
+// Returns NULL if a pointer is malformed. The pointers aren't needed after this returns.
+json_query_t * JSON_QueryCompile (char const * const * pointers, json_size_t pointer_count);
+void JSON_QueryDestroy (json_query_t * query);
+// Returns false on errors (which are reported through error_cb;) pointers that aren't in the input are not errors.
+bool JSON_QueryRun (
+    json_query_t const * query,
+    json_buffer_t input,
+    json_match_f match_cb,
+    json_error_f error_cb,              // Can be NULL
+    void * user_data
+);
+
 #if defined(__cplusplus)
 }   // extern "C"
 #endif
 
+#if defined(__cplusplus)
+#include <string.h>     // memcpy()
+#include <type_traits>  // std::void_t
+#include <utility>      // std::declval()
+
+// Sinks for the writer: for output functors in the style of y::fmt (called
+//  with a char, or with a whole run if they have a "write(char const *,
+//  size_t)" member; either returns false to stop,) for a MemWriter (or
+//  anything with "ptr" and "end",) which is filled from "ptr", and for a
+//  Buffer (or anything with "end" and "cap",) which is appended to. The
+//  memory ones fail when they run out of room. Pass the object itself as
+//  user data.
+template <typename OutF, typename = void>
+struct JSON_HasWrite : std::false_type {};
+template <typename OutF>
+struct JSON_HasWrite<OutF, std::void_t<decltype(std::declval<OutF &>().write((char const *)nullptr, size_t(0)))>> : std::true_type {};
+
+template <typename OutF>
+bool JSON_SinkToFunctor (char const * data, json_size_t size, void * user_data) {
+    OutF & out = *static_cast<OutF *>(user_data);
+    bool ret = true;
+    if constexpr (JSON_HasWrite<OutF>::value) {
+        ret = bool(out.write(data, size));
+    } else {
+        for (json_size_t i = 0; ret && i < size; ++i)
+            ret = bool(out(data[i]));
+    }
+    return ret;
+}
+
+template <typename MemWriterT>
+bool JSON_SinkToMemWriter (char const * data, json_size_t size, void * user_data) {
+    MemWriterT & mw = *static_cast<MemWriterT *>(user_data);
+    bool ret = false;
+    if (size <= size_t(mw.end - mw.ptr)) {
+        ::memcpy(mw.ptr, data, size);
+        mw.ptr += size;
+        ret = true;
+    }
+    return ret;
+}
+
+template <typename BufferT>
+bool JSON_SinkToBuffer (char const * data, json_size_t size, void * user_data) {
+    BufferT & buf = *static_cast<BufferT *>(user_data);
+    bool ret = false;
+    if (size <= size_t(buf.cap - buf.end)) {
+        ::memcpy(buf.end, data, size);
+        buf.end += size;
+        ret = true;
+    }
+    return ret;
+}
+#endif
+
 #endif  // Y_JSON_H_INCLUDE_GUARD_
@@ -0,0 +1,572 @@
+#pragma once
+
+//======================================================================
+// An asynchronous logger. The logging thread only copies the format string
+//  pointer, a timestamp and the raw bytes of the arguments into its own
+//  SPSC ring (see Lockfree::SPSCRing;) a background thread formats the
+//  records with y::fmt and writes them out in large batches, to stderr or
+//  to a file that is rotated when it gets too big.
+//
+//      y::Log::Config config;
+//      config.path = "server.log";
+//      y::Log::Start(config);
+//      y::Log::Info("accepted {} from {}", conn_id, peer_name);
+//      ...
+//      y::Log::Stop();     // Drains every ring, then flushes and closes
+//
+// The format string must outlive the logger (i.e. be a literal;) strings
+//  passed as arguments (char pointers and arrays, std::string and
+//  std::string_view) are copied, everything else must be trivially copyable
+//  and is copied byte for byte.
+//======================================================================
+
+#if !defined(Y_OPT_LOG_BATCH_SIZE)
+#define Y_OPT_LOG_BATCH_SIZE        (64 * 1024)
+#endif
+#if !defined(Y_OPT_LOG_MAX_NEW_THREADS)
+#define Y_OPT_LOG_MAX_NEW_THREADS   256     // Threads that can start logging between two passes of the background thread
+#endif
+
+//======================================================================
+
+#include <y_format.hpp>
+#include <y_lockfree.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+//======================================================================
+
+namespace y {
+    namespace Log {
+
+//======================================================================
+
+enum class Level : uint8_t {
+    Trace = 0,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Fatal,
+};
+
+// What a logging thread does when its ring is full.
+enum class FullPolicy : uint8_t {
+    Drop,   // The message is counted and dropped; a "dropped" line shows up later
+    Block,  // Wait (yielding) for the background thread to make room
+};
+
+struct Config {
+    std::string path;                       // Empty means stderr
+    uint64_t max_file_size = 64 << 20;      // Rotate once the file gets this big; 0 means never
+    unsigned max_files = 4;                 // On rotation, "path" -> "path.1" -> ... -> "path.<max_files>"
+    unsigned ring_size = 1 << 20;           // Bytes per logging thread (fixed when it first logs); a power of two, at least 128
+    FullPolicy when_full = FullPolicy::Drop;
+    Level min_level = Level::Info;
+    unsigned idle_wait_ms = 1;              // How long the background thread sleeps when there's nothing to do
+};
+
+//======================================================================
+
+        namespace detail {
+
+//----------------------------------------------------------------------
+// Output batching and file rotation; only used by the background thread.
+
+class Writer {
+public:
+    bool Open (Config const & config) {
+        m_path = config.path;
+        m_max_file_size = config.max_file_size;
+        m_max_files = config.max_files;
+        m_used = 0;
+        if (!m_buffer)
+            m_buffer.reset(new char [Y_OPT_LOG_BATCH_SIZE]);
+        if (m_path.empty()) {
+            m_file = stderr;
+            m_owns_file = false;
+            m_file_size = 0;
+            return true;
+        }
+        return OpenFile();
+    }
+
+    void Close () {
+        Flush();
+        if (m_owns_file && m_file)
+            ::fclose(m_file);
+        m_file = nullptr;
+    }
+
+    void Put (char c) {
+        if (m_used == Y_OPT_LOG_BATCH_SIZE)
+            Flush();
+        m_buffer[m_used++] = c;
+    }
+
+    void Append (char const * str, size_t size) {
+        if (size > Y_OPT_LOG_BATCH_SIZE - m_used) {
+            Flush();
+            if (size >= Y_OPT_LOG_BATCH_SIZE) {
+                WriteOut(str, size);
+                return;
+            }
+        }
+        ::memcpy(m_buffer.get() + m_used, str, size);
+        m_used += size;
+    }
+
+    void Flush () {
+        if (m_used > 0)
+            WriteOut(m_buffer.get(), m_used);
+        m_used = 0;
+    }
+
+    // Called between records, so a rotation never splits a line.
+    void AfterRecord () {
+        if (m_owns_file && m_max_file_size > 0 && m_file_size + m_used >= m_max_file_size) {
+            Flush();
+            Rotate();
+        }
+    }
+
+private:
+    bool OpenFile () {
+        m_file = ::fopen(m_path.c_str(), "ab");
+        if (!m_file)
+            return false;
+        ::setvbuf(m_file, nullptr, _IONBF, 0);  // We do our own batching
+        ::fseek(m_file, 0, SEEK_END);
+        long const pos = ::ftell(m_file);
+        m_file_size = (pos > 0) ? uint64_t(pos) : 0;
+        m_owns_file = true;
+        return true;
+    }
+
+    void Rotate () {
+        ::fclose(m_file);
+        m_file = nullptr;
+        if (m_max_files > 0) {
+            ::remove((m_path + "." + std::to_string(m_max_files)).c_str());
+            for (unsigned i = m_max_files - 1; i > 0; --i)
+                ::rename((m_path + "." + std::to_string(i)).c_str(), (m_path + "." + std::to_string(i + 1)).c_str());
+            ::rename(m_path.c_str(), (m_path + ".1").c_str());
+        } else {
+            ::remove(m_path.c_str());
+        }
+        OpenFile();
+    }
+
+    void WriteOut (char const * str, size_t size) {
+        if (m_file) {
+            ::fwrite(str, 1, size, m_file);
+            m_file_size += size;
+        }
+    }
+
+private:
+    std::unique_ptr<char []> m_buffer;
+    size_t m_used = 0;
+    FILE * m_file = nullptr;
+    bool m_owns_file = false;
+    uint64_t m_file_size = 0;
+    std::string m_path;
+    uint64_t m_max_file_size = 0;
+    unsigned m_max_files = 0;
+};
+
+// Lets y::fmt write straight into the batch.
+struct WriterSink {
+    Writer & writer;
+
+    bool operator () (char c) {writer.Put(c); return true;}
+    bool write (char const * str, size_t n) {writer.Append(str, n); return true;}
+};
+
+//----------------------------------------------------------------------
+// How arguments travel through the ring: strings as a u32 length and the
+//  characters, anything else as its raw bytes.
+
+template <typename T>
+using Decayed = std::remove_cv_t<std::decay_t<T>>;
+
+template <typename T>
+inline constexpr bool IsStrV =
+    std::is_same_v<Decayed<T>, char *> || std::is_same_v<Decayed<T>, char const *> ||
+    std::is_same_v<Decayed<T>, std::string> || std::is_same_v<Decayed<T>, std::string_view>;
+
+template <typename T>
+using StoredT = std::conditional_t<IsStrV<T>, std::string_view, Decayed<T>>;
+
+inline std::string_view AsStr (char const * s) {return s ? std::string_view{s} : std::string_view{};}
+inline std::string_view AsStr (std::string const & s) {return s;}
+inline std::string_view AsStr (std::string_view s) {return s;}
+
+template <typename T>
+size_t PackedSize (T const & v) {
+    if constexpr (IsStrV<T>) {
+        return sizeof(uint32_t) + AsStr(v).size();
+    } else {
+        static_assert(std::is_trivially_copyable_v<StoredT<T>> && std::is_default_constructible_v<StoredT<T>>,
+            "Log arguments (other than strings) are copied byte for byte to the background thread.");
+        return sizeof(StoredT<T>);
+    }
+}
+
+template <typename T>
+char * PackArg (char * p, T const & v) {
+    if constexpr (IsStrV<T>) {
+        std::string_view const s = AsStr(v);
+        uint32_t const n = uint32_t(s.size());
+        ::memcpy(p, &n, sizeof(n));
+        ::memcpy(p + sizeof(n), s.data(), n);
+        return p + sizeof(n) + n;
+    } else {
+        StoredT<T> const x = v;
+        ::memcpy(p, &x, sizeof(x));
+        return p + sizeof(x);
+    }
+}
+
+template <typename S>
+S UnpackArg (char const * & p) {
+    if constexpr (std::is_same_v<S, std::string_view>) {
+        uint32_t n;
+        ::memcpy(&n, p, sizeof(n));
+        std::string_view const ret {p + sizeof(n), n};
+        p += sizeof(n) + n;
+        return ret;
+    } else {
+        S ret;
+        ::memcpy(&ret, p, sizeof(ret));
+        p += sizeof(ret);
+        return ret;
+    }
+}
+
+using FormatFunc = void (*) (Writer & out, char const * fmt, char const * args);
+
+// One of these per distinct list of argument types; the braced init
+//  unpacks the arguments in order.
+template <typename ... Stored>
+void FormatRecord (Writer & out, char const * fmt, char const * args) {
+    (void)args;
+    std::tuple<Stored...> const values {UnpackArg<Stored>(args)...};
+    std::apply([&](auto const & ... v) {
+        y::fmt::detail::Do(
+            [](auto, auto &&, auto &&){return false;},
+            WriterSink{out},
+            y::fmt::detail::FmtStr{fmt, fmt + ::strlen(fmt)},
+            v...
+        );
+    }, values);
+}
+
+struct RecordHeader {
+    FormatFunc format;
+    char const * fmt;
+    int64_t time_us;    // Since the Unix epoch
+    Level level;
+};
+
+//----------------------------------------------------------------------
+
+struct ThreadRing {
+    std::unique_ptr<uint64_t []> memory;
+    Lockfree::SPSCRing ring;
+    std::atomic<uint64_t> dropped {0};
+    std::atomic<bool> orphaned {false};     // The thread has exited; free once drained
+
+    explicit ThreadRing (unsigned size)
+        : memory (new uint64_t [size / sizeof(uint64_t)])
+        , ring (memory.get(), size)
+    {}
+};
+
+struct RingHolder {
+    ThreadRing * ring = nullptr;
+
+    ~RingHolder () {
+        if (ring)
+            ring->orphaned.store(true, std::memory_order_release);
+    }
+};
+
+inline thread_local RingHolder t_ring;
+
+//----------------------------------------------------------------------
+
+// "YYYY-MM-DD HH:MM:SS.uuuuuu" in UTC (no locale, no locks.)
+inline void PutTimestamp (Writer & out, int64_t time_us) {
+    int64_t secs = time_us / 1'000'000;
+    int64_t us = time_us % 1'000'000;
+    if (us < 0) {us += 1'000'000; secs -= 1;}
+    int64_t days = secs / 86400;
+    int64_t sod = secs % 86400;
+    if (sod < 0) {sod += 86400; days -= 1;}
+
+    // Days to civil date; see Howard Hinnant's "chrono-Compatible Low-Level Date Algorithms"
+    days += 719468;
+    int64_t const era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned const doe = unsigned(days - era * 146097);
+    unsigned const yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned const doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned const mp = (5 * doy + 2) / 153;
+    unsigned const d = doy - (153 * mp + 2) / 5 + 1;
+    unsigned const m = (mp < 10) ? mp + 3 : mp - 9;
+    int64_t const y = int64_t(yoe) + era * 400 + (m <= 2);
+
+    char buffer [26];
+    auto put = [&] (unsigned pos, uint64_t v, unsigned digits) {
+        for (unsigned i = digits; i > 0; --i, v /= 10)
+            buffer[pos + i - 1] = char('0' + v % 10);
+    };
+    put(0, uint64_t(y), 4); buffer[4] = '-';
+    put(5, m, 2); buffer[7] = '-';
+    put(8, d, 2); buffer[10] = ' ';
+    put(11, uint64_t(sod / 3600), 2); buffer[13] = ':';
+    put(14, uint64_t(sod / 60 % 60), 2); buffer[16] = ':';
+    put(17, uint64_t(sod % 60), 2); buffer[19] = '.';
+    put(20, uint64_t(us), 6);
+    out.Append(buffer, sizeof(buffer));
+}
+
+inline char const * LevelTag (Level level) {
+    switch (level) {
+    case Level::Trace: return " TRACE ";
+    case Level::Debug: return " DEBUG ";
+    case Level::Info: return " INFO  ";
+    case Level::Warning: return " WARN  ";
+    case Level::Error: return " ERROR ";
+    case Level::Fatal: return " FATAL ";
+    }
+    return " ????? ";
+}
+
+inline int64_t NowMicros () {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+//----------------------------------------------------------------------
+
+class Logger {
+public:
+    static Logger & Instance () {
+        static Logger s_instance;
+        return s_instance;
+    }
+
+    ~Logger () {
+        Stop();
+        for (auto ring : m_rings)
+            if (ring->orphaned.load(std::memory_order_acquire))
+                delete ring;
+    }
+
+    // A ring has to hold at least one record with no arguments (see Write().)
+    static constexpr unsigned MinRingSize = 2 * unsigned(sizeof(RecordHeader) + 16);
+
+    bool Start (Config const & config) {
+        unsigned const ring_size = config.ring_size;
+        if (ring_size < MinRingSize || (ring_size & (ring_size - 1)) != 0)
+            return false;
+        if (m_running.load(std::memory_order_acquire) || !m_writer.Open(config))
+            return false;
+        m_ring_size = config.ring_size;
+        m_when_full = config.when_full;
+        m_idle_wait_ms = config.idle_wait_ms;
+        m_min_level.store(config.min_level, std::memory_order_relaxed);
+        m_running.store(true, std::memory_order_release);
+        m_thread = std::thread([this]{Run();});
+        return true;
+    }
+
+    void Stop () {
+        if (!m_running.exchange(false, std::memory_order_acq_rel))
+            return;
+        {
+            std::lock_guard<std::mutex> lock (m_idle_mutex);
+            m_idle_cv.notify_one();
+        }
+        m_thread.join();
+        // Whatever was committed (or whichever ring was handed over) while the
+        //  background thread was on its way out.
+        while (auto ring = m_new_rings.get())
+            m_rings.push_back(*ring);
+        while (DrainRings() > 0)
+            ;
+        m_writer.Close();
+    }
+
+    bool Running () const {return m_running.load(std::memory_order_acquire);}
+    bool Enabled (Level level) const {return level >= m_min_level.load(std::memory_order_relaxed) && Running();}
+    void SetLevel (Level level) {m_min_level.store(level, std::memory_order_relaxed);}
+    FullPolicy WhenFull () const {return m_when_full;}
+    uint64_t Dropped () const {return m_dropped.load(std::memory_order_relaxed);}
+
+    // Null if the logger is stopped before the new ring could be handed over.
+    ThreadRing * RingForThisThread () {
+        if (!t_ring.ring) {
+            auto ring = new ThreadRing (m_ring_size);
+            while (!m_new_rings.put(ring)) {
+                if (!Running()) {
+                    delete ring;
+                    return nullptr;
+                }
+                std::this_thread::yield();
+            }
+            t_ring.ring = ring;
+        }
+        return t_ring.ring;
+    }
+
+private:
+    Logger () = default;
+
+    void Run () {
+        for (;;) {
+            bool const stopping = !m_running.load(std::memory_order_acquire);
+            while (auto ring = m_new_rings.get())
+                m_rings.push_back(*ring);
+            if (0 == DrainRings()) {
+                m_writer.Flush();
+                if (stopping)
+                    break;
+                std::unique_lock<std::mutex> lock (m_idle_mutex);
+                if (m_running.load(std::memory_order_acquire))
+                    m_idle_cv.wait_for(lock, std::chrono::milliseconds(m_idle_wait_ms));
+            }
+        }
+    }
+
+    // Takes a bounded number of records from each ring per pass, to be fair.
+    size_t DrainRings () {
+        size_t ret = 0;
+        for (size_t i = 0; i < m_rings.size(); ) {
+            ThreadRing * ring = m_rings[i];
+            bool const orphaned = ring->orphaned.load(std::memory_order_acquire);
+            unsigned size;
+            size_t count = 0;
+            for (void const * rec; count < 4096 && (rec = ring->ring.peek(size)); ++count) {
+                FormatOne(static_cast<char const *>(rec));
+                ring->ring.release();
+            }
+            if (auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+                m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+                PutTimestamp(m_writer, NowMicros());
+                m_writer.Append(LevelTag(Level::Warning), 7);
+                char msg [80];
+                auto len = y::fmt::ToCStr(msg, sizeof(msg), "[{} messages dropped; the ring was full]\n", dropped);
+                m_writer.Append(msg, len - 1);
+                m_writer.AfterRecord();
+            }
+            ret += count;
+            if (orphaned && 0 == count && ring->ring.empty()) {
+                delete ring;
+                m_rings[i] = m_rings.back();
+                m_rings.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        return ret;
+    }
+
+    void FormatOne (char const * rec) {
+        RecordHeader header;
+        ::memcpy(&header, rec, sizeof(header));
+        PutTimestamp(m_writer, header.time_us);
+        m_writer.Append(LevelTag(header.level), 7);
+        header.format(m_writer, header.fmt, rec + sizeof(header));
+        m_writer.Put('\n');
+        m_writer.AfterRecord();
+    }
+
+private:
+    std::atomic<bool> m_running {false};
+    std::atomic<Level> m_min_level {Level::Info};
+    std::atomic<uint64_t> m_dropped {0};
+    unsigned m_ring_size = 1 << 20;
+    FullPolicy m_when_full = FullPolicy::Drop;
+    unsigned m_idle_wait_ms = 1;
+    std::thread m_thread;
+    std::mutex m_idle_mutex;                // Only so Stop() can wake the background thread up
+    std::condition_variable m_idle_cv;
+    Writer m_writer;
+    std::vector<ThreadRing *> m_rings;      // Only touched by the background thread (or after it's joined)
+    ThreadRing * m_new_ring_slots [Y_OPT_LOG_MAX_NEW_THREADS];
+    Lockfree::Queue<ThreadRing *> m_new_rings {m_new_ring_slots, Y_OPT_LOG_MAX_NEW_THREADS};
+};
+
+//----------------------------------------------------------------------
+
+        }   // namespace detail
+
+//======================================================================
+
+inline bool Start (Config const & config) {return detail::Logger::Instance().Start(config);}
+inline void Stop () {detail::Logger::Instance().Stop();}
+inline void SetLevel (Level level) {detail::Logger::Instance().SetLevel(level);}
+// Messages dropped so far (as far as the background thread has seen.)
+inline uint64_t DroppedCount () {return detail::Logger::Instance().Dropped();}
+
+// Returns false if the message was filtered out or dropped.
+template <typename ... ArgTypes>
+bool Write (Level level, char const * fmt, ArgTypes && ... args) {
+    auto & logger = detail::Logger::Instance();
+    if (!logger.Enabled(level))
+        return false;
+    detail::ThreadRing * ring = logger.RingForThisThread();
+    if (!ring)
+        return false;
+    size_t const size = sizeof(detail::RecordHeader) + (size_t(0) + ... + detail::PackedSize(args));
+    void * mem;
+    while (!(mem = ring->ring.reserve(unsigned(size)))) {
+        bool const never_fits = size + 16 > ring->ring.capacity() / 2;
+        if (FullPolicy::Drop == logger.WhenFull() || never_fits || !logger.Running()) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    detail::RecordHeader const header {&detail::FormatRecord<detail::StoredT<ArgTypes>...>, fmt, detail::NowMicros(), level};
+    char * p = static_cast<char *>(mem);
+    ::memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    ((p = detail::PackArg(p, args)), ...);
+    (void)p;
+    ring->ring.commit();
+    return true;
+}
+
+template <typename ... ArgTypes>
+bool Trace (char const * fmt, ArgTypes && ... args) {return Write(Level::Trace, fmt, std::forward<ArgTypes>(args)...);}
+template <typename ... ArgTypes>
+bool Debug (char const * fmt, ArgTypes && ... args) {return Write(Level::Debug, fmt, std::forward<ArgTypes>(args)...);}
+template <typename ... ArgTypes>
+bool Info (char const * fmt, ArgTypes && ... args) {return Write(Level::Info, fmt, std::forward<ArgTypes>(args)...);}
+template <typename ... ArgTypes>
+bool Warning (char const * fmt, ArgTypes && ... args) {return Write(Level::Warning, fmt, std::forward<ArgTypes>(args)...);}
+template <typename ... ArgTypes>
+bool Error (char const * fmt, ArgTypes && ... args) {return Write(Level::Error, fmt, std::forward<ArgTypes>(args)...);}
+template <typename ... ArgTypes>
+bool Fatal (char const * fmt, ArgTypes && ... args) {return Write(Level::Fatal, fmt, std::forward<ArgTypes>(args)...);}
+
+//======================================================================
+
+    }   // namespace Log
+}   // namespace y
@@ -2,3 +2,302 @@
 #include "../experimental/y_bignum.hpp"
 #include "catch.hpp"
 
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+struct Num {
+    y_bignum_num_t n = {};
+    explicit Num (int size) {y_bignum_realloc(&n, size, true);}
+    ~Num () {y_bignum_free(&n);}
+    Num (Num const &) = delete;
+    Num & operator = (Num const &) = delete;
+};
+
+std::vector<y_bignum_dig_t> Digits (Num const & num) {
+    return {num.n.digs, num.n.digs + num.n.size};
+}
+
+// Runs f() with the given thresholds, then puts the defaults back
+template <typename F>
+void WithThresholds (int karatsuba, int toom3, F && f) {
+    int const old_karatsuba = y_bignum_karatsuba_threshold;
+    int const old_toom3 = y_bignum_toom3_threshold;
+    y_bignum_karatsuba_threshold = karatsuba;
+    y_bignum_toom3_threshold = toom3;
+    f();
+    y_bignum_karatsuba_threshold = old_karatsuba;
+    y_bignum_toom3_threshold = old_toom3;
+}
+}
+
+TEST_CASE("Multiplying all-ones numbers", "[bignum]") {
+    // (B^n - 1)^2 = B^2n - 2 B^n + 1
+    for (int n : {1, 2, 3, 7, 16, 31, 32, 33, 64, 99, 127, 128, 129, 255, 300, 457, 1000}) {
+        Num a (n), r (2 * n);
+        for (int i = 0; i < n; ++i)
+            a.n.digs[i] = ~y_bignum_dig_t(0);
+        REQUIRE(y_bignum_mul(&r.n, &a.n, &a.n));
+
+        std::vector<y_bignum_dig_t> expected (2 * n, ~y_bignum_dig_t(0));
+        expected[0] = 1;
+        for (int i = 1; i < n; ++i)
+            expected[i] = 0;
+        expected[n] -= 1;
+        INFO("n = " << n);
+        CHECK(Digits(r) == expected);
+    }
+}
+
+TEST_CASE("Karatsuba and Toom-3 agree with schoolbook multiplication", "[bignum]") {
+    std::mt19937 rng (49);
+    for (int round = 0; round < 60; ++round) {
+        int const an = 1 + int(rng() % 700);
+        int const bn = (round % 3 == 0) ? 1 + int(rng() % an) : an - int(rng() % (an / 4 + 1));
+        Num a (an), b (bn), fast (an + bn + 3), slow (an + bn + 3);
+        for (int i = 0; i < an; ++i)
+            a.n.digs[i] = (round % 5 == 0) ? ~y_bignum_dig_t(0) : y_bignum_dig_t(rng());
+        for (int i = 0; i < bn; ++i)
+            b.n.digs[i] = y_bignum_dig_t(rng());
+        b.n.negative = (round % 2 == 1);
+
+        WithThresholds(4, 9, [&] {     // As much Karatsuba and Toom-3 as possible
+            Num scratch (y_bignum_mul_scratch_size(an, bn));
+            REQUIRE(y_bignum_mul_with_scratch(&fast.n, &a.n, &b.n, &scratch.n));
+        });
+        WithThresholds(1 << 30, 1 << 30, [&] {
+            REQUIRE(y_bignum_mul_scratch_size(an, bn) == 0);
+            REQUIRE(y_bignum_mul_with_scratch(&slow.n, &a.n, &b.n, nullptr));
+        });
+        INFO("an = " << an << ", bn = " << bn);
+        CHECK(Digits(fast) == Digits(slow));
+        CHECK(fast.n.negative == b.n.negative);
+
+        Num def (an + bn);
+        REQUIRE(y_bignum_mul(&def.n, &b.n, &a.n));
+        CHECK(std::vector<y_bignum_dig_t>(def.n.digs, def.n.digs + an + bn) ==
+            std::vector<y_bignum_dig_t>(slow.n.digs, slow.n.digs + an + bn));
+    }
+}
+
+TEST_CASE("Multiplication edge cases", "[bignum]") {
+    Num a (4), b (3), r (7), small (5);
+    a.n.digs[0] = 123;
+    a.n.digs[1] = 1;
+    b.n.digs[0] = 2;
+    b.n.negative = true;
+
+    // Leading zero digits don't count towards the room needed
+    REQUIRE(y_bignum_mul(&small.n, &a.n, &b.n));
+    CHECK(small.n.digs[0] == 246);
+    CHECK(small.n.digs[1] == 2);
+    CHECK(small.n.digs[2] == 0);
+    CHECK(small.n.negative);
+
+    Num tiny (2);
+    CHECK_FALSE(y_bignum_mul(&tiny.n, &a.n, &b.n));
+    CHECK_FALSE(y_bignum_mul(&a.n, &a.n, &b.n));
+
+    // Zero is never negative
+    Num zero (2);
+    r.n.digs[5] = 77;
+    REQUIRE(y_bignum_mul(&r.n, &zero.n, &b.n));
+    CHECK(Digits(r) == std::vector<y_bignum_dig_t>(7, 0));
+    CHECK_FALSE(r.n.negative);
+}
+
+namespace {
+// Digits that bring out the edge cases of quotient digit estimation
+y_bignum_dig_t SkewedDigit (std::mt19937 & rng) {
+    switch (rng() % 6) {
+    case 0: return 0;
+    case 1: return ~y_bignum_dig_t(0);
+    case 2: return y_bignum_dig_t(1) << 31;
+    case 3: return 1;
+    default: return y_bignum_dig_t(rng());
+    }
+}
+
+int SignificantDigits (Num const & num) {
+    int n = num.n.size;
+    while (n > 0 && 0 == num.n.digs[n - 1])
+        n -= 1;
+    return n;
+}
+
+unsigned long long ModOfDigits (Num const & num, unsigned long long m) {
+    unsigned long long ret = 0;
+    for (int i = num.n.size - 1; i >= 0; --i)
+        ret = ((ret << 32) | num.n.digs[i]) % m;
+    return ret;
+}
+
+unsigned long long NaivePowMod (unsigned long long g, Num const & e, unsigned long long m) {
+    unsigned long long ret = 1 % m;
+    for (int i = 32 * e.n.size - 1; i >= 0; --i) {
+        ret = ret * ret % m;
+        if ((e.n.digs[i / 32] >> (i % 32)) & 1)
+            ret = ret * g % m;
+    }
+    return ret;
+}
+}
+
+TEST_CASE("Division gives back the quotient and remainder it was built from", "[bignum]") {
+    std::mt19937 rng (50);
+    for (int round = 0; round < 300; ++round) {
+        int const bn = 1 + int(rng() % ((round % 4 == 0) ? 3 : 80));
+        int const qn = 1 + int(rng() % 80);
+        Num b (bn), q (qn), r (bn), a (qn + bn + 1);
+        for (int i = 0; i < bn; ++i)
+            b.n.digs[i] = SkewedDigit(rng);
+        if (0 == b.n.digs[bn - 1])
+            b.n.digs[bn - 1] = 1 + (rng() & 0xFF);
+        for (int i = 0; i < qn; ++i)
+            q.n.digs[i] = SkewedDigit(rng);
+        for (int i = 0; i < bn; ++i)    // r < b
+            r.n.digs[i] = (i == bn - 1) ? b.n.digs[i] - 1 : SkewedDigit(rng);
+
+        Num qb (qn + bn);
+        REQUIRE(y_bignum_mul(&qb.n, &q.n, &b.n));
+        REQUIRE(y_bignum_add_unsigned(&a.n, &qb.n, &r.n));
+
+        Num quot (qn + 1), rem (bn);
+        Num scratch (y_bignum_divmod_scratch_size(a.n.size, b.n.size));
+        REQUIRE(y_bignum_divmod_with_scratch(&quot.n, &rem.n, &a.n, &b.n, &scratch.n));
+        INFO("round " << round << ": qn = " << qn << ", bn = " << bn);
+        CHECK(std::vector<y_bignum_dig_t>(quot.n.digs, quot.n.digs + qn) == Digits(q));
+        CHECK(quot.n.digs[qn] == 0);
+        CHECK(Digits(rem) == Digits(r));
+    }
+}
+
+TEST_CASE("Division signs, sizes and zero", "[bignum]") {
+    Num a (3), b (2), q (3), r (2);
+    a.n.digs[0] = 7;
+    a.n.negative = true;
+    b.n.digs[0] = 2;
+    REQUIRE(y_bignum_div(&q.n, &a.n, &b.n));
+    REQUIRE(y_bignum_mod(&r.n, &a.n, &b.n));
+    CHECK(q.n.digs[0] == 3);
+    CHECK(q.n.negative);
+    CHECK(r.n.digs[0] == 1);
+    CHECK(r.n.negative);
+
+    b.n.digs[0] = 8;
+    REQUIRE(y_bignum_div(&q.n, &a.n, &b.n));
+    CHECK(Digits(q) == std::vector<y_bignum_dig_t>(3, 0));
+    CHECK_FALSE(q.n.negative);
+
+    Num zero (2), one_digit (1);
+    CHECK_FALSE(y_bignum_div(&q.n, &a.n, &zero.n));
+    a.n.digs[2] = 1;
+    CHECK_FALSE(y_bignum_div(&one_digit.n, &a.n, &b.n));     // The quotient needs 3 digits
+    CHECK(y_bignum_mod(&one_digit.n, &a.n, &b.n));
+    CHECK_FALSE(y_bignum_div(&a.n, &a.n, &b.n));
+}
+
+TEST_CASE("Modular exponentiation", "[bignum]") {
+    std::mt19937 rng (65537);
+
+    SECTION("Single-digit moduli, odd and even") {
+        for (int round = 0; round < 200; ++round) {
+            Num g (1 + rng() % 6), e (1 + rng() % 3), m (1), r (1);
+            for (int i = 0; i < g.n.size; ++i)
+                g.n.digs[i] = SkewedDigit(rng);
+            for (int i = 0; i < e.n.size; ++i)
+                e.n.digs[i] = y_bignum_dig_t(rng());
+            m.n.digs[0] = (round < 10) ? y_bignum_dig_t(round + 1) : y_bignum_dig_t(rng() | 2);
+            REQUIRE(y_bignum_powmod(&r.n, &g.n, &e.n, &m.n));
+            INFO("round " << round << ", m = " << m.n.digs[0]);
+            CHECK(r.n.digs[0] == NaivePowMod(ModOfDigits(g, m.n.digs[0]), e, m.n.digs[0]));
+        }
+    }
+
+    SECTION("Fermat's little theorem on Mersenne primes") {
+        for (int p : {127, 521, 1279}) {
+            int const n = (p + 31) / 32;
+            Num m (n), e (n), g (n), r (n);
+            for (int i = 0; i < n; ++i)
+                m.n.digs[i] = (i < n - 1) ? ~y_bignum_dig_t(0) : (y_bignum_dig_t(1) << (p % 32)) - 1;
+            for (int i = 0; i < n; ++i)
+                e.n.digs[i] = m.n.digs[i];
+            e.n.digs[0] -= 1;       // p - 1
+            for (int round = 0; round < 5; ++round) {
+                for (int i = 0; i < n - 1; ++i)
+                    g.n.digs[i] = y_bignum_dig_t(rng());
+                Num scratch (y_bignum_powmod_scratch_size(g.n.size, e.n.size, m.n.size));
+                REQUIRE(y_bignum_powmod_with_scratch(&r.n, &g.n, &e.n, &m.n, &scratch.n));
+                CHECK(r.n.digs[0] == 1);
+                CHECK(SignificantDigits(r) == 1);
+            }
+        }
+    }
+
+    SECTION("Even moduli agree with odd ones") {
+        // (g^e mod 2m) mod m == g^e mod m; only the odd one is done in Montgomery form
+        for (int round = 0; round < 20; ++round) {
+            int const n = 1 + int(rng() % 40);
+            Num g (n + 3), e (1 + rng() % 8), m (n), m2 (n + 1), r (n), r2 (n + 1), rr (n);
+            for (int i = 0; i < g.n.size; ++i)
+                g.n.digs[i] = SkewedDigit(rng);
+            for (int i = 0; i < e.n.size; ++i)
+                e.n.digs[i] = y_bignum_dig_t(rng());
+            for (int i = 0; i < n; ++i)
+                m.n.digs[i] = SkewedDigit(rng);
+            m.n.digs[0] |= 1;
+            m.n.digs[n - 1] |= 1;
+            REQUIRE(y_bignum_add_unsigned(&m2.n, &m.n, &m.n));
+            REQUIRE(y_bignum_powmod(&r.n, &g.n, &e.n, &m.n));
+            REQUIRE(y_bignum_powmod(&r2.n, &g.n, &e.n, &m2.n));
+            REQUIRE(y_bignum_mod(&rr.n, &r2.n, &m.n));
+            INFO("round " << round << ", n = " << n);
+            CHECK(Digits(r) == Digits(rr));
+        }
+    }
+
+    SECTION("Signs and small cases") {
+        Num g (1), e (1), m (1), r (1);
+        g.n.digs[0] = 2;
+        g.n.negative = true;
+        e.n.digs[0] = 3;
+        m.n.digs[0] = 7;
+        REQUIRE(y_bignum_powmod(&r.n, &g.n, &e.n, &m.n));
+        CHECK(r.n.digs[0] == 6);                // -8 mod 7
+        CHECK_FALSE(r.n.negative);
+        e.n.digs[0] = 0;
+        REQUIRE(y_bignum_powmod(&r.n, &g.n, &e.n, &m.n));
+        CHECK(r.n.digs[0] == 1);
+        m.n.digs[0] = 1;
+        REQUIRE(y_bignum_powmod(&r.n, &g.n, &e.n, &m.n));
+        CHECK(r.n.digs[0] == 0);
+        m.n.digs[0] = 0;
+        CHECK_FALSE(y_bignum_powmod(&r.n, &g.n, &e.n, &m.n));
+    }
+}
+
+TEST_CASE("Exponentiation without a modulus", "[bignum]") {
+    Num a (2), b (1), r (20), expected (20);
+    a.n.digs[0] = 0x89AB'CDEF;
+    a.n.digs[1] = 0x1234;
+    b.n.digs[0] = 11;
+    REQUIRE(y_bignum_pow(&r.n, &a.n, &b.n));
+
+    Num x (20), y (20);
+    x.n.digs[0] = 1;
+    for (int i = 0; i < 11; ++i) {
+        REQUIRE(y_bignum_mul(&y.n, &x.n, &a.n));
+        std::swap(x.n, y.n);
+    }
+    CHECK(Digits(r) == Digits(x));
+
+    Num small (3);     // Room for as many bits as a has, times b
+    CHECK_FALSE(y_bignum_pow(&small.n, &a.n, &b.n));
+    a.n.digs[1] = 0;
+    a.n.digs[0] = 3;
+    b.n.digs[0] = 40;
+    REQUIRE(y_bignum_pow(&small.n, &a.n, &b.n));
+    CHECK(small.n.digs[0] == y_bignum_dig_t(12157665459056928801ULL));
+    CHECK(small.n.digs[1] == y_bignum_dig_t(12157665459056928801ULL >> 32));
+}
@@ -0,0 +1,337 @@
+
+#include "../experimental/y_ecs.hpp"
+#include "catch.hpp"
+
+#include <atomic>
+#include <cstring>
+
+namespace ex = y::Ex;
+
+namespace {
+
+struct TestPos : ex::ComponentBase<TestPos> {
+    static char const * GetComponentName () {return "TestPos";}
+    float x, y;
+};
+
+struct TestVel : ex::ComponentBase<TestVel> {
+    static char const * GetComponentName () {return "TestVel";}
+    float x, y;
+};
+
+struct TestHp : ex::ComponentBase<TestHp> {
+    static char const * GetComponentName () {return "TestHp";}
+    int hp;
+};
+
+// Component types register themselves globally, so all the test cases share one type manager.
+ex::TypeManager const * TestTypes () {
+    static ex::TypeManager tm;
+    static bool const ok =
+        ex::TypeManager_Create(&tm) &&
+        ex::ComponentType_Register<TestPos>(&tm) &&
+        ex::ComponentType_Register<TestVel>(&tm) &&
+        ex::ComponentType_Register<TestHp>(&tm) &&
+        ex::ComponentType_CloseRegisteration(&tm) &&
+        ex::TagType_CloseRegisteration(&tm) &&
+        ex::EntityType_Register(&tm, "Mover", 0, {"TestPos", "TestVel"}, {}) &&
+        ex::EntityType_Register(&tm, "Static", 0, {"TestPos"}, {}) &&
+        ex::EntityType_Register(&tm, "Living", 0, {"TestHp"}, {}) &&
+        ex::EntityType_CloseRegisteration(&tm);
+    return ok ? &tm : nullptr;
+}
+
+ex::SizeType TypeIndex (ex::World const * world, char const * name) {
+    for (ex::SizeType i = 0; i < world->entity_type_count; ++i)
+        if (0 == ::strcmp(world->entity_type_names[i], name))
+            return i;
+    return ex::InvalidIndex;
+}
+
+template <typename... Ts>
+ex::ComponentBitSet Components () {return ex::ComponentTypePack<Ts...>::GetBitSet();}
+
+using MoveParams = ex::QueryParams<
+    ex::ComponentTypePack<TestPos>,
+    ex::ComponentTypePack<TestVel>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::TagTypePack<>,
+    ex::TagTypePack<>
+>;
+using PosWriteParams = ex::QueryParams<
+    ex::ComponentTypePack<TestPos>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::TagTypePack<>,
+    ex::TagTypePack<>
+>;
+using PosReadParams = ex::QueryParams<
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<TestPos>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::TagTypePack<>,
+    ex::TagTypePack<>
+>;
+using HpWriteParams = ex::QueryParams<
+    ex::ComponentTypePack<TestHp>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::TagTypePack<>,
+    ex::TagTypePack<>
+>;
+using HpPosReadParams = ex::QueryParams<
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<TestHp, TestPos>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::ComponentTypePack<>,
+    ex::TagTypePack<>,
+    ex::TagTypePack<>
+>;
+
+void NoopSystem (ex::World *, ex::JobPool *, void *) {}
+
+}   // namespace
+
+TEST_CASE("ECS Scheduler Waves", "[ecs]") {
+    REQUIRE(TestTypes());
+    ex::World world;
+    REQUIRE(ex::World_Create(&world, TestTypes(), 4096));
+
+    ex::Query<MoveParams> move;
+    ex::Query<PosReadParams> pos_read;
+    ex::Query<HpWriteParams> hp_write;
+    REQUIRE(ex::Query_Create(&move, &world));
+    REQUIRE(ex::Query_Create(&pos_read, &world));
+    REQUIRE(ex::Query_Create(&hp_write, &world));
+
+    ex::Scheduler scheduler;
+    REQUIRE(ex::Scheduler_Create(&scheduler, &world, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&scheduler, "Move", &move, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&scheduler, "Hp", &hp_write, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&scheduler, "Read positions", &pos_read, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&scheduler, "Move again", &move, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_Build(&scheduler));
+
+    CHECK(ex::System_ConflictsWith(scheduler.systems + 0, scheduler.systems + 2));
+    CHECK_FALSE(ex::System_ConflictsWith(scheduler.systems + 0, scheduler.systems + 1));
+    CHECK_FALSE(ex::System_ConflictsWith(scheduler.systems + 1, scheduler.systems + 2));
+
+    REQUIRE(scheduler.wave_count == 3);
+    CHECK(scheduler.systems[0].wave == 0);
+    CHECK(scheduler.systems[1].wave == 0);     // Doesn't touch any entity type that "Move" does
+    CHECK(scheduler.systems[2].wave == 1);     // Reads what "Move" writes
+    CHECK(scheduler.systems[3].wave == 2);     // Writes what "Read positions" reads
+    CHECK(scheduler.wave_offsets[0] == 0);
+    CHECK(scheduler.wave_offsets[1] == 2);
+    CHECK(scheduler.wave_offsets[2] == 3);
+    CHECK(scheduler.wave_offsets[3] == 4);
+    CHECK(ex::Scheduler_Run(&scheduler));
+
+    // Writing distinct components of the same entity types doesn't conflict either.
+    ex::Scheduler other;
+    REQUIRE(ex::Scheduler_Create(&other, &world, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&other, "Vel", ex::ComponentBitSet{}, Components<TestVel>(), move.entity_types_set, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&other, "Pos", ex::ComponentBitSet{}, Components<TestPos>(), move.entity_types_set, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_Build(&other));
+    CHECK(other.wave_count == 1);
+
+    ex::Scheduler_Destroy(&other);
+    ex::Scheduler_Destroy(&scheduler);
+    ex::World_Destroy(&world);
+}
+
+TEST_CASE("ECS Scheduler Sees New Entity Types", "[ecs]") {
+    REQUIRE(TestTypes());
+    ex::World world;
+    REQUIRE(ex::World_Create(&world, TestTypes(), 4096));
+
+    ex::Query<HpWriteParams> hp_write;
+    ex::Query<HpPosReadParams> hp_pos_read;
+    REQUIRE(ex::Query_Create(&hp_write, &world));
+    REQUIRE(ex::Query_Create(&hp_pos_read, &world));
+    CHECK(hp_pos_read.entity_type_count == 0);
+
+    ex::Scheduler scheduler;
+    REQUIRE(ex::Scheduler_Create(&scheduler, &world, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&scheduler, "Hp", &hp_write, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_AddSystem(&scheduler, "Read hp and positions", &hp_pos_read, NoopSystem, nullptr));
+    REQUIRE(ex::Scheduler_Run(&scheduler));
+    CHECK(scheduler.wave_count == 1);
+
+    // Both systems match this one, so they now conflict.
+    ex::SizeType index = 0;
+    REQUIRE(ex::World_AddEntityType(&world, &index, "Living mover", Components<TestHp, TestPos>(), ex::TagBitSet{}));
+    REQUIRE(ex::Scheduler_Run(&scheduler));
+    CHECK(scheduler.wave_count == 2);
+    CHECK(scheduler.systems[1].wave == 1);
+    CHECK(y::BitSet_GetBit(scheduler.systems[0].entity_types.bits, index));
+    CHECK(y::BitSet_GetBit(scheduler.systems[1].entity_types.bits, index));
+
+    ex::Scheduler_Destroy(&scheduler);
+    ex::World_Destroy(&world);
+}
+
+TEST_CASE("ECS Query Cache Invalidation", "[ecs]") {
+    REQUIRE(TestTypes());
+    ex::World world;
+    REQUIRE(ex::World_Create(&world, TestTypes(), 4096));
+
+    ex::Query<PosReadParams> query;
+    REQUIRE(ex::Query_Create(&query, &world));
+    CHECK(query.entity_type_count == 2);
+    CHECK(y::BitSet_GetBit(query.entity_types_set.bits, TypeIndex(&world, "Mover")));
+    CHECK(y::BitSet_GetBit(query.entity_types_set.bits, TypeIndex(&world, "Static")));
+    CHECK_FALSE(y::BitSet_GetBit(query.entity_types_set.bits, TypeIndex(&world, "Living")));
+
+    ex::SizeType unrelated = 0, matching = 0;
+    REQUIRE(ex::World_AddEntityType(&world, &unrelated, "Only velocity", Components<TestVel>(), ex::TagBitSet{}));
+    REQUIRE(ex::Query_Create(&query, &world));
+    CHECK(query.entity_type_count == 2);
+
+    REQUIRE(ex::World_AddEntityType(&world, &matching, "Living static", Components<TestPos, TestHp>(), ex::TagBitSet{}));
+    REQUIRE(ex::Query_Create(&query, &world));
+    CHECK(query.entity_type_count == 3);
+    CHECK(y::BitSet_GetBit(query.entity_types_set.bits, matching));
+    CHECK_FALSE(y::BitSet_GetBit(query.entity_types_set.bits, unrelated));
+
+    // Same components and tags as an existing type
+    CHECK_FALSE(ex::World_AddEntityType(&world, nullptr, "Duplicate", Components<TestPos>(), ex::TagBitSet{}));
+
+    ex::World_Destroy(&world);
+}
+
+TEST_CASE("ECS Query ForEachParallel", "[ecs]") {
+    REQUIRE(TestTypes());
+    ex::World world;
+    REQUIRE(ex::World_Create(&world, TestTypes(), 1024));     // Small pages, so there are many chunks
+    ex::JobPool * pool = nullptr;
+    REQUIRE(ex::JobPool_Create(&pool, 3));
+
+    ex::SizeType const movers = 10'007, statics = 5'003, living = 100;
+    REQUIRE(ex::World_SpawnEntities(&world, TypeIndex(&world, "Mover"), movers, nullptr));
+    REQUIRE(ex::World_SpawnEntities(&world, TypeIndex(&world, "Static"), statics, nullptr));
+    REQUIRE(ex::World_SpawnEntities(&world, TypeIndex(&world, "Living"), living, nullptr));
+
+    ex::Query<PosWriteParams> query;
+    REQUIRE(ex::Query_Create(&query, &world));
+
+    std::atomic<ex::SizeType> visited {0};
+    std::atomic<ex::SizeType> chunks {0};
+    for (int pass = 0; pass < 3; ++pass) {
+        REQUIRE(ex::Query_ForEachParallel(&query, pool, [&](ex::QueryChunk<PosWriteParams> const & chunk, unsigned worker_index) {
+            CHECK(worker_index <= ex::JobPool_ThreadCount(pool));
+            TestPos * pos = std::get<0>(chunk.arrays.fullaccess);
+            for (ex::SizeType i = 0; i < chunk.count; ++i)
+                pos[i].x += 1.0f;
+            visited += chunk.count;
+            chunks += 1;
+        }));
+    }
+    CHECK(visited == 3 * (movers + statics));
+    CHECK(chunks > 3 * 2);
+
+    // Every entity was touched exactly once per pass.
+    ex::SizeType wrong = 0;
+    REQUIRE(ex::Query_ForEachParallel(&query, nullptr, [&](ex::QueryChunk<PosWriteParams> const & chunk, unsigned /*worker_index*/) {
+        TestPos const * pos = std::get<0>(chunk.arrays.fullaccess);
+        for (ex::SizeType i = 0; i < chunk.count; ++i)
+            wrong += (pos[i].x != 3.0f);
+    }));
+    CHECK(wrong == 0);
+
+    ex::JobPool_Destroy(pool);
+    ex::World_Destroy(&world);
+}
+
+TEST_CASE("ECS Stale Entity IDs", "[ecs]") {
+    REQUIRE(TestTypes());
+    ex::World world;
+    REQUIRE(ex::World_Create(&world, TestTypes(), 4096));
+    ex::SizeType const statics = TypeIndex(&world, "Static");
+
+    ex::EntityID old_id;
+    REQUIRE(ex::World_SpawnEntities(&world, statics, 1, &old_id));
+    CHECK(ex::World_IsAlive(&world, old_id));
+    REQUIRE(ex::World_DespawnEntities(&world, &old_id, 1));
+    CHECK_FALSE(ex::World_IsAlive(&world, old_id));
+    CHECK_FALSE(ex::World_DespawnEntities(&world, &old_id, 1));
+
+    // The record gets reused, but with a new generation.
+    ex::EntityID new_id;
+    REQUIRE(ex::World_SpawnEntities(&world, statics, 1, &new_id));
+    CHECK(new_id.index == old_id.index);
+    CHECK(new_id.generation != old_id.generation);
+    CHECK(ex::World_IsAlive(&world, new_id));
+    CHECK_FALSE(ex::World_IsAlive(&world, old_id));
+
+    ex::SizeType type_index = ex::InvalidIndex, slot = ex::InvalidIndex;
+    CHECK_FALSE(ex::World_GetEntityLocation(&world, old_id, &type_index, &slot));
+    CHECK_FALSE(ex::World_MoveEntities(&world, &old_id, 1, TypeIndex(&world, "Mover")));
+    REQUIRE(ex::World_GetEntityLocation(&world, new_id, &type_index, &slot));
+    CHECK(type_index == statics);
+    CHECK(slot == 0);
+
+    ex::World_Destroy(&world);
+}
+
+TEST_CASE("ECS World Apply", "[ecs]") {
+    REQUIRE(TestTypes());
+    ex::World world;
+    REQUIRE(ex::World_Create(&world, TestTypes(), 4096));
+    ex::JobPool * pool = nullptr;
+    REQUIRE(ex::JobPool_Create(&pool, 2));
+    ex::SizeType const movers = TypeIndex(&world, "Mover");
+    ex::SizeType const statics = TypeIndex(&world, "Static");
+
+    ex::CommandQueue queue;
+    REQUIRE(ex::CommandQueue_Create(&queue, pool));
+    REQUIRE(queue.buffer_count == 3);
+    CHECK(ex::CommandQueue_GetBuffer(&queue, 3) == nullptr);
+
+    // Nothing recorded at all
+    CHECK(ex::World_Apply(&world, &queue));
+    CHECK(world.total_entity_count == 0);
+
+    // Only the last buffer has anything; the others have never allocated.
+    ex::EntityID ids [10];
+    REQUIRE(ex::CommandBuffer_Spawn(ex::CommandQueue_GetBuffer(&queue, 2), statics, 10, ids));
+    CHECK(ex::World_Apply(&world, &queue));
+    CHECK(world.total_entity_count == 10);
+    CHECK(world.entity_types[statics].entity_count == 10);
+    for (auto id : ids)
+        CHECK(ex::World_IsAlive(&world, id));
+    CHECK(queue.buffers[2].count == 0);
+
+    REQUIRE(ex::CommandBuffer_Move(ex::CommandQueue_GetBuffer(&queue, 0), ids[0], movers));
+    REQUIRE(ex::CommandBuffer_Despawn(ex::CommandQueue_GetBuffer(&queue, 1), ids[1]));
+    REQUIRE(ex::CommandBuffer_Despawn(ex::CommandQueue_GetBuffer(&queue, 2), ids[2]));
+    CHECK(ex::World_Apply(&world, &queue));
+    CHECK(world.total_entity_count == 8);
+    CHECK(world.entity_types[movers].entity_count == 1);
+    CHECK(world.entity_types[statics].entity_count == 7);
+    CHECK_FALSE(ex::World_IsAlive(&world, ids[1]));
+    CHECK_FALSE(ex::World_IsAlive(&world, ids[2]));
+    ex::SizeType type_index = ex::InvalidIndex;
+    REQUIRE(ex::World_GetEntityLocation(&world, ids[0], &type_index, nullptr));
+    CHECK(type_index == movers);
+
+    // A dead ID fails its command, but the rest still get applied.
+    REQUIRE(ex::CommandBuffer_Despawn(ex::CommandQueue_GetBuffer(&queue, 0), ids[1]));
+    REQUIRE(ex::CommandBuffer_Despawn(ex::CommandQueue_GetBuffer(&queue, 0), ids[3]));
+    CHECK_FALSE(ex::World_Apply(&world, &queue));
+    CHECK(world.total_entity_count == 7);
+    CHECK_FALSE(ex::World_IsAlive(&world, ids[3]));
+
+    ex::CommandQueue_Destroy(&queue);
+    ex::JobPool_Destroy(pool);
+    ex::World_Destroy(&world);
+}
@@ -68,3 +68,141 @@ TEST_CASE("Format Specs Galore!", "[fmt]") {
     s = y::fmt::ToStr("Only {0w13c}, and that's it.", 3.14);
     CHECK(s == "Only     3.14     , and that's it.");
 }
+
+TEST_CASE("Compiled formats match the run-time ones", "[fmt]") {
+    auto s = y::fmt::ToStr(Y_FMT("Tes{}, {}... {}... {}... {{{}}"), "ting", true, 2, -3, "*does the test*"s);
+    CHECK(s == "Testing, 1... 2... -3... {*does the test*}");
+    CHECK(s == y::fmt::ToStr("Tes{}, {}... {}... {}... {{{}}", "ting", true, 2, -3, "*does the test*"s));
+
+    CHECK(y::fmt::ToStr(Y_FMT("{1}{0}{3}"), 'a', 'b', 'c', 'd') == "bad");
+    CHECK(y::fmt::ToStr(Y_FMT("Only {0w13f-b10+rU}, and that's it."), 3.14) == "Only ---------3.14, and that's it.");
+    CHECK(y::fmt::ToStr(Y_FMT("Only {0w13C}, and that's it."), 3.14) == "Only      3.14    , and that's it.");
+    CHECK(y::fmt::ToStr(Y_FMT("[{w6r}|{w6}|{b16}]"), 42, "ab", 255u) == "[    42|ab    |ff]");
+    CHECK(y::fmt::ToStr(Y_FMT("")) == "");
+    CHECK(y::fmt::ToStr(Y_FMT("}{{")) == "}{");
+
+    char buffer [10];
+    auto r = y::fmt::ToCStr(buffer, sizeof(buffer), Y_FMT("Hello, {}!"), "world");
+    CHECK(r == 10);
+    CHECK("Hello, wo"s == buffer);
+}
+
+TEST_CASE("Compiled formats stop when the output does, and count what they wrote", "[fmt]") {
+    FILE * file = ::tmpfile();
+    REQUIRE(file);
+    CHECK(y::fmt::ToFile(file, Y_FMT("Hello, {}! {w5r}"), "world", 42) == 19);
+    CHECK(y::fmt::ToFile(file, "Hello, {}! {w5r}", "world", 42) == 19);
+    CHECK(::ftell(file) == 38);
+    ::fclose(file);
+
+    std::string out;
+    auto limited = [&](char c) {out += c; return out.size() < 3;};
+    CHECK_FALSE(y::fmt::detail::DoCompiled(Y_FMT("abcdef{}ghi"), limited, 'x'));
+    CHECK(out == "abc");
+    out.clear();
+    CHECK(y::fmt::detail::DoCompiled(Y_FMT("{}"), [&](char c) {out += c; return true;}, 7));
+    CHECK(out == "7");
+}
+
+namespace {
+// Counts how the output arrives, to check that runs are used when the functor can take them.
+struct RunCounter {
+    std::string & out;
+    int & chars;
+    int & runs;
+
+    bool operator () (char c) {out += c; chars++; return true;}
+    bool write (char const * s, size_t n) {out.append(s, n); runs++; return true;}
+};
+}
+
+TEST_CASE("Output functors with a write() get runs", "[fmt]") {
+    std::string out;
+    int chars = 0, runs = 0;
+    char const * fmt = "Literal text, then {w13r} and {}; {{done}";
+    y::fmt::detail::Do([](auto, auto, auto){return false;}, RunCounter{out, chars, runs}, [&]{return *fmt++;}, 123456789012LL, "a string");
+    CHECK(out == "Literal text, then  123456789012 and a string; {done}");
+    CHECK(chars == 0);
+    CHECK(runs <= 8);
+
+    out.clear();
+    chars = runs = 0;
+    y::fmt::detail::DoCompiled(Y_FMT("{w70f.r}|{}"), RunCounter{out, chars, runs}, 2.5, 'x');
+    CHECK(out == std::string(67, '.') + "2.5|x");
+    CHECK(chars == 1);      // Single characters still go through operator ()
+    CHECK(runs == 5);       // 32 + 32 + 3 fill, "2.5", "|"
+
+    // Long outputs, and truncation, through the C-string sink
+    char buffer [300];
+    std::string const long_str (500, 'z');
+    auto r = y::fmt::ToCStr(buffer, sizeof(buffer), "<{}>", long_str);
+    CHECK(r == sizeof(buffer));
+    CHECK(std::string(buffer) == "<" + long_str.substr(0, sizeof(buffer) - 2));
+}
+
+namespace {
+// Takes at most "room" characters; refuses the run that doesn't fit, and everything after it.
+struct FullSink {
+    std::string & out;
+    size_t room;
+    int & refused;
+
+    bool operator () (char c) {return write(&c, 1);}
+    bool write (char const * s, size_t n) {
+        if (refused > 0 || out.size() + n > room) {refused++; return false;}
+        out.append(s, n);
+        return true;
+    }
+};
+}
+
+TEST_CASE("A write() that fails stops the run", "[fmt]") {
+    std::string out;
+    int refused = 0;
+    CHECK_FALSE(y::fmt::detail::DoCompiled(Y_FMT("{w100f-r}|{}"), FullSink{out, 40, refused}, "ab", "cd"));
+    CHECK(out == std::string(32, '-'));
+    CHECK(refused == 2);    // The second fill run, then "|"; neither "ab" nor "cd" is tried
+
+    out.clear();
+    refused = 0;
+    CHECK_FALSE(y::fmt::cvt::PutRun(FullSink{out, 4, refused}, "abcdef", 6));
+    CHECK(out.empty());
+    CHECK(refused == 1);
+}
+
+TEST_CASE("ToStr() output spilling past the stack buffer", "[fmt]") {
+    std::string const a (100, 'a'), b (300, 'b');
+    CHECK(y::fmt::ToStr("[{}]", a) == "[" + a + "]");
+    CHECK(y::fmt::ToStr("[{}|{}|{}]", a, a, a) == "[" + a + "|" + a + "|" + a + "]");
+    CHECK(y::fmt::ToStr("{}{}", a, b) == a + b);
+    CHECK(y::fmt::ToStr(std::string_view{"{w250}|{}"}, 42, b) == "42" + std::string(248, ' ') + "|" + b);
+
+    std::string expected;
+    for (int i = 0; i < 100; ++i)
+        expected += "x" + std::to_string(i * 1000);
+    std::string out;
+    for (int i = 0; i < 100; ++i)
+        out += y::fmt::ToStr("x{}", i * 1000);
+    CHECK(out == expected);
+    CHECK(y::fmt::ToStr(Y_FMT("{}{}"), expected, "!") == expected + "!");
+}
+
+TEST_CASE("Any number of arguments, of any supported type", "[fmt]") {
+    auto s = y::fmt::ToStr("{}{}{}{}{}{}{}{}{}{}{}{}|{11}{0}",
+        0, 1u, 2LL, 3ULL, (short)4, (unsigned char)5, (signed char)'6', '7', 8.0f, 9.0, "1", std::string_view{"0"});
+    CHECK(s == "012345678910|00");
+
+    // Past the last argument, formatting stops (through the error functor)
+    CHECK(y::fmt::ToStr("{} and {}, then more", 1) == "1 and ");
+    CHECK(y::fmt::ToStr("{3}", 'a', 'b', 'c') == "");
+
+    // Types without a fast path go through their cvt::ToStr() overload
+    int * p = nullptr;
+    CHECK(y::fmt::ToStr("{}{}{}", p, 2.5L, std::string("!")) == "02.5!");
+
+    // And functors without a write() still get every character
+    std::string out;
+    char const * fmt = "{w5r}|{}";
+    y::fmt::detail::Do([](auto, auto, auto){return false;}, [&](char c){out += c; return true;}, [&]{return *fmt++;}, 42, "xyz");
+    CHECK(out == "   42|xyz");
+}
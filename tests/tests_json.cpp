@@ -1,4 +1,898 @@
 
 #include "../experimental/y_json.h"
+#include <y_basics.hpp>
 #include "catch.hpp"
 
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Collected {
+    int elements = 0;
+    int values = 0;
+    json_value_t last_value = {};
+    int errors = 0;
+    json_error_e last_error = JSON_ERR_INVALID;
+    json_location_t last_error_loc = {};
+};
+
+json_user_handle_t CountElements (
+    json_elem_type_e elem_type, json_user_handle_t, json_value_t value, json_user_handle_t,
+    json_buffer_t const *, json_location_t const *, void * user_data
+) {
+    auto c = static_cast<Collected *>(user_data);
+    c->elements += 1;
+    if (JSON_ETYPE_Value == elem_type) {
+        c->values += 1;
+        c->last_value = value;
+    }
+    return nullptr;
+}
+
+void RecordError (
+    json_error_severity_e, json_error_e error, json_buffer_t const *,
+    json_location_t const * location, void * user_data, char const *, int, int
+) {
+    auto c = static_cast<Collected *>(user_data);
+    c->errors += 1;
+    c->last_error = error;
+    c->last_error_loc = *location;
+}
+
+Collected Parse (std::string const & json) {
+    Collected ret;
+    JSON_Parse({json.data(), json_size_t(json.size())}, CountElements, RecordError, &ret);
+    return ret;
+}
+
+// Records every element and error as a flat list of numbers, so two parses can be compared.
+struct Trace {
+    std::vector<long long> events;
+    std::uintptr_t next_handle = 1;
+};
+
+json_user_handle_t TraceElement (
+    json_elem_type_e elem_type, json_user_handle_t self, json_value_t value, json_user_handle_t parent,
+    json_buffer_t const *, json_location_t const * location, void * user_data
+) {
+    auto t = static_cast<Trace *>(user_data);
+    std::uintptr_t handle = (JSON_ETYPE_ObjectBegin == elem_type || JSON_ETYPE_ArrayBegin == elem_type) ? t->next_handle++ : 0;
+    long long bits = 0;
+    switch (value.type) {
+    case JSON_VTYPE_Bool: bits = value.data.b; break;
+    case JSON_VTYPE_Int: bits = value.data.i; break;
+    case JSON_VTYPE_Real: bits = (long long)value.data.r; break;
+    case JSON_VTYPE_String: bits = (long long)value.data.s.begin * 1000003 + value.data.s.end; break;
+    default: break;
+    }
+    long long const e [] = {
+        elem_type, (long long)(std::uintptr_t)self, (long long)(std::uintptr_t)parent, (long long)handle,
+        value.type, bits, location->byte, location->depth, location->line, location->column,
+    };
+    t->events.insert(t->events.end(), std::begin(e), std::end(e));
+    return reinterpret_cast<json_user_handle_t>(handle);
+}
+
+void TraceError (
+    json_error_severity_e severity, json_error_e error, json_buffer_t const *,
+    json_location_t const * location, void * user_data, char const *, int, int
+) {
+    auto t = static_cast<Trace *>(user_data);
+    long long const e [] = {-1, severity, error, location->byte, location->line, location->column};
+    t->events.insert(t->events.end(), std::begin(e), std::end(e));
+}
+
+Trace ParseWith (std::string const & json, json_engine_e engine, json_size_t * out_consumed = nullptr) {
+    Trace ret;
+    json_options_t options {engine};
+    auto consumed = JSON_ParseEx({json.data(), json_size_t(json.size())}, &options, TraceElement, TraceError, &ret);
+    if (out_consumed)
+        *out_consumed = consumed;
+    return ret;
+}
+
+void CheckEnginesAgree (std::string const & json) {
+    json_size_t consumed_rd = 0, consumed_si = 0;
+    auto rd = ParseWith(json, JSON_ENGINE_RecursiveDescent, &consumed_rd);
+    auto si = ParseWith(json, JSON_ENGINE_StructuralIndex, &consumed_si);
+    INFO(json.substr(0, 200));
+    CHECK(rd.events == si.events);
+    CHECK(consumed_rd == consumed_si);
+}
+
+// Like Trace, but strings are recorded by content, since the push parser hands out different buffers.
+struct ContentTrace {
+    std::vector<std::string> events;
+    std::uintptr_t next_handle = 1;
+};
+
+json_user_handle_t ContentTraceElement (
+    json_elem_type_e elem_type, json_user_handle_t self, json_value_t value, json_user_handle_t parent,
+    json_buffer_t const * input, json_location_t const * location, void * user_data
+) {
+    auto t = static_cast<ContentTrace *>(user_data);
+    std::uintptr_t handle = (JSON_ETYPE_ObjectBegin == elem_type || JSON_ETYPE_ArrayBegin == elem_type) ? t->next_handle++ : 0;
+    std::string e = std::to_string(elem_type) + " " + std::to_string((std::uintptr_t)self) + " " + std::to_string((std::uintptr_t)parent)
+        + " @" + std::to_string(location->byte) + " d" + std::to_string(location->depth) + " v" + std::to_string(value.type) + " ";
+    switch (value.type) {
+    case JSON_VTYPE_Bool: e += std::to_string(value.data.b); break;
+    case JSON_VTYPE_Int: e += std::to_string(value.data.i); break;
+    case JSON_VTYPE_Real: e += std::to_string(value.data.r); break;
+    case JSON_VTYPE_String: e += std::string(input->ptr + value.data.s.begin, input->ptr + value.data.s.end); break;
+    default: break;
+    }
+    t->events.push_back(e);
+    return reinterpret_cast<json_user_handle_t>(handle);
+}
+
+void ContentTraceError (
+    json_error_severity_e severity, json_error_e error, json_buffer_t const *,
+    json_location_t const * location, void * user_data, char const *, int, int
+) {
+    auto t = static_cast<ContentTrace *>(user_data);
+    t->events.push_back("error " + std::to_string(severity) + " " + std::to_string(error) + " @" + std::to_string(location->byte)
+        + " " + std::to_string(location->line) + ":" + std::to_string(location->column));
+}
+
+ContentTrace PushInChunks (std::string const & json, std::vector<size_t> const & cuts) {
+    ContentTrace ret;
+    auto parser = JSON_PushCreate(ContentTraceElement, ContentTraceError, &ret);
+    size_t from = 0;
+    bool ok = true;
+    for (size_t i = 0; i <= cuts.size() && ok; ++i) {
+        size_t const to = (i < cuts.size() ? cuts[i] : json.size());
+        std::string chunk = json.substr(from, to - from);    // A copy, so nothing can keep pointing into it
+        ok = JSON_PushFeed(parser, {chunk.data(), json_size_t(chunk.size())});
+        from = to;
+    }
+    if (ok)
+        JSON_PushFinish(parser);
+    JSON_PushDestroy(parser);
+    return ret;
+}
+
+}   // namespace
+
+TEST_CASE("Long and escaped names", "[json]") {
+    std::string long_name (1000, 'x');
+    auto c = Parse("{\"" + long_name + "\": {}, \"a\\\"b\\\\c\\u0041\": [],\n\t\"" + long_name + "\\n\":{}}");
+    CHECK(c.errors == 0);
+    CHECK(c.elements == 11);
+}
+
+TEST_CASE("Whitespace runs", "[json]") {
+    std::string ws (100, ' ');
+    auto c = Parse(ws + "{" + ws + "\"a\"" + ws + ":" + ws + "[" + ws + "]" + ws + "}" + ws);
+    CHECK(c.errors == 0);
+    CHECK(c.elements == 5);
+}
+
+TEST_CASE("String errors report line and column", "[json]") {
+    auto c = Parse("{\n  \"ab\tc\": {}}");
+    CHECK(c.errors == 1);
+    CHECK(c.last_error == JSON_ERR_ControlCharInString);
+    CHECK(c.last_error_loc.byte == 7);
+    CHECK(c.last_error_loc.line == 2);
+    CHECK(c.last_error_loc.column == 6);
+
+    c = Parse("{\n\n\"" + std::string(40, 'z') + "\\q\": {}}");
+    CHECK(c.last_error == JSON_ERR_BadEscaping);
+    CHECK(c.last_error_loc.line == 3);
+    CHECK(c.last_error_loc.column == 43);
+
+    c = Parse("{\"" + std::string(70, 'z'));
+    CHECK(c.last_error == JSON_ERR_IncompleteInput);
+}
+
+TEST_CASE("Scalar values", "[json]") {
+    auto c = Parse("{\"a\": null, \"b\": true, \"c\": false, \"d\": \"str\", \"e\": [1, -2.5, 3e2]}");
+    CHECK(c.errors == 0);
+    CHECK(c.values == 7);
+    CHECK(c.elements == 1 + 5 + 7 + 2 + 1);
+
+    c = Parse("[true]");
+    CHECK(c.last_value.type == JSON_VTYPE_Bool);
+    CHECK(c.last_value.data.b == true);
+
+    c = Parse("[\"a\\nb\"]");
+    CHECK(c.last_value.type == JSON_VTYPE_String);
+    CHECK(c.last_value.data.s.begin == 2);
+    CHECK(c.last_value.data.s.end == 6);
+    CHECK(c.last_value.data.s.estimated_unescaped_size_bytes == 3);
+
+    c = Parse("[nul]");
+    CHECK(c.last_error == JSON_ERR_ExpectedValue);
+}
+
+TEST_CASE("Integers", "[json]") {
+    auto c = Parse("[1234567890123456789]");
+    CHECK(c.last_value.type == JSON_VTYPE_Int);
+    CHECK(c.last_value.data.i == 1234567890123456789LL);
+
+    c = Parse("[-9223372036854775808]");
+    CHECK(c.last_value.type == JSON_VTYPE_Int);
+    CHECK(c.last_value.data.i == INT64_MIN);
+
+    c = Parse("[9223372036854775808]");     // Doesn't fit; becomes a real
+    CHECK(c.last_value.type == JSON_VTYPE_Real);
+    CHECK(c.last_value.data.r == 9223372036854775808.0);
+
+    c = Parse("[0]");
+    CHECK(c.last_value.type == JSON_VTYPE_Int);
+    CHECK(c.last_value.data.i == 0);
+}
+
+TEST_CASE("Reals are correctly rounded", "[json]") {
+    char const * inputs [] = {
+        "0.1", "-2.5e-3", "1.7976931348623157e308", "2.2250738585072014e-308",
+        "4.9406564584124654e-324", "2.4703282292062328e-324", "9007199254740993.0",
+        "123456789012345678901234567890", "0.30000000000000004", "1e23", "8.98846567431158e307",
+        // Too many digits for the fast paths
+        "0.1000000000000000000001", "-2.47032822920623272088284396434110686182529901307162382212792841250337753635104375932649918180817996189898282347722858865463328355177969898199387398005390939063150356595155702263922908583924491051844359318028499365361525003193704576782492193656236698636584807570015857692699037063119282795585513329278343384093519780155312465972635795746227664652728272200563740064854999770965994704540208281662262378573934507363390079677619305775067401763246736009689513405355374585166611342237666786041621596804619144672918403005300575308490487653917113865916462395249126236538818796362393732804238910186723484976682350898633885879256283027559956575244555072551893136908362547791869486679949683240497058210285131854513962138377228261454376934125320985913276672363281255e-324", "+1.5",
+    };
+    for (auto in : inputs) {
+        auto c = Parse(std::string("[") + in + "]");
+        CHECK(c.errors == 0);
+        CHECK(c.last_value.type == JSON_VTYPE_Real);
+        CHECK(c.last_value.data.r == std::strtod(in, nullptr));
+    }
+
+    // Out of range, with more digits than the fast paths take
+    auto c = Parse("[1" + std::string(30, '1') + "e400, -1" + std::string(30, '1') + "e400]");
+    CHECK(c.errors == 0);
+    CHECK(c.last_value.data.r == -HUGE_VAL);
+    c = Parse("[1" + std::string(30, '1') + "e-400]");
+    CHECK(c.errors == 0);
+    CHECK(c.last_value.data.r == 0.0);
+}
+
+TEST_CASE("Structural index engine matches recursive descent", "[json]") {
+    char const * docs [] = {
+        "{}", "[]", " [ ] ", "0", "\"top\"", "  -12.5e3  ", "true", "null",
+        "{\"a\": null, \"b\": true, \"c\": false, \"d\": \"str\", \"e\": [1, -2.5, 3e2]}",
+        "[[[], {}], {\"x\": [{\"y\": {}}]}]",
+        "[1, 2, ]", "{\"a\": 1, }",
+        "{\"a\\\"\\\\\": \"\\\\\\\\\\\"[{,:}]\"}",
+        "[1 2]", "[1,, 2]", "{\"a\" 1}", "{\"a\": 1 \"b\": 2}", "{1: 2}", "[}", "{]",
+        "[1, 2", "{\"a\": ", "[\"abc", "[tru]", "[nul]", "", "   ", "[1]x", "{} {}",
+        "{\n  \"ab\tc\": {}}", "[\"\\q\"]", "[1e5x]", "[\"a\"b]",
+    };
+    for (auto doc : docs)
+        CheckEnginesAgree(doc);
+
+    // Strings, escapes and numbers straddling the 64-byte block boundaries
+    for (int pad = 0; pad < 70; ++pad) {
+        std::string p (pad, ' ');
+        std::string s (pad, 'z');
+        CheckEnginesAgree("[" + p + "\"" + s + "\\\\\", \"" + s + "\\\"]\", " + p + "12345.678e-3, true,\n null]");
+        CheckEnginesAgree("{\"" + s + "\\\\\\\\\":" + p + "[\"\\\"\\\\\\\"" + s + "\"]}");
+        CheckEnginesAgree("[" + p + "\"" + s);
+    }
+
+    // Something big, with many windows' worth of index
+    std::string big = "[";
+    for (int i = 0; i < 5000; ++i)
+        big += "{\"id\": " + std::to_string(i) + ", \"name\": \"item\\\"" + std::to_string(i) + "\", \"tags\": [true, null, -1.5e" + std::to_string(i % 50) + "]},\n";
+    big += "{}]";
+    CheckEnginesAgree(big);
+    CheckEnginesAgree(big.substr(0, big.size() / 2));
+}
+
+TEST_CASE("Push parser gives the same elements wherever the chunks are cut", "[json]") {
+    char const * docs [] = {
+        "{\"a\": null, \"b\": true, \"c\": false, \"d\": \"str\", \"e\": [1, -2.5, 3e2]}",
+        "[[[], {}], {\"x\\\"y\": [{\"y\": {}}]}, \"\\\\\", 12345678901234567890, -0.000125]",
+        "  \"just a string\"  ", "12", "[1,]", "{\"a\": 1, }",
+        "[1, 2", "{\"a\" 1}", "[tru]", "[\"a\tb\"]", "[\"\\q\"]", "{\n\n  \"k\": [1 2]}", "", "  ",
+    };
+    for (auto doc : docs) {
+        std::string json = doc;
+        ContentTrace whole = PushInChunks(json, {});
+        for (size_t cut = 0; cut <= json.size(); ++cut) {
+            INFO(json << " cut at " << cut);
+            CHECK(PushInChunks(json, {cut}).events == whole.events);
+        }
+        std::vector<size_t> every_byte;
+        for (size_t i = 1; i < json.size(); ++i)
+            every_byte.push_back(i);
+        INFO(json << " in 1-byte chunks");
+        CHECK(PushInChunks(json, every_byte).events == whole.events);
+    }
+}
+
+TEST_CASE("Push parser matches JSON_Parse", "[json]") {
+    std::string json = "[";
+    for (int i = 0; i < 300; ++i)
+        json += "{\"id\": " + std::to_string(i) + ",\n \"name\": \"it\\\"em " + std::string(i % 37, 'x') + "\", \"v\": [true, null, -1.5e" + std::to_string(i % 20) + "]},";
+    json += "{}]";
+
+    ContentTrace expected;
+    JSON_Parse({json.data(), json_size_t(json.size())}, ContentTraceElement, ContentTraceError, &expected);
+    CHECK(PushInChunks(json, {}).events == expected.events);
+    for (size_t chunk_size : {1, 7, 64, 1000}) {
+        std::vector<size_t> cuts;
+        for (size_t i = chunk_size; i < json.size(); i += chunk_size)
+            cuts.push_back(i);
+        INFO("chunk size " << chunk_size);
+        CHECK(PushInChunks(json, cuts).events == expected.events);
+    }
+
+    // Errors are reported at the same place in the stream
+    std::string bad = "{\"a\": [1, 2],\n \"b\": [3 4]}";
+    ContentTrace bad_expected;
+    JSON_Parse({bad.data(), json_size_t(bad.size())}, ContentTraceElement, ContentTraceError, &bad_expected);
+    CHECK(PushInChunks(bad, {3, 17}).events == bad_expected.events);
+    CHECK(bad_expected.events.back() == "error 2 3 @23 2:10");
+}
+
+TEST_CASE("Push parser takes a stream of values", "[json]") {
+    auto t = PushInChunks("{\"a\": 1} [2]\n3 \"four\"", {5, 12});
+    REQUIRE(t.events.size() == 9);
+    CHECK(t.events[8] == "8 0 0 @21 d0 v5 four");
+
+    t = PushInChunks("[1, 2", {2});
+    CHECK(t.events.back().rfind("error 2 3 @5", 0) == 0);
+    t = PushInChunks("  ", {1});
+    CHECK(t.events.back().rfind("error 2 4 @2", 0) == 0);
+
+    // Offsets are json_size_t, so the stream stops at 4GiB - 1 bytes. (The long chunk is rejected before it's read.)
+    ContentTrace too_long;
+    auto parser = JSON_PushCreate(ContentTraceElement, ContentTraceError, &too_long);
+    CHECK(JSON_PushFeed(parser, {"[1, ", 4}));
+    CHECK_FALSE(JSON_PushFeed(parser, {"2]", json_size_t(~json_size_t(0)) - 3}));
+    CHECK(too_long.events.back().rfind("error 3 " + std::to_string(JSON_ERR_StreamTooLong) + " @", 0) == 0);
+    CHECK_FALSE(JSON_PushFeed(parser, {"2]", 2}));
+    JSON_PushDestroy(parser);
+}
+
+TEST_CASE("Document navigation and values", "[json]") {
+    std::string json = "{\"a\": [1, 2.5, true, null, \"x\"], \"b\": {\"c\": {}}, \"d\": -7}";
+    json_doc_t * doc = JSON_DocParse({json.data(), json_size_t(json.size())}, nullptr, nullptr, nullptr);
+    REQUIRE(doc);
+    CHECK(JSON_DocType(doc, 0) == JSON_VTYPE_Object);
+    CHECK(JSON_DocCount(doc, 0) == 3);
+
+    json_node_t a = JSON_DocFind(doc, 0, "a", 1);
+    CHECK(JSON_DocType(doc, a) == JSON_VTYPE_Array);
+    CHECK(JSON_DocCount(doc, a) == 5);
+    double r = 0;
+    CHECK(JSON_DocGetReal(doc, JSON_DocAt(doc, a, 1), &r));
+    CHECK(r == 2.5);
+    CHECK(JSON_DocType(doc, JSON_DocAt(doc, a, 3)) == JSON_VTYPE_Null);
+    CHECK(JSON_DocAt(doc, a, 5) == JSON_NODE_INVALID);
+
+    long long i = 0;
+    CHECK(JSON_DocGetInt(doc, JSON_DocFind(doc, 0, "d", 1), &i));
+    CHECK(i == -7);
+    CHECK(JSON_DocFind(doc, 0, "c", 1) == JSON_NODE_INVALID);     // Only direct members
+    json_node_t b = JSON_DocFind(doc, 0, "b", 1);
+    CHECK(JSON_DocType(doc, JSON_DocFind(doc, b, "c", 1)) == JSON_VTYPE_Object);
+
+    // Members alternate names and values; Next skips whole subtrees
+    std::vector<std::string> names;
+    for (json_node_t n = JSON_DocFirstChild(doc, 0); n != JSON_NODE_INVALID; n = JSON_DocNext(doc, n + 1, 0)) {
+        char buf [8];
+        names.emplace_back(buf, JSON_DocGetString(doc, n, buf, sizeof(buf)));
+    }
+    CHECK(names == std::vector<std::string>{"a", "b", "d"});
+    JSON_DocDestroy(doc);
+
+    CHECK(nullptr == JSON_DocParse({"[1, ", 4}, nullptr, nullptr, nullptr));
+}
+
+TEST_CASE("Document strings are unescaped on demand", "[json]") {
+    std::string json = "[\"plain\", \"a\\\\b\\\"c\\n\\u0041\\u00e9\\u20ac\\ud83d\\ude00\\ud800x\"]";
+    json_doc_t * doc = JSON_DocParse({json.data(), json_size_t(json.size())}, nullptr, nullptr, nullptr);
+    REQUIRE(doc);
+
+    json_substr_t raw;
+    REQUIRE(JSON_DocGetRawString(doc, JSON_DocAt(doc, 0, 0), &raw));
+    CHECK(std::string(json.data() + raw.begin, json.data() + raw.end) == "plain");
+
+    json_node_t s = JSON_DocAt(doc, 0, 1);
+    json_size_t size = JSON_DocGetString(doc, s, nullptr, 0);
+    std::string out (size, '\0');
+    CHECK(JSON_DocGetString(doc, s, &out[0], size) == size);
+    CHECK(out == "a\\b\"c\nA\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xEF\xBF\xBDx");
+
+    char small [3];     // Truncated, but the full size is still returned
+    CHECK(JSON_DocGetString(doc, s, small, sizeof(small)) == size);
+    CHECK(std::string(small, 3) == "a\\b");
+    JSON_DocDestroy(doc);
+}
+
+TEST_CASE("Document key lookup in large objects", "[json]") {
+    std::string json = "{";
+    for (int i = 0; i < 1000; ++i)
+        json += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ", \"k\\u0065y_" + std::to_string(i) + "\": [" + std::to_string(-i) + "], ";
+    json += "\"key0\": \"duplicate\"}";
+    json_doc_t * doc = JSON_DocParse({json.data(), json_size_t(json.size())}, nullptr, nullptr, nullptr);
+    REQUIRE(doc);
+    CHECK(JSON_DocCount(doc, 0) == 2001);
+    for (int i = 0; i < 1000; ++i) {
+        std::string k = "key" + std::to_string(i);
+        long long v = -1;
+        CHECK(JSON_DocGetInt(doc, JSON_DocFind(doc, 0, k.data(), json_size_t(k.size())), &v));
+        CHECK(v == i);
+        k = "key_" + std::to_string(i);
+        json_node_t arr = JSON_DocFind(doc, 0, k.data(), json_size_t(k.size()));
+        CHECK(JSON_DocGetInt(doc, JSON_DocAt(doc, arr, 0), &v));
+        CHECK(v == -i);
+    }
+    CHECK(JSON_DocFind(doc, 0, "key1000", 7) == JSON_NODE_INVALID);
+    CHECK(JSON_DocType(doc, JSON_DocFind(doc, 0, "key0", 4)) == JSON_VTYPE_Int);  // The first one wins
+    JSON_DocDestroy(doc);
+}
+
+namespace {
+
+struct NDJSONWorkerState {
+    long long values = 0;
+};
+
+json_user_handle_t NDJSONRoot (
+    json_elem_type_e elem_type, json_user_handle_t, json_value_t value, json_user_handle_t,
+    json_buffer_t const *, json_location_t const *, void * user_data
+) {
+    auto w = static_cast<NDJSONWorkerState *>(user_data);
+    if (JSON_ETYPE_Value == elem_type)
+        w->values += 1;
+    // Records' roots are ints here, or arrays of one; either way the int is the result.
+    if (JSON_ETYPE_Value == elem_type && JSON_VTYPE_Int == value.type)
+        return reinterpret_cast<json_user_handle_t>(std::intptr_t(value.data.i));
+    return nullptr;
+}
+
+}   // namespace
+
+TEST_CASE("NDJSON records come back in order, with their errors", "[json]") {
+    std::string in;
+    int const n = 300000;   // Big enough for several chunks
+    for (int i = 1; i <= n; ++i)
+        in += (i % 3 ? std::to_string(i) : "[" + std::to_string(i) + "]") + (i % 5 ? "\n" : "\r\n");
+    in += "\n   \n{\"a\": }\n7 8\n\"unterminated\n42";
+
+    NDJSONWorkerState states [4];
+    void * user_data [4] = {&states[0], &states[1], &states[2], &states[3]};
+    json_ndjson_result_t result;
+    REQUIRE(JSON_NDJSONParseMemory(in.data(), in.size(), nullptr, 4, NDJSONRoot, user_data, &result));
+    REQUIRE(result.record_count == n + 4);
+    CHECK(result.error_count == 3);
+
+    bool in_order = true;
+    for (int i = 1; i <= n; ++i)
+        if (i % 3 && reinterpret_cast<std::intptr_t>(result.records[i - 1].root) != i)
+            in_order = false;
+    CHECK(in_order);
+    CHECK(states[0].values + states[1].values + states[2].values + states[3].values == n + 2);
+
+    json_ndjson_record_t const * r = result.records + n;
+    CHECK(r[0].error == JSON_ERR_ExpectedValue);
+    CHECK(in.substr(size_t(r[0].offset), r[0].size) == "{\"a\": }");
+    CHECK(r[0].error_location.byte == 6);
+    CHECK(r[1].error == JSON_ERR_TrailingContent);
+    CHECK(r[1].error_location.column == 3);
+    CHECK(r[2].error == JSON_ERR_IncompleteInput);
+    CHECK(r[3].error == JSON_ERR_INVALID);
+    CHECK(reinterpret_cast<std::intptr_t>(r[3].root) == 42);
+    CHECK(r[3].offset + r[3].size == in.size());
+    JSON_NDJSONFreeResult(&result);
+
+    // The same thing from a file, with the default number of threads
+    char const * path = "tests_json_ndjson.tmp";
+    FILE * f = std::fopen(path, "wb");
+    REQUIRE(f);
+    std::fwrite(in.data(), 1, in.size(), f);
+    std::fclose(f);
+    CHECK(JSON_NDJSONThreadCount(4) == 4);
+    int const default_threads = JSON_NDJSONThreadCount(0);
+    REQUIRE(default_threads >= 1);
+    CHECK(JSON_NDJSONThreadCount(-1) == default_threads);
+    std::vector<NDJSONWorkerState> default_states (size_t(default_threads), NDJSONWorkerState{});
+    std::vector<void *> default_user_data;
+    for (auto & s : default_states)
+        default_user_data.push_back(&s);
+    REQUIRE(JSON_NDJSONParseFile(path, nullptr, 0, NDJSONRoot, default_user_data.data(), &result));
+    CHECK(result.record_count == n + 4);
+    CHECK(result.error_count == 3);
+    long long default_values = 0;
+    for (auto const & s : default_states)
+        default_values += s.values;
+    CHECK(default_values == n + 2);
+    JSON_NDJSONFreeResult(&result);
+    std::remove(path);
+
+    CHECK_FALSE(JSON_NDJSONParseFile("does/not/exist.ndjson", nullptr, 1, nullptr, nullptr, &result));
+}
+
+TEST_CASE("Binding into a struct through a field table", "[json]") {
+    struct Vec {float x, y;};
+    struct Thing {
+        char name [8];
+        int32_t hp;
+        int64_t id;
+        double speed;
+        bool alive;
+        float weights [3];
+        Vec pos;
+        Vec path [2];
+    };
+    json_field_t const vec_fields [] = {
+        {JSON_FTYPE_F32, offsetof(Vec, x), sizeof(float), "x", nullptr},
+        {JSON_FTYPE_F32, offsetof(Vec, y), sizeof(float), "y", nullptr},
+    };
+    json_schema_t * vec = JSON_SchemaCreate(vec_fields, 2, sizeof(Vec));
+    REQUIRE(vec);
+    json_field_t const thing_fields [] = {
+        {JSON_FTYPE_Str, offsetof(Thing, name), sizeof(Thing::name), "name", nullptr},
+        {JSON_FTYPE_I32, offsetof(Thing, hp), sizeof(int32_t), "hp", nullptr},
+        {JSON_FTYPE_I64, offsetof(Thing, id), sizeof(int64_t), "id", nullptr},
+        {JSON_FTYPE_F64, offsetof(Thing, speed), sizeof(double), "speed", nullptr},
+        {JSON_FTYPE_Bool, offsetof(Thing, alive), sizeof(bool), "alive", nullptr},
+        {JSON_FTYPE_F32, offsetof(Thing, weights), sizeof(Thing::weights), "weights", nullptr},
+        {JSON_FTYPE_Struct, offsetof(Thing, pos), sizeof(Vec), "pos", vec},
+        {JSON_FTYPE_Struct, offsetof(Thing, path), sizeof(Thing::path), "path", vec},
+    };
+    json_schema_t * thing = JSON_SchemaCreate(thing_fields, 8, sizeof(Thing));
+    REQUIRE(thing);
+
+    std::string json = "{\"n\\u0061me\": \"orc\", \"hp\": 30, \"extra\": {\"hp\": [1, {\"hp\": 2}]}, \"id\": 12345678901,"
+        " \"speed\": 2, \"alive\": true, \"weights\": [0.5, 1.5], \"pos\": {\"y\": -1, \"x\": 4.25},"
+        " \"path\": [{\"x\": 1}, {\"y\": 2}]}";
+    Thing t = {};
+    Collected c;
+    CHECK(JSON_Bind({json.data(), json_size_t(json.size())}, thing, &t, RecordError, &c));
+    CHECK(c.errors == 0);
+    CHECK(std::string(t.name) == "orc");
+    CHECK(t.hp == 30);
+    CHECK(t.id == 12345678901LL);
+    CHECK(t.speed == 2.0);
+    CHECK(t.alive);
+    CHECK(t.weights[0] == 0.5f);
+    CHECK(t.weights[1] == 1.5f);
+    CHECK(t.weights[2] == 0.0f);
+    CHECK(t.pos.x == 4.25f);
+    CHECK(t.pos.y == -1.0f);
+    CHECK(t.path[0].x == 1.0f);
+    CHECK(t.path[1].y == 2.0f);
+
+    // Mismatches are reported and skipped; the rest still gets bound
+    json = "{\"name\": \"far too long\", \"hp\": 3000000000, \"alive\": 1, \"weights\": [1, 2, 3, 4], \"pos\": [1], \"id\": 7}";
+    t = {};
+    c = {};
+    CHECK_FALSE(JSON_Bind({json.data(), json_size_t(json.size())}, thing, &t, RecordError, &c));
+    CHECK(c.errors == 5);
+    CHECK(c.last_error == JSON_ERR_SchemaMismatch);
+    CHECK(std::string(t.name) == "far too");
+    CHECK(t.hp == 0);
+    CHECK_FALSE(t.alive);
+    CHECK(t.weights[2] == 3.0f);
+    CHECK(t.id == 7);
+
+    c = {};
+    CHECK_FALSE(JSON_Bind({"[1]", 3}, thing, &t, RecordError, &c));
+    CHECK(c.last_error == JSON_ERR_SchemaMismatch);
+    CHECK_FALSE(JSON_Bind({"{\"hp\": ", 7}, thing, &t, nullptr, nullptr));
+
+    // Skipped members don't count towards the binder's nesting limit
+    json = "{\"extra\": " + std::string(200, '[') + std::string(200, ']') + ", \"hp\": 5}";
+    t = {};
+    CHECK(JSON_Bind({json.data(), json_size_t(json.size())}, thing, &t, nullptr, nullptr));
+    CHECK(t.hp == 5);
+
+    // A field that sticks out of the struct makes no schema
+    json_field_t const bad = {JSON_FTYPE_I64, sizeof(Vec) - 4, sizeof(int64_t), "z", nullptr};
+    CHECK(nullptr == JSON_SchemaCreate(&bad, 1, sizeof(Vec)));
+
+    JSON_SchemaDestroy(thing);
+    JSON_SchemaDestroy(vec);
+}
+
+TEST_CASE("Writer output, compact and pretty", "[json]") {
+    std::string out;
+    auto append = [&](char c) {out += c; return true;};
+    auto write_sample = [](json_writer_t * w) {
+        JSON_WriteObjectBegin(w);
+        JSON_WriteName(w, "a", 1);
+        JSON_WriteArrayBegin(w);
+        JSON_WriteInt(w, -12);
+        JSON_WriteReal(w, 0.1);
+        JSON_WriteReal(w, 3);
+        JSON_WriteReal(w, 1e300);
+        JSON_WriteReal(w, 0.0 / 0.0);
+        JSON_WriteBool(w, true);
+        JSON_WriteNull(w);
+        JSON_WriteArrayEnd(w);
+        JSON_WriteName(w, "b\n", 2);
+        JSON_WriteObjectBegin(w);
+        JSON_WriteObjectEnd(w);
+        JSON_WriteName(w, "c", 1);
+        JSON_WriteArrayBegin(w);
+        JSON_WriteArrayEnd(w);
+        return JSON_WriteObjectEnd(w);
+    };
+
+    json_writer_t * w = JSON_WriterCreate(JSON_SinkToFunctor<decltype(append)>, &append, JSON_WSTYLE_Compact, 0);
+    REQUIRE(w);
+    CHECK(write_sample(w));
+    CHECK(JSON_WriterFinish(w));
+    JSON_WriterDestroy(w);
+    CHECK(out == "{\"a\":[-12,0.1,3.0,1e+300,null,true,null],\"b\\n\":{},\"c\":[]}");
+
+    out.clear();
+    w = JSON_WriterCreate(JSON_SinkToFunctor<decltype(append)>, &append, JSON_WSTYLE_Pretty, 2);
+    CHECK(write_sample(w));
+    CHECK(JSON_WriteInt(w, 1));     // Another top-level value goes on its own line
+    CHECK(JSON_WriterFinish(w));
+    JSON_WriterDestroy(w);
+    CHECK(out ==
+        "{\n"
+        "  \"a\": [\n"
+        "    -12,\n    0.1,\n    3.0,\n    1e+300,\n    null,\n    true,\n    null\n"
+        "  ],\n"
+        "  \"b\\n\": {},\n"
+        "  \"c\": []\n"
+        "}\n1");
+
+    // A functor that takes runs gets whole pieces instead of one char at a time
+    struct RunSink {
+        std::string & out;
+        int calls;
+        bool operator () (char c) {out += c; calls += 1; return true;}
+        bool write (char const * str, size_t n) {out.append(str, n); calls += 1; return true;}
+    } runs {out, 0};
+    out.clear();
+    w = JSON_WriterCreate(JSON_SinkToFunctor<RunSink>, &runs, JSON_WSTYLE_Compact, 0);
+    CHECK(write_sample(w));
+    CHECK(JSON_WriterFinish(w));
+    JSON_WriterDestroy(w);
+    CHECK(out == "{\"a\":[-12,0.1,3.0,1e+300,null,true,null],\"b\\n\":{},\"c\":[]}");
+    CHECK(runs.calls == 1);
+}
+
+TEST_CASE("Writer escapes strings, and rejects misuse", "[json]") {
+    // Long enough to cross blocks, with things to escape on both sides of the boundaries
+    std::string s;
+    for (int i = 0; i < 300; ++i)
+        s += (i % 37 == 0) ? '"' : (i % 41 == 0) ? '\\' : (i % 43 == 0) ? '\x01' : (i % 47 == 0) ? '\t' : char('a' + i % 26);
+    s += "\xC3\xA9";
+
+    std::vector<char> storage (4 * s.size());
+    y::MemWriter mem {reinterpret_cast<y::Byte *>(storage.data()), storage.size()};
+    json_writer_t * w = JSON_WriterCreate(JSON_SinkToMemWriter<y::MemWriter>, &mem, JSON_WSTYLE_Compact, 0);
+    REQUIRE(w);
+    CHECK(JSON_WriteString(w, s.data(), json_size_t(s.size())));
+    CHECK(JSON_WriterFinish(w));
+    JSON_WriterDestroy(w);
+
+    std::string const written (storage.data(), reinterpret_cast<char *>(mem.ptr));
+    CHECK(written.find("\\u0001") != std::string::npos);
+    CHECK(written.find("\\t") != std::string::npos);
+    json_doc_t * doc = JSON_DocParse({written.data(), json_size_t(written.size())}, nullptr, nullptr, nullptr);
+    REQUIRE(doc);
+    std::vector<char> back (s.size() + 1);
+    CHECK(JSON_DocGetString(doc, 0, back.data(), json_size_t(back.size())) == s.size());
+    CHECK(std::string(back.data(), s.size()) == s);
+    JSON_DocDestroy(doc);
+
+    // A full buffer fails the writer
+    char small_storage [8];
+    y::Buffer small {small_storage, y::Size(sizeof(small_storage))};
+    w = JSON_WriterCreate(JSON_SinkToBuffer<y::Buffer>, &small, JSON_WSTYLE_Compact, 0);
+    CHECK(JSON_WriteString(w, "0123456789", 10));
+    CHECK_FALSE(JSON_WriterFinish(w));
+    JSON_WriterDestroy(w);
+
+    small = {small_storage, y::Size(sizeof(small_storage))};
+    w = JSON_WriterCreate(JSON_SinkToBuffer<y::Buffer>, &small, JSON_WSTYLE_Compact, 0);
+    CHECK(JSON_WriteNull(w));
+    CHECK(JSON_WriterFinish(w));
+    JSON_WriterDestroy(w);
+    CHECK(std::string(small_storage, reinterpret_cast<char *>(small.end)) == "null");
+
+    w = JSON_WriterCreate(JSON_SinkToBuffer<y::Buffer>, &small, JSON_WSTYLE_Compact, 0);
+    CHECK(JSON_WriteObjectBegin(w));
+    CHECK_FALSE(JSON_WriteInt(w, 1));       // A member needs a name
+    CHECK_FALSE(JSON_WriteObjectEnd(w));    // ...and the writer stays failed
+    JSON_WriterDestroy(w);
+
+    w = JSON_WriterCreate(JSON_SinkToBuffer<y::Buffer>, &small, JSON_WSTYLE_Compact, 0);
+    CHECK(JSON_WriteArrayBegin(w));
+    CHECK_FALSE(JSON_WriteObjectEnd(w));
+    JSON_WriterDestroy(w);
+
+    w = JSON_WriterCreate(JSON_SinkToBuffer<y::Buffer>, &small, JSON_WSTYLE_Compact, 0);
+    CHECK(JSON_WriteArrayBegin(w));
+    CHECK_FALSE(JSON_WriterFinish(w));      // Still open
+    JSON_WriterDestroy(w);
+}
+
+namespace {
+struct Match {
+    json_size_t index;
+    json_value_t value;
+    std::string raw;
+};
+
+void CollectMatch (json_size_t index, json_value_t value, json_substr_t raw, json_buffer_t const * input, json_location_t const *, void * user_data) {
+    static_cast<std::vector<Match> *>(user_data)->push_back({index, value, std::string(input->ptr + raw.begin, raw.end - raw.begin)});
+}
+}
+
+TEST_CASE("Queries pick values by JSON pointer", "[json]") {
+    char const * pointers [] = {"/a/b/1", "/a/b/1", "/c", "/d~1e/x~0", "/a/k", "/missing/0", "/s"};
+    json_query_t * q = JSON_QueryCompile(pointers, 7);
+    REQUIRE(q);
+
+    std::string json = R"({"z": {"skip": ["}", "\"]", [{}], 1e5]}, "a": {"b": [true, 2.5, 3], "k": [1, {"y": null}]},)"
+        R"( "d/e": {"x~": "hi"}, "c": -4, "s": "téxt", "c": 99})";
+    std::vector<Match> m;
+    auto no_errors = [](json_error_severity_e, json_error_e, json_buffer_t const *, json_location_t const *, void *, char const *, int, int) {
+        FAIL("Unexpected error");
+    };
+    CHECK(JSON_QueryRun(q, {json.data(), json_size_t(json.size())}, CollectMatch, no_errors, &m));
+    REQUIRE(m.size() == 6);
+    CHECK(m[0].index == 1);     // Duplicate pointers come together, most recent first
+    CHECK(m[1].index == 0);
+    CHECK(m[1].value.type == JSON_VTYPE_Real);
+    CHECK(m[1].value.data.r == 2.5);
+    CHECK(m[2].index == 4);
+    CHECK(m[2].value.type == JSON_VTYPE_Array);
+    CHECK(m[2].raw == "[1, {\"y\": null}]");
+    CHECK(m[3].index == 3);
+    CHECK(m[3].raw == "\"hi\"");
+    CHECK(m[4].index == 2);     // Only the first "c"
+    CHECK(m[4].value.data.i == -4);
+    CHECK(m[5].index == 6);
+    CHECK(m[5].value.type == JSON_VTYPE_String);
+    JSON_QueryDestroy(q);
+
+    // Once everything's been found, the (broken) rest of the input isn't looked at
+    char const * first = "/z";
+    q = JSON_QueryCompile(&first, 1);
+    m.clear();
+    json.back() = '[';
+    CHECK(JSON_QueryRun(q, {json.data(), json_size_t(json.size())}, CollectMatch, no_errors, &m));
+    REQUIRE(m.size() == 1);
+    CHECK(m[0].raw == R"({"skip": ["}", "\"]", [{}], 1e5]})");
+    JSON_QueryDestroy(q);
+
+    char const * root = "";
+    q = JSON_QueryCompile(&root, 1);
+    m.clear();
+    CHECK(JSON_QueryRun(q, {" [1] ", 5}, CollectMatch, no_errors, &m));
+    REQUIRE(m.size() == 1);
+    CHECK(m[0].raw == "[1]");
+    JSON_QueryDestroy(q);
+
+    // Errors in skipped parts are still found if they break the structure
+    char const * deep = "/a/x";
+    q = JSON_QueryCompile(&deep, 1);
+    m.clear();
+    CHECK_FALSE(JSON_QueryRun(q, {"{\"a\": {\"b\": [1, \"]\", [", 22}, CollectMatch, [](json_error_severity_e, json_error_e error, json_buffer_t const *, json_location_t const *, void *, char const *, int, int) {
+        CHECK(error == JSON_ERR_IncompleteInput);
+    }, &m));
+    CHECK_FALSE(JSON_QueryRun(q, {"{\"a\": [", 7}, CollectMatch, nullptr, &m));     // No error callback
+    m.clear();
+    CHECK(JSON_QueryRun(q, {"{\"a\": {\"x\": 2}}", 16}, CollectMatch, nullptr, &m));
+    REQUIRE(m.size() == 1);
+    CHECK(m[0].raw == "2");
+    JSON_QueryDestroy(q);
+
+    char const * bad [] = {"a/b", "/a~2"};
+    CHECK(nullptr == JSON_QueryCompile(bad, 1));
+    CHECK(nullptr == JSON_QueryCompile(bad + 1, 1));
+}
+
+namespace {
+// Like ContentTrace, without locations (which can't agree between text and binary input.)
+json_user_handle_t ShapeTraceElement (
+    json_elem_type_e elem_type, json_user_handle_t self, json_value_t value, json_user_handle_t parent,
+    json_buffer_t const * input, json_location_t const * location, void * user_data
+) {
+    auto t = static_cast<ContentTrace *>(user_data);
+    std::uintptr_t handle = (JSON_ETYPE_ObjectBegin == elem_type || JSON_ETYPE_ArrayBegin == elem_type) ? t->next_handle++ : 0;
+    std::string e = std::to_string(elem_type) + " " + std::to_string((std::uintptr_t)self) + " " + std::to_string((std::uintptr_t)parent)
+        + " d" + std::to_string(location->depth) + " v" + std::to_string(value.type) + " ";
+    switch (value.type) {
+    case JSON_VTYPE_Bool: e += std::to_string(value.data.b); break;
+    case JSON_VTYPE_Int: e += std::to_string(value.data.i); break;
+    case JSON_VTYPE_Real: e += std::to_string(value.data.r); break;
+    case JSON_VTYPE_String: e.append(input->ptr + value.data.s.begin, value.data.s.end - value.data.s.begin); break;
+    default: break;
+    }
+    t->events.push_back(e);
+    return reinterpret_cast<json_user_handle_t>(handle);
+}
+
+std::string ToCBOR (std::string const & json) {
+    std::string out;
+    auto append = [&](char c) {out += c; return true;};
+    json_writer_t * w = JSON_WriterCreate(JSON_SinkToFunctor<decltype(append)>, &append, JSON_WSTYLE_CBOR, 0);
+    CHECK(JSON_WriteParsed(w, {json.data(), json_size_t(json.size())}, ContentTraceError, nullptr));
+    CHECK(JSON_WriterFinish(w));
+    JSON_WriterDestroy(w);
+    return out;
+}
+}
+
+TEST_CASE("CBOR output", "[json]") {
+    CHECK(ToCBOR(R"({"a": [1, -2, true, null, 1.5, 1000, -1000]})") ==
+        std::string("\xBF\x61" "a" "\x9F\x01\x21\xF5\xF6\xFA\x3F\xC0\x00\x00\x19\x03\xE8\x39\x03\xE7\xFF\xFF", 21));
+    CHECK(ToCBOR("[0.1, \"\\u00e9\", -9223372036854775808]") ==
+        std::string("\x9F\xFB\x3F\xB9\x99\x99\x99\x99\x99\x9A\x62\xC3\xA9\x3B\x7F\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF", 23));
+}
+
+TEST_CASE("CBOR input gives the same events as text", "[json]") {
+    std::string const json = R"({"name": "x\"y", "list": [1, -1, 2.5, 1e300, -1e-300, true, false, null, {}, [], 4294967296],)"
+        R"( "nested": {"deeper": {"deepest": [[[]]]}}, "big": -9223372036854775807})";
+    std::string const cbor = ToCBOR(json);
+
+    // Strings come out unescaped from CBOR, so compare against text without escapes
+    std::string plain = json;
+    plain.replace(plain.find("x\\\"y"), 4, "x'y");
+    std::string cbor_plain = cbor;
+    cbor_plain[cbor_plain.find("x\"y") + 1] = '\'';
+
+    ContentTrace text, binary;
+    JSON_Parse({plain.data(), json_size_t(plain.size())}, ShapeTraceElement, ContentTraceError, &text);
+    CHECK(JSON_CBORParse({cbor_plain.data(), json_size_t(cbor_plain.size())}, ShapeTraceElement, ContentTraceError, &binary) == cbor_plain.size());
+    CHECK(text.events == binary.events);
+
+    // Every truncation is an error, and never reads past the end
+    for (size_t n = 0; n < cbor.size(); ++n) {
+        std::vector<char> cut (cbor.begin(), cbor.begin() + n);
+        Collected c;
+        JSON_CBORParse({cut.data(), json_size_t(n)}, CountElements, RecordError, &c);
+        CHECK(c.errors == 1);
+        CHECK(c.last_error == JSON_ERR_IncompleteInput);
+    }
+}
+
+TEST_CASE("CBOR input from other encoders", "[json]") {
+    auto parse = [](std::string const & cbor) {
+        Collected c;
+        JSON_CBORParse({cbor.data(), json_size_t(cbor.size())}, CountElements, RecordError, &c);
+        return c;
+    };
+    // From RFC 8949, appendix A
+    Collected c = parse(std::string("\x1B\x00\x00\x00\xE8\xD4\xA5\x10\x00", 9));
+    CHECK(c.last_value.data.i == 1000000000000LL);
+    c = parse("\x3B\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF");     // -18446744073709551616 doesn't fit
+    CHECK(c.last_value.type == JSON_VTYPE_Real);
+    c = parse(std::string("\xF9\x3C\x00", 3));
+    CHECK(c.last_value.data.r == 1.0);
+    c = parse(std::string("\xF9\xC4\x00", 3));
+    CHECK(c.last_value.data.r == -4.0);
+    c = parse(std::string("\xF9\x00\x01", 3));
+    CHECK(c.last_value.data.r == 5.960464477539063e-8);
+    c = parse("\xC1\x1A\x51\x4B\x67\xB0");    // A tagged epoch time
+    CHECK(c.last_value.data.i == 1363896240);
+    c = parse("\xA2\x61" "a" "\x01\x61" "b" "\x82\x02\x03");
+    CHECK(c.errors == 0);
+    CHECK(c.elements == 9);
+    CHECK(c.last_value.data.i == 3);
+    c = parse("\xF7");  // undefined
+    CHECK(c.last_value.type == JSON_VTYPE_Null);
+
+    CHECK(parse("\xA1\x01\x02").last_error == JSON_ERR_Unsupported);    // Integer key
+    CHECK(parse("\x7F\x61" "a" "\xFF").last_error == JSON_ERR_Unsupported);
+    CHECK(parse("\xF0").last_error == JSON_ERR_Unsupported);
+    CHECK(parse("\xFF").last_error == JSON_ERR_Unsupported);
+    CHECK(parse("\x1C").last_error == JSON_ERR_ExpectedValue);
+
+    // Definite lengths that can't fit in what's left of the input; a count of 2^64 - 1 isn't "indefinite" either
+    CHECK(parse("\x9B\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF").last_error == JSON_ERR_IncompleteInput);
+    CHECK(parse("\xBB\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF").last_error == JSON_ERR_IncompleteInput);
+    CHECK(parse("\x83\x01\x02").last_error == JSON_ERR_IncompleteInput);
+    CHECK(parse("\xA2\x61" "a" "\x01").last_error == JSON_ERR_IncompleteInput);
+    c = parse("\x9F\x01\x02\xFF");     // Indefinite-length arrays are still fine
+    CHECK(c.errors == 0);
+    CHECK(c.elements == 4);
+}
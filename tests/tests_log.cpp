@@ -0,0 +1,177 @@
+#include "../experimental/y_log.hpp"
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::vector<std::string> ReadLines (char const * path) {
+    std::vector<std::string> ret;
+    std::ifstream f (path);
+    for (std::string line; std::getline(f, line); )
+        ret.push_back(line);
+    return ret;
+}
+}
+
+TEST_CASE("SPSC ring keeps records whole and in order", "[log]") {
+    alignas(8) char mem [256];
+    y::Lockfree::SPSCRing ring {mem, sizeof(mem)};
+    unsigned size = 0;
+
+    REQUIRE(ring.empty());
+    REQUIRE(ring.peek(size) == nullptr);
+    REQUIRE(ring.reserve(200) == nullptr);     // More than half the ring
+
+    // Odd sizes, so records keep landing at different offsets and wrap around
+    unsigned next_in = 0, next_out = 0;
+    for (int round = 0; round < 200; ++round) {
+        for (;;) {
+            unsigned const n = 1 + (next_in * 7) % 60;
+            auto p = static_cast<unsigned char *>(ring.reserve(n));
+            if (!p)
+                break;
+            REQUIRE((uintptr_t(p) & 7) == 0);
+            for (unsigned i = 0; i < n; ++i)
+                p[i] = (unsigned char)(next_in + i);
+            ring.commit();
+            next_in++;
+        }
+        for (int k = 0; k < 3; ++k) {
+            auto p = static_cast<unsigned char const *>(ring.peek(size));
+            REQUIRE(p != nullptr);
+            REQUIRE(size == 1 + (next_out * 7) % 60);
+            bool intact = true;
+            for (unsigned i = 0; i < size; ++i)
+                intact = intact && p[i] == (unsigned char)(next_out + i);
+            REQUIRE(intact);
+            ring.release();
+            next_out++;
+        }
+    }
+    while (ring.peek(size)) {
+        ring.release();
+        next_out++;
+    }
+    REQUIRE(next_out == next_in);
+    REQUIRE(ring.empty());
+}
+
+TEST_CASE("Log messages from several threads reach the file", "[log]") {
+    char const * const path = "tests_log_out.log";
+    ::remove(path);
+
+    y::Log::Config config;
+    config.path = path;
+    config.when_full = y::Log::FullPolicy::Block;
+    config.ring_size = 4096;    // Small, so the producers have to wait sometimes
+    config.min_level = y::Log::Level::Debug;
+    REQUIRE(y::Log::Start(config));
+    REQUIRE_FALSE(y::Log::Start(config));
+
+    constexpr int Threads = 3, PerThread = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t)
+        threads.emplace_back([t] {
+            std::string const name = "worker-" + std::to_string(t);
+            for (int i = 0; i < PerThread; ++i)
+                y::Log::Info("{} says {} ({w4r}, {})", name, i, t, 0.5);
+        });
+    for (auto & th : threads)
+        th.join();
+    CHECK_FALSE(y::Log::Trace("filtered out"));
+    char buffer [16] = "on the stack";
+    CHECK(y::Log::Warning("{}|{}|{}", buffer, std::string_view{"view"}, 'c'));
+    y::Log::Stop();
+    CHECK_FALSE(y::Log::Info("after stop"));
+
+    auto lines = ReadLines(path);
+    REQUIRE(lines.size() == Threads * PerThread + 1);
+    std::vector<int> next (Threads, 0);
+    for (auto & line : lines) {
+        REQUIRE(line.size() > 33);
+        CHECK(line[4] == '-');
+        CHECK(line[19] == '.');
+        if (line.find("WARN") != std::string::npos) {
+            CHECK(line.substr(33) == "on the stack|view|c");
+            continue;
+        }
+        CHECK(line.substr(26, 7) == " INFO  ");
+        int t = line[33 + 7] - '0';
+        REQUIRE((0 <= t && t < Threads));
+        // Each thread's messages stay in order
+        CHECK(line.substr(33) == "worker-" + std::to_string(t) + " says " + std::to_string(next[t]) + " (   " + std::to_string(t) + ", 0.5)");
+        next[t]++;
+    }
+    ::remove(path);
+}
+
+TEST_CASE("Ring sizes that can't work are refused", "[log]") {
+    y::Log::Config config;
+    for (unsigned size : {0u, 1u, 64u, 96u, 100u, 1000u, 4095u}) {
+        config.ring_size = size;
+        CHECK_FALSE(y::Log::Start(config));
+        CHECK_FALSE(y::Log::Info("not running"));
+    }
+    config.ring_size = y::Log::detail::Logger::MinRingSize;
+    CHECK_FALSE(y::Log::Start(config));     // Not a power of two
+    config.ring_size = 128;
+    REQUIRE(y::Log::Start(config));
+    y::Log::Stop();
+}
+
+TEST_CASE("Log files are rotated", "[log]") {
+    char const * const path = "tests_log_rot.log";
+    std::string const p1 = std::string(path) + ".1", p2 = std::string(path) + ".2";
+    ::remove(path); ::remove(p1.c_str()); ::remove(p2.c_str());
+
+    y::Log::Config config;
+    config.path = path;
+    config.when_full = y::Log::FullPolicy::Block;
+    config.max_file_size = 1000;
+    config.max_files = 1;
+    REQUIRE(y::Log::Start(config));
+    for (int i = 0; i < 100; ++i)
+        y::Log::Error("line {w3f0r} of some padding text", i);
+    y::Log::Stop();
+
+    auto cur = ReadLines(path);
+    auto old = ReadLines(p1.c_str());
+    CHECK(ReadLines(p2.c_str()).empty());
+    REQUIRE(!cur.empty());
+    REQUIRE(!old.empty());
+    CHECK(old.size() * 60 < 1100);
+    CHECK(cur.back().substr(33) == "line 099 of some padding text");
+    ::remove(path); ::remove(p1.c_str());
+}
+
+TEST_CASE("Full rings drop and count messages", "[log]") {
+    char const * const path = "tests_log_drop.log";
+    ::remove(path);
+
+    y::Log::Config config;
+    config.path = path;
+    config.ring_size = 1024;
+    config.idle_wait_ms = 50;
+    REQUIRE(y::Log::Start(config));
+    int logged = 0;
+    std::thread th ([&] {   // A fresh thread, so it gets a ring of this size
+        for (int i = 0; i < 1000; ++i)
+            logged += y::Log::Info("message {}", i) ? 1 : 0;
+    });
+    th.join();
+    y::Log::Stop();
+
+    auto lines = ReadLines(path);
+    uint64_t dropped_lines = 0;
+    for (auto & line : lines)
+        if (line.find("messages dropped") != std::string::npos)
+            dropped_lines++;
+    CHECK(lines.size() - dropped_lines == unsigned(logged));
+    CHECK(y::Log::DroppedCount() == uint64_t(1000 - logged));
+    CHECK((dropped_lines > 0) == (logged < 1000));
+    ::remove(path);
+}
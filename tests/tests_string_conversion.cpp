@@ -2,6 +2,12 @@
 #include "../experimental/y_string_conversion.hpp"
 #include "catch.hpp"
 
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
 #include <string>
 using namespace std::string_literals;
 
@@ -98,3 +104,348 @@ TEST_CASE("Basics 1", "[cvt]") {
     CHECK(res.size == 7);
     CHECK(buffer == "10'010C"s);
 }
+
+TEST_CASE("Base-10 and base-16 fast paths match std::to_chars", "[cvt]") {
+    char buffer [100], expected [100];
+    auto check = [&] (auto v, int base, bool uppercase) {
+        auto res = y::cvt::i2s(buffer, sizeof(buffer), v, (unsigned char)base, uppercase, 0, '\'', true);
+        auto end = std::to_chars(expected, expected + sizeof(expected), v, base).ptr;
+        std::string exp (expected, end);
+        if (uppercase)
+            for (auto & c : exp) c = char(std::toupper(c));
+        return res.succeeded && res.size == exp.size() && buffer == exp;
+    };
+
+    std::mt19937_64 rng (42);
+    bool all_good = true;
+    for (int i = 0; i < 20000; ++i) {
+        unsigned long long const v = rng() >> (rng() % 64);
+        all_good = all_good && check(v, 10, false) && check(v, 16, false) && check(v, 16, true);
+        all_good = all_good && check((long long)v, 10, false) && check(-(long long)(v >> 1), 10, false);
+        all_good = all_good && check(unsigned(v), 10, false) && check(int(v), 16, false);
+    }
+    CHECK(all_good);
+    for (unsigned long long p = 1; p != 0 && p <= 10000000000000000000ULL; p *= 10)
+        CHECK((check(p - 1, 10, false) && check(p, 10, false) && check(p + 1, 10, false)));
+    CHECK(check(~0ULL, 10, false));
+    CHECK(check(~0ULL, 16, true));
+    CHECK(check(std::numeric_limits<long long>::min(), 10, false));
+    CHECK(check(std::numeric_limits<signed char>::min(), 16, false));
+}
+
+TEST_CASE("Digit grouping and short buffers", "[cvt]") {
+    char buffer [100];
+
+    auto res = y::cvt::i2s(buffer, sizeof(buffer), 18446744073709551615ULL, 10, false, 3, ',', true);
+    CHECK(res.succeeded);
+    CHECK(buffer == "18,446,744,073,709,551,615"s);
+
+    res = y::cvt::i2s(buffer, sizeof(buffer), -1234567, 10, false, 3, '\'', true);
+    CHECK(res.succeeded);
+    CHECK(buffer == "-1'234'567"s);
+
+    res = y::cvt::i2s(buffer, sizeof(buffer), 123456, 10, false, 2, '_', true);
+    CHECK(buffer == "12_34_56"s);
+    res = y::cvt::i2s(buffer, sizeof(buffer), 1234567, 10, false, 1, '.', true);
+    CHECK(buffer == "1.2.3.4.5.6.7"s);
+
+    res = y::cvt::i2s(buffer, sizeof(buffer), 0xDEADBEEFCAFEULL, 16, true, 4, ' ', true);
+    CHECK(res.size == 14);
+    CHECK(buffer == "DEAD BEEF CAFE"s);
+    res = y::cvt::i2s(buffer, sizeof(buffer), 0xABCDEu, 16, false, 2, ':', true);
+    CHECK(buffer == "a:bc:de"s);
+
+    // Too short: the fast paths leave it to the general loop, which keeps the low digits
+    res = y::cvt::i2s(buffer, 4, 123456u, 10, false, 0, '\'', false);
+    CHECK_FALSE(res.succeeded);
+    CHECK(res.size == 4);
+    CHECK(std::string(buffer, 4) == "3456");
+    res = y::cvt::i2s(buffer, 6, 123456u, 10, false, 0, '\'', true);
+    CHECK_FALSE(res.succeeded);
+    CHECK(res.size == 6);
+    res = y::cvt::i2s(buffer, 7, 123456u, 10, false, 0, '\'', true);
+    CHECK(res.succeeded);
+    CHECK(buffer == "123456"s);
+}
+
+namespace {
+template <typename T>
+std::string F2S (T v, y::cvt::FloatFormat format = y::cvt::FloatFormat::General, int precision = -1, unsigned group = 0) {
+    char buffer [1200];
+    auto res = y::cvt::f2s(buffer, sizeof(buffer), v, format, precision, group, ',', false, true);
+    return res.succeeded ? std::string(buffer, res.size) : "(failed)";
+}
+
+template <typename T>
+std::string ToChars (T v, y::cvt::FloatFormat format = y::cvt::FloatFormat::General, int precision = -1) {
+    char buffer [1200];
+    auto const fmt =
+        (y::cvt::FloatFormat::Fixed == format) ? std::chars_format::fixed :
+        (y::cvt::FloatFormat::Scientific == format) ? std::chars_format::scientific :
+        std::chars_format::general;
+    std::to_chars_result res;
+    if (precision >= 0)
+        res = std::to_chars(buffer, buffer + sizeof(buffer), v, fmt, precision);
+    else if (y::cvt::FloatFormat::General == format)
+        res = std::to_chars(buffer, buffer + sizeof(buffer), v);
+    else
+        res = std::to_chars(buffer, buffer + sizeof(buffer), v, fmt);
+    return std::string(buffer, res.ptr);
+}
+}
+
+TEST_CASE("f2s() gives the shortest digits that read back the same", "[cvt]") {
+    using y::cvt::FloatFormat;
+    CHECK(F2S(0.1) == "0.1");
+    CHECK(F2S(0.1f) == "0.1");
+    CHECK(F2S(1.0 / 3) == "0.3333333333333333");
+    CHECK(F2S(100.0) == "100");
+    CHECK(F2S(1e15) == "1e+15");
+    CHECK(F2S(1e-4) == "1e-04");
+    CHECK(F2S(-0.0) == "-0");
+    CHECK(F2S(5e-324) == "5e-324");
+    CHECK(F2S(1.7976931348623157e308) == "1.7976931348623157e+308");
+    CHECK(F2S(16777216.0f) == "16777216");
+    CHECK(F2S(1e23, FloatFormat::Scientific) == "1e+23");
+    CHECK(F2S(1e23, FloatFormat::Fixed) == "99999999999999991611392");
+    CHECK(F2S(std::numeric_limits<double>::infinity()) == "inf");
+    CHECK(F2S(-std::numeric_limits<float>::infinity()) == "-inf");
+    CHECK(F2S(std::numeric_limits<double>::quiet_NaN()) == "nan");
+
+    // Random bit patterns, so every exponent and subnormals come up
+    std::mt19937_64 rng (1234);
+    int mismatches = 0;
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t const bits = rng();
+        double d;
+        float f;
+        uint32_t const bits32 = uint32_t(bits >> 32);
+        ::memcpy(&d, &bits, sizeof(d));
+        ::memcpy(&f, &bits32, sizeof(f));
+        if (d == d && F2S(d) != ToChars(d))
+            mismatches++;
+        if (f == f && F2S(f) != ToChars(f))
+            mismatches++;
+        if (d == d && F2S(d, FloatFormat::Scientific) != ToChars(d, FloatFormat::Scientific))
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("f2s() with a precision rounds the exact value", "[cvt]") {
+    using y::cvt::FloatFormat;
+    CHECK(F2S(3.14159, FloatFormat::Fixed, 2) == "3.14");
+    CHECK(F2S(0.1, FloatFormat::Fixed, 20) == "0.10000000000000000555");
+    CHECK(F2S(0.125, FloatFormat::Fixed, 2) == "0.12");        // A real tie goes to even...
+    CHECK(F2S(0.375, FloatFormat::Fixed, 2) == "0.38");
+    CHECK(F2S(2.675, FloatFormat::Fixed, 2) == "2.67");         // ...but this one is just below 2.675
+    CHECK(F2S(9.9999, FloatFormat::Fixed, 2) == "10.00");
+    CHECK(F2S(0.004, FloatFormat::Fixed, 2) == "0.00");
+    CHECK(F2S(-0.006, FloatFormat::Fixed, 2) == "-0.01");
+    CHECK(F2S(0.0, FloatFormat::Fixed, 3) == "0.000");
+    CHECK(F2S(0.0, FloatFormat::Scientific, 2) == "0.00e+00");
+    CHECK(F2S(123456.0, FloatFormat::Scientific, 2) == "1.23e+05");
+    CHECK(F2S(0.000123456, FloatFormat::General, 3) == "0.000123");
+    CHECK(F2S(1234567.0, FloatFormat::General, 3) == "1.23e+06");
+    CHECK(F2S(100.0, FloatFormat::General, 6) == "100");
+    CHECK(F2S(5e-324, FloatFormat::Scientific, 16) == "4.9406564584124654e-324");
+    CHECK(F2S(1e300, FloatFormat::Fixed, 0).size() == 301);
+
+    std::mt19937_64 rng (4321);
+    int mismatches = 0;
+    for (int i = 0; i < 100000; ++i) {
+        double v = std::ldexp(double(rng() >> 11), int(rng() % 140) - 110);
+        if (rng() & 1)
+            v = -v;
+        int const precision = int(rng() % 25);
+        for (auto format : {FloatFormat::Fixed, FloatFormat::Scientific, FloatFormat::General})
+            if (F2S(v, format, precision) != ToChars(v, format, precision))
+                mismatches++;
+        float const f = float(v);
+        if (F2S(f, FloatFormat::Fixed, precision % 10) != ToChars(f, FloatFormat::Fixed, precision % 10))
+            mismatches++;
+        // Short decimals are where the ties are
+        double const m = double(rng() % 100000) / 1000;
+        if (F2S(m, FloatFormat::Fixed, precision % 4) != ToChars(m, FloatFormat::Fixed, precision % 4))
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("f2s() digit grouping, case and short buffers", "[cvt]") {
+    using y::cvt::FloatFormat;
+    CHECK(F2S(1234567.891, FloatFormat::Fixed, 2, 3) == "1,234,567.89");
+    CHECK(F2S(-123456.0, FloatFormat::General, -1, 3) == "-123,456");
+    CHECK(F2S(999.9996, FloatFormat::Fixed, 3, 3) == "1,000.000");
+    CHECK(F2S(1e9f, FloatFormat::Fixed, -1, 4) == "10,0000,0000");
+    CHECK(F2S(0.5, FloatFormat::Fixed, 1, 3) == "0.5");
+
+    char buffer [9];
+    auto res = y::cvt::f2s(buffer, sizeof(buffer), 1e-7, FloatFormat::Scientific, 2, 0, '\'', true, true);
+    CHECK(res.succeeded);
+    CHECK(buffer == "1.00E-07"s);
+    res = y::cvt::f2s(buffer, sizeof(buffer), -std::numeric_limits<double>::infinity(), FloatFormat::General, -1, 0, '\'', true, true);
+    CHECK(res.succeeded);
+    CHECK(buffer == "-INF"s);
+    res = y::cvt::f2s(buffer, sizeof(buffer), 3.0, FloatFormat::Fixed, 7, 0, '\'', false, true);
+    CHECK_FALSE(res.succeeded);
+    res = y::cvt::f2s(buffer, sizeof(buffer), 3.0, FloatFormat::Fixed, 6, 0, '\'', false, true);
+    CHECK(res.succeeded);
+    CHECK(res.size == 8);
+    CHECK(buffer == "3.000000"s);
+
+    // General's precision counts significant digits, not characters
+    char short_buffer [10];
+    res = y::cvt::f2s(short_buffer, sizeof(short_buffer), 1.00000000001, FloatFormat::General, 12);
+    CHECK_FALSE(res.succeeded);
+    CHECK(std::string(short_buffer, res.size) == "1.00000000");
+    char long_buffer [14];
+    res = y::cvt::f2s(long_buffer, sizeof(long_buffer), 1.00000000001, FloatFormat::General, 12, 0, '\'', false, true);
+    CHECK(res.succeeded);
+    CHECK(long_buffer == "1.00000000001"s);
+    char tiny_buffer [4];
+    res = y::cvt::f2s(tiny_buffer, sizeof(tiny_buffer), 0.1, FloatFormat::General, 30);
+    CHECK_FALSE(res.succeeded);
+    res = y::cvt::f2s(tiny_buffer, sizeof(tiny_buffer), 0.1, FloatFormat::General, 3);
+    CHECK(res.succeeded);
+    CHECK(std::string(tiny_buffer, res.size) == "0.1");
+
+    // A wide separator goes out as it is
+    wchar_t wide [16];
+    auto wres = y::cvt::f2s(wide, 16, 1234567.0, FloatFormat::Fixed, 0, 3, L'\u202F', false, true);
+    CHECK(wres.succeeded);
+    CHECK(std::wstring(wide) == L"1\u202F234\u202F567");
+}
+
+TEST_CASE("s2i() reads integers in any base", "[cvt]") {
+    int i = 0;
+    auto res = y::cvt::s2i("-12345xyz", 9, i);
+    CHECK(res.succeeded);
+    CHECK(res.size == 6);
+    CHECK(i == -12345);
+
+    unsigned long long u = 0;
+    res = y::cvt::s2i("18446744073709551615", 20, u);
+    CHECK(res.succeeded);
+    CHECK(u == 18446744073709551615ULL);
+    res = y::cvt::s2i("18446744073709551616", 20, u);
+    CHECK_FALSE(res.succeeded);
+    CHECK(res.size == 20);
+    CHECK(u == 18446744073709551615ULL);
+
+    signed char c = 0;
+    res = y::cvt::s2i("-128", 4, c);
+    CHECK(res.succeeded);
+    CHECK(c == -128);
+    res = y::cvt::s2i("128", 3, c);
+    CHECK_FALSE(res.succeeded);
+    CHECK(c == 127);
+
+    res = y::cvt::s2i("1'234'567", 9, i, 10, '\'');
+    CHECK(res.succeeded);
+    CHECK(i == 1234567);
+    res = y::cvt::s2i("1''234", 6, i, 10, '\'');   // Only between two digits
+    CHECK(res.size == 1);
+    CHECK(i == 1);
+    res = y::cvt::s2i("12'", 3, i, 10, '\'');
+    CHECK(res.size == 2);
+
+    res = y::cvt::s2i("ff_FF", 5, i, 16, '_');
+    CHECK(i == 0xFFFF);
+    res = y::cvt::s2i("0x1F", 4, i, 0);
+    CHECK(res.size == 4);
+    CHECK(i == 31);
+    res = y::cvt::s2i("0b101", 5, i, 0);
+    CHECK(i == 5);
+    res = y::cvt::s2i("0xg", 3, i, 0);
+    CHECK(res.size == 1);
+    CHECK(i == 0);
+    res = y::cvt::s2i("zz", 2, i, 36);
+    CHECK(i == 36 * 36 - 1);
+
+    res = y::cvt::s2i("-5", 2, u);
+    CHECK_FALSE(res.succeeded);
+    CHECK(res.size == 0);
+    res = y::cvt::s2i("", 0, i);
+    CHECK_FALSE(res.succeeded);
+
+    // Long runs of digits go eight at a time
+    std::mt19937_64 rng (77);
+    int mismatches = 0;
+    for (int k = 0; k < 100000; ++k) {
+        std::string const s = std::to_string(rng() >> (rng() % 64)) + (k % 2 ? "" : " ");
+        unsigned long long ours = 0, expected = 0;
+        auto r = y::cvt::s2i(s.data(), unsigned(s.size()), ours);
+        std::from_chars(s.data(), s.data() + s.size(), expected);
+        if (!r.succeeded || ours != expected || r.size != s.size() - (k % 2 ? 0 : 1))
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("s2f() reads back what f2s() writes, correctly rounded", "[cvt]") {
+    auto parse = [] (std::string const & s, unsigned expected_size = ~0U) {
+        double d = -1;
+        auto res = y::cvt::s2f(s.data(), unsigned(s.size()), d);
+        CHECK(res.size == (~0U == expected_size ? s.size() : expected_size));
+        return d;
+    };
+    CHECK(parse("0.1") == 0.1);
+    CHECK(parse("-1.5e-3") == -1.5e-3);
+    CHECK(parse(".5") == 0.5);
+    CHECK(parse("5.") == 5.0);
+    CHECK(parse("1e5x", 3) == 1e5);
+    CHECK(parse("1e", 1) == 1.0);
+    CHECK(parse("2.4703282292062328e-324") == 5e-324);    // Just over half the smallest subnormal
+    CHECK(parse("2.4703282292062327e-324") == 0.0);
+    CHECK(parse("9007199254740993") == 9007199254740992.0);  // A tie goes to even
+    // More digits than fit in 64 bits, just above that tie
+    CHECK(parse("9007199254740993.00000000000000000000001") == 9007199254740994.0);
+    CHECK(parse("inf") == std::numeric_limits<double>::infinity());
+    CHECK(parse("-Infinity") == -std::numeric_limits<double>::infinity());
+    CHECK(std::isnan(parse("nan")));
+
+    double d = 0;
+    auto res = y::cvt::s2f("1,234,567.5", 11, d, ',');
+    CHECK(res.succeeded);
+    CHECK(d == 1234567.5);
+    res = y::cvt::s2f("1e400", 5, d);
+    CHECK_FALSE(res.succeeded);
+    CHECK(d == std::numeric_limits<double>::infinity());
+    res = y::cvt::s2f("-.e1", 4, d);
+    CHECK_FALSE(res.succeeded);
+    CHECK(res.size == 0);
+
+    float f = 0;
+    res = y::cvt::s2f("3.4028235e38", 12, f);
+    CHECK(res.succeeded);
+    CHECK(f == std::numeric_limits<float>::max());
+
+    std::mt19937_64 rng (88);
+    int mismatches = 0;
+    for (int k = 0; k < 100000; ++k) {
+        uint64_t const bits = rng();
+        double v;
+        ::memcpy(&v, &bits, sizeof(v));
+        if (!std::isfinite(v))
+            continue;
+        char buffer [64];
+        auto r = y::cvt::f2s(buffer, sizeof(buffer), v);
+        double back = 0;
+        y::cvt::s2f(buffer, r.size, back);
+        if (::memcmp(&back, &v, sizeof(v)))
+            mismatches++;
+
+        // Random digit strings, many too long for 64 bits
+        std::string s;
+        for (int n = int(rng() % 30) + 1; n > 0; --n)
+            s += char('0' + rng() % 10);
+        s += "e" + std::to_string(int(rng() % 660) - 330);
+        double ours = 0, expected = 0;
+        y::cvt::s2f(s.data(), unsigned(s.size()), ours);
+        std::from_chars(s.data(), s.data() + s.size(), expected);
+        if (ours != expected && std::isfinite(ours))
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+}
@@ -5,7 +5,7 @@
 #define Y_OPT_FMT_SUPPORT_STDIO                     1
 #define Y_OPT_FMT_SUPPORT_IOSTREAM                  1
 #define Y_OPT_FMT_SUPPORT_STD_STRING                1
-#define Y_OPT_FMT_STD_STRING_OUTPUT_PRECALC_SIZE    1
+#define Y_OPT_FMT_STD_STRING_STACK_BUFFER_SIZE      256
 #define Y_OPT_FMT_MAX_REAL_NUM_CHAR_SIZE            100
 #define Y_OPT_FMT_MAX_INTEGER_NUM_CHAR_SIZE         64
 
@@ -14,7 +14,10 @@
 //#define _HAS_COMPLETE_CHARCONV  1
 
 #include <cstdint>
-#include <utility>  // std::forward
+#include <cstring>  // memcpy(), memset()
+#include <type_traits>
+#include <utility>  // std::forward, std::index_sequence
+#include <tuple>    // std::forward_as_tuple, for compiled formats
 #include <charconv> // std::to_chars() for float/double/long double
 #if defined(Y_OPT_FMT_SUPPORT_STD_STRING)
     #include <string>
@@ -108,13 +111,55 @@ static_assert(sizeof(Flags) == 8, "");
 //template <typename OutF, typename T>
 //void ToStr (OutF && out, T const & v, Flags flags);
 
+//----------------------------------------------------------------------
+// An output functor is called with one character at a time. It can also
+//  have a "write(char const *, size_t)" member, which takes a whole run
+//  (of literal text, digits or padding) at once; both return false to stop.
+
+template <typename OutF, typename = void>
+struct HasWrite : std::false_type {};
+template <typename OutF>
+struct HasWrite<OutF, std::void_t<decltype(std::declval<OutF &>().write((char const *)nullptr, size_t(0)))>> : std::true_type {};
+
+template <typename OutF>
+inline constexpr bool HasWriteV = HasWrite<std::remove_reference_t<OutF>>::value;
+
+template <typename OutF, typename Char>
+inline bool PutRun (OutF && out, Char const * str, size_t size) {
+    bool ret = true;
+    if constexpr (HasWriteV<OutF> && std::is_same_v<Char, char>) {
+        if (size > 0)
+            ret = bool(out.write(str, size));
+    } else {
+        for (size_t i = 0; i < size && ret; ++i)
+            ret = bool(out(str[i]));
+    }
+    return ret;
+}
+
+template <typename OutF, typename Char>
+inline bool PutFill (OutF && out, Char c, size_t count) {
+    bool ret = true;
+    if constexpr (HasWriteV<OutF> && std::is_same_v<Char, char>) {
+        char fill [32];
+        ::memset(fill, c, count < sizeof(fill) ? count : sizeof(fill));
+        for (; count > sizeof(fill) && ret; count -= sizeof(fill))
+            ret = bool(out.write(fill, sizeof(fill)));
+        if (count > 0 && ret)
+            ret = bool(out.write(fill, count));
+    } else {
+        for (size_t i = 0; i < count && ret; ++i)
+            ret = bool(out(c));
+    }
+    return ret;
+}
+
 //----------------------------------------------------------------------
 
 template <typename OutF>
 void ToStr (OutF && out, char const * v) {
     if (v)
-        while (*v)
-            out(*v++);
+        PutRun(std::forward<OutF>(out), v, ::strlen(v));
     //else
     //    ToStr(std::forward<OutF>(out), "(null)");
 }
@@ -122,29 +167,26 @@ void ToStr (OutF && out, char const * v) {
 #if defined(Y_OPT_FMT_SUPPORT_STD_STRING)
 template <typename OutF, typename C>
 void ToStr (OutF && out, std::basic_string<C> const & v) {
-    for (auto c : v)
-        out(c);
+    PutRun(std::forward<OutF>(out), v.data(), v.size());
 }
 #endif  // defined(Y_OPT_FMT_SUPPORT_STD_STRING)
 
 #if defined(Y_OPT_FMT_SUPPORT_STD_STRING)
 template <typename OutF, typename C>
 void ToStr (OutF && out, std::basic_string_view<C> const & v) {
-    for (auto c : v)
-        out(c);
+    PutRun(std::forward<OutF>(out), v.data(), v.size());
 }
 #endif  // defined(Y_OPT_FMT_SUPPORT_STD_STRING)
 
 template <typename OutF>
 void ToStr (OutF && out, unsigned long long v) {
-    int cnt = 0;
     char buffer [20];
+    int first = sizeof(buffer);
     do {
-        buffer[cnt++] = '0' + (v % 10);
+        buffer[--first] = '0' + (v % 10);
         v /= 10;
     } while (v > 0);
-    for (int i = cnt - 1; i >= 0; --i)
-        out(buffer[i]);
+    PutRun(std::forward<OutF>(out), buffer + first, sizeof(buffer) - first);
 }
 
 template <typename OutF>
@@ -179,24 +221,21 @@ template <typename OutF>
 void ToStr (OutF && out, float v) {
     char buffer [Y_OPT_FMT_MAX_REAL_NUM_CHAR_SIZE];
     auto res = std::to_chars(buffer, buffer + sizeof(buffer), v);
-    for (char const * p = buffer; p != res.ptr; ++p)
-        out(*p);
+    PutRun(std::forward<OutF>(out), buffer, res.ptr - buffer);
 }
 
 template <typename OutF>
 void ToStr (OutF && out, double v) {
     char buffer [Y_OPT_FMT_MAX_REAL_NUM_CHAR_SIZE];
     auto res = std::to_chars(buffer, buffer + sizeof(buffer), v);
-    for (char const * p = buffer; p != res.ptr; ++p)
-        out(*p);
+    PutRun(std::forward<OutF>(out), buffer, res.ptr - buffer);
 }
 
 template <typename OutF>
 void ToStr (OutF && out, long double v) {
     char buffer [Y_OPT_FMT_MAX_REAL_NUM_CHAR_SIZE];
     auto res = std::to_chars(buffer, buffer + sizeof(buffer), v);
-    for (char const * p = buffer; p != res.ptr; ++p)
-        out(*p);
+    PutRun(std::forward<OutF>(out), buffer, res.ptr - buffer);
 }
 
 template <typename OutF>
@@ -229,10 +268,10 @@ void ToStrHelper (OutF && out, Char const * str, unsigned size, Flags const flag
         else if (flags.justify == Justify::CenterRight) {pad_before = (total_pad + 1) / 2; pad_after = total_pad / 2;}
     }
 
-    for (unsigned i = 0; i < pad_before; ++i) out(fill_char);
     //if (needs_sign) out(is_negative ? '-' : (flags.sign == Sign::Always ? '+' : ' '));
-    for (unsigned i = 0; i < size; ++i) out(str[i]);
-    for (unsigned i = 0; i < pad_after; ++i) out(fill_char);
+    PutFill(out, fill_char, pad_before)
+        && PutRun(out, str, size)
+        && PutFill(out, fill_char, pad_after);
 }
 
 namespace detail {
@@ -260,9 +299,7 @@ std::enable_if_t<
     std::is_same_v<CharT, char32_t>>
 ToStr (OutF && out, CharT const * v, Flags flags) {
     if (0 == flags.has_any_non_defaults) {
-        if (v)
-            while (*v)
-                out(*v++);
+        PutRun(std::forward<OutF>(out), v, detail::StrLen(v));
     } else {
         unsigned size = detail::StrLen(v);
         ToStrHelper(std::forward<OutF>(out), v, size, flags);
@@ -273,8 +310,7 @@ ToStr (OutF && out, CharT const * v, Flags flags) {
 template <typename OutF, typename C>
 void ToStr (OutF && out, std::basic_string<C> const & v, Flags flags) {
     if (0 == flags.has_any_non_defaults) {
-        for (auto const c : v)
-            out(c);
+        PutRun(std::forward<OutF>(out), v.data(), v.size());
     } else {
         ToStrHelper(std::forward<OutF>(out), v.data(), unsigned(v.size()), flags);
     }
@@ -285,8 +321,7 @@ void ToStr (OutF && out, std::basic_string<C> const & v, Flags flags) {
 template <typename OutF, typename C>
 void ToStr (OutF && out, std::basic_string_view<C> const & v, Flags flags) {
     if (0 == flags.has_any_non_defaults) {
-        for (auto const c : v)
-            out(c);
+        PutRun(std::forward<OutF>(out), v.data(), v.size());
     } else {
         ToStrHelper(std::forward<OutF>(out), v.data(), unsigned(v.size()), flags);
     }
@@ -308,8 +343,7 @@ ToStr (OutF && out, RealT v, Flags flags) {
 
     if (0 == flags.has_any_non_defaults) {
         res = std::to_chars(buffer, buffer + sizeof(buffer), v);
-        for (char const * p = buffer; p != res.ptr; ++p)
-            out(*p);
+        PutRun(std::forward<OutF>(out), buffer, res.ptr - buffer);
     } else {
         //bool is_negative = false;
         //if (flags.overridden.sign && v < 0) {
@@ -328,8 +362,7 @@ ToStr (OutF && out, RealT v, Flags flags) {
         if (flags.overridden.width || flags.overridden.fill || flags.overridden.justify /*|| flags.overridden.sign*/)
             ToStrHelper(std::forward<OutF>(out), buffer, unsigned(res.ptr - buffer), flags/*, true, is_negative*/);
         else
-            for (char const * p = buffer; p != res.ptr; ++p)
-                out(*p);
+            PutRun(std::forward<OutF>(out), buffer, res.ptr - buffer);
     }
 }
 
@@ -355,8 +388,7 @@ ToStr (OutF && out, IntT v, Flags flags) {
 
     if (0 == flags.has_any_non_defaults) {
         res = std::to_chars(buffer, buffer + sizeof(buffer), v);
-        for (char const * p = buffer; p != res.ptr; ++p)
-            out(*p);
+        PutRun(std::forward<OutF>(out), buffer, res.ptr - buffer);
     } else {
         int base = (flags.overridden.base ? flags.base : 10);
         if (base < 2) base = 2;
@@ -366,8 +398,7 @@ ToStr (OutF && out, IntT v, Flags flags) {
         if (flags.overridden.width || flags.overridden.fill || flags.overridden.justify /*|| flags.overridden.sign*/)
             ToStrHelper(std::forward<OutF>(out), buffer, unsigned(res.ptr - buffer), flags/*, true, is_negative*/);
         else
-            for (char const * p = buffer; p != res.ptr; ++p)
-                out(*p);
+            PutRun(std::forward<OutF>(out), buffer, res.ptr - buffer);
     }
 }
 
@@ -418,78 +449,160 @@ enum class Err {
 
 //----------------------------------------------------------------------
 
-template <typename OutF, typename T>
-inline bool EmitValue (OutF && out, T && v, cvt::Flags flags) {
-    //if (0 == flags.has_any_non_defaults)
-    //    cvt::ToStr(std::forward<OutF>(out), std::forward<T>(v));
-    //else    // flags have something non-default in them...
-    //    cvt::ToStr(std::forward<OutF>(out), std::forward<T>(v), flags);
-    //return true;
-    
-    cvt::ToStr(std::forward<OutF>(out), std::forward<T>(v), flags);
-    return true;
-}
-
-template <typename ErrF, typename OutF, typename InF>
-inline bool EmitArg (unsigned /*idx*/, cvt::Flags flags, ErrF && err, OutF && out, InF && in) {
-    err(Err::TooFewArgs, std::forward<OutF>(out), std::forward<InF>(in));
-    return false;
-}
-template <typename ErrF, typename OutF, typename InF, typename ArgType0>
-inline bool EmitArg (unsigned idx, cvt::Flags flags, ErrF && err, OutF && out, InF && in, ArgType0 && arg0) {
-    switch (idx) {
-    case  0: return EmitValue(std::forward<OutF>(out), std::forward<ArgType0>(arg0), flags);
-    default: err(Err::TooFewArgs, std::forward<OutF>(out), std::forward<InF>(in)); return false;
-    }
-}
-template <typename ErrF, typename OutF, typename InF, typename ArgType0, typename ArgType1>
-inline bool EmitArg (unsigned idx, cvt::Flags flags, ErrF && err, OutF && out, InF && in, ArgType0 && arg0, ArgType1 && arg1) {
-    switch (idx) {
-    case  0: return EmitValue(std::forward<OutF>(out), std::forward<ArgType0>(arg0), flags);
-    case  1: return EmitValue(std::forward<OutF>(out), std::forward<ArgType1>(arg1), flags);
-    default: err(Err::TooFewArgs, std::forward<OutF>(out), std::forward<InF>(in)); return false;
-    }
-}
-template <typename ErrF, typename OutF, typename InF, typename ArgType0, typename ArgType1, typename ArgType2>
-inline bool EmitArg (unsigned idx, cvt::Flags flags, ErrF && err, OutF && out, InF && in, ArgType0 && arg0, ArgType1 && arg1, ArgType2 && arg2) {
-    switch (idx) {
-    case  0: return EmitValue(std::forward<OutF>(out), std::forward<ArgType0>(arg0), flags);
-    case  1: return EmitValue(std::forward<OutF>(out), std::forward<ArgType1>(arg1), flags);
-    case  2: return EmitValue(std::forward<OutF>(out), std::forward<ArgType2>(arg2), flags);
-    default: err(Err::TooFewArgs, std::forward<OutF>(out), std::forward<InF>(in)); return false;
+// The run-time formatter is one non-template function (DoArgs(),) no matter
+//  how many arguments there are or what types they have: Do() packs the
+//  arguments into an array of tagged values on the stack, and hands DoArgs()
+//  type-erased references to its output, input and error functors.
+
+struct OutRef {
+    void * obj;
+    bool (*put_fn) (void * obj, char c);
+    bool (*write_fn) (void * obj, char const * str, size_t n);
+
+    bool operator () (char c) {return put_fn(obj, c);}
+    bool write (char const * str, size_t n) {return write_fn(obj, str, n);}
+
+    template <typename OutF>
+    static OutRef Of (OutF & out) {
+        OutRef ret;
+        ret.obj = &out;
+        ret.put_fn = [](void * obj, char c) {return bool((*static_cast<OutF *>(obj))(c));};
+        if constexpr (cvt::HasWriteV<OutF>) {
+            ret.write_fn = [](void * obj, char const * str, size_t n) {return bool(static_cast<OutF *>(obj)->write(str, n));};
+        } else {
+            ret.write_fn = [](void * obj, char const * str, size_t n) {
+                bool ok = true;
+                for (size_t i = 0; i < n && ok; ++i)
+                    ok = bool((*static_cast<OutF *>(obj))(str[i]));
+                return ok;
+            };
+        }
+        return ret;
     }
-}
-template <typename ErrF, typename OutF, typename InF, typename ArgType0, typename ArgType1, typename ArgType2, typename ArgType3>
-inline bool EmitArg (unsigned idx, cvt::Flags flags, ErrF && err, OutF && out, InF && in, ArgType0 && arg0, ArgType1 && arg1, ArgType2 && arg2, ArgType3 && arg3) {
-    switch (idx) {
-    case  0: return EmitValue(std::forward<OutF>(out), std::forward<ArgType0>(arg0), flags);
-    case  1: return EmitValue(std::forward<OutF>(out), std::forward<ArgType1>(arg1), flags);
-    case  2: return EmitValue(std::forward<OutF>(out), std::forward<ArgType2>(arg2), flags);
-    case  3: return EmitValue(std::forward<OutF>(out), std::forward<ArgType3>(arg3), flags);
-    default: err(Err::TooFewArgs, std::forward<OutF>(out), std::forward<InF>(in)); return false;
+};
+
+// A format string that is known to be contiguous; used as the "in" functor
+//  by ToCStr(), ToStr(), etc. so that DoArgs() can read it directly.
+struct FmtStr {
+    char const * cur;
+    char const * end;
+
+    char operator () () {return (cur < end) ? *cur++ : '\0';}
+};
+
+struct InRef {
+    FmtStr str;             // Used when "get" is null
+    void * obj;
+    char (*get) (void * obj);
+
+    char operator () () {return get ? get(obj) : str();}
+
+    template <typename InF>
+    static InRef Of (InF & in) {
+        InRef ret = {};
+        if constexpr (std::is_same_v<std::remove_cv_t<InF>, FmtStr>) {
+            ret.str = in;
+        } else {
+            ret.obj = &in;
+            ret.get = [](void * obj) {return char((*static_cast<InF *>(obj))());};
+        }
+        return ret;
     }
+};
+
+struct ErrRef {
+    void * obj;
+    bool (*report) (void * obj, Err err);
+
+    bool operator () (Err err) {return report(obj, err);}
+};
+
+//----------------------------------------------------------------------
+
+enum class ArgType : uint8_t {
+    Bool,
+    Char,
+    Int,
+    UInt,
+    Float,
+    Double,
+    Str,
+    Other,      // Anything else that has a cvt::ToStr(); called through "emit"
+};
+
+struct Arg {
+    ArgType type;
+    union {
+        bool b;
+        char c;
+        long long i;
+        unsigned long long u;
+        float f;
+        double d;
+        struct {char const * ptr; size_t size;} str;
+        struct {void const * obj; void (*emit) (OutRef & out, void const * obj, cvt::Flags flags);} other;
+    };
+};
+
+template <typename T>
+void EmitOther (OutRef & out, void const * obj, cvt::Flags flags) {
+    cvt::ToStr(out, *static_cast<T const *>(obj), flags);
 }
-template <typename ErrF, typename OutF, typename InF, typename ArgType0, typename ArgType1, typename ArgType2, typename ArgType3, typename ArgType4>
-inline bool EmitArg (unsigned idx, cvt::Flags flags, ErrF && err, OutF && out, InF && in, ArgType0 && arg0, ArgType1 && arg1, ArgType2 && arg2, ArgType3 && arg3, ArgType4 && arg4) {
-    switch (idx) {
-    case  0: return EmitValue(std::forward<OutF>(out), std::forward<ArgType0>(arg0), flags);
-    case  1: return EmitValue(std::forward<OutF>(out), std::forward<ArgType1>(arg1), flags);
-    case  2: return EmitValue(std::forward<OutF>(out), std::forward<ArgType2>(arg2), flags);
-    case  3: return EmitValue(std::forward<OutF>(out), std::forward<ArgType3>(arg3), flags);
-    case  4: return EmitValue(std::forward<OutF>(out), std::forward<ArgType4>(arg4), flags);
-    default: err(Err::TooFewArgs, std::forward<OutF>(out), std::forward<InF>(in)); return false;
+
+template <typename T>
+Arg MakeArg (T const & v) {
+    using U = std::remove_cv_t<std::decay_t<T>>;
+    Arg ret;
+    if constexpr (std::is_same_v<U, bool>) {
+        ret.type = ArgType::Bool; ret.b = v;
+    } else if constexpr (std::is_same_v<U, char> || std::is_same_v<U, signed char>) {
+        ret.type = ArgType::Char; ret.c = char(v);
+    } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U> && sizeof(U) <= sizeof(long long)) {
+        ret.type = ArgType::Int; ret.i = v;
+    } else if constexpr (std::is_integral_v<U> && std::is_unsigned_v<U> && sizeof(U) <= sizeof(long long)) {
+        ret.type = ArgType::UInt; ret.u = v;
+    } else if constexpr (std::is_same_v<U, float>) {
+        ret.type = ArgType::Float; ret.f = v;
+    } else if constexpr (std::is_same_v<U, double>) {
+        ret.type = ArgType::Double; ret.d = v;
+    } else if constexpr (std::is_same_v<U, char *> || std::is_same_v<U, char const *>) {
+        char const * p = v;
+        ret.type = ArgType::Str; ret.str.ptr = p; ret.str.size = p ? ::strlen(p) : 0;
+#if defined(Y_OPT_FMT_SUPPORT_STD_STRING)
+    } else if constexpr (std::is_same_v<U, std::string> || std::is_same_v<U, std::string_view>) {
+        ret.type = ArgType::Str; ret.str.ptr = v.data(); ret.str.size = v.size();
+#endif  // defined(Y_OPT_FMT_SUPPORT_STD_STRING)
+    } else {
+        ret.type = ArgType::Other; ret.other.obj = &v; ret.other.emit = &EmitOther<T>;
     }
+    return ret;
 }
-template <typename ErrF, typename OutF, typename InF, typename ArgType0, typename ArgType1, typename ArgType2, typename ArgType3, typename ArgType4, typename ArgType5, typename ... ArgTypes>
-inline bool EmitArg (unsigned idx, cvt::Flags flags, ErrF && err, OutF && out, InF && in, ArgType0 && arg0, ArgType1 && arg1, ArgType2 && arg2, ArgType3 && arg3, ArgType4 && arg4, ArgType5 && arg5, ArgTypes && ... args) {
-    switch (idx) {
-    case  0: return EmitValue(std::forward<OutF>(out), std::forward<ArgType0>(arg0), flags);
-    case  1: return EmitValue(std::forward<OutF>(out), std::forward<ArgType1>(arg1), flags);
-    case  2: return EmitValue(std::forward<OutF>(out), std::forward<ArgType2>(arg2), flags);
-    case  3: return EmitValue(std::forward<OutF>(out), std::forward<ArgType3>(arg3), flags);
-    case  4: return EmitValue(std::forward<OutF>(out), std::forward<ArgType4>(arg4), flags);
-    case  5: return EmitValue(std::forward<OutF>(out), std::forward<ArgType5>(arg5), flags);
-    default: return EmitArg(idx - 6, std::forward<ErrF>(err), std::forward<OutF>(out), std::forward<InF>(in), std::forward<ArgTypes>(args)...);
+
+inline void EmitArg (OutRef & out, Arg const & arg, cvt::Flags flags) {
+    switch (arg.type) {
+    case ArgType::Bool: cvt::ToStr(out, arg.b, flags); break;
+    case ArgType::Char: cvt::ToStr(out, arg.c, flags); break;
+    case ArgType::Int:      // The narrower conversion is cheaper, and most values fit
+        if (arg.i == (long long)(int)arg.i)
+            cvt::ToStr(out, int(arg.i), flags);
+        else
+            cvt::ToStr(out, arg.i, flags);
+        break;
+    case ArgType::UInt:
+        if (arg.u == (unsigned long long)(unsigned)arg.u)
+            cvt::ToStr(out, unsigned(arg.u), flags);
+        else
+            cvt::ToStr(out, arg.u, flags);
+        break;
+    case ArgType::Float: cvt::ToStr(out, arg.f, flags); break;
+    case ArgType::Double: cvt::ToStr(out, arg.d, flags); break;
+    case ArgType::Str:
+        if (0 == flags.has_any_non_defaults)
+            cvt::PutRun(out, arg.str.ptr, arg.str.size);
+        else
+            cvt::ToStrHelper(out, arg.str.ptr, unsigned(arg.str.size), flags);
+        break;
+    case ArgType::Other: arg.other.emit(out, arg.other.obj, flags); break;
     }
 }
 
@@ -561,46 +674,98 @@ cvt::Flags ReadCvtFlags (InF && in) {
 }
 
 //----------------------------------------------------------------------
-// InF: A callable thing that returns a character-like object each time
-//      it is called. Should return 0 when the format string is finished.
-// OutF: A callable thing that will be called with a single character-like
-//      parameter that it should emit out to the output stream or whatever.
-//      It should return a bool-like thing, and when "false", the formatting
-//      operation will stop. Will be called with a 0 at the end of input
-//      (or upon error.)
-// ErrF: A callable thing that will be called with 3 parameters: an "Err"
-//      for the error code, the "out" object and the "in" object (in case
-//      it needs to extract some state from them, e.g. position, etc.) It
-//      should return a boolean-like thing to signal whether we should continue
-//      or not.
-template <typename ErrF, typename OutF, typename InF, typename ... ArgTypes>
-void Do (ErrF && err, OutF && out, InF && in, ArgTypes && ... args) {
+
+// Instantiated twice: for a contiguous format string, and for any other "in".
+template <typename InT>
+void DoArgsFrom (ErrRef err, OutRef out, InT in, Arg const * args, unsigned arg_count) {
+    char run [64];
+    unsigned run_size = 0;
+    auto flush = [&] {
+        bool ret = true;
+        if (run_size > 0)
+            ret = out.write(run, run_size);
+        run_size = 0;
+        return ret;
+    };
+    auto put = [&] (char c) {
+        run[run_size++] = c;
+        return run_size < sizeof(run) || flush();
+    };
+
     uint8_t cur_arg = 0;
     bool should_continue = true;
     while (should_continue) {
+        if constexpr (std::is_same_v<InT, FmtStr>) {
+            // Literal text up to the next spec goes out in one run
+            auto brace = static_cast<char const *>(::memchr(in.cur, '{', size_t(in.end - in.cur)));
+            auto stop = brace ? brace : in.end;
+            if (stop != in.cur) {
+                should_continue = flush() && out.write(in.cur, size_t(stop - in.cur));
+                in.cur = stop;
+                continue;
+            }
+        }
         auto c = in();
         if ('\0' == c) {
+            flush();
             should_continue = false;
         } else if ('{' == c) {
-            auto flags = ReadCvtFlags(std::forward<InF>(in));
+            auto flags = ReadCvtFlags(in);
             if (flags.valid) {
                 if (flags. escaped_curly_brace) {
-                    should_continue = out('{');
+                    should_continue = put('{');
                 } else {
                     if (!flags.explicit_index) {
                         flags.index = cur_arg++;
                     }
-                    should_continue = EmitArg(flags.index, flags, std::forward<ErrF>(err), std::forward<OutF>(out), std::forward<InF>(in), std::forward<ArgTypes>(args)...);
+                    should_continue = flush();
+                    if (should_continue && flags.index < arg_count) {
+                        EmitArg(out, args[flags.index], flags);
+                    } else if (should_continue) {
+                        err(Err::TooFewArgs);
+                        should_continue = false;
+                    }
                 }
             } else {
-                should_continue = err(Err::BadFormat, std::forward<OutF>(out), std::forward<InF>(in));
+                should_continue = flush() && err(Err::BadFormat);
             }
         } else {
-            should_continue = out(c);
+            should_continue = put(c);
         }
     }
-    //if (cur_arg != sizeof...(args))
-    //    err(Err::TooManyArgs, std::forward<OutF>(out), std::forward<InF>(in));
+    //if (cur_arg != arg_count)
+    //    err(Err::TooManyArgs);
+}
+
+inline void DoArgs (ErrRef err, OutRef out, InRef in, Arg const * args, unsigned arg_count) {
+    if (in.get)
+        DoArgsFrom(err, out, in, args, arg_count);
+    else
+        DoArgsFrom(err, out, in.str, args, arg_count);
+}
+
+// InF: A callable thing that returns a character-like object each time
+//      it is called. Should return 0 when the format string is finished.
+// OutF: A callable thing that will be called with a single character-like
+//      parameter that it should emit out to the output stream or whatever.
+//      It should return a bool-like thing, and when "false", the formatting
+//      operation will stop. Will be called with a 0 at the end of input
+//      (or upon error.)
+// ErrF: A callable thing that will be called with 3 parameters: an "Err"
+//      for the error code, the "out" object and the "in" object (in case
+//      it needs to extract some state from them, e.g. position, etc.) It
+//      should return a boolean-like thing to signal whether we should continue
+//      or not.
+// If OutF has a "write" (see cvt::HasWrite,) literal text is gathered and
+//  handed to it in runs. Any number of arguments can be passed; only the
+//  packing is generated per call site, the formatting itself is DoArgs().
+template <typename ErrF, typename OutF, typename InF, typename ... ArgTypes>
+void Do (ErrF && err, OutF && out, InF && in, ArgTypes && ... args) {
+    Arg const packed [sizeof...(args) > 0 ? sizeof...(args) : 1] = {MakeArg(args)...};
+    auto on_err = [&] (Err e) {return bool(err(e, std::forward<OutF>(out), std::forward<InF>(in)));};
+    using OnErr = decltype(on_err);
+    ErrRef err_ref = {&on_err, [](void * obj, Err e) {return (*static_cast<OnErr *>(obj))(e);}};
+    DoArgs(err_ref, OutRef::Of(out), InRef::Of(in), packed, unsigned(sizeof...(args)));
 }
 
 //----------------------------------------------------------------------
@@ -626,6 +791,95 @@ auto UTF8inator (OutF && out) {
     };
 }
 
+//----------------------------------------------------------------------
+// The output functors behind ToCStr(), ToStr(), etc.; all of them take runs.
+
+struct CStrSink {
+    char * buffer;
+    unsigned size;      // Not counting the NUL
+    unsigned & ret;
+
+    bool operator () (char c) {if (ret < size) buffer[ret++] = c; return ret <= size;}
+    bool write (char const * str, size_t n) {
+        size_t const room = size - ret;
+        size_t const k = (n < room) ? n : room;
+        ::memcpy(buffer + ret, str, k);
+        ret += unsigned(k);
+        return ret <= size;
+    }
+};
+
+#if defined(Y_OPT_FMT_SUPPORT_STDIO)
+struct FileSink {
+    FILE * file;
+    unsigned & ret;     // Characters actually written
+
+    bool operator () (char c) {
+        bool const ok = (::fputc(c, file) != EOF);
+        ret += ok ? 1 : 0;
+        return ok;
+    }
+    bool write (char const * str, size_t n) {
+        size_t const k = ::fwrite(str, 1, n, file);
+        ret += unsigned(k);
+        return k == n;
+    }
+};
+#endif  // defined(Y_OPT_FMT_SUPPORT_STDIO)
+
+#if defined(Y_OPT_FMT_SUPPORT_IOSTREAM)
+struct OStreamSink {
+    std::ostream & os;
+    unsigned & ret;
+
+    bool operator () (char c) {os.put(c); ret += os ? 1 : 0; return bool(os);}
+    bool write (char const * str, size_t n) {os.write(str, std::streamsize(n)); ret += os ? unsigned(n) : 0; return bool(os);}
+};
+#endif  // defined(Y_OPT_FMT_SUPPORT_IOSTREAM)
+
+#if defined(Y_OPT_FMT_SUPPORT_STD_STRING)
+// Formats into a stack buffer and only spills into the string when that fills
+//  up (the string then grows geometrically on its own), so a short result is a
+//  single exact-size allocation and nothing is ever formatted twice.
+// Call Finish() once the formatter is done; the sink must not be copied.
+struct StdStringBuilderSink {
+    std::string & str;
+    size_t used = 0;
+    char stack [Y_OPT_FMT_STD_STRING_STACK_BUFFER_SIZE];
+
+    explicit StdStringBuilderSink (std::string & s) : str (s) {}
+    StdStringBuilderSink (StdStringBuilderSink const &) = delete;
+    StdStringBuilderSink & operator = (StdStringBuilderSink const &) = delete;
+
+    bool operator () (char c) {
+        if (used == sizeof(stack))
+            spill();
+        stack[used++] = c;
+        return true;
+    }
+    bool write (char const * s, size_t n) {
+        if (n > sizeof(stack) - used) {
+            spill();
+            if (n > sizeof(stack)) {
+                str.append(s, n);
+                return true;
+            }
+        }
+        ::memcpy(stack + used, s, n);
+        used += n;
+        return true;
+    }
+    void spill () {str.append(stack, used); used = 0;}
+    void Finish () {
+        if (str.empty())
+            str.assign(stack, used);
+        else
+            str.append(stack, used);
+        used = 0;
+    }
+};
+#endif  // defined(Y_OPT_FMT_SUPPORT_STD_STRING)
+
 //----------------------------------------------------------------------
 
         }   // namespace _detail
@@ -639,8 +893,8 @@ unsigned ToCStr (char * buffer, unsigned size, char const * fmt, ArgTypes && ...
         size -= 1;
         detail::Do(
             [](auto, auto, auto){return false;},
-            [&](auto c){if (ret < size) buffer[ret++] = c; return ret <= size;},
-            [&]{return *fmt++;},
+            detail::CStrSink{buffer, size, ret},
+            detail::FmtStr{fmt, fmt + ::strlen(fmt)},
             std::forward<ArgTypes>(args)...
         );
         buffer[ret++] = '\0';
@@ -653,7 +907,7 @@ unsigned ToCStr (char * buffer, unsigned size, char const * fmt, ArgTypes && ...
 #if defined(Y_OPT_FMT_SUPPORT_STD_STRING)
 template <typename ... ArgTypes>
 unsigned ToCStr (char * buffer, unsigned size, std::string const & fmt, ArgTypes && ... args) {
-    return ToCStr(buffer, size, fmt.c_str(), std::forward<ArgTypes>(args));
+    return ToCStr(buffer, size, fmt.c_str(), std::forward<ArgTypes>(args)...);
 }
 #endif  // defined(Y_OPT_FMT_SUPPORT_STD_STRING)
 
@@ -665,11 +919,10 @@ unsigned ToCStr (char * buffer, unsigned size, std::string_view const & fmt, Arg
     unsigned ret = 0;
     if (buffer && size && !fmt.empty()) {
         size -= 1;
-        unsigned idx = 0;
         detail::Do(
             [](auto, auto, auto){return false;},
-            [&](auto c){if (ret < size) buffer[ret++] = c; return ret <= size;},
-            [&]{return (idx < fmt.size()) ? fmt[idx++] : '\0';},
+            detail::CStrSink{buffer, size, ret},
+            detail::FmtStr{fmt.data(), fmt.data() + fmt.size()},
             std::forward<ArgTypes>(args)...
         );
         buffer[ret++] = '\0';
@@ -687,8 +940,8 @@ unsigned ToFile (FILE * file, char const * fmt, ArgTypes && ... args) {
     if (file && fmt) {
         detail::Do(
             [](auto, auto, auto){return false;},
-            [&](auto c){return ::fputc(c, file) != EOF;},
-            [&]{return *fmt++;},
+            detail::FileSink{file, ret},
+            detail::FmtStr{fmt, fmt + ::strlen(fmt)},
             std::forward<ArgTypes>(args)...
         );
     }
@@ -714,8 +967,8 @@ unsigned ToFile (std::ostream & os, char const * fmt, ArgTypes && ... args) {
     if (os && fmt) {
         detail::Do(
             [](auto, auto, auto){return false;},
-            [&](auto c){os.put(c); return bool(os);},
-            [&]{return *fmt++;},
+            detail::OStreamSink{os, ret},
+            detail::FmtStr{fmt, fmt + ::strlen(fmt)},
             std::forward<ArgTypes>(args)...
         );
     }
@@ -730,23 +983,14 @@ template <typename ... ArgTypes>
 std::string ToStr (char const * fmt, ArgTypes && ... args) {
     std::string ret;
     if (fmt) {
-    #if defined(Y_OPT_FMT_STD_STRING_OUTPUT_PRECALC_SIZE)
-        size_t len = 0;
-        char const * fmt_cpy = fmt;
+        detail::StdStringBuilderSink sink {ret};
         detail::Do(
-            [](auto, auto, auto){return false;},
-            [&](auto){len++; return true;},
-            [&]{return *fmt_cpy++;},
-            std::forward<ArgTypes>(args)...
-        );
-        ret.reserve(len);
-    #endif
-        detail::Do(
-            [](auto, auto, auto){return false;},
-            [&](auto c){ret += c; return true;},
-            [&]{return *fmt++;},
+            [](auto, auto &&, auto &&){return false;},
+            sink,
+            detail::FmtStr{fmt, fmt + ::strlen(fmt)},
             std::forward<ArgTypes>(args)...
         );
+        sink.Finish();
     }
     return ret;
 }
@@ -767,30 +1011,256 @@ std::string ToStr (std::string const & fmt, ArgTypes && ... args) {
 template <typename ... ArgTypes>
 std::string ToStr (std::string_view const & fmt, ArgTypes && ... args) {
     std::string ret;
-    if (fmt) {
-        size_t idx = 0;
-    #if defined(Y_OPT_FMT_STD_STRING_OUTPUT_PRECALC_SIZE)
-        size_t len = 0;
-        detail::Do(
-            [](auto, auto, auto){return false;},
-            [&](auto){len++;},
-            [&]{return (idx < fmt.size()) ? fmt[idx++] : '\0';},
-            std::forward<ArgTypes>(args)...
-        );
-        idx = 0;
-    #endif
-        ret.reserve(len);
+    if (!fmt.empty()) {
+        detail::StdStringBuilderSink sink {ret};
         detail::Do(
-            [](auto, auto, auto){return false;},
-            [&](auto c){ret += c;},
-            [&]{return (idx < fmt.size()) ? fmt[idx++] : '\0';},
+            [](auto, auto &&, auto &&){return false;},
+            sink,
+            detail::FmtStr{fmt.data(), fmt.data() + fmt.size()},
             std::forward<ArgTypes>(args)...
         );
+        sink.Finish();
     }
     return ret;
 }
 #endif  // defined(Y_OPT_FMT_SUPPORT_IOSTREAM)
 
+//======================================================================
+// Compiled formats: Y_FMT("...") makes a format string that is parsed at
+//  compile time (into literal runs and specs; a bad spec or a missing
+//  argument fails to compile,) and is then emitted as a straight line of
+//  literal copies and cvt::ToStr() calls, with no parsing at run time.
+//  Pass it wherever a format string goes:
+//      auto s = y::fmt::ToStr(Y_FMT("{} + {w4r} = {}"), a, b, a + b);
+
+#define Y_FMT(literal_)                                                         \
+    ([]{                                                                        \
+        struct Y_FmtLiteral_ {                                                  \
+            static constexpr char const * Str () {return literal_;}             \
+        };                                                                      \
+        return ::y::fmt::CompiledFormat<Y_FmtLiteral_>{};                       \
+    }())
+
+        namespace detail {
+
+//----------------------------------------------------------------------
+
+// Either a run of literal characters, or a spec; the spec is kept apart from cvt::Flags (which is a union, so it
+//  can't be built at compile time) and turned into one where it's used.
+struct CompiledSegment {
+    bool is_arg;
+    unsigned begin;     // Literal run
+    unsigned size;
+    uint8_t index;      // Spec
+    uint8_t width;
+    uint8_t precision;
+    char fill;
+    uint8_t base;
+    cvt::Justify justify;
+    bool has_width, has_precision, has_fill, has_base, has_justify;
+};
+
+template <unsigned MaxSegments>
+struct CompiledSegments {
+    CompiledSegment segs [MaxSegments];
+    unsigned count;
+    unsigned arg_count;     // Highest argument index used, plus one
+    bool valid;
+};
+
+constexpr CompiledSegment LiteralSegment (unsigned begin, unsigned size) {
+    CompiledSegment ret = {};
+    ret.begin = begin;
+    ret.size = size;
+    return ret;
+}
+
+constexpr unsigned ConstStrLen (char const * s) {
+    unsigned ret = 0;
+    while (s[ret])
+        ++ret;
+    return ret;
+}
+
+// Accepts the same specs as ReadCvtFlags(), starting right after the '{'; false if it's not valid.
+constexpr bool ParseCompiledSpec (char const * s, unsigned & pos, CompiledSegment & seg, bool & explicit_index) {
+    seg.is_arg = true;
+    explicit_index = false;
+    unsigned idx = 0;
+    while ('0' <= s[pos] && s[pos] <= '9') {
+        idx = 10 * idx + (s[pos++] - '0');
+        explicit_index = true;
+    }
+    seg.index = uint8_t(idx);
+    if ('w' == s[pos]) {
+        unsigned v = 0;
+        for (++pos; '0' <= s[pos] && s[pos] <= '9'; ++pos) {v = 10 * v + (s[pos] - '0'); seg.has_width = true;}
+        seg.width = uint8_t(v);
+    }
+    if ('p' == s[pos]) {
+        unsigned v = 0;
+        for (++pos; '0' <= s[pos] && s[pos] <= '9'; ++pos) {v = 10 * v + (s[pos] - '0'); seg.has_precision = true;}
+        seg.precision = uint8_t(v);
+    }
+    if ('f' == s[pos] && s[pos + 1]) {
+        seg.fill = s[pos + 1];
+        seg.has_fill = true;
+        pos += 2;
+    }
+    if ('b' == s[pos]) {
+        unsigned v = 0;
+        for (++pos; '0' <= s[pos] && s[pos] <= '9'; ++pos) {v = 10 * v + (s[pos] - '0'); seg.has_base = true;}
+        seg.base = uint8_t(v);
+    }
+    if ('+' == s[pos] || '_' == s[pos])
+        ++pos;
+    if ('c' == s[pos] || 'C' == s[pos] || 'r' == s[pos]) {
+        seg.justify = ('c' == s[pos]) ? cvt::Justify::CenterLeft : (('C' == s[pos]) ? cvt::Justify::CenterRight : cvt::Justify::Right);
+        seg.has_justify = true;
+        ++pos;
+    }
+    if ('U' == s[pos])
+        ++pos;
+    bool const ret = ('}' == s[pos]);
+    if (ret)
+        ++pos;
+    return ret;
+}
+
+template <unsigned MaxSegments>
+constexpr CompiledSegments<MaxSegments> CompileFormat (char const * s) {
+    CompiledSegments<MaxSegments> ret = {};
+    ret.valid = true;
+    unsigned cur_arg = 0;
+    unsigned pos = 0;
+    while (ret.valid && s[pos]) {
+        if ('{' == s[pos] && '{' == s[pos + 1]) {
+            ret.segs[ret.count++] = LiteralSegment(pos, 1);
+            pos += 2;
+        } else if ('{' == s[pos]) {
+            ++pos;
+            CompiledSegment seg = {};
+            bool explicit_index = false;
+            ret.valid = ParseCompiledSpec(s, pos, seg, explicit_index);
+            if (!explicit_index)
+                seg.index = uint8_t(cur_arg++);
+            if (seg.index + 1u > ret.arg_count)
+                ret.arg_count = seg.index + 1u;
+            ret.segs[ret.count++] = seg;
+        } else {
+            unsigned const begin = pos;
+            while (s[pos] && '{' != s[pos])
+                ++pos;
+            ret.segs[ret.count++] = LiteralSegment(begin, pos - begin);
+        }
+    }
+    return ret;
+}
+
+inline cvt::Flags MakeFlags (CompiledSegment const & seg) {
+    cvt::Flags ret = {};
+    ret.overridden.width = seg.has_width;
+    ret.overridden.precision = seg.has_precision;
+    ret.overridden.fill = seg.has_fill;
+    ret.overridden.base = seg.has_base;
+    ret.overridden.justify = seg.has_justify;
+    ret.index = seg.index;
+    ret.width = seg.width;
+    ret.precision = seg.precision;
+    ret.fill = seg.fill;
+    ret.base = seg.base;
+    ret.justify = seg.justify;
+    ret.valid = true;
+    return ret;
+}
+
+//----------------------------------------------------------------------
+
+        }   // namespace detail
+
+//======================================================================
+
+template <typename LiteralT>
+struct CompiledFormat {
+    static constexpr char const * Str = LiteralT::Str();
+    static constexpr auto Segments = detail::CompileFormat<detail::ConstStrLen(LiteralT::Str()) + 1>(LiteralT::Str());
+    static_assert(Segments.valid, "Bad format spec in a Y_FMT() format string");
+};
+
+        namespace detail {
+
+// Like DoArgs(), a literal run that the output functor refuses stops the whole thing.
+template <typename FmtT, unsigned I, typename OutF, typename ArgsTuple>
+inline bool EmitCompiledSegment (OutF && out, ArgsTuple && args) {
+    constexpr CompiledSegment seg = FmtT::Segments.segs[I];
+    bool ret = true;
+    if constexpr (seg.is_arg) {
+        cvt::ToStr(out, std::get<seg.index>(std::forward<ArgsTuple>(args)), MakeFlags(seg));
+    } else {
+        ret = cvt::PutRun(out, FmtT::Str + seg.begin, seg.size);
+    }
+    return ret;
+}
+
+template <typename FmtT, typename OutF, typename ArgsTuple, unsigned ... Is>
+inline bool EmitCompiledSegments (OutF && out, ArgsTuple && args, std::integer_sequence<unsigned, Is...>) {
+    return (true && ... && EmitCompiledSegment<FmtT, Is>(out, args));
+}
+
+// The compiled counterpart of Do(); there's nothing to go wrong in the format
+//  at run time, so no ErrF. Returns false if the output functor stopped it.
+template <typename LiteralT, typename OutF, typename ... ArgTypes>
+inline bool DoCompiled (CompiledFormat<LiteralT>, OutF && out, ArgTypes && ... args) {
+    using FmtT = CompiledFormat<LiteralT>;
+    static_assert(FmtT::Segments.arg_count <= sizeof...(ArgTypes), "Too few arguments for a Y_FMT() format string");
+    return EmitCompiledSegments<FmtT>(std::forward<OutF>(out), std::forward_as_tuple(std::forward<ArgTypes>(args)...), std::make_integer_sequence<unsigned, FmtT::Segments.count>{});
+}
+
+        }   // namespace detail
+
+//----------------------------------------------------------------------
+
+template <typename LiteralT, typename ... ArgTypes>
+unsigned ToCStr (char * buffer, unsigned size, CompiledFormat<LiteralT> fmt, ArgTypes && ... args) {
+    unsigned ret = 0;
+    if (buffer && size) {
+        size -= 1;
+        detail::DoCompiled(fmt, detail::CStrSink{buffer, size, ret}, std::forward<ArgTypes>(args)...);
+        buffer[ret++] = '\0';
+    }
+    return ret;
+}
+
+//----------------------------------------------------------------------
+
+#if defined(Y_OPT_FMT_SUPPORT_STDIO)
+template <typename LiteralT, typename ... ArgTypes>
+unsigned ToFile (FILE * file, CompiledFormat<LiteralT> fmt, ArgTypes && ... args) {
+    unsigned ret = 0;
+    if (file)
+        detail::DoCompiled(fmt, detail::FileSink{file, ret}, std::forward<ArgTypes>(args)...);
+    return ret;
+}
+
+template <typename LiteralT, typename ... ArgTypes>
+unsigned ToConsole (CompiledFormat<LiteralT> fmt, ArgTypes && ... args) {
+    return ToFile(stdout, fmt, std::forward<ArgTypes>(args)...);
+}
+#endif  // defined(Y_OPT_FMT_SUPPORT_STDIO)
+
+//----------------------------------------------------------------------
+
+#if defined(Y_OPT_FMT_SUPPORT_STD_STRING)
+template <typename LiteralT, typename ... ArgTypes>
+std::string ToStr (CompiledFormat<LiteralT> fmt, ArgTypes && ... args) {
+    std::string ret;
+    detail::StdStringBuilderSink sink {ret};
+    detail::DoCompiled(fmt, sink, std::forward<ArgTypes>(args)...);
+    sink.Finish();
+    return ret;
+}
+#endif  // defined(Y_OPT_FMT_SUPPORT_STD_STRING)
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 //======================================================================
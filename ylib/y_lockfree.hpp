@@ -258,6 +258,116 @@ private:
     mutable std::atomic<u64> m_cursors;
 };
 
+//======================================================================
+// A single-producer, single-consumer ring of variable-sized records (e.g.
+//  a message header followed by its payload.) The producer reserve()s room
+//  for a record, fills it in and commit()s it; the consumer peek()s at the
+//  oldest record and release()s it when done. Records never wrap around the
+//  end of the buffer (the producer leaves a marker and skips to the start,)
+//  so each one is contiguous and 8-byte aligned.
+// Each side only touches the other's cursor when its cached copy says the
+//  ring is full (or empty,) so an uncontended put or get is a few plain
+//  loads and stores and one release store.
+
+class SPSCRing {
+public:
+    SPSCRing (void * buffer, unsigned size)
+        : m_data (static_cast<char *>(buffer))
+        , m_size (size)
+    {
+        Y_ASSERT_STRONG(nullptr != m_data);
+        Y_ASSERT_STRONG((uintptr_t(m_data) & (Align - 1)) == 0, "Buffer must be 8-byte aligned.");
+        Y_ASSERT_STRONG(m_size >= 2 * HeaderSize);
+        Y_ASSERT_STRONG((m_size & (m_size - 1)) == 0, "Size must be a power of two.");
+    }
+
+    unsigned capacity () const noexcept {
+        return m_size;
+    }
+    bool empty () const noexcept {
+        return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+    }
+
+    // Producer side: returns null if there isn't room (right now, or ever;
+    //  a record, with its 8-byte header, can be at most half the ring.)
+    //  Only one record can be reserved at a time; it becomes visible to the
+    //  consumer on commit().
+    void * reserve (unsigned size) noexcept {
+        u64 const need = RecordSize(size);
+        if (need > m_size / 2)
+            return nullptr;
+        u64 head = m_head.load(std::memory_order_relaxed);
+        u64 const contiguous = m_size - (head & (m_size - 1));
+        u64 const total = (need <= contiguous) ? need : contiguous + need;
+        if (head + total - m_tail_cache > m_size) {
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if (head + total - m_tail_cache > m_size)
+                return nullptr;
+        }
+        if (need > contiguous) {
+            WriteHeader(head, WrapMarker);
+            head += contiguous;
+        }
+        WriteHeader(head, size);
+        m_reserved_head = head + need;
+        return m_data + (head & (m_size - 1)) + HeaderSize;
+    }
+    void commit () noexcept {
+        m_head.store(m_reserved_head, std::memory_order_release);
+    }
+
+    // Consumer side: returns null if there's nothing to read. The record
+    //  stays valid (and in the ring) until release().
+    void const * peek (unsigned & size) noexcept {
+        u64 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head_cache) {
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if (tail == m_head_cache)
+                return nullptr;
+        }
+        u32 len = ReadHeader(tail);
+        if (WrapMarker == len) {
+            tail += m_size - (tail & (m_size - 1));
+            len = ReadHeader(tail);
+        }
+        size = len;
+        m_peeked_tail = tail + RecordSize(len);
+        return m_data + (tail & (m_size - 1)) + HeaderSize;
+    }
+    void release () noexcept {
+        m_tail.store(m_peeked_tail, std::memory_order_release);
+    }
+
+private:
+    using u32 = uint32_t;
+
+    static constexpr u64 Align = 8;
+    static constexpr u64 HeaderSize = 8;    // A u32 size, padded for alignment
+    static constexpr u32 WrapMarker = 0xFFFF'FFFF;
+
+    static u64 RecordSize (u32 size) noexcept {
+        return (HeaderSize + size + Align - 1) & ~(Align - 1);
+    }
+    void WriteHeader (u64 pos, u32 value) noexcept {
+        *reinterpret_cast<u32 *>(m_data + (pos & (m_size - 1))) = value;
+    }
+    u32 ReadHeader (u64 pos) const noexcept {
+        return *reinterpret_cast<u32 const *>(m_data + (pos & (m_size - 1)));
+    }
+
+private:
+    char * const m_data;
+    unsigned const m_size;
+    // Producer's
+    alignas(64) std::atomic<u64> m_head {0};
+    u64 m_tail_cache = 0;
+    u64 m_reserved_head = 0;
+    // Consumer's
+    alignas(64) std::atomic<u64> m_tail {0};
+    u64 m_head_cache = 0;
+    u64 m_peeked_tail = 0;
+};
+
 //======================================================================
 
     }   // namespace Lockfree